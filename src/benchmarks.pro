@@ -0,0 +1,89 @@
+##############################################
+# Micro-benchmarks of the engine
+#
+# Build next to modbusengine.pro and run:
+#   microbenchmarks [--filter <substring>] [--json <file>] [--min-time <seconds>]
+##############################################
+
+TEMPLATE = app
+TARGET = microbenchmarks
+CONFIG += console
+CONFIG -= app_bundle
+CONFIG -= qt
+
+##############################################
+# benchmark files
+##############################################
+
+HEADERS += benchmarks/microbenchmark.hpp
+HEADERS += benchmarks/mocksqldriver.hpp
+
+SOURCES += benchmarks/microbenchmarks.cpp
+
+##############################################
+# the measured engine sources
+##############################################
+
+# Core source files
+SOURCES += core/logger.cpp
+SOURCES += core/mberror.cpp
+SOURCES += core/mblinemasterconnection.cpp
+SOURCES += core/mbrtubus.cpp
+SOURCES += core/mbtcpline.cpp
+SOURCES += core/mbtcpmasterconnection.cpp
+SOURCES += core/metrics.cpp
+SOURCES += core/modbuspdu.cpp
+SOURCES += core/symboltable.cpp
+SOURCES += core/trace.cpp
+
+# Modbus Driver modul sources
+SOURCES += modbusdriver/circuitbreaker.cpp
+SOURCES += modbusdriver/modbusblock.cpp
+SOURCES += modbusdriver/pollplanner.cpp
+SOURCES += modbusdriver/modbusdevice.cpp
+SOURCES += modbusdriver/modbusdriver.cpp
+SOURCES += modbusdriver/requestarbiter.cpp
+SOURCES += modbusdriver/statusevents.cpp
+
+# Tag Synchronizer modul sources
+SOURCES += tagsynchronizer/bittag.cpp
+SOURCES += tagsynchronizer/bytetag.cpp
+SOURCES += tagsynchronizer/dwordtag.cpp
+SOURCES += tagsynchronizer/real16tag.cpp
+SOURCES += tagsynchronizer/sqltagsink.cpp
+SOURCES += tagsynchronizer/tag.cpp
+SOURCES += tagsynchronizer/tagsink.cpp
+SOURCES += tagsynchronizer/tagsynchronizer.cpp
+SOURCES += tagsynchronizer/ubytetag.cpp
+SOURCES += tagsynchronizer/udwordtag.cpp
+SOURCES += tagsynchronizer/uwordtag.cpp
+SOURCES += tagsynchronizer/wordtag.cpp
+
+# SQL Driver modul sources
+SOURCES += sqldriver/mysqldriver.cpp
+
+# mbpro
+SOURCES += mbpro.cpp
+SOURCES += mbprocache.cpp
+
+##############################################
+# dynamic libraries
+##############################################
+
+# linking init
+unix: CONFIG += link_pkgconfig
+
+# libmodbus
+unix: PKGCONFIG += libmodbus
+
+# libmysqlcppconn
+unix: PKGCONFIG += libmysqlcppconn
+
+##############################################
+# other compile options
+##############################################
+
+# C++11, thread support and optimized build
+QMAKE_CXXFLAGS += -std=c++11
+QMAKE_CXXFLAGS_RELEASE += -O2 -DNDEBUG
+LIBS += -pthread
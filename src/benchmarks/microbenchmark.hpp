@@ -0,0 +1,272 @@
+#ifndef MICROBENCHMARK_HPP
+#define MICROBENCHMARK_HPP
+
+#include <chrono>
+#include <ctime>
+#include <sstream>
+#include <stdio.h>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace ModbusEngine
+{
+
+/**
+ * @brief The MicroBenchmark class
+ *
+ * Self-contained micro-benchmark runner.
+ *
+ * A benchmark is a function with a timed loop:
+ *
+ *      static void bench_something( MicroBenchmark::State& state )
+ *      {
+ *          ... setup ( not timed ) ...
+ *          while( state.next() )
+ *          {
+ *              MicroBenchmark::keep( do_something() );
+ *          }
+ *      }
+ *
+ * The iteration count grows until the loop runs for minTime, the result
+ * is the time per iteration. The JSON output follows the format of
+ * Google Benchmark ( context + benchmarks ), so its compare tools can
+ * track the regressions between the releases.
+ * It is a library class.
+ */
+class MicroBenchmark
+{
+
+public:
+    /// the timed loop of one run
+    class State
+    {
+    private:
+        long long iterations;
+        long long left;
+        bool started;
+        std::chrono::steady_clock::time_point start;
+        std::clock_t startCpu;
+        double realTime;
+        double cpuTime;
+
+    public:
+        State( long long iterations )
+        {
+            this->iterations = iterations;
+            this->left = iterations;
+            this->started = false;
+            this->realTime = 0;
+            this->cpuTime = 0;
+        }
+
+        /**
+         * @brief next
+         * @return false when the loop is done
+         *
+         * The first call starts the clock, the last one stops it.
+         */
+        bool next()
+        {
+            if( !this->started )
+            {
+                this->started = true;
+                this->startCpu = std::clock();
+                this->start = std::chrono::steady_clock::now();
+            }
+
+            if( this->left > 0 )
+            {
+                this->left--;
+                return true;
+            }
+
+            this->realTime = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now() - this->start ).count();
+            this->cpuTime = ( std::clock() - this->startCpu ) * 1e9 / CLOCKS_PER_SEC;
+
+            return false;
+        }
+
+        long long readIterations() { return this->iterations; }
+        double readRealTime() { return this->realTime; }
+        double readCpuTime() { return this->cpuTime; }
+    };
+
+    typedef void ( *Function )( State& );
+
+private:
+    /// one registered benchmark and its result
+    class Entry
+    {
+    public:
+        std::string name;
+        Function function;
+        long long iterations;
+        double realTime;
+        double cpuTime;
+    };
+
+    std::vector<Entry> entries;
+
+    /// minimum measured time of a benchmark in seconds
+    double minTime;
+
+    /**
+     * @brief escape
+     * @param text -> text
+     * @return JSON string content
+     */
+    static std::string escape( const std::string& text )
+    {
+        std::string _r;
+        for( size_t i = 0; i < text.size(); i++ )
+        {
+            if( text[ i ] == '"' || text[ i ] == '\\' ) _r += '\\';
+            _r += text[ i ];
+        }
+        return _r;
+    }
+
+public:
+    MicroBenchmark()
+    {
+        this->minTime = 0.5;
+    }
+
+    /**
+     * @brief keep
+     * @param value -> a result the compiler must not optimize away
+     */
+    template<typename T>
+    static void keep( const T& value )
+    {
+        asm volatile( "" : : "r,m"( value ) : "memory" );
+    }
+
+    /**
+     * @brief add
+     * @param name      -> benchmark name ( e.g. "Tag/word/readValueFromModbusDriver" )
+     * @param function  -> the benchmark function
+     */
+    void add( const std::string& name, Function function )
+    {
+        Entry _e;
+        _e.name = name;
+        _e.function = function;
+        _e.iterations = 0;
+        _e.realTime = 0;
+        _e.cpuTime = 0;
+
+        this->entries.push_back( _e );
+    }
+
+    /**
+     * @brief setMinTime
+     * @param seconds -> minimum measured time of a benchmark
+     */
+    void setMinTime( double seconds )
+    {
+        this->minTime = seconds;
+    }
+
+    /**
+     * @brief run
+     * @param filter -> only the benchmarks with this substring in the name run ( empty -> all )
+     *
+     * Runs the benchmarks and prints a table to the standard output.
+     */
+    void run( const std::string& filter )
+    {
+        std::vector<Entry> _done;
+
+        printf( "%-56s %14s %14s %12s\n", "Benchmark", "Time (ns)", "CPU (ns)", "Iterations" );
+
+        for( size_t i = 0; i < this->entries.size(); i++ )
+        {
+            Entry _e = this->entries[ i ];
+            if( !filter.empty() && _e.name.find( filter ) == std::string::npos ) continue;
+
+            long long _n = 1;
+            while( true )
+            {
+                State _state( _n );
+                _e.function( _state );
+
+                double _seconds = _state.readRealTime() / 1e9;
+                if( _seconds >= this->minTime || _n >= 1000000000LL )
+                {
+                    _e.iterations = _n;
+                    _e.realTime = _state.readRealTime() / _n;
+                    _e.cpuTime = _state.readCpuTime() / _n;
+                    break;
+                }
+
+                /// aim at the min time with some overshoot, grow at most 10x
+                double _factor = _seconds > 0 ? this->minTime * 1.4 / _seconds : 10.0;
+                _n = (long long)( _n * ( _factor > 10.0 ? 10.0 : ( _factor < 2.0 ? 2.0 : _factor ) ) );
+            }
+
+            printf( "%-56s %14.1f %14.1f %12lld\n", _e.name.c_str(), _e.realTime, _e.cpuTime, _e.iterations );
+            fflush( stdout );
+
+            _done.push_back( _e );
+        }
+
+        this->entries = _done;
+    }
+
+    /**
+     * @brief toJson
+     * @return the results of the last run() in JSON
+     */
+    std::string toJson()
+    {
+        std::stringstream _out;
+
+        char _date[ 64 ];
+        std::time_t _now = std::time( NULL );
+        std::strftime( _date, sizeof( _date ), "%Y-%m-%dT%H:%M:%S", std::localtime( &_now ) );
+
+        char _host[ 256 ] = "";
+        gethostname( _host, sizeof( _host ) - 1 );
+
+        _out << "{\n";
+        _out << "  \"context\": {\n";
+        _out << "    \"date\": \"" << _date << "\",\n";
+        _out << "    \"host_name\": \"" << escape( _host ) << "\",\n";
+        _out << "    \"num_cpus\": " << std::thread::hardware_concurrency() << ",\n";
+#ifdef NDEBUG
+        _out << "    \"library_build_type\": \"release\"\n";
+#else
+        _out << "    \"library_build_type\": \"debug\"\n";
+#endif
+        _out << "  },\n";
+        _out << "  \"benchmarks\": [";
+
+        for( size_t i = 0; i < this->entries.size(); i++ )
+        {
+            Entry& _e = this->entries[ i ];
+
+            _out << ( i == 0 ? "\n" : ",\n" );
+            _out << "    {\n";
+            _out << "      \"name\": \"" << escape( _e.name ) << "\",\n";
+            _out << "      \"run_type\": \"iteration\",\n";
+            _out << "      \"iterations\": " << _e.iterations << ",\n";
+            _out << "      \"real_time\": " << _e.realTime << ",\n";
+            _out << "      \"cpu_time\": " << _e.cpuTime << ",\n";
+            _out << "      \"time_unit\": \"ns\"\n";
+            _out << "    }";
+        }
+
+        _out << "\n  ]\n}\n";
+
+        return _out.str();
+    }
+
+};
+
+} // namespace ModbusEngine
+
+#endif // MICROBENCHMARK_HPP
@@ -0,0 +1,385 @@
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include "microbenchmark.hpp"
+#include "mocksqldriver.hpp"
+#include "../Core/conversion.hpp"
+#include "../Core/metrics.h"
+#include "../ModbusDriver/modbusdriver.h"
+#include "../TagSynchronizer/bittag.h"
+#include "../TagSynchronizer/bytetag.h"
+#include "../TagSynchronizer/dwordtag.h"
+#include "../TagSynchronizer/real16tag.h"
+#include "../TagSynchronizer/tagsynchronizer.h"
+#include "../TagSynchronizer/ubytetag.h"
+#include "../TagSynchronizer/udwordtag.h"
+#include "../TagSynchronizer/uwordtag.h"
+#include "../TagSynchronizer/wordtag.h"
+#include "../mbpro.h"
+
+using namespace ModbusEngine;
+
+/**
+ * @brief The FakeDriver class
+ *
+ * Driver data interface without blocks: every register reads seed + address,
+ * so the decode of the tags is measured alone.
+ */
+class FakeDriver : public ModbusDriverDataInterface
+{
+
+public:
+    /// changing it changes every value
+    uint16 seed;
+
+    FakeDriver()
+    {
+        this->seed = 0;
+    }
+
+    bool readBit( std::string, std::string, int nReg, int nBit ) throw( std::string )
+    {
+        return ( ( this->seed + nReg ) >> nBit ) & 1;
+    }
+
+    void writeBit( std::string, std::string, int, int, bool ) throw( std::string ){}
+
+    uint8 readByte( std::string, std::string, int nReg, int nByte ) throw( std::string )
+    {
+        return (uint8)( ( this->seed + nReg ) >> ( 8 * nByte ) );
+    }
+
+    void writeByte( std::string, std::string, int, int, uint8 ) throw( std::string ){}
+
+    uint16 readWord( std::string, std::string, int nReg ) throw( std::string )
+    {
+        return (uint16)( this->seed + nReg );
+    }
+
+    void writeWord( std::string, std::string, int, uint16 ) throw( std::string ){}
+
+    MBError::Code tryReadBit( Symbol, Symbol, int nReg, int nBit, bool& bit )
+    {
+        bit = ( ( this->seed + nReg ) >> nBit ) & 1;
+        return MBError::NO_ERROR;
+    }
+
+    MBError::Code tryWriteBit( Symbol, Symbol, int, int, bool )
+    {
+        return MBError::NO_ERROR;
+    }
+
+    MBError::Code tryReadByte( Symbol, Symbol, int nReg, int nByte, uint8& byte )
+    {
+        byte = (uint8)( ( this->seed + nReg ) >> ( 8 * nByte ) );
+        return MBError::NO_ERROR;
+    }
+
+    MBError::Code tryWriteByte( Symbol, Symbol, int, int, uint8 )
+    {
+        return MBError::NO_ERROR;
+    }
+
+    MBError::Code tryReadWord( Symbol, Symbol, int nReg, uint16& word )
+    {
+        word = (uint16)( this->seed + nReg );
+        return MBError::NO_ERROR;
+    }
+
+    MBError::Code tryWriteWord( Symbol, Symbol, int, uint16 )
+    {
+        return MBError::NO_ERROR;
+    }
+
+    MBError::Code tryDemand( Symbol, Symbol, int )
+    {
+        return MBError::NO_ERROR;
+    }
+
+    void doWrite(){}
+
+};
+
+/**
+ * @brief project_file
+ * @param tags -> number of the tags ( 50 per block, 2 blocks per device )
+ * @return path of a synthetic mbpro file, written at the first call
+ */
+static std::string project_file( int tags )
+{
+    static const char* const _types[] = { "bit", "byte", "ubyte", "word", "uword", "dword", "udword", "real16" };
+
+    std::stringstream _path;
+    _path << "/tmp/modbusengine-bench-" << tags << ".xml";
+
+    std::ifstream _check( _path.str().c_str() );
+    if( _check.good() ) return _path.str();
+
+    int _devices = ( tags + 99 ) / 100;
+    std::ofstream _f( _path.str().c_str() );
+
+    _f << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<mbpro>\n";
+    _f << "<project><name>Bench</name></project>\n";
+    _f << "<db><dbType>mysql</dbType><dbUrl>localhost</dbUrl><dbPort>3306</dbPort>"
+          "<dbName>bench</dbName><dbUser>bench</dbUser><dbPass></dbPass></db>\n";
+    _f << "<modbusdriver><devices>\n";
+
+    for( int d = 0; d < _devices; d++ )
+    {
+        _f << "<device><deviceId>DEV_" << d << "</deviceId><ip>127.0.0.1</ip><port>" << ( 20000 + d )
+           << "</port><slaveId>1</slaveId><responseTimeout>1000</responseTimeout>"
+              "<connectionTimeout>1000</connectionTimeout><blocks>\n";
+        for( int b = 0; b < 2; b++ )
+        {
+            _f << "<block><blockId>BLK_" << b << "</blockId><offset>" << ( b * 100 )
+               << "</offset><count>100</count><cycleTime>500</cycleTime><retries>1</retries></block>\n";
+        }
+        _f << "</blocks></device>\n";
+    }
+
+    _f << "</devices></modbusdriver>\n<taglist>\n";
+
+    for( int t = 0; t < tags; t++ )
+    {
+        int _slot = t % 100;
+        _f << "<tag name=\"tag_" << t << "\" deviceId=\"DEV_" << t / 100 << "\" blockId=\"BLK_" << _slot / 50
+           << "\" address=\"" << ( _slot % 50 ) * 2 << "\" subAddress=\"" << t % 8
+           << "\" type=\"" << _types[ t % 8 ] << "\" divider=\"10\"/>\n";
+    }
+
+    _f << "</taglist>\n</mbpro>\n";
+    _f.close();
+
+    return _path.str();
+}
+
+/**
+ ############################################################################
+ # Tag decode
+ ############################################################################
+*/
+
+template<class T>
+static void bench_tag_read( MicroBenchmark::State& state )
+{
+    FakeDriver _driver;
+    T _tag( 1, "tag", "DEV_0", "BLK_0", 10, 3, "1", "0", false, 10 );
+
+    while( state.next() )
+    {
+        _driver.seed++;
+        _tag.readValueFromModbusDriver( &_driver );
+        MicroBenchmark::keep( _tag.value );
+    }
+}
+
+/**
+ ############################################################################
+ # Conversion
+ ############################################################################
+*/
+
+static void bench_convert_string_to_int( MicroBenchmark::State& state )
+{
+    std::string _text = "12345";
+
+    while( state.next() )
+    {
+        MicroBenchmark::keep( Conversion::convert<std::string,int>( _text ) );
+    }
+}
+
+static void bench_convert_int_to_string( MicroBenchmark::State& state )
+{
+    int _value = 0;
+
+    while( state.next() )
+    {
+        MicroBenchmark::keep( Conversion::convert<int,std::string>( _value++ ) );
+    }
+}
+
+static void bench_convert_float_to_string( MicroBenchmark::State& state )
+{
+    float _value = 0.5f;
+
+    while( state.next() )
+    {
+        _value += 0.25f;
+        MicroBenchmark::keep( Conversion::toString( _value, 2 ) );
+    }
+}
+
+/**
+ ############################################################################
+ # ModbusDriver lookup ( the blocks are not started, so they are invalid )
+ ############################################################################
+*/
+
+template<int TAGS>
+static void bench_driver_try_read_word( MicroBenchmark::State& state )
+{
+    MBPro _mbpro( project_file( TAGS ) );
+    _mbpro.readMBPro();
+    MetricsRegistry _metrics;
+    ModbusDriver _driver( &_mbpro, &_metrics );
+
+    std::stringstream _last;
+    _last << "DEV_" << ( TAGS + 99 ) / 100 - 1;
+    Symbol _device = SymbolTable::find( _last.str() );
+    Symbol _block = SymbolTable::find( "BLK_1" );
+
+    while( state.next() )
+    {
+        uint16 _word;
+        MicroBenchmark::keep( _driver.tryReadWord( _device, _block, 110, _word ) );
+    }
+}
+
+template<int TAGS>
+static void bench_driver_read_word( MicroBenchmark::State& state )
+{
+    MBPro _mbpro( project_file( TAGS ) );
+    _mbpro.readMBPro();
+    MetricsRegistry _metrics;
+    ModbusDriver _driver( &_mbpro, &_metrics );
+
+    std::stringstream _last;
+    _last << "DEV_" << ( TAGS + 99 ) / 100 - 1;
+    std::string _device = _last.str();
+
+    while( state.next() )
+    {
+        try
+        {
+            MicroBenchmark::keep( _driver.readWord( _device, "BLK_1", 110 ) );
+        }
+        catch( std::string ex )
+        {
+            MicroBenchmark::keep( ex );
+        }
+    }
+}
+
+/**
+ ############################################################################
+ # mbpro parsing
+ ############################################################################
+*/
+
+template<int TAGS, bool CACHED>
+static void bench_read_mbpro( MicroBenchmark::State& state )
+{
+    std::string _path = project_file( TAGS );
+
+    /// the first load writes the cache
+    if( CACHED )
+    {
+        MBPro _mbpro( _path );
+        _mbpro.readMBPro();
+    }
+
+    while( state.next() )
+    {
+        MBPro _mbpro( _path, CACHED );
+        _mbpro.readMBPro();
+        MicroBenchmark::keep( _mbpro.taglist.tags.size() );
+    }
+}
+
+/**
+ ############################################################################
+ # TagSynchronizer decode cycle with the mock SQL sink
+ ############################################################################
+*/
+
+template<int TAGS, bool CHANGING>
+static void bench_tagsync_read( MicroBenchmark::State& state )
+{
+    MBPro _mbpro( project_file( TAGS ) );
+    _mbpro.readMBPro();
+    MetricsRegistry _metrics;
+    FakeDriver _driver;
+    MockSQLDriver _sql;
+    TagSynchronizer _sync( &_mbpro, &_driver, &_metrics, &_sql );
+
+    while( state.next() )
+    {
+        if( CHANGING )
+        {
+            _driver.seed++;
+        }
+        _sync.readCycle();
+        _sync.sinkCycle();
+    }
+
+    MicroBenchmark::keep( _sql.readStatements() );
+}
+
+int main( int argc, char* argv[] )
+{
+    std::string _filter;
+    std::string _json;
+    MicroBenchmark _bench;
+
+    for( int i = 1; i < argc; i++ )
+    {
+        std::string _arg( argv[ i ] );
+
+        if( _arg == "--filter" && i + 1 < argc )
+        {
+            _filter = argv[ ++i ];
+        }
+        else if( _arg == "--json" && i + 1 < argc )
+        {
+            _json = argv[ ++i ];
+        }
+        else if( _arg == "--min-time" && i + 1 < argc )
+        {
+            _bench.setMinTime( atof( argv[ ++i ] ) );
+        }
+        else
+        {
+            std::cout << "Usage:" << std::endl;
+            std::cout << "microbenchmarks [--filter <substring>] [--json <file>] [--min-time <seconds>]" << std::endl;
+            return -1;
+        }
+    }
+
+    _bench.add( "Tag/bit/readValueFromModbusDriver", &bench_tag_read<BitTag> );
+    _bench.add( "Tag/byte/readValueFromModbusDriver", &bench_tag_read<ByteTag> );
+    _bench.add( "Tag/ubyte/readValueFromModbusDriver", &bench_tag_read<UByteTag> );
+    _bench.add( "Tag/word/readValueFromModbusDriver", &bench_tag_read<WordTag> );
+    _bench.add( "Tag/uword/readValueFromModbusDriver", &bench_tag_read<UWordTag> );
+    _bench.add( "Tag/dword/readValueFromModbusDriver", &bench_tag_read<DWordTag> );
+    _bench.add( "Tag/udword/readValueFromModbusDriver", &bench_tag_read<UDWordTag> );
+    _bench.add( "Tag/real16/readValueFromModbusDriver", &bench_tag_read<Real16Tag> );
+
+    _bench.add( "Conversion/convert/string_to_int", &bench_convert_string_to_int );
+    _bench.add( "Conversion/convert/int_to_string", &bench_convert_int_to_string );
+    _bench.add( "Conversion/toString/float", &bench_convert_float_to_string );
+
+    _bench.add( "ModbusDriver/tryReadWord/100_devices", &bench_driver_try_read_word<10000> );
+    _bench.add( "ModbusDriver/readWord/100_devices/invalid_block", &bench_driver_read_word<10000> );
+
+    _bench.add( "MBPro/readMBPro/100_tags", &bench_read_mbpro<100,false> );
+    _bench.add( "MBPro/readMBPro/1000_tags", &bench_read_mbpro<1000,false> );
+    _bench.add( "MBPro/readMBPro/10000_tags", &bench_read_mbpro<10000,false> );
+    _bench.add( "MBPro/readMBPro/10000_tags/cached", &bench_read_mbpro<10000,true> );
+
+    _bench.add( "TagSynchronizer/do_read/1000_tags/unchanged", &bench_tagsync_read<1000,false> );
+    _bench.add( "TagSynchronizer/do_read/1000_tags/changing", &bench_tagsync_read<1000,true> );
+    _bench.add( "TagSynchronizer/do_read/10000_tags/changing", &bench_tagsync_read<10000,true> );
+
+    _bench.run( _filter );
+
+    if( !_json.empty() )
+    {
+        std::ofstream _out( _json.c_str() );
+        _out << _bench.toJson();
+    }
+
+    return 0;
+}
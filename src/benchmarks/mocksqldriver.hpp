@@ -0,0 +1,62 @@
+#ifndef MOCKSQLDRIVER_HPP
+#define MOCKSQLDRIVER_HPP
+
+#include <map>
+#include <string>
+
+#include "../SQLDriver/sqldriver.h"
+
+namespace ModbusEngine
+{
+
+/**
+ * @brief The MockSQLDriver class
+ *
+ * SQL sink without database for the benchmarks. Counts the statements
+ * and their bytes, the control table always reads write_flag=0.
+ */
+class MockSQLDriver : public SQLDriver
+{
+
+private:
+    unsigned long long statements;
+    unsigned long long bytes;
+
+public:
+    MockSQLDriver()
+    {
+        this->statements = 0;
+        this->bytes = 0;
+    }
+
+    void connect() throw( SQLDriverException ){}
+    void close() throw( SQLDriverException ){}
+
+    void execute( std::string sql ) throw( SQLDriverException )
+    {
+        this->statements++;
+        this->bytes += sql.size();
+    }
+
+    SQLResult executeQuery( std::string sql ) throw( SQLDriverException )
+    {
+        this->statements++;
+        this->bytes += sql.size();
+
+        std::map<std::string,std::string> _row;
+        _row[ "write_flag" ] = "0";
+
+        std::map<int,SQLRow> _rows;
+        _rows[ 0 ] = SQLRow( _row );
+
+        return SQLResult( _rows );
+    }
+
+    unsigned long long readStatements() { return this->statements; }
+    unsigned long long readBytes() { return this->bytes; }
+
+};
+
+} // namespace ModbusEngine
+
+#endif // MOCKSQLDRIVER_HPP
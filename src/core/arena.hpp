@@ -0,0 +1,135 @@
+#ifndef ARENA_HPP
+#define ARENA_HPP
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace ModbusEngine
+{
+
+/**
+ * @brief The Arena class
+ *
+ * Monotonic object arena. The objects are constructed one after the other
+ * in a few large chunks, so the objects created together sit together in
+ * the memory. There is no delete for one object: the destructor of the
+ * arena destroys all objects ( in reverse order ) and frees the chunks at
+ * once. It is not thread safe. It is a library class.
+ */
+class Arena
+{
+
+private:
+    /// the default size of a chunk
+    static const size_t CHUNK_SIZE = 64 * 1024;
+
+    /// a destructor to call, stored in the arena before its object
+    class Finalizer
+    {
+    public:
+        void (*destroy)( void* );
+        void* object;
+        Finalizer* next;
+    };
+
+    std::vector<char*> chunks;
+    /// the free part of the last chunk
+    char* pos;
+    char* end;
+    /// the last created object with a destructor
+    Finalizer* finalizers;
+
+    Arena( const Arena& );
+    Arena& operator=( const Arena& );
+
+    template<typename T>
+    static void destroy( void* object )
+    {
+        static_cast<T*>( object )->~T();
+    }
+
+    /**
+     * @brief allocate
+     * @param size  -> bytes
+     * @param align -> alignment ( power of two )
+     * @return aligned raw memory of the arena
+     */
+    void* allocate( size_t size, size_t align )
+    {
+        char* _p = (char*)( ( (size_t)this->pos + align - 1 ) & ~( align - 1 ) );
+
+        if( this->pos == NULL || _p + size > this->end )
+        {
+            size_t _size = CHUNK_SIZE;
+            if( size + align > _size )
+            {
+                _size = size + align;
+            }
+
+            char* _chunk = (char*)std::malloc( _size );
+
+            if( _chunk == NULL )
+            {
+                throw std::bad_alloc();
+            }
+
+            this->chunks.push_back( _chunk );
+            this->pos = _chunk;
+            this->end = _chunk + _size;
+
+            _p = (char*)( ( (size_t)this->pos + align - 1 ) & ~( align - 1 ) );
+        }
+
+        this->pos = _p + size;
+
+        return _p;
+    }
+
+public:
+    Arena()
+    {
+        this->pos = NULL;
+        this->end = NULL;
+        this->finalizers = NULL;
+    }
+
+    ~Arena()
+    {
+        for( Finalizer* _f = this->finalizers; _f != NULL; _f = _f->next )
+        {
+            _f->destroy( _f->object );
+        }
+
+        for( size_t i = 0; i < this->chunks.size(); i++ )
+        {
+            std::free( this->chunks[ i ] );
+        }
+    }
+
+    /**
+     * @brief create
+     * @param args -> the arguments of the constructor
+     * @return the new object, it lives until the arena is destroyed
+     */
+    template<typename T, typename... Args>
+    T* create( Args&&... args )
+    {
+        Finalizer* _f = new( this->allocate( sizeof( Finalizer ), alignof( Finalizer ) ) ) Finalizer();
+        T* _object = new( this->allocate( sizeof( T ), alignof( T ) ) ) T( std::forward<Args>( args )... );
+
+        _f->destroy = &Arena::destroy<T>;
+        _f->object = _object;
+        _f->next = this->finalizers;
+        this->finalizers = _f;
+
+        return _object;
+    }
+
+};
+
+}
+
+#endif // ARENA_HPP
@@ -0,0 +1,117 @@
+#ifndef HISTOGRAM_HPP
+#define HISTOGRAM_HPP
+
+#include <atomic>
+
+namespace ModbusEngine
+{
+
+/**
+ * @brief The Histogram class
+ *
+ * Lock-free latency histogram with fixed buckets.
+ * The record() function only increments atomic counters, so it can be called
+ * from any thread without locking. It is a library class.
+ */
+class Histogram
+{
+
+public:
+    /// number of buckets, the last one is the +Inf bucket
+    static const int BUCKET_NUM = 17;
+
+private:
+    /// non cumulative bucket counters
+    std::atomic<unsigned long long> buckets[ BUCKET_NUM ];
+    /// summary of the recorded values in microsecs
+    std::atomic<unsigned long long> sum;
+    /// number of the recorded values
+    std::atomic<unsigned long long> count;
+
+public:
+    Histogram()
+    {
+        for( int i = 0; i < BUCKET_NUM; i++ )
+        {
+            this->buckets[ i ] = 0;
+        }
+
+        this->sum = 0;
+        this->count = 0;
+    }
+
+    /**
+     * @brief readBound
+     * @param bucket -> bucket index
+     * @return the upper bound of the bucket in microsecs, -1 for the +Inf bucket
+     */
+    static long long readBound( int bucket )
+    {
+        static const long long _bounds[ BUCKET_NUM ] = {
+            100, 200, 500, 1000, 2000, 5000, 10000, 20000, 50000, 100000,
+            200000, 500000, 1000000, 2000000, 5000000, 10000000, -1 };
+
+        return _bounds[ bucket ];
+    }
+
+    /**
+     * @brief record
+     * @param microseconds -> the measured value
+     */
+    void record( long long microseconds )
+    {
+        if( microseconds < 0 )
+        {
+            microseconds = 0;
+        }
+
+        int i = 0;
+        while( i < BUCKET_NUM - 1 && microseconds > readBound( i ) )
+        {
+            i++;
+        }
+
+        this->buckets[ i ].fetch_add( 1, std::memory_order_relaxed );
+        this->sum.fetch_add( (unsigned long long)microseconds, std::memory_order_relaxed );
+        this->count.fetch_add( 1, std::memory_order_relaxed );
+    }
+
+    /**
+     * @brief readBucket
+     * @param bucket -> bucket index
+     * @return number of values less or equal than the bound of the bucket
+     */
+    unsigned long long readBucket( int bucket )
+    {
+        unsigned long long _r = 0;
+        for( int i = 0; i <= bucket; i++ )
+        {
+            _r += this->buckets[ i ].load( std::memory_order_relaxed );
+        }
+
+        return _r;
+    }
+
+    /**
+     * @brief readSum
+     * @return summary of the recorded values in microsecs
+     */
+    unsigned long long readSum()
+    {
+        return this->sum.load( std::memory_order_relaxed );
+    }
+
+    /**
+     * @brief readCount
+     * @return number of the recorded values
+     */
+    unsigned long long readCount()
+    {
+        return this->count.load( std::memory_order_relaxed );
+    }
+
+};
+
+} // namespace ModbusEngine
+
+#endif // HISTOGRAM_HPP
@@ -0,0 +1,208 @@
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <sstream>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "logger.h"
+
+namespace ModbusEngine
+{
+
+Logger* Logger::logger = NULL;
+
+Logger::Logger( std::string filename, long long maxSize, int files, int level )
+    : queue( QUEUE_SIZE )
+{
+    this->filename = filename;
+    this->maxSize = maxSize;
+    this->files = files;
+    this->fd = -1;
+    this->size = 0;
+    this->minLevel.store( level );
+    this->dropped.store( 0 );
+    this->running.store( false );
+}
+
+void Logger::open( std::string filename, long long maxSize, int files, int level ) throw( std::string )
+{
+    logger = new Logger( filename, maxSize, files, level );
+
+    /// the writer retries the open when the caller goes on anyway
+    if( !logger->open_file() )
+    {
+        throw std::string( "Error: can not open the log file ( " + filename + " )" );
+    }
+}
+
+void Logger::start()
+{
+    if( logger == NULL ) return;
+
+    logger->running.store( true );
+    logger->startThread();
+}
+
+void Logger::log( int level, const std::string& message )
+{
+    if( logger == NULL || level < logger->minLevel.load( std::memory_order_relaxed ) ) return;
+
+    logger->push( level, message );
+}
+
+bool Logger::isLogged( int level )
+{
+    return logger != NULL && level >= logger->minLevel.load( std::memory_order_relaxed );
+}
+
+int Logger::toLevel( std::string name )
+{
+    if( name == "debug" ) return LEVEL_DEBUG;
+    if( name == "info" ) return LEVEL_INFO;
+    if( name == "warning" ) return LEVEL_WARNING;
+    if( name == "error" ) return LEVEL_ERROR;
+
+    return -1;
+}
+
+void Logger::push( int level, const std::string& message )
+{
+    Entry _entry;
+    _entry.level = level;
+    _entry.time = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::system_clock::now().time_since_epoch() ).count();
+
+    size_t _length = message.copy( _entry.text, MESSAGE_SIZE - 1 );
+    _entry.text[ _length ] = '\0';
+
+    if( !this->queue.push( _entry ) )
+    {
+        this->dropped.fetch_add( 1, std::memory_order_relaxed );
+    }
+}
+
+bool Logger::open_file()
+{
+    this->fd = ::open( this->filename.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644 );
+    if( this->fd < 0 ) return false;
+
+    struct stat _st;
+    this->size = fstat( this->fd, &_st ) == 0 ? (long long)_st.st_size : 0;
+
+    return true;
+}
+
+void Logger::rotate()
+{
+    ::close( this->fd );
+    this->fd = -1;
+
+    /// modbusengine.log.N-1 -> modbusengine.log.N, ..., modbusengine.log -> modbusengine.log.1
+    for( int i = this->files - 1; i > 0; i-- )
+    {
+        std::stringstream _from, _to;
+        _from << this->filename << "." << i;
+        _to << this->filename << "." << ( i + 1 );
+        std::rename( _from.str().c_str(), _to.str().c_str() );
+    }
+
+    if( this->files > 0 )
+    {
+        std::rename( this->filename.c_str(), ( this->filename + ".1" ).c_str() );
+    }
+    else
+    {
+        unlink( this->filename.c_str() );
+    }
+
+    open_file();
+}
+
+void Logger::write_batch( const std::string& batch )
+{
+    if( this->fd < 0 && !open_file() ) return;
+
+    const char* _data = batch.c_str();
+    size_t _left = batch.length();
+
+    while( _left > 0 )
+    {
+        ssize_t _written = ::write( this->fd, _data, _left );
+        if( _written <= 0 ) break;
+
+        _data += _written;
+        _left -= _written;
+        this->size += _written;
+    }
+
+    if( this->maxSize > 0 && this->size >= this->maxSize )
+    {
+        rotate();
+    }
+}
+
+std::string Logger::format( const Entry& entry )
+{
+    static const char* _levels[] = { "DEBUG", "INFO", "WARNING", "ERROR" };
+
+    std::time_t _seconds = (std::time_t)( entry.time / 1000000 );
+    int _millis = (int)( ( entry.time / 1000 ) % 1000 );
+
+    struct tm _tm;
+    localtime_r( &_seconds, &_tm );
+
+    char _head[ 48 ];
+    size_t _length = std::strftime( _head, sizeof( _head ), "%Y-%m-%d %H:%M:%S", &_tm );
+    std::snprintf( _head + _length, sizeof( _head ) - _length, ".%03d %-7s ", _millis,
+                   _levels[ entry.level < LEVEL_DEBUG || entry.level > LEVEL_ERROR ? LEVEL_ERROR : entry.level ] );
+
+    return std::string( _head ) + entry.text + "\n";
+}
+
+void Logger::run()
+{
+    Entry _entry;
+    std::string _batch;
+
+    while( this->running.load() )
+    {
+        Thread::msleep( FLUSH_PERIOD );
+
+        _batch.clear();
+
+        while( this->queue.pop( _entry ) )
+        {
+            _batch += format( _entry );
+        }
+
+        unsigned long long _dropped = this->dropped.exchange( 0, std::memory_order_relaxed );
+        if( _dropped > 0 )
+        {
+            std::stringstream _ss;
+            _ss << "Logger: " << _dropped << " messages dropped ( queue full )";
+
+            _entry.level = LEVEL_WARNING;
+            _entry.time = std::chrono::duration_cast<std::chrono::microseconds>(
+                        std::chrono::system_clock::now().time_since_epoch() ).count();
+            std::strncpy( _entry.text, _ss.str().c_str(), MESSAGE_SIZE - 1 );
+            _entry.text[ MESSAGE_SIZE - 1 ] = '\0';
+
+            _batch += format( _entry );
+        }
+
+        if( !_batch.empty() )
+        {
+            write_batch( _batch );
+        }
+    }
+}
+
+void Logger::halt()
+{
+    this->running.store( false );
+}
+
+} // namespace ModbusEngine
@@ -0,0 +1,175 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <atomic>
+#include <string>
+
+#include "mpscqueue.hpp"
+#include "thread.hpp"
+
+namespace ModbusEngine
+{
+
+/**
+ * @brief The Logger class
+ *
+ * Asynchronous log of the engine.
+ *
+ * The callers only format their message and push it to a lock-free
+ * MPSCQueue ( no syscall, no lock ), the writer thread wakes up in every
+ * FLUSH_PERIOD, adds the timestamps, batches the queued messages into
+ * one write and rotates the file by size
+ * ( modbusengine.log -> modbusengine.log.1 -> ... ).
+ * When the queue is full the message is dropped and counted, a logging
+ * caller never waits for the disk.
+ *
+ * Usage:
+ *
+ * 1. Call Logger::open()
+ * 2. Call Logger::start() ( after the fork )
+ * 3. Call Logger::log() from any thread
+ */
+
+class Logger : public Thread
+{
+
+public:
+    /// severity levels
+    static const int LEVEL_DEBUG = 0;
+    static const int LEVEL_INFO = 1;
+    static const int LEVEL_WARNING = 2;
+    static const int LEVEL_ERROR = 3;
+
+private:
+    /// defined class constants
+    static const int QUEUE_SIZE = 4096;
+    static const int MESSAGE_SIZE = 240;
+    /// the writer drains the queue in every FLUSH_PERIOD millisecs
+    static const int FLUSH_PERIOD = 100;
+
+    /// one queued message, fixed size so the queue never allocates
+    class Entry
+    {
+    public:
+        int level;
+        long long time;
+        char text[ MESSAGE_SIZE ];
+    };
+
+    /// the opened logger, NULL -> the messages are dropped silently
+    static Logger* logger;
+
+    /// file parameters
+    std::string filename;
+    long long maxSize;
+    int files;
+    int fd;
+    long long size;
+
+    /// minimum level of the logged messages
+    std::atomic<int> minLevel;
+
+    /// the queued messages and the number of the dropped ones
+    MPSCQueue<Entry> queue;
+    std::atomic<unsigned long long> dropped;
+
+    /// thread stop flag
+    std::atomic<bool> running;
+
+    Logger( std::string filename, long long maxSize, int files, int level );
+
+    /**
+     * @brief push
+     * @param level     -> severity
+     * @param message   -> the message ( truncated to MESSAGE_SIZE - 1 )
+     */
+    void push( int level, const std::string& message );
+
+    /**
+     * @brief open_file
+     * @return the file is opened for append
+     */
+    bool open_file();
+
+    /**
+     * @brief rotate
+     *
+     * Shifts the old files and opens a new one.
+     */
+    void rotate();
+
+    /**
+     * @brief write_batch
+     * @param batch -> the formatted lines
+     */
+    void write_batch( const std::string& batch );
+
+    /**
+     * @brief format
+     * @param entry -> queued message
+     * @return the line with timestamp and level
+     */
+    static std::string format( const Entry& entry );
+
+public:
+    /**
+     * @brief open
+     * @param filename  -> path of the log file
+     * @param maxSize   -> max size of the file in bytes before rotation
+     * @param files     -> number of the kept rotated files
+     * @param level     -> minimum level ( see toLevel() )
+     *
+     * Creates the logger. The function throws std::string exception when
+     * the file can not be opened.
+     */
+    static void open( std::string filename, long long maxSize, int files, int level ) throw( std::string );
+
+    /**
+     * @brief start
+     *
+     * Starts the writer thread of the opened logger.
+     */
+    static void start();
+
+    /**
+     * @brief log
+     * @param level     -> severity
+     * @param message   -> the message without newline
+     *
+     * Can be called from any thread, it never blocks.
+     */
+    static void log( int level, const std::string& message );
+
+    /**
+     * @brief isLogged
+     * @param level -> severity
+     * @return the messages of the level are logged ( the caller can skip formatting )
+     */
+    static bool isLogged( int level );
+
+    /**
+     * @brief toLevel
+     * @param name -> "debug", "info", "warning" or "error"
+     * @return the level, -1 when the name is unknown
+     */
+    static int toLevel( std::string name );
+
+    /**
+     * @brief run
+     *
+     * Inherited function from Thread class.
+     */
+    void run();
+
+    /**
+     * @brief halt
+     *
+     * Inherited function from Thread class.
+     */
+    void halt();
+
+};
+
+} // namespace ModbusEngine
+
+#endif // LOGGER_H
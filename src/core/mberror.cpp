@@ -0,0 +1,152 @@
+#include "mberror.h"
+
+namespace ModbusEngine
+{
+
+/// the names in the order of the codes
+static const char* const error_names[ MBError::CODE_NUM ] =
+{
+    "no_error",
+    "error_init",
+    "no_enough_memory",
+
+    "connection_failed",
+    "host_not_reachable",
+    "circuit_open",
+    "connection_reset",
+
+    "illegal_function_code",
+    "illegal_data_address",
+    "illegal_data_value",
+    "server_fail",
+    "error_ack",
+    "server_busy",
+    "negative_ack",
+    "memory_parity",
+    "gateway_path_exception",
+    "gateway_respond_exception",
+    "too_many_data",
+    "bad_exception",
+    "undefined_exception",
+
+    "response_timeout",
+    "bad_crc",
+    "bad_response",
+
+    "bad_device",
+    "bad_block",
+    "bad_register",
+    "bad_bit_number",
+    "bad_area",
+    "read_only_area",
+    "block_error",
+    "write_queue_full",
+    "stale_data"
+};
+
+std::string MBError::toString( Code code )
+{
+    if( code < 0 || code >= CODE_NUM )
+    {
+        return std::string( error_names[ UNDEFINED_EXCEPTION ] );
+    }
+
+    return std::string( error_names[ code ] );
+}
+
+MBError::Code MBError::fromString( const std::string& name )
+{
+    for( int i = 0; i < CODE_NUM; i++ )
+    {
+        if( name == error_names[ i ] )
+        {
+            return (Code)i;
+        }
+    }
+
+    return UNDEFINED_EXCEPTION;
+}
+
+/// the names in the order of the categories
+static const char* const category_names[] =
+{
+    "none",
+    "link",
+    "timeout",
+    "protocol",
+    "framing",
+    "access"
+};
+
+MBError::Category MBError::category( Code code )
+{
+    switch( code )
+    {
+        case NO_ERROR :
+        case STALE_DATA :
+            return CATEGORY_NONE;
+
+        case RESPONSE_TIMEOUT :
+            return CATEGORY_TIMEOUT;
+
+        case ILLEGAL_FUNCTION_CODE :
+        case ILLEGAL_DATA_ADDRESS :
+        case ILLEGAL_DATA_VALUE :
+        case SERVER_FAIL :
+        case ERROR_ACK :
+        case SERVER_BUSY :
+        case NEGATIVE_ACK :
+        case MEMORY_PARITY :
+        case GATEWAY_PATH_EXCEPTION :
+        case GATEWAY_RESPOND_EXCEPTION :
+        case BAD_EXCEPTION :
+            return CATEGORY_PROTOCOL;
+
+        case TOO_MANY_DATA :
+        case BAD_CRC :
+        case BAD_RESPONSE :
+            return CATEGORY_FRAMING;
+
+        case BAD_DEVICE :
+        case BAD_BLOCK :
+        case BAD_REGISTER :
+        case BAD_BIT_NUMBER :
+        case BAD_AREA :
+        case READ_ONLY_AREA :
+        case BLOCK_ERROR :
+        case WRITE_QUEUE_FULL :
+            return CATEGORY_ACCESS;
+
+        /// unknown errors are handled as a lost connection
+        default :
+            return CATEGORY_LINK;
+    }
+}
+
+std::string MBError::categoryToString( Category category )
+{
+    if( category < CATEGORY_NONE || category > CATEGORY_ACCESS )
+    {
+        return std::string( category_names[ CATEGORY_LINK ] );
+    }
+
+    return std::string( category_names[ category ] );
+}
+
+MBError::Recovery MBError::recovery( Code code )
+{
+    switch( category( code ) )
+    {
+        case CATEGORY_LINK :
+            return RECOVERY_RECONNECT;
+
+        case CATEGORY_TIMEOUT :
+        case CATEGORY_FRAMING :
+            return RECOVERY_FLUSH;
+
+        default :
+            return RECOVERY_NONE;
+    }
+}
+
+} // namespace ModbusEngine
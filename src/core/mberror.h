@@ -0,0 +1,147 @@
+#ifndef MBERROR_H
+#define MBERROR_H
+
+#include <string>
+
+namespace ModbusEngine
+{
+
+/**
+ * @brief The MBError class
+ *
+ * Error codes of the engine. The polling path ( connections, lines,
+ * blocks, devices, driver and tags ) returns these codes instead of
+ * throwing, only the compatibility functions of the driver throw
+ * the names of the codes ( see toString() ).
+ * Every code belongs to a category, and the category decides how the
+ * connection recovers from the error ( see recovery() ).
+ * It is a library class.
+ */
+
+class MBError
+{
+
+public:
+    /// error codes
+    enum Code
+    {
+        NO_ERROR = 0,
+        ERROR_INIT,
+        NO_ENOUGH_MEMORY,
+
+        /// connecting
+        CONNECTION_FAILED,
+        HOST_NOT_REACHABLE,
+        CIRCUIT_OPEN,
+        CONNECTION_RESET,
+
+        /// modbus exception responses
+        ILLEGAL_FUNCTION_CODE,
+        ILLEGAL_DATA_ADDRESS,
+        ILLEGAL_DATA_VALUE,
+        SERVER_FAIL,
+        ERROR_ACK,
+        SERVER_BUSY,
+        NEGATIVE_ACK,
+        MEMORY_PARITY,
+        GATEWAY_PATH_EXCEPTION,
+        GATEWAY_RESPOND_EXCEPTION,
+        TOO_MANY_DATA,
+        BAD_EXCEPTION,
+        UNDEFINED_EXCEPTION,
+
+        /// transport
+        RESPONSE_TIMEOUT,
+        BAD_CRC,
+        BAD_RESPONSE,
+
+        /// data access
+        BAD_DEVICE,
+        BAD_BLOCK,
+        BAD_REGISTER,
+        BAD_BIT_NUMBER,
+        BAD_AREA,
+        READ_ONLY_AREA,
+        BLOCK_ERROR,
+        WRITE_QUEUE_FULL,
+        /// the value is a restored last-known value ( not an error )
+        STALE_DATA,
+
+        CODE_NUM
+    };
+
+    /// error categories
+    enum Category
+    {
+        CATEGORY_NONE = 0,
+        /// the connection is lost or can not be opened
+        CATEGORY_LINK,
+        /// no answer in time
+        CATEGORY_TIMEOUT,
+        /// the slave answered with an exception response
+        CATEGORY_PROTOCOL,
+        /// the answer is corrupted or does not belong to the request
+        CATEGORY_FRAMING,
+        /// bad arguments of the data functions
+        CATEGORY_ACCESS
+    };
+
+    /// recovery actions
+    enum Recovery
+    {
+        /// the connection is healthy
+        RECOVERY_NONE = 0,
+        /// late or partial answers must be dropped
+        RECOVERY_FLUSH,
+        /// the connection must be dropped and connected again
+        RECOVERY_RECONNECT
+    };
+
+    /**
+     * @brief toString
+     * @param code -> error code
+     * @return the name of the code ( e.g. "response_timeout" )
+     */
+    static std::string toString( Code code );
+
+    /**
+     * @brief fromString
+     * @param name -> name of a code
+     * @return the code, UNDEFINED_EXCEPTION for unknown names
+     */
+    static Code fromString( const std::string& name );
+
+    /**
+     * @brief category
+     * @param code -> error code
+     * @return the category of the code
+     */
+    static Category category( Code code );
+
+    /**
+     * @brief categoryToString
+     * @param category -> error category
+     * @return the name of the category ( e.g. "timeout" )
+     */
+    static std::string categoryToString( Category category );
+
+    /**
+     * @brief recovery
+     * @param code -> error code
+     * @return what the connection has to do after the error
+     *
+     * Policy:
+     *
+     *      CATEGORY_LINK       -> RECOVERY_RECONNECT
+     *      CATEGORY_TIMEOUT    -> RECOVERY_FLUSH
+     *      CATEGORY_FRAMING    -> RECOVERY_FLUSH
+     *      CATEGORY_PROTOCOL   -> RECOVERY_NONE ( the slave is alive )
+     *      CATEGORY_ACCESS     -> RECOVERY_NONE
+     */
+    static Recovery recovery( Code code );
+
+};
+
+} // namespace ModbusEngine
+
+#endif // MBERROR_H
@@ -0,0 +1,98 @@
+#ifndef MBLINE_H
+#define MBLINE_H
+
+#include <string>
+#include <vector>
+
+#include "mberror.h"
+#include "types.h"
+
+namespace ModbusEngine
+{
+
+/**
+ * @brief The MBLine class
+ *
+ * Abstract communication line shared by more slaves. The slave is
+ * addressed in every request ( slave id / unit id ).
+ * The lines do the framing themselves, the pdus are built by ModbusPDU.
+ */
+
+class MBLine
+{
+
+public:
+    /// consecutive response timeouts of the line ( no slave answers ) before
+    /// a network line is closed: a half-open socket fails all of its slaves
+    static const int MAX_TIMEOUTS = 3;
+
+    virtual ~MBLine(){}
+
+    /**
+     * @brief open
+     * @param timeout -> connection timeout in millisecs
+     * @return NO_ERROR or CONNECTION_FAILED when the line can not be opened
+     *
+     * Opens the line when it is closed.
+     */
+    virtual MBError::Code open( int timeout ) = 0;
+
+    /**
+     * @brief close
+     *
+     * Closes the line.
+     */
+    virtual void close() = 0;
+
+    /**
+     * @brief flush
+     *
+     * Drops the unread bytes of the line.
+     */
+    virtual void flush() = 0;
+
+    /**
+     * @brief isOpen
+     * @return the line is open
+     */
+    virtual bool isOpen() = 0;
+
+    /**
+     * @brief frameOverhead
+     * @return bytes of the framing around a pdu ( MBAP header or address and CRC )
+     */
+    virtual int frameOverhead() = 0;
+
+    /**
+     * @brief transact
+     * @param slaveId           -> address of the slave
+     * @param request           -> the request pdu
+     * @param responseTimeout   -> response timeout in millisecs
+     * @param response          -> the response pdu (not checked)
+     * @return error code
+     *
+     * Sends the request to the slave and waits for the answer.
+     *
+     * Error codes:
+     *
+     *      CONNECTION_RESET    -> the line is closed or I/O error
+     *      RESPONSE_TIMEOUT    -> no answer ( MAX_TIMEOUTS in a row close a network line )
+     *      BAD_CRC             -> the answer is corrupted
+     *      BAD_RESPONSE        -> the answer came from an other slave
+     */
+    virtual MBError::Code transact( int slaveId,
+                                    const std::vector<uint8>& request,
+                                    int responseTimeout,
+                                    std::vector<uint8>& response ) = 0;
+
+    /**
+     * @brief readName
+     * @return the name of the line
+     */
+    virtual std::string readName() = 0;
+
+};
+
+} // namespace ModbusEngine
+
+#endif // MBLINE_H
@@ -0,0 +1,158 @@
+#include <chrono>
+
+#include "mblinemasterconnection.h"
+#include "modbuspdu.h"
+#include "trace.h"
+
+namespace ModbusEngine
+{
+
+MBLineMasterConnection::MBLineMasterConnection( MBLine* bus,
+                                              int slaveId,
+                                              int responseTimeout,
+                                              int connectionTimeout )
+{
+    this->bus = bus;
+    this->slaveId = slaveId;
+    this->responseTimeout = responseTimeout;
+    this->connectionTimeout = connectionTimeout;
+}
+
+MBError::Code MBLineMasterConnection::connect()
+{
+    return this->bus->open( this->connectionTimeout );
+}
+
+void MBLineMasterConnection::disconnect()
+{
+    /// the line is shared by the slaves, it closes itself on I/O error and
+    /// when no slave answers ( MBLine::MAX_TIMEOUTS ), one silent slave does
+    /// not close it for the others
+}
+
+void MBLineMasterConnection::flush()
+{
+    this->bus->flush();
+}
+
+MBLine* MBLineMasterConnection::delegateLine()
+{
+    return this->bus;
+}
+
+bool MBLineMasterConnection::isConnected()
+{
+    return this->bus->isOpen();
+}
+
+MBError::Code MBLineMasterConnection::do_request( const std::vector<uint8>& request,
+                                                  std::vector<uint8>& response )
+{
+    std::chrono::steady_clock::time_point _start = std::chrono::steady_clock::now();
+    int _overhead = this->bus->frameOverhead();
+
+    MBError::Code _error = this->bus->transact( this->slaveId,
+                                                request,
+                                                this->responseTimeout,
+                                                response );
+
+    if( _error == MBError::NO_ERROR )
+    {
+        Trace::begin( "decode" );
+        _error = ModbusPDU::checkResponse( request, response );
+        Trace::end( "decode" );
+    }
+
+    return this->account( _start,
+                          _error,
+                          _overhead + (int)request.size(),
+                          response.empty() ? 0 : _overhead + (int)response.size() );
+}
+
+MBError::Code MBLineMasterConnection::readCoils( int offset,
+                                                 int count,
+                                                 std::vector<uint16>& values )
+{
+    std::vector<uint8> _response;
+    MBError::Code _error =
+            this->do_request( ModbusPDU::buildRead( ModbusPDU::FC_READ_COILS, offset, count ), _response );
+
+    if( _error == MBError::NO_ERROR )
+    {
+        values = ModbusPDU::parseBits( _response, count );
+    }
+
+    return _error;
+} // readCoils
+
+MBError::Code MBLineMasterConnection::readDiscreteInputs( int offset,
+                                                          int count,
+                                                          std::vector<uint16>& values )
+{
+    std::vector<uint8> _response;
+    MBError::Code _error =
+            this->do_request( ModbusPDU::buildRead( ModbusPDU::FC_READ_DISCRETE_INPUTS, offset, count ), _response );
+
+    if( _error == MBError::NO_ERROR )
+    {
+        values = ModbusPDU::parseBits( _response, count );
+    }
+
+    return _error;
+} // readDiscreteInputs
+
+MBError::Code MBLineMasterConnection::readHoldingRegisters( int offset,
+                                                            int count,
+                                                            std::vector<uint16>& values )
+{
+    std::vector<uint8> _response;
+    MBError::Code _error =
+            this->do_request( ModbusPDU::buildRead( ModbusPDU::FC_READ_HOLDING_REGISTERS, offset, count ), _response );
+
+    if( _error == MBError::NO_ERROR )
+    {
+        values = ModbusPDU::parseRegisters( _response, count );
+    }
+
+    return _error;
+} // readHoldingRegisters
+
+MBError::Code MBLineMasterConnection::readInputRegisters( int offset,
+                                                          int count,
+                                                          std::vector<uint16>& values )
+{
+    std::vector<uint8> _response;
+    MBError::Code _error =
+            this->do_request( ModbusPDU::buildRead( ModbusPDU::FC_READ_INPUT_REGISTERS, offset, count ), _response );
+
+    if( _error == MBError::NO_ERROR )
+    {
+        values = ModbusPDU::parseRegisters( _response, count );
+    }
+
+    return _error;
+} // readInputRegisters
+
+MBError::Code MBLineMasterConnection::writeSingleCoil( int offset, bool value )
+{
+    std::vector<uint8> _response;
+    return this->do_request( ModbusPDU::buildWriteSingleCoil( offset, value ), _response );
+} // writeSingleCoil
+
+MBError::Code MBLineMasterConnection::writeMultipleCoils( int offset,
+                                                          int count,
+                                                          const std::vector<uint16>& values )
+{
+    std::vector<uint8> _response;
+    return this->do_request( ModbusPDU::buildWriteMultipleCoils( offset, count, values ), _response );
+} // writeMultipleCoils
+
+MBError::Code MBLineMasterConnection::writeMultipleRegisters( int offset,
+                                                              int count,
+                                                              const std::vector<uint16>& values )
+{
+    std::vector<uint8> _response;
+    return this->do_request( ModbusPDU::buildWriteMultipleRegisters( offset, count, values ), _response );
+} // writeMultipleRegisters
+
+} // namespace ModbusEngine
@@ -0,0 +1,96 @@
+#ifndef MBLINEMASTERCONNECTION_H
+#define MBLINEMASTERCONNECTION_H
+
+#include <string>
+#include <vector>
+
+#include "mbmasterconnection.h"
+#include "mbline.h"
+#include "types.h"
+
+namespace ModbusEngine
+{
+
+/**
+ * @brief The MBLineMasterConnection class
+ *
+ * Represents a modbus master connection of one slave on a shared
+ * line ( RTU serial, RTU over TCP or TCP gateway ) with master operations:
+ *   - connecting (opens the line)
+ *   - flush
+ *   - Read Coils - FC 0x01
+ *   - Read Discrete Inputs - FC 0x02
+ *   - Modbus Read Holding Registers - FC 0x03
+ *   - Read Input Registers - FC 0x04
+ *   - Write Single Coil - FC 0x05
+ *   - Write Multiple Coils - FC 0x0F
+ *   - Write Multiple Registers - FC 0x10
+ *
+ * The line is shared, so disconnect() does not close it: the line closes
+ * itself on I/O error, and a network line when none of its slaves
+ * answers ( MBLine::MAX_TIMEOUTS, a half-open socket ). A silent slave
+ * gives "response_timeout" and the other slaves of the line are not
+ * disturbed.
+ *
+ * The functions return the error codes of MBTCPMasterConnection and
+ * of MBLine::transact().
+ */
+
+class MBLineMasterConnection : public MBMasterConnection
+{
+
+private:
+    /// the shared line
+    MBLine* bus;
+
+    /// main parameters
+    int slaveId;
+    int responseTimeout;
+    int connectionTimeout;
+
+    /**
+     * @brief do_request
+     * @param request   -> the request pdu
+     * @param response  -> the checked response pdu
+     * @return error code
+     */
+    MBError::Code do_request( const std::vector<uint8>& request, std::vector<uint8>& response );
+
+public:
+    /**
+     * @brief MBLineMasterConnection
+     * @param bus                   -> the shared line
+     * @param slaveId               -> device slaveId
+     * @param responseTimeout       -> the timeout of the modbus question in millisecs
+     * @param connectionTimeout     -> the connecting timeout in millisecs
+     */
+    MBLineMasterConnection( MBLine* bus,
+                           int slaveId,
+                           int responseTimeout,
+                           int connectionTimeout );
+
+    MBLine* delegateLine();
+
+    MBError::Code connect();
+    void disconnect();
+    void flush();
+    bool isConnected();
+
+    MBError::Code readCoils( int offset, int count, std::vector<uint16>& values );
+    MBError::Code readDiscreteInputs( int offset, int count, std::vector<uint16>& values );
+    MBError::Code readHoldingRegisters( int offset, int count, std::vector<uint16>& values );
+    MBError::Code readInputRegisters( int offset, int count, std::vector<uint16>& values );
+
+    MBError::Code writeSingleCoil( int offset, bool value );
+    MBError::Code writeMultipleCoils( int offset,
+                                      int count,
+                                      const std::vector<uint16>& values );
+    MBError::Code writeMultipleRegisters( int offset,
+                                          int count,
+                                          const std::vector<uint16>& values );
+
+};
+
+} // namespace ModbusEngine
+
+#endif // MBLINEMASTERCONNECTION_H
@@ -0,0 +1,139 @@
+#ifndef MBMASTERCONNECTION_H
+#define MBMASTERCONNECTION_H
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "mberror.h"
+#include "metrics.h"
+#include "types.h"
+
+namespace ModbusEngine
+{
+
+class MBLine;
+
+/**
+ * @brief The MBMasterConnection class
+ *
+ * Abstract modbus master connection of one slave. The transports
+ * ( TCP, RTU, RTU over TCP ) implement it.
+ *
+ * Bit areas are delivered packed into uint16 words, LSB first
+ * ( bit i is the bit i%16 of the word i/16 ).
+ *
+ * The functions return the error codes listed at MBTCPMasterConnection,
+ * the read functions deliver the data in the values parameter.
+ *
+ * Every request is counted by the transports ( see account() ), the
+ * counters are added to the metrics registry by registerMetrics().
+ */
+
+class MBMasterConnection
+{
+
+protected:
+    /// request metrics (lock-free)
+    Counter requests;
+    Counter requestErrors;
+    Counter txBytes;
+    Counter rxBytes;
+    Histogram requestDuration;
+
+    /**
+     * @brief account
+     * @param start     -> start of the request
+     * @param error     -> result of the request
+     * @param tx        -> bytes sent
+     * @param rx        -> bytes received
+     * @return the error parameter
+     */
+    MBError::Code account( std::chrono::steady_clock::time_point start,
+                           MBError::Code error,
+                           int tx,
+                           int rx )
+    {
+        this->requests.add();
+        this->txBytes.add( tx );
+        this->rxBytes.add( rx );
+        this->requestDuration.record( std::chrono::duration_cast<std::chrono::microseconds>(
+                                          std::chrono::steady_clock::now() - start ).count() );
+
+        if( error != MBError::NO_ERROR )
+        {
+            this->requestErrors.add();
+        }
+
+        return error;
+    }
+
+public:
+    virtual ~MBMasterConnection(){}
+
+    /**
+     * @brief registerMetrics
+     * @param registry  -> the metrics registry
+     * @param labels    -> labels of the connection ( e.g. device="plc1" )
+     */
+    void registerMetrics( MetricsRegistry* registry, const std::string& labels )
+    {
+        registry->addCounter( "modbus_requests_total",
+                              "Modbus requests sent.", labels, &this->requests );
+        registry->addCounter( "modbus_request_errors_total",
+                              "Modbus requests without valid answer.", labels, &this->requestErrors );
+        registry->addCounter( "modbus_tx_bytes_total",
+                              "Bytes sent on the wire ( ADU ).", labels, &this->txBytes );
+        registry->addCounter( "modbus_rx_bytes_total",
+                              "Bytes received on the wire ( ADU ).", labels, &this->rxBytes );
+        registry->addHistogram( "modbus_request_duration_seconds",
+                                "Round trip time of the modbus requests.", labels, &this->requestDuration );
+    }
+
+    /**
+     * @brief unregisterMetrics
+     * @param registry -> the metrics registry
+     *
+     * Removes the metrics of the connection before it is deleted.
+     */
+    void unregisterMetrics( MetricsRegistry* registry )
+    {
+        registry->remove( &this->requests );
+        registry->remove( &this->requestErrors );
+        registry->remove( &this->txBytes );
+        registry->remove( &this->rxBytes );
+        registry->remove( &this->requestDuration );
+    }
+
+    /**
+     * @brief delegateLine
+     * @return the shared line of the connection, NULL if it has its own socket
+     */
+    virtual MBLine* delegateLine()
+    {
+        return NULL;
+    }
+
+    virtual MBError::Code connect() = 0;
+    virtual void disconnect() = 0;
+    virtual void flush() = 0;
+    virtual bool isConnected() = 0;
+
+    virtual MBError::Code readCoils( int offset, int count, std::vector<uint16>& values ) = 0;
+    virtual MBError::Code readDiscreteInputs( int offset, int count, std::vector<uint16>& values ) = 0;
+    virtual MBError::Code readHoldingRegisters( int offset, int count, std::vector<uint16>& values ) = 0;
+    virtual MBError::Code readInputRegisters( int offset, int count, std::vector<uint16>& values ) = 0;
+
+    virtual MBError::Code writeSingleCoil( int offset, bool value ) = 0;
+    virtual MBError::Code writeMultipleCoils( int offset,
+                                              int count,
+                                              const std::vector<uint16>& values ) = 0;
+    virtual MBError::Code writeMultipleRegisters( int offset,
+                                                  int count,
+                                                  const std::vector<uint16>& values ) = 0;
+
+};
+
+} //namespace ModbusEngine
+
+#endif // MBMASTERCONNECTION_H
@@ -0,0 +1,438 @@
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <sstream>
+#include <termios.h>
+#include <thread>
+#include <unistd.h>
+
+#include "mbrtubus.h"
+#include "modbuspdu.h"
+#include "trace.h"
+
+namespace ModbusEngine
+{
+
+/**
+ * @brief to_speed
+ * @param baudRate -> the baud rate
+ * @return the termios speed, B0 when the baud rate is not supported
+ */
+static speed_t to_speed( int baudRate )
+{
+    switch( baudRate )
+    {
+        case 1200 : return B1200;
+        case 2400 : return B2400;
+        case 4800 : return B4800;
+        case 9600 : return B9600;
+        case 19200 : return B19200;
+        case 38400 : return B38400;
+        case 57600 : return B57600;
+        case 115200 : return B115200;
+        case 230400 : return B230400;
+        default : return B0;
+    }
+}
+
+MBRTUBus::MBRTUBus( std::string serialPort,
+                    int baudRate,
+                    char parity,
+                    int dataBits,
+                    int stopBits )
+{
+    this->transport = TRANSPORT_SERIAL;
+    this->serialPort = serialPort;
+    this->baudRate = baudRate;
+    this->parity = parity;
+    this->dataBits = dataBits;
+    this->stopBits = stopBits;
+    this->port = 0;
+    this->fd = -1;
+    this->timeouts = 0;
+    this->opened = false;
+
+    /// t3.5 is 3.5 characters of 11 bits, but fixed 1750 us above 19200 baud
+    this->silence = ( baudRate > 19200 ) ? 1750 : 38500000 / baudRate;
+    this->lastFrame = std::chrono::steady_clock::now();
+}
+
+MBRTUBus::MBRTUBus( std::string ip, int port, SocketOptions options )
+{
+    this->transport = TRANSPORT_TCP;
+    this->ip = ip;
+    this->port = port;
+    this->options = options;
+    this->baudRate = 0;
+    this->parity = 'N';
+    this->dataBits = 8;
+    this->stopBits = 1;
+    this->fd = -1;
+    this->timeouts = 0;
+    this->opened = false;
+
+    /// the serial server keeps the silence on its own line
+    this->silence = 0;
+    this->lastFrame = std::chrono::steady_clock::now();
+}
+
+MBRTUBus::~MBRTUBus()
+{
+    this->close();
+}
+
+int MBRTUBus::open_serial()
+{
+    int _fd = ::open( this->serialPort.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK );
+
+    if( _fd == -1 )
+    {
+        return -1;
+    }
+
+    struct termios _tio;
+    memset( &_tio, 0, sizeof( _tio ) );
+
+    _tio.c_cflag = CREAD | CLOCAL;
+    _tio.c_cflag |= ( this->dataBits == 7 ) ? CS7 : CS8;
+    if( this->stopBits == 2 )
+    {
+        _tio.c_cflag |= CSTOPB;
+    }
+    if( this->parity == 'E' )
+    {
+        _tio.c_cflag |= PARENB;
+    }
+    else if( this->parity == 'O' )
+    {
+        _tio.c_cflag |= PARENB | PARODD;
+    }
+
+    /// raw mode, no character processing
+    _tio.c_iflag = ( this->parity == 'N' ) ? IGNPAR : INPCK;
+    _tio.c_oflag = 0;
+    _tio.c_lflag = 0;
+    _tio.c_cc[ VMIN ] = 0;
+    _tio.c_cc[ VTIME ] = 0;
+
+    if( cfsetispeed( &_tio, to_speed( this->baudRate ) ) == -1 ||
+        cfsetospeed( &_tio, to_speed( this->baudRate ) ) == -1 ||
+        tcsetattr( _fd, TCSANOW, &_tio ) == -1 )
+    {
+        ::close( _fd );
+        return -1;
+    }
+
+    tcflush( _fd, TCIOFLUSH );
+
+    return _fd;
+}
+
+int MBRTUBus::open_tcp( int timeout )
+{
+    return NetworkTester::connect( this->ip, this->port, timeout, this->options );
+}
+
+void MBRTUBus::close_line()
+{
+    if( this->fd != -1 )
+    {
+        ::close( this->fd );
+        this->fd = -1;
+    }
+    this->opened = false;
+}
+
+void MBRTUBus::discard_input()
+{
+    if( this->fd == -1 )
+    {
+        return;
+    }
+
+    if( this->transport == TRANSPORT_SERIAL )
+    {
+        tcflush( this->fd, TCIFLUSH );
+        return;
+    }
+
+    uint8 _buffer[ 256 ];
+    while( ::read( this->fd, _buffer, sizeof( _buffer ) ) > 0 )
+    {
+    }
+}
+
+MBError::Code MBRTUBus::write_frame( const std::vector<uint8>& frame, int timeout )
+{
+    size_t _sent = 0;
+
+    while( _sent < frame.size() )
+    {
+        ssize_t _n = ::write( this->fd, &frame[ _sent ], frame.size() - _sent );
+
+        if( _n > 0 )
+        {
+            _sent += _n;
+            continue;
+        }
+
+        if( _n == -1 && errno != EAGAIN && errno != EINTR )
+        {
+            this->close_line();
+            return MBError::CONNECTION_RESET;
+        }
+
+        struct pollfd _pfd;
+        _pfd.fd = this->fd;
+        _pfd.events = POLLOUT;
+        _pfd.revents = 0;
+
+        if( poll( &_pfd, 1, timeout ) == 0 )
+        {
+            return MBError::RESPONSE_TIMEOUT;
+        }
+    }
+
+    /// the response timeout starts when the frame is on the line
+    if( this->transport == TRANSPORT_SERIAL )
+    {
+        tcdrain( this->fd );
+    }
+
+    return MBError::NO_ERROR;
+}
+
+MBError::Code MBRTUBus::read_bytes( std::vector<uint8>& buffer,
+                                    int count,
+                                    std::chrono::steady_clock::time_point deadline )
+{
+    size_t _size = buffer.size() + count;
+    buffer.resize( _size );
+    size_t _pos = _size - count;
+
+    while( _pos < _size )
+    {
+        long long _left = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    deadline - std::chrono::steady_clock::now() ).count();
+
+        if( _left < 0 )
+        {
+            return MBError::RESPONSE_TIMEOUT;
+        }
+
+        struct pollfd _pfd;
+        _pfd.fd = this->fd;
+        _pfd.events = POLLIN;
+        _pfd.revents = 0;
+
+        int _ready = poll( &_pfd, 1, (int)_left );
+
+        if( _ready == 0 )
+        {
+            return MBError::RESPONSE_TIMEOUT;
+        }
+        if( _ready == -1 )
+        {
+            if( errno == EINTR ) continue;
+            this->close_line();
+            return MBError::CONNECTION_RESET;
+        }
+
+        ssize_t _n = ::read( this->fd, &buffer[ _pos ], _size - _pos );
+
+        if( _n > 0 )
+        {
+            _pos += _n;
+        }
+        else if( _n == 0 || ( errno != EAGAIN && errno != EINTR ) )
+        {
+            /// the serial server closed the connection or the line is gone
+            this->close_line();
+            return MBError::CONNECTION_RESET;
+        }
+    }
+
+    return MBError::NO_ERROR;
+}
+
+MBError::Code MBRTUBus::open( int timeout )
+{
+    this->busMutex.lock();
+
+    if( this->fd != -1 )
+    {
+        this->busMutex.unlock();
+        return MBError::NO_ERROR;
+    }
+
+    if( this->transport == TRANSPORT_SERIAL )
+    {
+        this->fd = this->open_serial();
+    }
+    else
+    {
+        this->fd = this->open_tcp( timeout );
+    }
+
+    if( this->fd == -1 )
+    {
+        this->busMutex.unlock();
+        return MBError::CONNECTION_FAILED;
+    }
+
+    this->opened = true;
+    this->timeouts = 0;
+    this->lastFrame = std::chrono::steady_clock::now();
+
+    this->busMutex.unlock();
+
+    return MBError::NO_ERROR;
+}
+
+void MBRTUBus::close()
+{
+    this->busMutex.lock();
+    this->close_line();
+    this->busMutex.unlock();
+}
+
+void MBRTUBus::flush()
+{
+    this->busMutex.lock();
+    this->discard_input();
+    this->busMutex.unlock();
+}
+
+bool MBRTUBus::isOpen()
+{
+    return this->opened;
+}
+
+int MBRTUBus::frameOverhead()
+{
+    /// slave address and CRC
+    return 3;
+}
+
+MBError::Code MBRTUBus::transact( int slaveId,
+                                  const std::vector<uint8>& request,
+                                  int responseTimeout,
+                                  std::vector<uint8>& response )
+{
+    std::lock_guard<std::mutex> _lock( this->busMutex );
+
+    if( this->fd == -1 )
+    {
+        return MBError::CONNECTION_RESET;
+    }
+
+    int _length = ModbusPDU::responseLength( request );
+
+    if( _length == -1 )
+    {
+        return MBError::ILLEGAL_FUNCTION_CODE;
+    }
+
+    /// address + pdu + crc (low byte first)
+    std::vector<uint8> _frame;
+    _frame.reserve( request.size() + 3 );
+    _frame.push_back( (uint8)slaveId );
+    _frame.insert( _frame.end(), request.begin(), request.end() );
+    uint16 _crc = ModbusPDU::crc16( &_frame[ 0 ], _frame.size() );
+    _frame.push_back( (uint8)( _crc & 0xFF ) );
+    _frame.push_back( (uint8)( _crc >> 8 ) );
+
+    /// inter-frame silence, the request goes out right after it
+    std::this_thread::sleep_until( this->lastFrame + std::chrono::microseconds( this->silence ) );
+
+    this->discard_input();
+
+    Trace::begin( "send" );
+    MBError::Code _error = this->write_frame( _frame, responseTimeout );
+    Trace::end( "send" );
+
+    if( _error != MBError::NO_ERROR )
+    {
+        return _error;
+    }
+
+    std::chrono::steady_clock::time_point _deadline =
+            std::chrono::steady_clock::now() + std::chrono::milliseconds( responseTimeout );
+
+    std::vector<uint8> _answer;
+    _answer.reserve( _length + 3 );
+
+    /// address + function code tells the length of the rest
+    Trace::begin( "receive" );
+    _error = this->read_bytes( _answer, 2, _deadline );
+
+    if( _error == MBError::NO_ERROR )
+    {
+        if( _answer[ 1 ] & ModbusPDU::EXCEPTION_BIT )
+        {
+            _error = this->read_bytes( _answer, 3, _deadline );
+        }
+        else
+        {
+            _error = this->read_bytes( _answer, _length + 1, _deadline );
+        }
+    }
+
+    Trace::end( "receive" );
+    this->lastFrame = std::chrono::steady_clock::now();
+
+    /// no slave answers: the socket of the serial server may be half-open
+    if( _error == MBError::RESPONSE_TIMEOUT && _answer.empty() )
+    {
+        if( ++this->timeouts >= MAX_TIMEOUTS && this->transport == TRANSPORT_TCP )
+        {
+            this->close_line();
+        }
+    }
+    else
+    {
+        this->timeouts = 0;
+    }
+
+    if( _error != MBError::NO_ERROR )
+    {
+        return _error;
+    }
+
+    uint16 _got = (uint16)( _answer[ _answer.size() - 2 ] | ( _answer[ _answer.size() - 1 ] << 8 ) );
+
+    if( ModbusPDU::crc16( &_answer[ 0 ], _answer.size() - 2 ) != _got )
+    {
+        this->discard_input();
+        return MBError::BAD_CRC;
+    }
+
+    if( _answer[ 0 ] != (uint8)slaveId )
+    {
+        return MBError::BAD_RESPONSE;
+    }
+
+    response.assign( _answer.begin() + 1, _answer.end() - 2 );
+
+    return MBError::NO_ERROR;
+}
+
+std::string MBRTUBus::readName()
+{
+    if( this->transport == TRANSPORT_SERIAL )
+    {
+        return this->serialPort;
+    }
+
+    std::stringstream _ss;
+    _ss << this->ip << ":" << this->port;
+    return _ss.str();
+}
+
+bool MBRTUBus::isValidBaudRate( int baudRate )
+{
+    return to_speed( baudRate ) != B0;
+}
+
+} // namespace ModbusEngine
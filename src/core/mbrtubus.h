@@ -0,0 +1,181 @@
+#ifndef MBRTUBUS_H
+#define MBRTUBUS_H
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "mbline.h"
+#include "networktester.hpp"
+#include "types.h"
+
+namespace ModbusEngine
+{
+
+/**
+ * @brief The MBRTUBus class
+ *
+ * One modbus RTU line shared by the slaves on it. The line is a serial
+ * port ( RS-232 / RS-485 ) or a TCP connection of a serial server
+ * ( RTU over TCP ).
+ *
+ * Features:
+ *   - RTU framing with CRC
+ *   - keeps the inter-frame silence (t3.5) of the serial line, but not more:
+ *     the next request goes out right when the silence is over
+ *   - discards the late answers before every request
+ *   - closes itself on I/O error, the TCP line on MAX_TIMEOUTS response
+ *     timeouts in a row too ( a half-open socket of the serial server )
+ *
+ * The requests must be serialized by the caller (RequestArbiter).
+ */
+
+class MBRTUBus : public MBLine
+{
+
+public:
+    /// transport types
+    static const int TRANSPORT_SERIAL = 0;
+    static const int TRANSPORT_TCP = 1;
+
+private:
+    /// Line parameters
+    int transport;
+    std::string serialPort;
+    int baudRate;
+    char parity;
+    int dataBits;
+    int stopBits;
+    std::string ip;
+    int port;
+    SocketOptions options;
+
+    /// inter-frame silence in microsecs
+    int silence;
+    /// end of the last frame on the line
+    std::chrono::steady_clock::time_point lastFrame;
+
+    /// file descriptor of the line
+    int fd;
+    /// response timeouts since the last answer of any slave
+    int timeouts;
+    std::atomic<bool> opened;
+
+    /// required mutex for multi threading support
+    std::mutex busMutex;
+
+    /**
+     * @brief open_serial
+     * @return the file descriptor, -1 on error
+     */
+    int open_serial();
+
+    /**
+     * @brief open_tcp
+     * @param timeout -> connection timeout in millisecs
+     * @return the file descriptor, -1 on error
+     */
+    int open_tcp( int timeout );
+
+    /**
+     * @brief close_line
+     *
+     * Closes the line. Called with locked busMutex.
+     */
+    void close_line();
+
+    /**
+     * @brief discard_input
+     *
+     * Drops the unread bytes of the line. Called with locked busMutex.
+     */
+    void discard_input();
+
+    /**
+     * @brief write_frame
+     * @param frame     -> the frame
+     * @param timeout   -> timeout in millisecs
+     * @return error code
+     *
+     * Error codes:
+     *
+     *      CONNECTION_RESET    -> I/O error, the line is closed
+     *      RESPONSE_TIMEOUT    -> the line is not writable
+     */
+    MBError::Code write_frame( const std::vector<uint8>& frame, int timeout );
+
+    /**
+     * @brief read_bytes
+     * @param buffer    -> the frame buffer to append
+     * @param count     -> number of bytes to read
+     * @param deadline  -> end of waiting
+     * @return error code
+     *
+     * Error codes:
+     *
+     *      CONNECTION_RESET    -> I/O error, the line is closed
+     *      RESPONSE_TIMEOUT    -> no answer until the deadline
+     */
+    MBError::Code read_bytes( std::vector<uint8>& buffer,
+                              int count,
+                              std::chrono::steady_clock::time_point deadline );
+
+public:
+    /**
+     * @brief MBRTUBus
+     * @param serialPort    -> the serial device (e.g. /dev/ttyS0)
+     * @param baudRate      -> baud rate
+     * @param parity        -> 'N', 'E' or 'O'
+     * @param dataBits      -> 7 or 8
+     * @param stopBits      -> 1 or 2
+     *
+     * Creates a serial line. Does not open it.
+     */
+    MBRTUBus( std::string serialPort,
+              int baudRate,
+              char parity,
+              int dataBits,
+              int stopBits );
+
+    /**
+     * @brief MBRTUBus
+     * @param ip        -> ip address of the serial server
+     * @param port      -> port of the serial server
+     * @param options   -> socket options
+     *
+     * Creates an RTU over TCP line. Does not open it.
+     */
+    MBRTUBus( std::string ip, int port, SocketOptions options );
+
+    /**
+     * @brief ~MBRTUBus
+     *
+     * Closes the line.
+     */
+    ~MBRTUBus();
+
+    MBError::Code open( int timeout );
+    void close();
+    void flush();
+    bool isOpen();
+    int frameOverhead();
+    MBError::Code transact( int slaveId,
+                            const std::vector<uint8>& request,
+                            int responseTimeout,
+                            std::vector<uint8>& response );
+    std::string readName();
+
+    /**
+     * @brief isValidBaudRate
+     * @param baudRate -> the baud rate
+     * @return the baud rate is supported
+     */
+    static bool isValidBaudRate( int baudRate );
+
+};
+
+} // namespace ModbusEngine
+
+#endif // MBRTUBUS_H
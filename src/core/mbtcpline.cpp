@@ -0,0 +1,380 @@
+#include <cerrno>
+#include <poll.h>
+#include <sstream>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "mbtcpline.h"
+#include "trace.h"
+
+namespace ModbusEngine
+{
+
+MBTCPLine::MBTCPLine( std::string ip, int port, int maxPipeline, SocketOptions options )
+{
+    this->ip = ip;
+    this->port = port;
+    this->maxPipeline = ( maxPipeline < 1 ) ? 1 : maxPipeline;
+    this->options = options;
+    this->fd = -1;
+    this->opened = false;
+    this->nextTransaction = 1;
+    this->reading = false;
+    this->senders = 0;
+    this->timeouts = 0;
+}
+
+MBTCPLine::~MBTCPLine()
+{
+    this->close();
+
+    for( size_t i = 0; i < this->staleFds.size(); i++ )
+    {
+        ::close( this->staleFds[ i ] );
+    }
+}
+
+void MBTCPLine::close_line( MBError::Code error )
+{
+    std::map<uint16,Pending*>::iterator _it = this->pending.begin();
+    for( ; _it != this->pending.end(); _it++ )
+    {
+        _it->second->done = true;
+        _it->second->error = error;
+    }
+    this->pending.clear();
+    this->rxBuffer.clear();
+
+    if( this->fd != -1 )
+    {
+        if( this->reading || this->senders > 0 )
+        {
+            /// wakes up the reader and the senders, the last of them closes the socket
+            shutdown( this->fd, SHUT_RDWR );
+            this->staleFds.push_back( this->fd );
+        }
+        else
+        {
+            ::close( this->fd );
+        }
+        this->fd = -1;
+    }
+
+    this->opened = false;
+    this->lineCond.notify_all();
+}
+
+void MBTCPLine::close_stale()
+{
+    if( this->reading || this->senders > 0 )
+    {
+        return;
+    }
+
+    for( size_t i = 0; i < this->staleFds.size(); i++ )
+    {
+        ::close( this->staleFds[ i ] );
+    }
+    this->staleFds.clear();
+}
+
+bool MBTCPLine::send_frame( int fd, const std::vector<uint8>& frame, std::chrono::steady_clock::time_point deadline )
+{
+    size_t _sent = 0;
+
+    while( _sent < frame.size() )
+    {
+        ssize_t _n = send( fd, &frame[ _sent ], frame.size() - _sent, MSG_NOSIGNAL );
+
+        if( _n > 0 )
+        {
+            _sent += _n;
+            continue;
+        }
+
+        if( _n == -1 && errno != EAGAIN && errno != EINTR )
+        {
+            return false;
+        }
+
+        long long _left = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    deadline - std::chrono::steady_clock::now() ).count();
+
+        if( _left <= 0 )
+        {
+            return false;
+        }
+
+        struct pollfd _pfd;
+        _pfd.fd = fd;
+        _pfd.events = POLLOUT;
+        _pfd.revents = 0;
+        poll( &_pfd, 1, (int)_left );
+    }
+
+    return true;
+}
+
+bool MBTCPLine::receive( int fd, std::chrono::steady_clock::time_point deadline )
+{
+    long long _left = std::chrono::duration_cast<std::chrono::milliseconds>(
+                deadline - std::chrono::steady_clock::now() ).count();
+
+    struct pollfd _pfd;
+    _pfd.fd = fd;
+    _pfd.events = POLLIN;
+    _pfd.revents = 0;
+
+    int _ready = poll( &_pfd, 1, ( _left > 0 ) ? (int)_left : 0 );
+
+    if( _ready == 0 )
+    {
+        return true;
+    }
+    if( _ready == -1 )
+    {
+        return errno == EINTR;
+    }
+
+    uint8 _buffer[ 1024 ];
+    ssize_t _n = ::read( fd, _buffer, sizeof( _buffer ) );
+
+    if( _n == 0 )
+    {
+        /// the gateway closed the connection
+        return false;
+    }
+    if( _n == -1 )
+    {
+        return errno == EAGAIN || errno == EINTR;
+    }
+
+    std::lock_guard<std::mutex> _lock( this->lineMutex );
+
+    this->rxBuffer.insert( this->rxBuffer.end(), _buffer, _buffer + _n );
+
+    /// MBAP header: transaction id, protocol id, length, unit id
+    while( this->rxBuffer.size() >= 7 )
+    {
+        int _length = ( this->rxBuffer[ 4 ] << 8 ) | this->rxBuffer[ 5 ];
+
+        if( _length < 2 || _length > 254 )
+        {
+            /// out of sync
+            return false;
+        }
+
+        size_t _total = 6 + _length;
+        if( this->rxBuffer.size() < _total )
+        {
+            break;
+        }
+
+        /// the gateway answers ( a late answer too ), the socket is alive
+        this->timeouts = 0;
+
+        uint16 _transaction = (uint16)( ( this->rxBuffer[ 0 ] << 8 ) | this->rxBuffer[ 1 ] );
+        std::map<uint16,Pending*>::iterator _it = this->pending.find( _transaction );
+
+        /// the late answers of the timed out requests are dropped
+        if( _it != this->pending.end() )
+        {
+            Pending* _p = _it->second;
+
+            if( this->rxBuffer[ 6 ] != (uint8)_p->slaveId )
+            {
+                _p->error = MBError::BAD_RESPONSE;
+            }
+            else
+            {
+                _p->response.assign( this->rxBuffer.begin() + 7, this->rxBuffer.begin() + _total );
+            }
+            _p->done = true;
+            this->pending.erase( _it );
+        }
+
+        this->rxBuffer.erase( this->rxBuffer.begin(), this->rxBuffer.begin() + _total );
+    }
+
+    return true;
+}
+
+MBError::Code MBTCPLine::open( int timeout )
+{
+    std::lock_guard<std::mutex> _lock( this->lineMutex );
+
+    if( this->fd != -1 )
+    {
+        return MBError::NO_ERROR;
+    }
+
+    this->fd = NetworkTester::connect( this->ip, this->port, timeout, this->options );
+
+    if( this->fd == -1 )
+    {
+        return MBError::CONNECTION_FAILED;
+    }
+
+    this->rxBuffer.clear();
+    this->timeouts = 0;
+    this->opened = true;
+
+    return MBError::NO_ERROR;
+}
+
+void MBTCPLine::close()
+{
+    std::lock_guard<std::mutex> _lock( this->lineMutex );
+    this->close_line( MBError::CONNECTION_RESET );
+}
+
+void MBTCPLine::flush()
+{
+    std::lock_guard<std::mutex> _lock( this->lineMutex );
+
+    /// late answers are dropped by their transaction id, the buffer
+    /// may hold the half of an other slave's answer while it is in flight
+    if( this->pending.empty() && !this->reading )
+    {
+        this->rxBuffer.clear();
+    }
+}
+
+bool MBTCPLine::isOpen()
+{
+    return this->opened;
+}
+
+int MBTCPLine::frameOverhead()
+{
+    /// MBAP header with the unit id
+    return 7;
+}
+
+MBError::Code MBTCPLine::transact( int slaveId,
+                                   const std::vector<uint8>& request,
+                                   int responseTimeout,
+                                   std::vector<uint8>& response )
+{
+    std::chrono::steady_clock::time_point _deadline =
+            std::chrono::steady_clock::now() + std::chrono::milliseconds( responseTimeout );
+
+    std::unique_lock<std::mutex> _lock( this->lineMutex );
+
+    /// waiting for a free place in the pipeline
+    while( this->fd != -1 && (int)this->pending.size() >= this->maxPipeline )
+    {
+        if( this->lineCond.wait_until( _lock, _deadline ) == std::cv_status::timeout &&
+            (int)this->pending.size() >= this->maxPipeline )
+        {
+            return MBError::RESPONSE_TIMEOUT;
+        }
+    }
+
+    if( this->fd == -1 )
+    {
+        return MBError::CONNECTION_RESET;
+    }
+
+    Pending _p;
+    _p.slaveId = slaveId;
+    _p.done = false;
+    _p.error = MBError::NO_ERROR;
+
+    uint16 _transaction = this->nextTransaction++;
+    this->pending[ _transaction ] = &_p;
+
+    std::vector<uint8> _frame;
+    _frame.reserve( request.size() + 7 );
+    _frame.push_back( (uint8)( _transaction >> 8 ) );
+    _frame.push_back( (uint8)( _transaction & 0xFF ) );
+    _frame.push_back( 0 );
+    _frame.push_back( 0 );
+    _frame.push_back( (uint8)( ( request.size() + 1 ) >> 8 ) );
+    _frame.push_back( (uint8)( ( request.size() + 1 ) & 0xFF ) );
+    _frame.push_back( (uint8)slaveId );
+    _frame.insert( _frame.end(), request.begin(), request.end() );
+
+    /// the reader dispatches the other answers while the frame is sent,
+    /// the frames are not interleaved on the wire
+    int _sendFd = this->fd;
+    this->senders++;
+    _lock.unlock();
+
+    this->sendMutex.lock();
+    Trace::begin( "send" );
+    bool _sent = this->send_frame( _sendFd, _frame, _deadline );
+    Trace::end( "send" );
+    this->sendMutex.unlock();
+
+    _lock.lock();
+    this->senders--;
+
+    /// a stalled gateway ( or a broken socket ) blocks the whole line, it is closed
+    if( !_sent && this->fd == _sendFd )
+    {
+        this->close_line( MBError::CONNECTION_RESET );
+    }
+    this->close_stale();
+
+    while( !_p.done )
+    {
+        if( std::chrono::steady_clock::now() >= _deadline )
+        {
+            this->pending.erase( _transaction );
+
+            /// no slave answers: the socket of the gateway may be half-open
+            if( ++this->timeouts >= MAX_TIMEOUTS && this->fd != -1 )
+            {
+                this->close_line( MBError::CONNECTION_RESET );
+            }
+
+            this->lineCond.notify_all();
+            return MBError::RESPONSE_TIMEOUT;
+        }
+
+        if( !this->reading )
+        {
+            int _fd = this->fd;
+            this->reading = true;
+            _lock.unlock();
+
+            Trace::begin( "receive" );
+            bool _ok = this->receive( _fd, _deadline );
+            Trace::end( "receive" );
+
+            _lock.lock();
+            this->reading = false;
+
+            if( !_ok && this->fd == _fd )
+            {
+                this->close_line( MBError::CONNECTION_RESET );
+            }
+            this->close_stale();
+
+            this->lineCond.notify_all();
+        }
+        else
+        {
+            this->lineCond.wait_until( _lock, _deadline );
+        }
+    }
+
+    this->lineCond.notify_all();
+
+    if( _p.error == MBError::NO_ERROR )
+    {
+        response.swap( _p.response );
+    }
+
+    return _p.error;
+}
+
+std::string MBTCPLine::readName()
+{
+    std::stringstream _ss;
+    _ss << this->ip << ":" << this->port;
+    return _ss.str();
+}
+
+} // namespace ModbusEngine
@@ -0,0 +1,151 @@
+#ifndef MBTCPLINE_H
+#define MBTCPLINE_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "mbline.h"
+#include "networktester.hpp"
+#include "types.h"
+
+namespace ModbusEngine
+{
+
+/**
+ * @brief The MBTCPLine class
+ *
+ * One modbus TCP connection of a gateway, shared by the slaves
+ * (unit ids) behind it.
+ *
+ * Features:
+ *   - MBAP framing, the unit id is set per request
+ *   - pipelining: at most maxPipeline requests are on the wire,
+ *     the answers are matched by transaction id
+ *   - maxPipeline 1 means strict request - answer order
+ *   - no reader thread: one of the waiting callers reads the socket
+ *     and hands out the answers to the others
+ *   - closes itself on I/O error ( or a send timeout, or MAX_TIMEOUTS
+ *     response timeouts in a row ) and fails the waiting requests
+ */
+
+class MBTCPLine : public MBLine
+{
+
+private:
+    /// a request waiting for its answer
+    class Pending
+    {
+    public:
+        int slaveId;
+        bool done;
+        MBError::Code error;
+        std::vector<uint8> response;
+    };
+
+    /// Line parameters
+    std::string ip;
+    int port;
+    int maxPipeline;
+    SocketOptions options;
+
+    /// the socket
+    int fd;
+    std::atomic<bool> opened;
+    /// closed sockets still used by the reading or the sending callers,
+    /// the last of them closes them
+    std::vector<int> staleFds;
+
+    /// requests on the wire by transaction id
+    std::map<uint16,Pending*> pending;
+    uint16 nextTransaction;
+    /// a caller is reading the socket
+    bool reading;
+    /// response timeouts since the last answer of any slave
+    int timeouts;
+    /// callers sending ( or waiting to send ) a frame without locked lineMutex
+    int senders;
+    /// the received but not processed bytes
+    std::vector<uint8> rxBuffer;
+
+    /// required mutexes and condition variable for multi threading support
+    /// ( sendMutex keeps the frames apart on the wire while lineMutex is free )
+    std::mutex lineMutex;
+    std::mutex sendMutex;
+    std::condition_variable lineCond;
+
+    /**
+     * @brief close_line
+     * @param error -> the error of the waiting requests
+     *
+     * Closes the socket. Called with locked lineMutex.
+     */
+    void close_line( MBError::Code error );
+
+    /**
+     * @brief close_stale
+     *
+     * Closes the stale sockets when no caller reads or sends on them.
+     * Called with locked lineMutex.
+     */
+    void close_stale();
+
+    /**
+     * @brief send_frame
+     * @param fd        -> the socket
+     * @param frame     -> the frame
+     * @param deadline  -> end of sending ( a stalled gateway, zero window )
+     * @return false on I/O error or timeout
+     *
+     * Called without locked lineMutex, with locked sendMutex.
+     */
+    bool send_frame( int fd, const std::vector<uint8>& frame, std::chrono::steady_clock::time_point deadline );
+
+    /**
+     * @brief receive
+     * @param fd        -> the socket
+     * @param deadline  -> end of waiting
+     * @return false on I/O error
+     *
+     * Reads the socket once and dispatches the complete answers.
+     * Called without locked lineMutex, by the reading caller only.
+     */
+    bool receive( int fd, std::chrono::steady_clock::time_point deadline );
+
+public:
+    /**
+     * @brief MBTCPLine
+     * @param ip            -> ip address of the gateway
+     * @param port          -> port of the gateway
+     * @param maxPipeline   -> max number of requests on the wire
+     * @param options       -> socket options
+     */
+    MBTCPLine( std::string ip, int port, int maxPipeline, SocketOptions options );
+
+    /**
+     * @brief ~MBTCPLine
+     *
+     * Closes the line.
+     */
+    ~MBTCPLine();
+
+    MBError::Code open( int timeout );
+    void close();
+    void flush();
+    bool isOpen();
+    int frameOverhead();
+    MBError::Code transact( int slaveId,
+                            const std::vector<uint8>& request,
+                            int responseTimeout,
+                            std::vector<uint8>& response );
+    std::string readName();
+
+};
+
+} // namespace ModbusEngine
+
+#endif // MBTCPLINE_H
@@ -1,8 +1,10 @@
 #include <cerrno>
+#include <chrono>
+#include <fcntl.h>
 #include <stdint.h>
 
 #include "mbtcpmasterconnection.h"
-#include "networktester.hpp"
+#include "trace.h"
 
 namespace ModbusEngine
 {
@@ -11,13 +13,15 @@ MBTCPMasterConnection::MBTCPMasterConnection( std::string ip,
                                               int port,
                                               int slaveId,
                                               int responseTimeout,
-                                              int connectionTimeout ) throw( std::string )
+                                              int connectionTimeout,
+                                              SocketOptions options ) throw( std::string )
 {
     this->ip = ip;
     this->port = port;
     this->slaveId = slaveId;
     this->responseTimeout = responseTimeout;
     this->connectionTimeout = connectionTimeout;
+    this->options = options;
     this->connected = false;
 
     this->context = modbus_new_tcp( ip.c_str(), port );
@@ -40,19 +44,30 @@ MBTCPMasterConnection::~MBTCPMasterConnection()
     modbus_free( this->context );
 }
 
-void MBTCPMasterConnection::connect() throw( std::string )
+MBError::Code MBTCPMasterConnection::connect()
 {
-    if( !NetworkTester::ping( this->ip, this->connectionTimeout ) )
-    {
-        throw std::string( "host_not_reachable" );
-    }
+    int _fd = NetworkTester::connect( this->ip,
+                                      this->port,
+                                      this->connectionTimeout,
+                                      this->options );
 
-    if( modbus_connect( this->context ) == -1 )
+    if( _fd == -1 )
     {
-        throw std::string( "connection_failed" );
+        if( errno == ETIMEDOUT || errno == EHOSTUNREACH || errno == ENETUNREACH )
+        {
+            return MBError::HOST_NOT_REACHABLE;
+        }
+
+        return MBError::CONNECTION_FAILED;
     }
 
+    /// libmodbus works with blocking sockets
+    fcntl( _fd, F_SETFL, fcntl( _fd, F_GETFL, 0 ) & ~O_NONBLOCK );
+    modbus_set_socket( this->context, _fd );
+
     this->connected = true;
+
+    return MBError::NO_ERROR;
 }
 
 void MBTCPMasterConnection::disconnect()
@@ -71,144 +86,283 @@ bool MBTCPMasterConnection::isConnected()
     return this->connected;
 }
 
-std::vector<uint16> MBTCPMasterConnection::readHoldingRegisters( int offset,
-                                                                 int count )
-                                                                 throw( std::string )
+MBError::Code MBTCPMasterConnection::modbus_error()
 {
-    std::vector<uint16> _values;
-    uint16_t* _lib_std_values = new uint16_t[ count ];
+    switch( errno )
+    {
+        case EMBXILFUN :
+            return MBError::ILLEGAL_FUNCTION_CODE;
+
+        case EMBXILADD :
+            return MBError::ILLEGAL_DATA_ADDRESS;
+
+        case EMBXILVAL :
+            return MBError::ILLEGAL_DATA_VALUE;
+
+        case EMBXSFAIL :
+            return MBError::SERVER_FAIL;
+
+        case EMBXACK :
+            return MBError::ERROR_ACK;
+
+        case EMBXSBUSY :
+            return MBError::SERVER_BUSY;
+
+        case EMBXNACK :
+            return MBError::NEGATIVE_ACK;
+
+        case EMBXMEMPAR :
+            return MBError::MEMORY_PARITY;
+
+        case EMBXGPATH :
+            return MBError::GATEWAY_PATH_EXCEPTION;
+
+        case EMBXGTAR :
+            return MBError::GATEWAY_RESPOND_EXCEPTION;
+
+        case EMBBADEXC :
+        case EMBUNKEXC :
+            return MBError::BAD_EXCEPTION;
+
+        case EMBMDATA :
+            return MBError::TOO_MANY_DATA;
+
+        case EMBBADCRC :
+            return MBError::BAD_CRC;
+
+        case EMBBADDATA :
+            return MBError::BAD_RESPONSE;
 
-    if( modbus_read_registers( this->context,
-                               offset,
-                               count,
-                               _lib_std_values ) != -1 )
+#ifdef EMBBADSLAVE
+        /// the answer of an other unit id ( libmodbus 3.1.2 ), flushed like the lines do
+        case EMBBADSLAVE :
+            return MBError::BAD_RESPONSE;
+#endif
+
+        /// select() of libmodbus ran out of the response timeout
+        case ETIMEDOUT :
+            return MBError::RESPONSE_TIMEOUT;
+
+        case ECONNRESET :
+        case ECONNABORTED :
+        case ECONNREFUSED :
+        case ENOTCONN :
+        case EPIPE :
+        case EBADF :
+            return MBError::CONNECTION_RESET;
+
+        default :
+            return MBError::UNDEFINED_EXCEPTION;
+    }
+}
+
+int MBTCPMasterConnection::answer_size( MBError::Code error, int pdu )
+{
+    if( error == MBError::NO_ERROR )
+    {
+        return MBAP_SIZE + pdu;
+    }
+
+    /// exception response: function code and exception code
+    if( MBError::category( error ) == MBError::CATEGORY_PROTOCOL )
     {
-        _values.resize( count );
-        for( int i = 0; i < count; i++ )
+        return MBAP_SIZE + 2;
+    }
+
+    return 0;
+}
+
+void MBTCPMasterConnection::pack_bits( uint8* bits, int count, std::vector<uint16>& values )
+{
+    values.assign( ( count + 15 ) / 16, 0 );
+
+    for( int i = 0; i < count; i++ )
+    {
+        if( bits[ i ] )
         {
-           _values[ i ] = (uint16)_lib_std_values[ i ];
+            values[ i / 16 ] |= (uint16)( 1 << ( i % 16 ) );
         }
+    }
+}
 
-        delete[] _lib_std_values;
-        return _values;
+MBError::Code MBTCPMasterConnection::readCoils( int offset,
+                                                int count,
+                                                std::vector<uint16>& values )
+{
+    std::chrono::steady_clock::time_point _start = std::chrono::steady_clock::now();
+    MBError::Code _error = MBError::NO_ERROR;
+    uint8_t* _lib_std_bits = new uint8_t[ count ];
+
+    Trace::begin( "request" );
+    int _rc = modbus_read_bits( this->context,
+                                offset,
+                                count,
+                                _lib_std_bits );
+    Trace::end( "request" );
+
+    if( _rc == -1 )
+    {
+        _error = modbus_error();
     }
     else
     {
-        delete[] _lib_std_values;
-        switch( errno )
-        {
-            case 112345679 :
-                throw std::string( "illegal_function_code" );
-                break;
-
-            case 112345680 :
-                throw std::string( "illegal_data_address" );
-                break;
+        Trace::begin( "decode" );
+        pack_bits( (uint8*)_lib_std_bits, count, values );
+        Trace::end( "decode" );
+    }
 
-            case 112345681 :
-                throw std::string( "illegal_data_value" );
-                break;
+    delete[] _lib_std_bits;
 
-            case 112345682 :
-                throw std::string( "server_fail" );
-                break;
+    return this->account( _start, _error, MBAP_SIZE + 5, answer_size( _error, 2 + ( count + 7 ) / 8 ) );
+} // readCoils
 
-            case 112345683 :
-                throw std::string( "error_ack" );
-                break;
+MBError::Code MBTCPMasterConnection::readDiscreteInputs( int offset,
+                                                         int count,
+                                                         std::vector<uint16>& values )
+{
+    std::chrono::steady_clock::time_point _start = std::chrono::steady_clock::now();
+    MBError::Code _error = MBError::NO_ERROR;
+    uint8_t* _lib_std_bits = new uint8_t[ count ];
+
+    Trace::begin( "request" );
+    int _rc = modbus_read_input_bits( this->context,
+                                      offset,
+                                      count,
+                                      _lib_std_bits );
+    Trace::end( "request" );
+
+    if( _rc == -1 )
+    {
+        _error = modbus_error();
+    }
+    else
+    {
+        Trace::begin( "decode" );
+        pack_bits( (uint8*)_lib_std_bits, count, values );
+        Trace::end( "decode" );
+    }
 
-            case 112345684 :
-                throw std::string( "server_busy" );
-                break;
+    delete[] _lib_std_bits;
 
-            case 112345688 :
-                throw std::string( "gateway_path_exception" );
-                break;
+    return this->account( _start, _error, MBAP_SIZE + 5, answer_size( _error, 2 + ( count + 7 ) / 8 ) );
+} // readDiscreteInputs
 
-            case 112345689 :
-                throw std::string( "gateway_respond_exception" );
-                break;
+MBError::Code MBTCPMasterConnection::readHoldingRegisters( int offset,
+                                                           int count,
+                                                           std::vector<uint16>& values )
+{
+    std::chrono::steady_clock::time_point _start = std::chrono::steady_clock::now();
+    MBError::Code _error = MBError::NO_ERROR;
 
-            case 112345694 :
-                throw std::string( "too_many_data" );
-                break;
+    /// uint16 is the same as uint16_t, libmodbus reads into the vector
+    values.resize( count );
 
-            default :
-                throw std::string( "undefined_exception" );
-                break;
-        }
+    Trace::begin( "request" );
+    int _rc = modbus_read_registers( this->context,
+                                     offset,
+                                     count,
+                                     (uint16_t*)&values[ 0 ] );
+    Trace::end( "request" );
 
-        return _values;
+    if( _rc == -1 )
+    {
+        _error = modbus_error();
     }
 
+    return this->account( _start, _error, MBAP_SIZE + 5, answer_size( _error, 2 + 2 * count ) );
 } // readHoldingRegister
 
-void MBTCPMasterConnection::writeMultipleRegisters( int offset,
-                                                    int count,
-                                                    std::vector<uint16> values )
-                                                    throw( std::string )
+MBError::Code MBTCPMasterConnection::readInputRegisters( int offset,
+                                                         int count,
+                                                         std::vector<uint16>& values )
 {
-    uint16_t* _lib_std_values = new uint16_t[ count ];
+    std::chrono::steady_clock::time_point _start = std::chrono::steady_clock::now();
+    MBError::Code _error = MBError::NO_ERROR;
 
-    for( int i = 0; i < count; i++ )
+    values.resize( count );
+
+    Trace::begin( "request" );
+    int _rc = modbus_read_input_registers( this->context,
+                                           offset,
+                                           count,
+                                           (uint16_t*)&values[ 0 ] );
+    Trace::end( "request" );
+
+    if( _rc == -1 )
     {
-        _lib_std_values[ i ] = (uint16_t)values[ i ];
+        _error = modbus_error();
     }
 
-    if( modbus_write_registers( this->context,
-                                offset,
-                                count,
-                                _lib_std_values ) != -1 )
+    return this->account( _start, _error, MBAP_SIZE + 5, answer_size( _error, 2 + 2 * count ) );
+} // readInputRegisters
+
+MBError::Code MBTCPMasterConnection::writeSingleCoil( int offset, bool value )
+{
+    std::chrono::steady_clock::time_point _start = std::chrono::steady_clock::now();
+    MBError::Code _error = MBError::NO_ERROR;
+
+    Trace::begin( "request" );
+    int _rc = modbus_write_bit( this->context, offset, value ? 1 : 0 );
+    Trace::end( "request" );
+
+    if( _rc == -1 )
     {
-        delete[] _lib_std_values;
+        _error = modbus_error();
     }
-    else
-    {
-        delete[] _lib_std_values;
-        switch( errno )
-        {
-            case 112345679 :
-                throw std::string( "illegal_function_code" );
-                break;
 
-            case 112345680 :
-                throw std::string( "illegal_data_address" );
-                break;
+    return this->account( _start, _error, MBAP_SIZE + 5, answer_size( _error, 5 ) );
+} // writeSingleCoil
 
-            case 112345681 :
-                throw std::string( "illegal_data_value" );
-                break;
+MBError::Code MBTCPMasterConnection::writeMultipleCoils( int offset,
+                                                         int count,
+                                                         const std::vector<uint16>& values )
+{
+    std::chrono::steady_clock::time_point _start = std::chrono::steady_clock::now();
+    MBError::Code _error = MBError::NO_ERROR;
+    uint8_t* _lib_std_bits = new uint8_t[ count ];
+
+    for( int i = 0; i < count; i++ )
+    {
+        _lib_std_bits[ i ] = ( values[ i / 16 ] >> ( i % 16 ) ) & 1;
+    }
 
-            case 112345682 :
-                throw std::string( "server_fail" );
-                break;
+    Trace::begin( "request" );
+    int _rc = modbus_write_bits( this->context,
+                                 offset,
+                                 count,
+                                 _lib_std_bits );
+    Trace::end( "request" );
 
-            case 112345683 :
-                throw std::string( "error_ack" );
-                break;
+    if( _rc == -1 )
+    {
+        _error = modbus_error();
+    }
 
-            case 112345684 :
-                throw std::string( "server_busy" );
-                break;
+    delete[] _lib_std_bits;
 
-            case 112345688 :
-                throw std::string( "gateway_path_exception" );
-                break;
+    return this->account( _start, _error, MBAP_SIZE + 6 + ( count + 7 ) / 8, answer_size( _error, 5 ) );
+} // writeMultipleCoils
 
-            case 112345689 :
-                throw std::string( "gateway_respond_exception" );
-                break;
+MBError::Code MBTCPMasterConnection::writeMultipleRegisters( int offset,
+                                                             int count,
+                                                             const std::vector<uint16>& values )
+{
+    std::chrono::steady_clock::time_point _start = std::chrono::steady_clock::now();
+    MBError::Code _error = MBError::NO_ERROR;
 
-            case 112345694 :
-                throw std::string( "too_many_data" );
-                break;
+    Trace::begin( "request" );
+    int _rc = modbus_write_registers( this->context,
+                                      offset,
+                                      count,
+                                      (const uint16_t*)&values[ 0 ] );
+    Trace::end( "request" );
 
-            default :
-                throw std::string( "undefined_exception" );
-                break;
-        }
+    if( _rc == -1 )
+    {
+        _error = modbus_error();
     }
 
+    return this->account( _start, _error, MBAP_SIZE + 6 + 2 * count, answer_size( _error, 5 ) );
 } // writeMultipleRegisters
 
 
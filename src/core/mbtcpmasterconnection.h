@@ -1,10 +1,14 @@
 #ifndef MBTCPMASTERCONNECTION_H
 #define MBTCPMASTERCONNECTION_H
 
+#include <atomic>
 #include <modbus.h>
 #include <string>
 #include <vector>
 
+#include "mberror.h"
+#include "mbmasterconnection.h"
+#include "networktester.hpp"
 #include "types.h"
 
 namespace ModbusEngine
@@ -17,27 +21,61 @@ namespace ModbusEngine
  *   - connecting to server
  *   - disconnect from server
  *   - flush
+ *   - Read Coils - FC 0x01
+ *   - Read Discrete Inputs - FC 0x02
  *   - Modbus Read Holding Registers - FC 0x03
+ *   - Read Input Registers - FC 0x04
+ *   - Write Single Coil - FC 0x05
+ *   - Write Multiple Coils - FC 0x0F
  *   - Write Multiple Registers - FC 0x10
+ *
+ * Bit areas are delivered packed into uint16 words, LSB first
+ * ( bit i is the bit i%16 of the word i/16 ).
  */
 
-class MBTCPMasterConnection
+class MBTCPMasterConnection : public MBMasterConnection
 {
 
 private:
+    /// size of the MBAP header with the unit id
+    static const int MBAP_SIZE = 7;
+
     /// main parameters
     std::string ip;
     int port;
     int slaveId;
     int responseTimeout;
     int connectionTimeout;
+    SocketOptions options;
 
-    /// connection status indicator
-    bool connected;
+    /// connection status indicator ( read by the monitor thread )
+    std::atomic<bool> connected;
 
     /// the context delivered by libmodbus library
     modbus_t* context;
 
+    /**
+     * @brief modbus_error
+     * @return the error code of the last failed libmodbus call ( by errno )
+     */
+    static MBError::Code modbus_error();
+
+    /**
+     * @brief answer_size
+     * @param error -> result of the request
+     * @param pdu   -> pdu size of the normal answer
+     * @return the received bytes of the answer ( estimated by the result )
+     */
+    static int answer_size( MBError::Code error, int pdu );
+
+    /**
+     * @brief pack_bits
+     * @param bits  -> one byte per bit ( libmodbus format )
+     * @param count -> number of bits
+     * @param values -> the packed bits
+     */
+    static void pack_bits( uint8* bits, int count, std::vector<uint16>& values );
+
 public:
 
     /**
@@ -47,6 +85,7 @@ public:
      * @param slaveId               -> device slaveId
      * @param responseTimeout       -> the timeout of the modbus question in millisecs
      * @param connectionTimeout     -> the connecting timeout in millisecs
+     * @param options               -> socket options
      *
      * The constructor creates the full object.
      * The constructor throws std::string exceptions when error happens:
@@ -57,7 +96,8 @@ public:
                            int port,
                            int slaveId,
                            int responseTimeout,
-                           int connectionTimeout ) throw( std::string );
+                           int connectionTimeout,
+                           SocketOptions options = SocketOptions() ) throw( std::string );
 
     /**
       * @brief ~MBTCPMasterConnection
@@ -68,14 +108,16 @@ public:
 
     /**
      * @brief connect
+     * @return error code
      *
-     * Connects to a modbus device.
-     * The function throws std::string exception when error happens:
+     * Connects to a modbus device. The connect is non-blocking, it gives up
+     * after connectionTimeout millisecs.
+     * Error codes:
      *
-     *      "host_not_reachable"    -> host not reachable on network
-     *      "connection_failed"     -> connecting failed
+     *      HOST_NOT_REACHABLE  -> host not reachable on network or timeout
+     *      CONNECTION_FAILED   -> connecting failed
      */
-    void connect() throw( std::string );
+    MBError::Code connect();
 
     /**
      * @brief disconnect
@@ -97,52 +139,215 @@ public:
      */
     bool isConnected();
 
+    /**
+     * @brief MBTCPMasterConnection::readCoils
+     * @param offset    -> the modbus coil offset
+     * @param count     -> number of coils
+     * @param values    -> the packed coils
+     * @return error code
+     *
+     * The function uses the FC 0x01 for reading.
+     * Error codes:
+     *
+     *      ILLEGAL_FUNCTION_CODE       -> see modbus protocol definition
+     *      ILLEGAL_DATA_ADDRESS        -> see modbus protocol definition
+     *      ILLEGAL_DATA_VALUE          -> see modbus protocol definition
+     *      SERVER_FAIL                 -> see modbus protocol definition
+     *      ERROR_ACK                   -> see modbus protocol definition
+     *      SERVER_BUSY                 -> see modbus protocol definition
+     *      GATEWAY_PATH_EXCEPTION      -> see modbus protocol definition
+     *      GATEWAY_RESPOND_EXCEPTION   -> see modbus protocol definition
+     *      NEGATIVE_ACK                -> see modbus protocol definition
+     *      MEMORY_PARITY               -> see modbus protocol definition
+     *      TOO_MANY_DATA               -> see modbus protocol definition
+     *      BAD_EXCEPTION               -> unknown exception response
+     *      BAD_CRC / BAD_RESPONSE      -> corrupted or foreign answer
+     *      RESPONSE_TIMEOUT            -> no answer in time
+     *      CONNECTION_RESET            -> the connection is lost
+     *      UNDEFINED_EXCEPTION         -> not modbus defined exception
+     */
+    MBError::Code readCoils( int offset, int count, std::vector<uint16>& values );
+
+    /**
+     * @brief MBTCPMasterConnection::readDiscreteInputs
+     * @param offset    -> the modbus discrete input offset
+     * @param count     -> number of discrete inputs
+     * @param values    -> the packed discrete inputs
+     * @return error code
+     *
+     * The function uses the FC 0x02 for reading.
+     * Error codes:
+     *
+     *      ILLEGAL_FUNCTION_CODE       -> see modbus protocol definition
+     *      ILLEGAL_DATA_ADDRESS        -> see modbus protocol definition
+     *      ILLEGAL_DATA_VALUE          -> see modbus protocol definition
+     *      SERVER_FAIL                 -> see modbus protocol definition
+     *      ERROR_ACK                   -> see modbus protocol definition
+     *      SERVER_BUSY                 -> see modbus protocol definition
+     *      GATEWAY_PATH_EXCEPTION      -> see modbus protocol definition
+     *      GATEWAY_RESPOND_EXCEPTION   -> see modbus protocol definition
+     *      NEGATIVE_ACK                -> see modbus protocol definition
+     *      MEMORY_PARITY               -> see modbus protocol definition
+     *      TOO_MANY_DATA               -> see modbus protocol definition
+     *      BAD_EXCEPTION               -> unknown exception response
+     *      BAD_CRC / BAD_RESPONSE      -> corrupted or foreign answer
+     *      RESPONSE_TIMEOUT            -> no answer in time
+     *      CONNECTION_RESET            -> the connection is lost
+     *      UNDEFINED_EXCEPTION         -> not modbus defined exception
+     */
+    MBError::Code readDiscreteInputs( int offset, int count, std::vector<uint16>& values );
+
     /**
      * @brief MBTCPMasterConnection::readHoldingRegisters
      * @param offset    -> the modbus register offset
      * @param count     -> number of registers
-     * @return the vector of the registers
+     * @param values    -> the registers
+     * @return error code
      *
      * The function uses the FC 0x03 for reading.
-     * The function throws std::string exception when error happens:
-     *
-     *      "illegal_function_code"     -> see modbus protocol definition
-     *      "illegal_data_address"      -> see modbus protocol definition
-     *      "illegal_data_value"        -> see modbus protocol definition
-     *      "server_fail"               -> see modbus protocol definition
-     *      "error_ack"                 -> see modbus protocol definition
-     *      "server_busy"               -> see modbus protocol definition
-     *      "gateway_path_exception"    -> see modbus protocol definition
-     *      "gateway_respond_exception" -> see modbus protocol definition
-     *      "too_many_data"             -> see modbus protocol definition
-     *      "undefined_exception"       -> not modbus defined exception
+     * Error codes:
+     *
+     *      ILLEGAL_FUNCTION_CODE       -> see modbus protocol definition
+     *      ILLEGAL_DATA_ADDRESS        -> see modbus protocol definition
+     *      ILLEGAL_DATA_VALUE          -> see modbus protocol definition
+     *      SERVER_FAIL                 -> see modbus protocol definition
+     *      ERROR_ACK                   -> see modbus protocol definition
+     *      SERVER_BUSY                 -> see modbus protocol definition
+     *      GATEWAY_PATH_EXCEPTION      -> see modbus protocol definition
+     *      GATEWAY_RESPOND_EXCEPTION   -> see modbus protocol definition
+     *      NEGATIVE_ACK                -> see modbus protocol definition
+     *      MEMORY_PARITY               -> see modbus protocol definition
+     *      TOO_MANY_DATA               -> see modbus protocol definition
+     *      BAD_EXCEPTION               -> unknown exception response
+     *      BAD_CRC / BAD_RESPONSE      -> corrupted or foreign answer
+     *      RESPONSE_TIMEOUT            -> no answer in time
+     *      CONNECTION_RESET            -> the connection is lost
+     *      UNDEFINED_EXCEPTION         -> not modbus defined exception
+     */
+    MBError::Code readHoldingRegisters( int offset,
+                                        int count,
+                                        std::vector<uint16>& values );
+
+    /**
+     * @brief MBTCPMasterConnection::readInputRegisters
+     * @param offset    -> the modbus register offset
+     * @param count     -> number of registers
+     * @param values    -> the registers
+     * @return error code
+     *
+     * The function uses the FC 0x04 for reading.
+     * Error codes:
+     *
+     *      ILLEGAL_FUNCTION_CODE       -> see modbus protocol definition
+     *      ILLEGAL_DATA_ADDRESS        -> see modbus protocol definition
+     *      ILLEGAL_DATA_VALUE          -> see modbus protocol definition
+     *      SERVER_FAIL                 -> see modbus protocol definition
+     *      ERROR_ACK                   -> see modbus protocol definition
+     *      SERVER_BUSY                 -> see modbus protocol definition
+     *      GATEWAY_PATH_EXCEPTION      -> see modbus protocol definition
+     *      GATEWAY_RESPOND_EXCEPTION   -> see modbus protocol definition
+     *      NEGATIVE_ACK                -> see modbus protocol definition
+     *      MEMORY_PARITY               -> see modbus protocol definition
+     *      TOO_MANY_DATA               -> see modbus protocol definition
+     *      BAD_EXCEPTION               -> unknown exception response
+     *      BAD_CRC / BAD_RESPONSE      -> corrupted or foreign answer
+     *      RESPONSE_TIMEOUT            -> no answer in time
+     *      CONNECTION_RESET            -> the connection is lost
+     *      UNDEFINED_EXCEPTION         -> not modbus defined exception
+     */
+    MBError::Code readInputRegisters( int offset,
+                                      int count,
+                                      std::vector<uint16>& values );
+
+    /**
+     * @brief MBTCPMasterConnection::writeSingleCoil
+     * @param offset    -> the modbus coil offset
+     * @param value     -> the coil status we want to write
+     * @return error code
+     *
+     * The function uses the FC 0x05 for writing.
+     * Error codes:
+     *
+     *      ILLEGAL_FUNCTION_CODE       -> see modbus protocol definition
+     *      ILLEGAL_DATA_ADDRESS        -> see modbus protocol definition
+     *      ILLEGAL_DATA_VALUE          -> see modbus protocol definition
+     *      SERVER_FAIL                 -> see modbus protocol definition
+     *      ERROR_ACK                   -> see modbus protocol definition
+     *      SERVER_BUSY                 -> see modbus protocol definition
+     *      GATEWAY_PATH_EXCEPTION      -> see modbus protocol definition
+     *      GATEWAY_RESPOND_EXCEPTION   -> see modbus protocol definition
+     *      NEGATIVE_ACK                -> see modbus protocol definition
+     *      MEMORY_PARITY               -> see modbus protocol definition
+     *      TOO_MANY_DATA               -> see modbus protocol definition
+     *      BAD_EXCEPTION               -> unknown exception response
+     *      BAD_CRC / BAD_RESPONSE      -> corrupted or foreign answer
+     *      RESPONSE_TIMEOUT            -> no answer in time
+     *      CONNECTION_RESET            -> the connection is lost
+     *      UNDEFINED_EXCEPTION         -> not modbus defined exception
+     */
+    MBError::Code writeSingleCoil( int offset, bool value );
+
+    /**
+     * @brief MBTCPMasterConnection::writeMultipleCoils
+     * @param offset    -> the modbus coil offset
+     * @param count     -> number of coils
+     * @param values    -> the packed coils we want to write ( bit 0 is the coil at offset )
+     * @return error code
+     *
+     * The function uses the FC 0x0F for writing.
+     * Error codes:
+     *
+     *      ILLEGAL_FUNCTION_CODE       -> see modbus protocol definition
+     *      ILLEGAL_DATA_ADDRESS        -> see modbus protocol definition
+     *      ILLEGAL_DATA_VALUE          -> see modbus protocol definition
+     *      SERVER_FAIL                 -> see modbus protocol definition
+     *      ERROR_ACK                   -> see modbus protocol definition
+     *      SERVER_BUSY                 -> see modbus protocol definition
+     *      GATEWAY_PATH_EXCEPTION      -> see modbus protocol definition
+     *      GATEWAY_RESPOND_EXCEPTION   -> see modbus protocol definition
+     *      NEGATIVE_ACK                -> see modbus protocol definition
+     *      MEMORY_PARITY               -> see modbus protocol definition
+     *      TOO_MANY_DATA               -> see modbus protocol definition
+     *      BAD_EXCEPTION               -> unknown exception response
+     *      BAD_CRC / BAD_RESPONSE      -> corrupted or foreign answer
+     *      RESPONSE_TIMEOUT            -> no answer in time
+     *      CONNECTION_RESET            -> the connection is lost
+     *      UNDEFINED_EXCEPTION         -> not modbus defined exception
      */
-    std::vector<uint16> readHoldingRegisters( int offset,
-                                              int count ) throw( std::string );
+    MBError::Code writeMultipleCoils( int offset,
+                                      int count,
+                                      const std::vector<uint16>& values );
 
     /**
      * @brief MBTCPMasterConnection::writeMultipleRegisters
      * @param offset    -> the modbus register offset
      * @param count     -> number of registers
      * @param values    -> the registers we want to write
+     * @return error code
      *
      * The function uses the FC 0x10 for writing.
-     * The function throws exception when error happens:
-     *
-     *      "illegal_function_code"     -> see modbus protocol definition
-     *      "illegal_data_address"      -> see modbus protocol definition
-     *      "illegal_data_value"        -> see modbus protocol definition
-     *      "server_fail"               -> see modbus protocol definition
-     *      "error_ack"                 -> see modbus protocol definition
-     *      "server_busy"               -> see modbus protocol definition
-     *      "gateway_path_exception"    -> see modbus protocol definition
-     *      "gateway_respond_exception" -> see modbus protocol definition
-     *      "too_many_data"             -> see modbus protocol definition
-     *      "undefined_exception"       -> not modbus defined exception
+     * Error codes:
+     *
+     *      ILLEGAL_FUNCTION_CODE       -> see modbus protocol definition
+     *      ILLEGAL_DATA_ADDRESS        -> see modbus protocol definition
+     *      ILLEGAL_DATA_VALUE          -> see modbus protocol definition
+     *      SERVER_FAIL                 -> see modbus protocol definition
+     *      ERROR_ACK                   -> see modbus protocol definition
+     *      SERVER_BUSY                 -> see modbus protocol definition
+     *      GATEWAY_PATH_EXCEPTION      -> see modbus protocol definition
+     *      GATEWAY_RESPOND_EXCEPTION   -> see modbus protocol definition
+     *      NEGATIVE_ACK                -> see modbus protocol definition
+     *      MEMORY_PARITY               -> see modbus protocol definition
+     *      TOO_MANY_DATA               -> see modbus protocol definition
+     *      BAD_EXCEPTION               -> unknown exception response
+     *      BAD_CRC / BAD_RESPONSE      -> corrupted or foreign answer
+     *      RESPONSE_TIMEOUT            -> no answer in time
+     *      CONNECTION_RESET            -> the connection is lost
+     *      UNDEFINED_EXCEPTION         -> not modbus defined exception
      */
-    void writeMultipleRegisters( int offset,
-                                 int count,
-                                 std::vector<uint16> values ) throw( std::string );
+    MBError::Code writeMultipleRegisters( int offset,
+                                          int count,
+                                          const std::vector<uint16>& values );
 
 };
 
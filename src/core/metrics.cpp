@@ -0,0 +1,233 @@
+#include <sstream>
+#include <stdio.h>
+
+#include "metrics.h"
+
+namespace ModbusEngine
+{
+
+void MetricsRegistry::add_series( const std::string& name,
+                                  const std::string& help,
+                                  int type,
+                                  const Series& series )
+{
+    std::lock_guard<std::mutex> _lock( this->registryMutex );
+
+    for( size_t i = 0; i < this->families.size(); i++ )
+    {
+        if( this->families[ i ].name == name )
+        {
+            this->families[ i ].series.push_back( series );
+            return;
+        }
+    }
+
+    Family _f;
+    _f.name = name;
+    _f.help = help;
+    _f.type = type;
+    _f.series.push_back( series );
+
+    this->families.push_back( _f );
+}
+
+void MetricsRegistry::addCounter( const std::string& name,
+                                  const std::string& help,
+                                  const std::string& labels,
+                                  Counter* counter )
+{
+    Series _s;
+    _s.labels = labels;
+    _s.counter = counter;
+    _s.gauge = NULL;
+    _s.histogram = NULL;
+
+    this->add_series( name, help, TYPE_COUNTER, _s );
+}
+
+void MetricsRegistry::addGauge( const std::string& name,
+                                const std::string& help,
+                                const std::string& labels,
+                                Gauge* gauge )
+{
+    Series _s;
+    _s.labels = labels;
+    _s.counter = NULL;
+    _s.gauge = gauge;
+    _s.histogram = NULL;
+
+    this->add_series( name, help, TYPE_GAUGE, _s );
+}
+
+void MetricsRegistry::addHistogram( const std::string& name,
+                                    const std::string& help,
+                                    const std::string& labels,
+                                    Histogram* histogram )
+{
+    Series _s;
+    _s.labels = labels;
+    _s.counter = NULL;
+    _s.gauge = NULL;
+    _s.histogram = histogram;
+
+    this->add_series( name, help, TYPE_HISTOGRAM, _s );
+}
+
+void MetricsRegistry::remove( const void* metric )
+{
+    std::lock_guard<std::mutex> _lock( this->registryMutex );
+
+    for( size_t i = 0; i < this->families.size(); )
+    {
+        std::vector<Series>& _series = this->families[ i ].series;
+
+        for( size_t j = 0; j < _series.size(); )
+        {
+            if( _series[ j ].counter == metric || _series[ j ].gauge == metric || _series[ j ].histogram == metric )
+            {
+                _series.erase( _series.begin() + j );
+            }
+            else
+            {
+                j++;
+            }
+        }
+
+        /// a family without series is not exposed
+        if( _series.empty() )
+        {
+            this->families.erase( this->families.begin() + i );
+        }
+        else
+        {
+            i++;
+        }
+    }
+}
+
+std::string MetricsRegistry::seconds( long long microseconds )
+{
+    char _text[ 32 ];
+    snprintf( _text, sizeof( _text ), "%lld.%06lld", microseconds / 1000000, microseconds % 1000000 );
+
+    return std::string( _text );
+}
+
+std::string MetricsRegistry::label( const std::string& name, const std::string& value )
+{
+    std::string _r = name + "=\"";
+
+    for( size_t i = 0; i < value.size(); i++ )
+    {
+        if( value[ i ] == '\\' || value[ i ] == '"' )
+        {
+            _r += '\\';
+            _r += value[ i ];
+        }
+        else if( value[ i ] == '\n' )
+        {
+            _r += "\\n";
+        }
+        else
+        {
+            _r += value[ i ];
+        }
+    }
+
+    return _r + "\"";
+}
+
+unsigned long long MetricsRegistry::readCounter( const std::string& name )
+{
+    unsigned long long _r = 0;
+
+    std::lock_guard<std::mutex> _lock( this->registryMutex );
+
+    for( size_t i = 0; i < this->families.size(); i++ )
+    {
+        Family& _f = this->families[ i ];
+        if( _f.name != name || _f.type != TYPE_COUNTER ) continue;
+
+        for( size_t j = 0; j < _f.series.size(); j++ )
+        {
+            _r += _f.series[ j ].counter->read();
+        }
+    }
+
+    return _r;
+}
+
+std::vector<unsigned long long> MetricsRegistry::readBuckets( const std::string& name )
+{
+    std::vector<unsigned long long> _r( Histogram::BUCKET_NUM, 0 );
+
+    std::lock_guard<std::mutex> _lock( this->registryMutex );
+
+    for( size_t i = 0; i < this->families.size(); i++ )
+    {
+        Family& _f = this->families[ i ];
+        if( _f.name != name || _f.type != TYPE_HISTOGRAM ) continue;
+
+        for( size_t j = 0; j < _f.series.size(); j++ )
+        {
+            for( int b = 0; b < Histogram::BUCKET_NUM; b++ )
+            {
+                _r[ b ] += _f.series[ j ].histogram->readBucket( b );
+            }
+        }
+    }
+
+    return _r;
+}
+
+std::string MetricsRegistry::expose()
+{
+    static const char* const _types[] = { "counter", "gauge", "histogram" };
+
+    std::stringstream _out;
+
+    std::lock_guard<std::mutex> _lock( this->registryMutex );
+
+    for( size_t i = 0; i < this->families.size(); i++ )
+    {
+        Family& _f = this->families[ i ];
+
+        _out << "# HELP " << _f.name << " " << _f.help << "\n";
+        _out << "# TYPE " << _f.name << " " << _types[ _f.type ] << "\n";
+
+        for( size_t j = 0; j < _f.series.size(); j++ )
+        {
+            Series& _s = _f.series[ j ];
+            std::string _labels = _s.labels.empty() ? "" : "{" + _s.labels + "}";
+
+            if( _f.type == TYPE_COUNTER )
+            {
+                _out << _f.name << _labels << " " << _s.counter->read() << "\n";
+            }
+            else if( _f.type == TYPE_GAUGE )
+            {
+                _out << _f.name << _labels << " " << _s.gauge->read() << "\n";
+            }
+            else
+            {
+                std::string _prefix = _s.labels.empty() ? "" : _s.labels + ",";
+
+                for( int b = 0; b < Histogram::BUCKET_NUM; b++ )
+                {
+                    long long _bound = Histogram::readBound( b );
+
+                    _out << _f.name << "_bucket{" << _prefix << "le=\""
+                         << ( _bound < 0 ? std::string( "+Inf" ) : seconds( _bound ) ) << "\"} "
+                         << _s.histogram->readBucket( b ) << "\n";
+                }
+
+                _out << _f.name << "_sum" << _labels << " " << seconds( _s.histogram->readSum() ) << "\n";
+                _out << _f.name << "_count" << _labels << " " << _s.histogram->readCount() << "\n";
+            }
+        }
+    }
+
+    return _out.str();
+}
+
+} // namespace ModbusEngine
@@ -0,0 +1,243 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "histogram.hpp"
+
+namespace ModbusEngine
+{
+
+/**
+ * @brief The Counter class
+ *
+ * Lock-free monotonic counter. It is a library class.
+ */
+class Counter
+{
+
+private:
+    std::atomic<unsigned long long> value;
+
+public:
+    Counter()
+    {
+        this->value = 0;
+    }
+
+    /**
+     * @brief add
+     * @param n -> increment
+     */
+    void add( unsigned long long n = 1 )
+    {
+        this->value.fetch_add( n, std::memory_order_relaxed );
+    }
+
+    /**
+     * @brief read
+     * @return the current value
+     */
+    unsigned long long read()
+    {
+        return this->value.load( std::memory_order_relaxed );
+    }
+
+};
+
+/**
+ * @brief The Gauge class
+ *
+ * Lock-free value that can go up and down. It is a library class.
+ */
+class Gauge
+{
+
+private:
+    std::atomic<long long> value;
+
+public:
+    Gauge()
+    {
+        this->value = 0;
+    }
+
+    /**
+     * @brief set
+     * @param v -> the new value
+     */
+    void set( long long v )
+    {
+        this->value.store( v, std::memory_order_relaxed );
+    }
+
+    /**
+     * @brief add
+     * @param n -> increment (negative to decrement)
+     */
+    void add( long long n )
+    {
+        this->value.fetch_add( n, std::memory_order_relaxed );
+    }
+
+    /**
+     * @brief read
+     * @return the current value
+     */
+    long long read()
+    {
+        return this->value.load( std::memory_order_relaxed );
+    }
+
+};
+
+/**
+ * @brief The MetricsRegistry class
+ *
+ * Engine-wide list of the metrics for the Prometheus text exposition.
+ *
+ * The modules own their Counter, Gauge and Histogram objects ( like the
+ * write latency histogram of the driver ) and add them to the registry
+ * once, when they are built. The hot paths only touch their own atomic
+ * objects, the registry mutex is taken by the registration and by
+ * expose() only.
+ *
+ * The Histogram values are microsecs, they are exposed in seconds.
+ */
+class MetricsRegistry
+{
+
+private:
+    /// metric types
+    static const int TYPE_COUNTER = 0;
+    static const int TYPE_GAUGE = 1;
+    static const int TYPE_HISTOGRAM = 2;
+
+    /// one labelled series of a family
+    class Series
+    {
+    public:
+        std::string labels;
+        Counter* counter;
+        Gauge* gauge;
+        Histogram* histogram;
+    };
+
+    /// the series of one metric name
+    class Family
+    {
+    public:
+        std::string name;
+        std::string help;
+        int type;
+        std::vector<Series> series;
+    };
+
+    /// the families in registration order
+    std::vector<Family> families;
+
+    /// guards the families
+    std::mutex registryMutex;
+
+    /**
+     * @brief add_series
+     *
+     * Adds the series to the family of the name, creates the family at the first use.
+     */
+    void add_series( const std::string& name,
+                     const std::string& help,
+                     int type,
+                     const Series& series );
+
+    /**
+     * @brief seconds
+     * @param microseconds -> value in microsecs
+     * @return the value in seconds as text
+     */
+    static std::string seconds( long long microseconds );
+
+public:
+    MetricsRegistry(){}
+
+    /**
+     * @brief addCounter
+     * @param name      -> metric name ( e.g. "modbus_requests_total" )
+     * @param help      -> one line description
+     * @param labels    -> label list without braces ( see label() ), empty for none
+     * @param counter   -> the counter, owned by the caller
+     */
+    void addCounter( const std::string& name,
+                     const std::string& help,
+                     const std::string& labels,
+                     Counter* counter );
+
+    /**
+     * @brief addGauge
+     * @param name      -> metric name
+     * @param help      -> one line description
+     * @param labels    -> label list without braces, empty for none
+     * @param gauge     -> the gauge, owned by the caller
+     */
+    void addGauge( const std::string& name,
+                   const std::string& help,
+                   const std::string& labels,
+                   Gauge* gauge );
+
+    /**
+     * @brief addHistogram
+     * @param name      -> metric name ( e.g. "modbus_request_duration_seconds" )
+     * @param help      -> one line description
+     * @param labels    -> label list without braces, empty for none
+     * @param histogram -> the histogram in microsecs, owned by the caller
+     */
+    void addHistogram( const std::string& name,
+                       const std::string& help,
+                       const std::string& labels,
+                       Histogram* histogram );
+
+    /**
+     * @brief remove
+     * @param metric -> a registered Counter, Gauge or Histogram
+     *
+     * Removes the series of the metric, the owner calls it before the
+     * metric is deleted ( e.g. a block removed by a reload ).
+     */
+    void remove( const void* metric );
+
+    /**
+     * @brief expose
+     * @return all metrics in Prometheus text format ( version 0.0.4 )
+     */
+    std::string expose();
+
+    /**
+     * @brief readCounter
+     * @param name -> metric name
+     * @return summary of the counter series of the name
+     */
+    unsigned long long readCounter( const std::string& name );
+
+    /**
+     * @brief readBuckets
+     * @param name -> metric name
+     * @return summary of the cumulative buckets of the histogram series of the name
+     *         ( BUCKET_NUM values, see Histogram )
+     */
+    std::vector<unsigned long long> readBuckets( const std::string& name );
+
+    /**
+     * @brief label
+     * @param name  -> label name
+     * @param value -> label value
+     * @return name="value" with the value escaped
+     */
+    static std::string label( const std::string& name, const std::string& value );
+
+};
+
+} // namespace ModbusEngine
+
+#endif // METRICS_H
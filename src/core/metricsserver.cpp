@@ -0,0 +1,195 @@
+#include <arpa/inet.h>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sstream>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "metricsserver.h"
+
+namespace ModbusEngine
+{
+
+const int MetricsServer::IO_TIMEOUT;
+
+MetricsServer::MetricsServer( std::string address, int port, MetricsRegistry* registry )
+{
+    this->address = address;
+    this->port = port;
+    this->registry = registry;
+    this->listenFd = -1;
+    this->running = false;
+}
+
+MetricsServer::~MetricsServer()
+{
+    if( this->listenFd != -1 )
+    {
+        ::close( this->listenFd );
+    }
+}
+
+void MetricsServer::open() throw( std::string )
+{
+    struct sockaddr_in _addr;
+    memset( &_addr, 0, sizeof( _addr ) );
+    _addr.sin_family = AF_INET;
+    _addr.sin_port = htons( this->port );
+
+    if( inet_pton( AF_INET, this->address.c_str(), &_addr.sin_addr ) != 1 )
+    {
+        throw std::string( "bad metrics address: " + this->address );
+    }
+
+    this->listenFd = socket( AF_INET, SOCK_STREAM, 0 );
+
+    if( this->listenFd == -1 )
+    {
+        throw std::string( "metrics socket: " ) + strerror( errno );
+    }
+
+    int _flag = 1;
+    setsockopt( this->listenFd, SOL_SOCKET, SO_REUSEADDR, &_flag, sizeof( _flag ) );
+
+    if( bind( this->listenFd, (struct sockaddr*)&_addr, sizeof( _addr ) ) == -1 ||
+        listen( this->listenFd, 8 ) == -1 )
+    {
+        std::string _error = strerror( errno );
+        ::close( this->listenFd );
+        this->listenFd = -1;
+        throw "metrics port " + std::to_string( this->port ) + ": " + _error;
+    }
+}
+
+bool MetricsServer::send_all( int fd, const std::string& data )
+{
+    size_t _sent = 0;
+
+    while( _sent < data.size() )
+    {
+        struct pollfd _pfd;
+        _pfd.fd = fd;
+        _pfd.events = POLLOUT;
+        _pfd.revents = 0;
+
+        if( poll( &_pfd, 1, IO_TIMEOUT ) != 1 )
+        {
+            return false;
+        }
+
+        ssize_t _n = ::send( fd, data.data() + _sent, data.size() - _sent, MSG_NOSIGNAL );
+
+        if( _n <= 0 )
+        {
+            if( _n == -1 && errno == EINTR ) continue;
+            return false;
+        }
+
+        _sent += _n;
+    }
+
+    return true;
+}
+
+void MetricsServer::serve( int fd )
+{
+    std::string _request;
+    char _buffer[ 1024 ];
+
+    std::chrono::steady_clock::time_point _deadline =
+            std::chrono::steady_clock::now() + std::chrono::milliseconds( IO_TIMEOUT );
+
+    /// the header only, the scrapes have no body
+    while( _request.find( "\r\n\r\n" ) == std::string::npos && _request.size() < 8192 )
+    {
+        long long _left = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    _deadline - std::chrono::steady_clock::now() ).count();
+
+        struct pollfd _pfd;
+        _pfd.fd = fd;
+        _pfd.events = POLLIN;
+        _pfd.revents = 0;
+
+        if( _left <= 0 || poll( &_pfd, 1, (int)_left ) != 1 )
+        {
+            return;
+        }
+
+        ssize_t _n = ::recv( fd, _buffer, sizeof( _buffer ), 0 );
+
+        if( _n <= 0 )
+        {
+            if( _n == -1 && errno == EINTR ) continue;
+            return;
+        }
+
+        _request.append( _buffer, _n );
+    }
+
+    std::stringstream _answer;
+
+    if( _request.compare( 0, 13, "GET /metrics " ) == 0 ||
+        _request.compare( 0, 13, "GET /metrics?" ) == 0 )
+    {
+        std::string _body = this->registry->expose();
+
+        _answer << "HTTP/1.1 200 OK\r\n";
+        _answer << "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n";
+        _answer << "Content-Length: " << _body.size() << "\r\n";
+        _answer << "Connection: close\r\n\r\n";
+        _answer << _body;
+    }
+    else
+    {
+        _answer << "HTTP/1.1 404 Not Found\r\n";
+        _answer << "Content-Length: 0\r\n";
+        _answer << "Connection: close\r\n\r\n";
+    }
+
+    send_all( fd, _answer.str() );
+}
+
+/**
+ ############################################################################
+ # Inherited functions from Thread.
+ ############################################################################
+*/
+
+void MetricsServer::run()
+{
+    this->running = true;
+
+    while( this->running )
+    {
+        struct pollfd _pfd;
+        _pfd.fd = this->listenFd;
+        _pfd.events = POLLIN;
+        _pfd.revents = 0;
+
+        /// wakes up now and then to see the stop flag
+        if( poll( &_pfd, 1, 500 ) != 1 )
+        {
+            continue;
+        }
+
+        int _fd = accept( this->listenFd, NULL, NULL );
+
+        if( _fd == -1 )
+        {
+            continue;
+        }
+
+        this->serve( _fd );
+        ::close( _fd );
+    }
+}
+
+void MetricsServer::halt()
+{
+    this->running = false;
+}
+
+} // namespace ModbusEngine
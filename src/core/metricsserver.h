@@ -0,0 +1,100 @@
+#ifndef METRICSSERVER_H
+#define METRICSSERVER_H
+
+#include <atomic>
+#include <string>
+
+#include "metrics.h"
+#include "thread.hpp"
+
+namespace ModbusEngine
+{
+
+/**
+ * @brief The MetricsServer class
+ *
+ * Minimal HTTP server of the metrics registry: answers "GET /metrics"
+ * with the Prometheus text exposition and any other request with 404.
+ * The requests are served one by one, the scrapes are rare.
+ *
+ * Usage:
+ *
+ * 1. Create instance
+ * 2. Call open()
+ * 3. Call startThread()
+ */
+
+class MetricsServer : public Thread
+{
+
+private:
+    /// max time in millisecs for reading a request and writing the answer
+    static const int IO_TIMEOUT = 2000;
+
+    /// listening address and port
+    std::string address;
+    int port;
+
+    /// the exposed registry
+    MetricsRegistry* registry;
+
+    /// the listening socket
+    int listenFd;
+
+    /// thread stop flag
+    std::atomic<bool> running;
+
+    /**
+     * @brief serve
+     * @param fd -> the accepted connection
+     *
+     * Reads the request header and sends the answer.
+     */
+    void serve( int fd );
+
+    /**
+     * @brief send_all
+     * @param fd    -> the accepted connection
+     * @param data  -> the bytes to send
+     * @return the data is sent
+     */
+    static bool send_all( int fd, const std::string& data );
+
+public:
+    /**
+     * @brief MetricsServer
+     * @param address   -> listening ip address ( e.g. "127.0.0.1" )
+     * @param port      -> listening port
+     * @param registry  -> the exposed registry
+     */
+    MetricsServer( std::string address, int port, MetricsRegistry* registry );
+    ~MetricsServer();
+
+    /**
+     * @brief open
+     *
+     * Creates the listening socket.
+     *
+     * The function throws std::string exception when the socket can not be bound.
+     */
+    void open() throw( std::string );
+
+    /**
+     * @brief run
+     *
+     * Inherited function from Thread class.
+     */
+    void run();
+
+    /**
+     * @brief halt
+     *
+     * Inherited function from Thread class.
+     */
+    void halt();
+
+};
+
+} // namespace ModbusEngine
+
+#endif // METRICSSERVER_H
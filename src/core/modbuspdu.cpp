@@ -0,0 +1,236 @@
+#include "modbuspdu.h"
+
+namespace ModbusEngine
+{
+
+std::vector<uint8> ModbusPDU::buildRead( int function, int offset, int count )
+{
+    std::vector<uint8> _pdu;
+
+    _pdu.push_back( (uint8)function );
+    _pdu.push_back( (uint8)( offset >> 8 ) );
+    _pdu.push_back( (uint8)( offset & 0xFF ) );
+    _pdu.push_back( (uint8)( count >> 8 ) );
+    _pdu.push_back( (uint8)( count & 0xFF ) );
+
+    return _pdu;
+}
+
+std::vector<uint8> ModbusPDU::buildWriteSingleCoil( int offset, bool value )
+{
+    std::vector<uint8> _pdu;
+
+    _pdu.push_back( FC_WRITE_SINGLE_COIL );
+    _pdu.push_back( (uint8)( offset >> 8 ) );
+    _pdu.push_back( (uint8)( offset & 0xFF ) );
+    _pdu.push_back( value ? 0xFF : 0x00 );
+    _pdu.push_back( 0x00 );
+
+    return _pdu;
+}
+
+std::vector<uint8> ModbusPDU::buildWriteMultipleCoils( int offset,
+                                                       int count,
+                                                       const std::vector<uint16>& values )
+{
+    std::vector<uint8> _pdu;
+    int _bytes = ( count + 7 ) / 8;
+
+    _pdu.push_back( FC_WRITE_MULTIPLE_COILS );
+    _pdu.push_back( (uint8)( offset >> 8 ) );
+    _pdu.push_back( (uint8)( offset & 0xFF ) );
+    _pdu.push_back( (uint8)( count >> 8 ) );
+    _pdu.push_back( (uint8)( count & 0xFF ) );
+    _pdu.push_back( (uint8)_bytes );
+
+    for( int i = 0; i < _bytes; i++ )
+    {
+        uint16 _word = values[ i / 2 ];
+        uint8 _byte = ( i % 2 ) ? (uint8)( _word >> 8 ) : (uint8)( _word & 0xFF );
+
+        /// the unused bits of the last byte must be zero
+        if( i == _bytes - 1 && count % 8 )
+        {
+            _byte &= (uint8)( ( 1 << ( count % 8 ) ) - 1 );
+        }
+
+        _pdu.push_back( _byte );
+    }
+
+    return _pdu;
+}
+
+std::vector<uint8> ModbusPDU::buildWriteMultipleRegisters( int offset,
+                                                           int count,
+                                                           const std::vector<uint16>& values )
+{
+    std::vector<uint8> _pdu;
+
+    _pdu.push_back( FC_WRITE_MULTIPLE_REGISTERS );
+    _pdu.push_back( (uint8)( offset >> 8 ) );
+    _pdu.push_back( (uint8)( offset & 0xFF ) );
+    _pdu.push_back( (uint8)( count >> 8 ) );
+    _pdu.push_back( (uint8)( count & 0xFF ) );
+    _pdu.push_back( (uint8)( count * 2 ) );
+
+    for( int i = 0; i < count; i++ )
+    {
+        _pdu.push_back( (uint8)( values[ i ] >> 8 ) );
+        _pdu.push_back( (uint8)( values[ i ] & 0xFF ) );
+    }
+
+    return _pdu;
+}
+
+int ModbusPDU::responseLength( const std::vector<uint8>& request )
+{
+    if( request.size() < 5 )
+    {
+        return -1;
+    }
+
+    int _count = ( request[ 3 ] << 8 ) | request[ 4 ];
+
+    switch( request[ 0 ] )
+    {
+        case FC_READ_COILS :
+        case FC_READ_DISCRETE_INPUTS :
+            return 2 + ( _count + 7 ) / 8;
+
+        case FC_READ_HOLDING_REGISTERS :
+        case FC_READ_INPUT_REGISTERS :
+            return 2 + _count * 2;
+
+        case FC_WRITE_SINGLE_COIL :
+        case FC_WRITE_SINGLE_REGISTER :
+        case FC_WRITE_MULTIPLE_COILS :
+        case FC_WRITE_MULTIPLE_REGISTERS :
+            return 5;
+
+        default :
+            return -1;
+    }
+}
+
+MBError::Code ModbusPDU::checkResponse( const std::vector<uint8>& request,
+                                        const std::vector<uint8>& response )
+{
+    if( response.size() == 2 && response[ 0 ] == ( request[ 0 ] | EXCEPTION_BIT ) )
+    {
+        return exceptionCode( response[ 1 ] );
+    }
+
+    if( response.empty() ||
+        response[ 0 ] != request[ 0 ] ||
+        (int)response.size() != responseLength( request ) )
+    {
+        return MBError::BAD_RESPONSE;
+    }
+
+    /// the write responses echo the address
+    if( request[ 0 ] >= FC_WRITE_SINGLE_COIL &&
+        ( response[ 1 ] != request[ 1 ] || response[ 2 ] != request[ 2 ] ) )
+    {
+        return MBError::BAD_RESPONSE;
+    }
+
+    return MBError::NO_ERROR;
+}
+
+std::vector<uint16> ModbusPDU::parseRegisters( const std::vector<uint8>& response, int count )
+{
+    std::vector<uint16> _values( count, 0 );
+
+    for( int i = 0; i < count; i++ )
+    {
+        _values[ i ] = (uint16)( ( response[ 2 + 2 * i ] << 8 ) | response[ 3 + 2 * i ] );
+    }
+
+    return _values;
+}
+
+std::vector<uint16> ModbusPDU::parseBits( const std::vector<uint8>& response, int count )
+{
+    std::vector<uint16> _values( ( count + 15 ) / 16, 0 );
+    int _bytes = ( count + 7 ) / 8;
+
+    for( int i = 0; i < _bytes; i++ )
+    {
+        uint8 _byte = response[ 2 + i ];
+
+        /// the unused bits of the last byte are ignored
+        if( i == _bytes - 1 && count % 8 )
+        {
+            _byte &= (uint8)( ( 1 << ( count % 8 ) ) - 1 );
+        }
+
+        _values[ i / 2 ] |= ( i % 2 ) ? (uint16)( _byte << 8 ) : (uint16)_byte;
+    }
+
+    return _values;
+}
+
+MBError::Code ModbusPDU::exceptionCode( int code )
+{
+    switch( code )
+    {
+        case 1 :
+            return MBError::ILLEGAL_FUNCTION_CODE;
+
+        case 2 :
+            return MBError::ILLEGAL_DATA_ADDRESS;
+
+        case 3 :
+            return MBError::ILLEGAL_DATA_VALUE;
+
+        case 4 :
+            return MBError::SERVER_FAIL;
+
+        case 5 :
+            return MBError::ERROR_ACK;
+
+        case 6 :
+            return MBError::SERVER_BUSY;
+
+        case 7 :
+            return MBError::NEGATIVE_ACK;
+
+        case 8 :
+            return MBError::MEMORY_PARITY;
+
+        case 10 :
+            return MBError::GATEWAY_PATH_EXCEPTION;
+
+        case 11 :
+            return MBError::GATEWAY_RESPOND_EXCEPTION;
+
+        default :
+            return MBError::BAD_EXCEPTION;
+    }
+}
+
+uint16 ModbusPDU::crc16( const uint8* data, int length )
+{
+    uint16 _crc = 0xFFFF;
+
+    for( int i = 0; i < length; i++ )
+    {
+        _crc ^= data[ i ];
+
+        for( int j = 0; j < 8; j++ )
+        {
+            if( _crc & 0x0001 )
+            {
+                _crc = ( _crc >> 1 ) ^ 0xA001;
+            }
+            else
+            {
+                _crc >>= 1;
+            }
+        }
+    }
+
+    return _crc;
+}
+
+} // namespace ModbusEngine
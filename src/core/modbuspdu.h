@@ -0,0 +1,135 @@
+#ifndef MODBUSPDU_H
+#define MODBUSPDU_H
+
+#include <string>
+#include <vector>
+
+#include "mberror.h"
+#include "types.h"
+
+namespace ModbusEngine
+{
+
+/**
+ * @brief The ModbusPDU class
+ *
+ * Encoder and decoder of the modbus protocol data units ( function code + data )
+ * and the RTU CRC. Used by the transports which do the framing themselves.
+ * It is a library class.
+ */
+
+class ModbusPDU
+{
+
+public:
+    /// supported function codes
+    static const int FC_READ_COILS = 0x01;
+    static const int FC_READ_DISCRETE_INPUTS = 0x02;
+    static const int FC_READ_HOLDING_REGISTERS = 0x03;
+    static const int FC_READ_INPUT_REGISTERS = 0x04;
+    static const int FC_WRITE_SINGLE_COIL = 0x05;
+    static const int FC_WRITE_SINGLE_REGISTER = 0x06;
+    static const int FC_WRITE_MULTIPLE_COILS = 0x0F;
+    static const int FC_WRITE_MULTIPLE_REGISTERS = 0x10;
+
+    /// the function code of an exception response has this bit set
+    static const int EXCEPTION_BIT = 0x80;
+
+    /// protocol limits
+    static const int MAX_READ_BITS = 2000;
+    static const int MAX_READ_REGISTERS = 125;
+    static const int MAX_WRITE_BITS = 1968;
+    static const int MAX_WRITE_REGISTERS = 123;
+
+    /**
+     * @brief buildRead
+     * @param function  -> FC_READ_COILS .. FC_READ_INPUT_REGISTERS
+     * @param offset    -> first address
+     * @param count     -> number of bits or registers
+     * @return the request pdu
+     */
+    static std::vector<uint8> buildRead( int function, int offset, int count );
+
+    /**
+     * @brief buildWriteSingleCoil
+     * @param offset    -> address of the coil
+     * @param value     -> the value to write
+     * @return the request pdu
+     */
+    static std::vector<uint8> buildWriteSingleCoil( int offset, bool value );
+
+    /**
+     * @brief buildWriteMultipleCoils
+     * @param offset    -> first address
+     * @param count     -> number of coils
+     * @param values    -> the packed values (LSB first)
+     * @return the request pdu
+     */
+    static std::vector<uint8> buildWriteMultipleCoils( int offset,
+                                                       int count,
+                                                       const std::vector<uint16>& values );
+
+    /**
+     * @brief buildWriteMultipleRegisters
+     * @param offset    -> first address
+     * @param count     -> number of registers
+     * @param values    -> the values to write
+     * @return the request pdu
+     */
+    static std::vector<uint8> buildWriteMultipleRegisters( int offset,
+                                                           int count,
+                                                           const std::vector<uint16>& values );
+
+    /**
+     * @brief responseLength
+     * @param request -> the request pdu
+     * @return length of the normal response pdu, -1 for unknown function
+     */
+    static int responseLength( const std::vector<uint8>& request );
+
+    /**
+     * @brief checkResponse
+     * @param request   -> the request pdu
+     * @param response  -> the response pdu
+     * @return NO_ERROR, the code of the exception response or BAD_RESPONSE
+     *         when the response does not match the request
+     */
+    static MBError::Code checkResponse( const std::vector<uint8>& request,
+                                        const std::vector<uint8>& response );
+
+    /**
+     * @brief parseRegisters
+     * @param response  -> checked read registers response pdu
+     * @param count     -> number of registers
+     * @return the registers
+     */
+    static std::vector<uint16> parseRegisters( const std::vector<uint8>& response, int count );
+
+    /**
+     * @brief parseBits
+     * @param response  -> checked read bits response pdu
+     * @param count     -> number of bits
+     * @return the bits packed into words (LSB first)
+     */
+    static std::vector<uint16> parseBits( const std::vector<uint8>& response, int count );
+
+    /**
+     * @brief exceptionCode
+     * @param code -> modbus exception code
+     * @return the engine error code of the exception code
+     */
+    static MBError::Code exceptionCode( int code );
+
+    /**
+     * @brief crc16
+     * @param data      -> the frame
+     * @param length    -> length of the frame
+     * @return the modbus RTU CRC of the frame
+     */
+    static uint16 crc16( const uint8* data, int length );
+
+};
+
+} // namespace ModbusEngine
+
+#endif // MODBUSPDU_H
@@ -0,0 +1,156 @@
+#ifndef MPSCQUEUE_HPP
+#define MPSCQUEUE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <stdint.h>
+
+namespace ModbusEngine
+{
+
+/**
+ * @brief The MPSCQueue class
+ *
+ * Bounded lock-free multi producer / single consumer queue.
+ * Every cell carries a sequence number, so producers never take a lock and
+ * never wait for the consumer: push() only retries its CAS when another
+ * producer took the same slot, and fails immediately when the queue is full.
+ * It is a library class.
+ */
+template<typename T>
+class MPSCQueue
+{
+
+private:
+    /// one slot of the ring buffer
+    class Cell
+    {
+    public:
+        std::atomic<size_t> sequence;
+        T data;
+    };
+
+    /// the ring buffer and the index mask ( capacity - 1 )
+    Cell* buffer;
+    size_t mask;
+
+    /// producer position (shared by the producers)
+    std::atomic<size_t> enqueuePos;
+    /// keeps the two positions on different cache lines
+    char padding[ 64 ];
+    /// consumer position (touched only by the consumer)
+    size_t dequeuePos;
+
+    MPSCQueue( const MPSCQueue& );
+    MPSCQueue& operator=( const MPSCQueue& );
+
+public:
+    /**
+     * @brief MPSCQueue
+     * @param capacity -> number of slots, rounded up to a power of two
+     */
+    MPSCQueue( size_t capacity )
+    {
+        size_t _size = 2;
+        while( _size < capacity )
+        {
+            _size <<= 1;
+        }
+
+        this->buffer = new Cell[ _size ];
+        this->mask = _size - 1;
+
+        for( size_t i = 0; i < _size; i++ )
+        {
+            this->buffer[ i ].sequence.store( i, std::memory_order_relaxed );
+        }
+
+        this->enqueuePos.store( 0, std::memory_order_relaxed );
+        this->dequeuePos = 0;
+    }
+
+    ~MPSCQueue()
+    {
+        delete[] this->buffer;
+    }
+
+    /**
+     * @brief push
+     * @param item -> the item to enqueue
+     * @return false when the queue is full
+     *
+     * Can be called from any thread.
+     */
+    bool push( const T& item )
+    {
+        Cell* _cell;
+        size_t _pos = this->enqueuePos.load( std::memory_order_relaxed );
+
+        while( true )
+        {
+            _cell = &this->buffer[ _pos & this->mask ];
+            size_t _seq = _cell->sequence.load( std::memory_order_acquire );
+            intptr_t _dif = (intptr_t)_seq - (intptr_t)_pos;
+
+            if( _dif == 0 )
+            {
+                if( this->enqueuePos.compare_exchange_weak( _pos, _pos + 1,
+                                                            std::memory_order_relaxed ) )
+                {
+                    break;
+                }
+            }
+            else if( _dif < 0 )
+            {
+                return false;
+            }
+            else
+            {
+                _pos = this->enqueuePos.load( std::memory_order_relaxed );
+            }
+        }
+
+        _cell->data = item;
+        _cell->sequence.store( _pos + 1, std::memory_order_release );
+
+        return true;
+    }
+
+    /**
+     * @brief pop
+     * @param item -> the dequeued item
+     * @return false when the queue is empty
+     *
+     * Must be called from the consumer thread only.
+     */
+    bool pop( T& item )
+    {
+        Cell* _cell = &this->buffer[ this->dequeuePos & this->mask ];
+        size_t _seq = _cell->sequence.load( std::memory_order_acquire );
+
+        if( (intptr_t)_seq - (intptr_t)( this->dequeuePos + 1 ) < 0 )
+        {
+            return false;
+        }
+
+        item = _cell->data;
+        _cell->sequence.store( this->dequeuePos + this->mask + 1, std::memory_order_release );
+        this->dequeuePos++;
+
+        return true;
+    }
+
+    /**
+     * @brief capacity
+     * @return the number of slots
+     */
+    size_t capacity()
+    {
+        return this->mask + 1;
+    }
+
+};
+
+} // namespace ModbusEngine
+
+#endif // MPSCQUEUE_HPP
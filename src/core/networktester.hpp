@@ -1,14 +1,58 @@
+#ifndef NETWORKTESTER_HPP
+#define NETWORKTESTER_HPP
+
+#include <arpa/inet.h>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string>
+#include <sys/socket.h>
+#include <unistd.h>
 
 namespace ModbusEngine
 {
 
+/**
+ * @brief The SocketOptions class
+ *
+ * TCP socket options of a connection.
+ */
+class SocketOptions
+{
+
+public:
+    /// disables the Nagle algorithm
+    bool noDelay;
+    /// keepalive probes: idle time and interval in secs, number of probes
+    bool keepAlive;
+    int keepAliveIdle;
+    int keepAliveInterval;
+    int keepAliveCount;
+    /// max time in millisecs for unacknowledged data, 0 -> system default
+    int userTimeout;
+
+    SocketOptions()
+    {
+        noDelay = true;
+        keepAlive = false;
+        keepAliveIdle = 60;
+        keepAliveInterval = 10;
+        keepAliveCount = 3;
+        userTimeout = 0;
+    }
+};
+
 /**
  * @brief The NetworkTester class
  *
- * It is a library class for test if the host is reachable or not.
+ * It is a library class for test if the host is reachable or not,
+ * and for connecting with timeout.
  */
 class NetworkTester
 {
@@ -65,6 +109,96 @@ public:
 
         return false;
     }
+
+    /**
+     * @brief connect
+     * @param ip        -> host's ip address
+     * @param port      -> host's port
+     * @param timeout   -> connection timeout in millisecs
+     * @param options   -> socket options
+     * @return the connected non-blocking socket, -1 on error ( errno is set,
+     *         ETIMEDOUT when the timeout is over )
+     */
+    static int connect( std::string ip,
+                        int port,
+                        int timeout,
+                        const SocketOptions& options = SocketOptions() )
+    {
+        struct sockaddr_in addr;
+        memset( &addr, 0, sizeof( addr ) );
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons( port );
+
+        if( inet_pton( AF_INET, ip.c_str(), &addr.sin_addr ) != 1 ) {
+            errno = EINVAL;
+            return -1;
+        }
+
+        int fd = socket( AF_INET, SOCK_STREAM, 0 );
+        if( fd == -1 ) {
+            return -1;
+        }
+
+        fcntl( fd, F_SETFL, fcntl( fd, F_GETFL, 0 ) | O_NONBLOCK );
+
+        int flag = options.noDelay ? 1 : 0;
+        setsockopt( fd, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof( flag ) );
+
+        if( options.keepAlive ) {
+            flag = 1;
+            setsockopt( fd, SOL_SOCKET, SO_KEEPALIVE, &flag, sizeof( flag ) );
+            setsockopt( fd, IPPROTO_TCP, TCP_KEEPIDLE, &options.keepAliveIdle, sizeof( int ) );
+            setsockopt( fd, IPPROTO_TCP, TCP_KEEPINTVL, &options.keepAliveInterval, sizeof( int ) );
+            setsockopt( fd, IPPROTO_TCP, TCP_KEEPCNT, &options.keepAliveCount, sizeof( int ) );
+        }
+
+        if( options.userTimeout > 0 ) {
+            unsigned int userTimeout = options.userTimeout;
+            setsockopt( fd, IPPROTO_TCP, TCP_USER_TIMEOUT, &userTimeout, sizeof( userTimeout ) );
+        }
+
+        /// Non-blocking connect, waiting at most timeout millisecs
+        if( ::connect( fd, (struct sockaddr*)&addr, sizeof( addr ) ) == -1 ) {
+            if( errno != EINPROGRESS ) {
+                int error = errno;
+                close( fd );
+                errno = error;
+                return -1;
+            }
+
+            struct pollfd pfd;
+            pfd.fd = fd;
+            pfd.events = POLLOUT;
+            pfd.revents = 0;
+
+            int ready;
+            std::chrono::steady_clock::time_point deadline =
+                    std::chrono::steady_clock::now() + std::chrono::milliseconds( timeout );
+
+            do {
+                long long left = std::chrono::duration_cast<std::chrono::milliseconds>(
+                            deadline - std::chrono::steady_clock::now() ).count();
+                ready = poll( &pfd, 1, left > 0 ? (int)left : 0 );
+            } while( ready == -1 && errno == EINTR );
+
+            int error = ETIMEDOUT;
+            socklen_t len = sizeof( error );
+
+            if( ready == 1 &&
+                getsockopt( fd, SOL_SOCKET, SO_ERROR, &error, &len ) == 0 &&
+                error == 0 ) {
+                return fd;
+            }
+
+            close( fd );
+            errno = ( ready == 1 ) ? error : ETIMEDOUT;
+            return -1;
+        }
+
+        return fd;
+    }
 };
 
 }
+
+#endif // NETWORKTESTER_HPP
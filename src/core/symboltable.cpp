@@ -0,0 +1,51 @@
+#include "symboltable.h"
+
+namespace ModbusEngine
+{
+
+const Symbol SymbolTable::NONE;
+
+std::mutex SymbolTable::tableMutex;
+std::map<std::string,Symbol> SymbolTable::symbols;
+std::deque<std::string> SymbolTable::names;
+
+Symbol SymbolTable::intern( const std::string& name )
+{
+    std::lock_guard<std::mutex> _lock( tableMutex );
+
+    std::map<std::string,Symbol>::iterator _it = symbols.find( name );
+
+    if( _it != symbols.end() )
+    {
+        return _it->second;
+    }
+
+    Symbol _symbol = names.size();
+    names.push_back( name );
+    symbols[ name ] = _symbol;
+
+    return _symbol;
+}
+
+Symbol SymbolTable::find( const std::string& name )
+{
+    std::lock_guard<std::mutex> _lock( tableMutex );
+
+    std::map<std::string,Symbol>::iterator _it = symbols.find( name );
+
+    return ( _it != symbols.end() ) ? _it->second : NONE;
+}
+
+std::string SymbolTable::name( Symbol symbol )
+{
+    std::lock_guard<std::mutex> _lock( tableMutex );
+
+    if( symbol < 0 || symbol >= (Symbol)names.size() )
+    {
+        return "";
+    }
+
+    return names[ symbol ];
+}
+
+}
@@ -0,0 +1,66 @@
+#ifndef SYMBOLTABLE_H
+#define SYMBOLTABLE_H
+
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+
+namespace ModbusEngine
+{
+
+/// an interned identifier ( device id, block id ), equal names -> equal symbols
+typedef int Symbol;
+
+/**
+ * @brief The SymbolTable class
+ *
+ * Engine-wide interning table of the identifiers. The devices and the
+ * blocks are stored and found by their symbols, the polling path compares
+ * small integers instead of strings. The names are materialized only for
+ * the output ( tables, logs ).
+ *
+ * The symbols are given when the project is loaded and they are never
+ * taken back, a reload keeps the symbols of the unchanged identifiers.
+ * It is thread safe, intern() and find() take a lock: do not call them
+ * on the polling path, keep the symbol instead.
+ */
+class SymbolTable
+{
+
+private:
+    static std::mutex tableMutex;
+    static std::map<std::string,Symbol> symbols;
+    /// the names by symbol ( a deque keeps the stored names in place )
+    static std::deque<std::string> names;
+
+public:
+    /// the symbol of an unknown name, nothing is stored under it
+    static const Symbol NONE = -1;
+
+    /**
+     * @brief intern
+     * @param name -> the identifier
+     * @return the symbol of the name, a new one for a new name
+     */
+    static Symbol intern( const std::string& name );
+
+    /**
+     * @brief find
+     * @param name -> the identifier
+     * @return the symbol of the name, NONE when it was never interned
+     */
+    static Symbol find( const std::string& name );
+
+    /**
+     * @brief name
+     * @param symbol -> the symbol
+     * @return the name of the symbol, "" for NONE
+     */
+    static std::string name( Symbol symbol );
+
+};
+
+}
+
+#endif // SYMBOLTABLE_H
@@ -0,0 +1,160 @@
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <unistd.h>
+
+#include "trace.h"
+
+namespace ModbusEngine
+{
+
+std::atomic<bool> Trace::enabled( false );
+std::atomic<bool> Trace::dumpFlag( false );
+size_t Trace::bufferSize = 4096;
+uint64_t Trace::baseTsc = 0;
+std::chrono::steady_clock::time_point Trace::baseTime;
+std::mutex Trace::buffersMutex;
+std::vector<Trace::Buffer*> Trace::buffers;
+int Trace::lastTid = 0;
+thread_local Trace::Buffer* Trace::local = NULL;
+thread_local Trace::Owner Trace::owner;
+
+Trace::Owner::~Owner()
+{
+    if( local == NULL ) return;
+
+    std::lock_guard<std::mutex> _lock( buffersMutex );
+    local->released = true;
+    local = NULL;
+}
+
+void Trace::enable( size_t events )
+{
+    size_t _size = 2;
+    while( _size < events )
+    {
+        _size <<= 1;
+    }
+
+    bufferSize = _size;
+    baseTsc = timestamp();
+    baseTime = std::chrono::steady_clock::now();
+
+    enabled.store( true );
+}
+
+Trace::Buffer* Trace::local_buffer()
+{
+    /// constructs the owner of the thread, it releases the ring at the exit
+    (void)owner;
+
+    std::lock_guard<std::mutex> _lock( buffersMutex );
+
+    Buffer* _b = NULL;
+    for( size_t i = 0; i < buffers.size() && _b == NULL; i++ )
+    {
+        if( buffers[ i ]->released ) _b = buffers[ i ];
+    }
+
+    /// the events of the exited thread are dropped
+    if( _b == NULL )
+    {
+        _b = new Buffer();
+        _b->events.resize( bufferSize );
+        _b->mask = bufferSize - 1;
+        buffers.push_back( _b );
+    }
+
+    _b->head.store( 0 );
+    _b->tid = ++lastTid;
+    _b->name.clear();
+    _b->released = false;
+
+    local = _b;
+
+    return _b;
+}
+
+void Trace::setThreadName( const std::string& name )
+{
+    if( !isEnabled() ) return;
+
+    Buffer* _b = local ? local : local_buffer();
+
+    std::lock_guard<std::mutex> _lock( buffersMutex );
+    _b->name = name;
+}
+
+bool Trace::dump( const std::string& filename )
+{
+    std::ofstream _file;
+    _file.open( filename, _file.out | _file.trunc );
+    if( !_file.is_open() ) return false;
+
+    /// ticks per microsec since enable()
+    double _elapsed = (double)std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - baseTime ).count();
+    double _ticks = (double)( timestamp() - baseTsc );
+    double _rate = ( _elapsed > 0 && _ticks > 0 ) ? _ticks / _elapsed : 1.0;
+
+    std::lock_guard<std::mutex> _lock( buffersMutex );
+
+    int _pid = (int)getpid();
+    bool _first = true;
+
+    /// microsecs with nanosec resolution
+    _file << std::fixed << std::setprecision( 3 );
+
+    _file << "{\"traceEvents\":[";
+
+    for( size_t i = 0; i < buffers.size(); i++ )
+    {
+        Buffer* _b = buffers[ i ];
+        size_t _size = _b->events.size();
+
+        /// copy the ring, then drop what the owner overwrote meanwhile
+        uint64_t _head = _b->head.load( std::memory_order_acquire );
+        uint64_t _start = _head > _size ? _head - _size : 0;
+
+        std::vector<Event> _events;
+        _events.reserve( _head - _start );
+        for( uint64_t k = _start; k < _head; k++ )
+        {
+            _events.push_back( _b->events[ k & _b->mask ] );
+        }
+
+        uint64_t _after = _b->head.load( std::memory_order_acquire );
+        /// the owner writes the slot of head before publishing head + 1
+        uint64_t _valid = _after + 1 > _size ? _after + 1 - _size : 0;
+
+        if( !_b->name.empty() )
+        {
+            _file << ( _first ? "" : "," ) << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << _pid
+                  << ",\"tid\":" << _b->tid << ",\"args\":{\"name\":\"" << _b->name << "\"}}";
+            _first = false;
+        }
+
+        for( uint64_t k = std::max( _start, _valid ); k < _head; k++ )
+        {
+            const Event& _e = _events[ k - _start ];
+
+            double _ts = _e.tsc > baseTsc ? (double)( _e.tsc - baseTsc ) / _rate : 0.0;
+
+            _file << ( _first ? "" : "," ) << "\n{\"name\":\"" << _e.name << "\",\"ph\":\"" << _e.phase
+                  << "\",\"ts\":" << _ts << ",\"pid\":" << _pid << ",\"tid\":" << _b->tid;
+            if( _e.phase == 'i' )
+            {
+                _file << ",\"s\":\"t\"";
+            }
+            _file << "}";
+            _first = false;
+        }
+    }
+
+    _file << "\n]}\n";
+    _file.close();
+
+    return true;
+}
+
+} // namespace ModbusEngine
@@ -0,0 +1,210 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#if defined( __x86_64__ ) || defined( __i386__ )
+#include <x86intrin.h>
+#endif
+
+namespace ModbusEngine
+{
+
+/**
+ * @brief The Trace class
+ *
+ * Per-thread ring buffers of trace events for finding where the time
+ * of a cycle goes ( arbiter, locks, send, receive, decode ).
+ *
+ * Every thread writes its own fixed-size ring without locking, an event
+ * is a TSC timestamp, a static name and a phase ( begin, end, instant ).
+ * When the tracing is disabled an event costs one relaxed atomic load.
+ * The rings are dumped on demand to Chrome trace JSON
+ * ( chrome://tracing, Perfetto ), the oldest events are overwritten.
+ *
+ * The names must be string literals, only the pointers are stored.
+ * It is a library class.
+ */
+class Trace
+{
+
+private:
+    /// one event
+    class Event
+    {
+    public:
+        uint64_t tsc;
+        const char* name;
+        char phase;
+    };
+
+    /// the ring of one thread
+    class Buffer
+    {
+    public:
+        std::vector<Event> events;
+        size_t mask;
+        /// number of the written events, only the owner thread writes it
+        std::atomic<uint64_t> head;
+        int tid;
+        std::string name;
+        /// the thread exited, the next new thread takes the ring
+        bool released;
+    };
+
+    /// releases the ring of the thread at its exit
+    class Owner
+    {
+    public:
+        ~Owner();
+    };
+
+    /// tracing on/off
+    static std::atomic<bool> enabled;
+    /// dump requested by signal
+    static std::atomic<bool> dumpFlag;
+
+    /// number of events per thread ( power of two )
+    static size_t bufferSize;
+    /// time base for converting the timestamps
+    static uint64_t baseTsc;
+    static std::chrono::steady_clock::time_point baseTime;
+
+    /// the rings of the threads
+    static std::mutex buffersMutex;
+    static std::vector<Buffer*> buffers;
+    static int lastTid;
+    static thread_local Buffer* local;
+    static thread_local Owner owner;
+
+    /**
+     * @brief local_buffer
+     * @return the ring of the calling thread, created at the first use
+     *
+     * A ring released by an exited thread is taken over with a new tid,
+     * so the threads started by the reloads do not grow the rings.
+     */
+    static Buffer* local_buffer();
+
+    /**
+     * @brief record
+     * @param name  -> event name
+     * @param phase -> 'B', 'E' or 'i'
+     */
+    static void record( const char* name, char phase )
+    {
+        Buffer* _b = local ? local : local_buffer();
+        uint64_t _h = _b->head.load( std::memory_order_relaxed );
+
+        Event& _e = _b->events[ _h & _b->mask ];
+        _e.tsc = timestamp();
+        _e.name = name;
+        _e.phase = phase;
+
+        _b->head.store( _h + 1, std::memory_order_release );
+    }
+
+public:
+    /**
+     * @brief enable
+     * @param events -> number of events per thread, rounded up to a power of two
+     *
+     * Turns the tracing on. Must be called before the threads start.
+     */
+    static void enable( size_t events );
+
+    /**
+     * @brief isEnabled
+     * @return the tracing is on
+     */
+    static bool isEnabled()
+    {
+        return enabled.load( std::memory_order_relaxed );
+    }
+
+    /**
+     * @brief timestamp
+     * @return the time stamp counter ( steady clock nanosecs where there is no TSC )
+     */
+    static uint64_t timestamp()
+    {
+#if defined( __x86_64__ ) || defined( __i386__ )
+        return __rdtsc();
+#else
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch() ).count();
+#endif
+    }
+
+    /**
+     * @brief begin
+     * @param name -> span name ( string literal )
+     */
+    static void begin( const char* name )
+    {
+        if( enabled.load( std::memory_order_relaxed ) ) record( name, 'B' );
+    }
+
+    /**
+     * @brief end
+     * @param name -> span name ( the same as at begin() )
+     */
+    static void end( const char* name )
+    {
+        if( enabled.load( std::memory_order_relaxed ) ) record( name, 'E' );
+    }
+
+    /**
+     * @brief instant
+     * @param name -> event name ( string literal )
+     */
+    static void instant( const char* name )
+    {
+        if( enabled.load( std::memory_order_relaxed ) ) record( name, 'i' );
+    }
+
+    /**
+     * @brief setThreadName
+     * @param name -> name of the calling thread in the dump
+     */
+    static void setThreadName( const std::string& name );
+
+    /**
+     * @brief requestDump
+     *
+     * Asks for a dump, it is async-signal-safe.
+     */
+    static void requestDump()
+    {
+        dumpFlag.store( true );
+    }
+
+    /**
+     * @brief dumpRequested
+     * @return a dump was requested since the last call
+     */
+    static bool dumpRequested()
+    {
+        return dumpFlag.exchange( false );
+    }
+
+    /**
+     * @brief dump
+     * @param filename -> the JSON file to write
+     * @return the file is written
+     *
+     * Writes the events of all threads to Chrome trace JSON. The threads
+     * are not stopped, the events overwritten during the copy are dropped.
+     */
+    static bool dump( const std::string& filename );
+
+};
+
+} // namespace ModbusEngine
+
+#endif // TRACE_H
@@ -1,8 +1,10 @@
 #include <iostream>
-#include <fstream>
 #include <ctime>
+#include <sstream>
+#include <signal.h>
 
 #include "engine.h"
+#include "mbprocache.h"
 #include "Core/lib/rapidxml/rapidxml.hpp"
 
 namespace ModbusEngine
@@ -11,14 +13,17 @@ namespace ModbusEngine
 Engine::Engine( std::string mbproXmlUrl )
 {
     this->mbproXmlUrl = mbproXmlUrl;
+    this->metrics = new MetricsRegistry();
+    this->metricsServer = NULL;
+    this->stateFile = NULL;
 }
 
-void Engine::read_mpro() throw( std::string )
+bool Engine::read_mpro() throw( std::string )
 {
     mbpro = new MBPro( mbproXmlUrl );
 
     try {
-        mbpro->readMBPro();
+        return mbpro->readMBPro();
     } catch( std::string ex ) {
         throw ex;
     }
@@ -30,7 +35,29 @@ bool Engine::buildEngine()
     try
     {
         std::cout << "Open file: '" << this->mbproXmlUrl << "'...";
-        read_mpro();
+        bool _cached = read_mpro();
+        std::cout << "DONE." << std::endl;
+
+        /// the logger is not open yet
+        if( !_cached )
+        {
+            std::cout << "WARNING: MBPro cache cannot be written: '"
+                      << MBProCache::cacheUrl( this->mbproXmlUrl ) << "'" << std::endl;
+        }
+    }
+    catch( std::string ex )
+    {
+        std::cout << std::endl;
+        std::cout << "ERROR: " << ex << std::endl;
+        return false;
+    }
+
+    /// open the log file, the writer thread starts after the fork
+    try
+    {
+        std::cout << "Open log file: '" << mbpro->log.file << "'...";
+        Logger::open( mbpro->log.file, mbpro->log.maxSize, mbpro->log.files,
+                      Logger::toLevel( mbpro->log.level ) );
         std::cout << "DONE." << std::endl;
     }
     catch( std::string ex )
@@ -40,16 +67,31 @@ bool Engine::buildEngine()
         return false;
     }
 
+    /// the trace buffers are sized before the threads start
+    if( mbpro->trace.enabled )
+    {
+        Trace::enable( mbpro->trace.events );
+    }
+
     /// create modbus driver
     std::cout << "Build Modbus Driver module...";
-    driver = new ModbusDriver( mbpro );
+    driver = new ModbusDriver( mbpro, metrics );
     std::cout << "DONE." << std::endl;
 
+    /// restore the last known block images, the tags start as stale
+    if( !mbpro->state.file.empty() )
+    {
+        std::cout << "Restore state file: '" << mbpro->state.file << "'...";
+        stateFile = new StateFile( mbpro->state.file, mbpro->state.period );
+        stateFile->restore( mbpro, driver );
+        std::cout << "DONE." << std::endl;
+    }
+
     /// create tagsynchronizer module
     try
     {
         std::cout << "Build Tag Synchronizer module...";
-        tagSynchronizer = new TagSynchronizer( mbpro, driver );
+        tagSynchronizer = new TagSynchronizer( mbpro, driver, metrics );
         std::cout << "DONE." << std::endl;
     }
     catch( std::string ex )
@@ -63,7 +105,7 @@ bool Engine::buildEngine()
     try
     {
         std::cout << "Build Monitor Synchronizer module...";
-        monitorSynchronizer = new MonitorSynchronizer( mbpro, driver );
+        monitorSynchronizer = new MonitorSynchronizer( mbpro, driver, metrics );
         std::cout << "DONE." << std::endl;
     }
     catch( std::string ex )
@@ -73,69 +115,147 @@ bool Engine::buildEngine()
         return false;
     }
 
+    /// open the metrics endpoint
+    if( mbpro->metrics.port > 0 )
+    {
+        try
+        {
+            std::cout << "Open metrics endpoint...";
+            metricsServer = new MetricsServer( mbpro->metrics.address, mbpro->metrics.port, metrics );
+            metricsServer->open();
+            std::cout << "DONE." << std::endl;
+        }
+        catch( std::string ex )
+        {
+            std::cout << std::endl;
+            std::cout << "ERROR: " << ex << std::endl;
+            return false;
+        }
+    }
+
     return true;
 }
 
+/// SIGUSR1: dump the trace buffers ( done by the main loop )
+static void on_trace_signal( int )
+{
+    Trace::requestDump();
+}
+
+/// SIGHUP: reload the mbpro file ( done by the main loop )
+static volatile sig_atomic_t reloadRequested = 0;
+
+static void on_reload_signal( int )
+{
+    reloadRequested = 1;
+}
+
 void Engine::startEngine()
 {
-    /// start modbus driver
+    /// start the log writer
+    Logger::start();
+    Logger::log( Logger::LEVEL_INFO, "Engine started: " + mbproXmlUrl );
+
+    if( Trace::isEnabled() )
+    {
+        signal( SIGUSR1, on_trace_signal );
+    }
+    signal( SIGHUP, on_reload_signal );
+
+    /// start modbus driver first, the devices connect on their block threads
     driver->startBlockThreads();
 
-    /// start tag synchronizer
+    /// start tag synchronizer, it builds and loads its tables meanwhile
     tagSynchronizer->startThread();
 
-    /// start monitor synchronizer
+    /// start monitor synchronizer, it builds its tables meanwhile
     monitorSynchronizer->startThread();
-}
 
-void Engine::loop()
-{
-    while( true )
+    /// start metrics endpoint
+    if( metricsServer != NULL )
     {
-        Thread::sleep( 120 );
+        metricsServer->startThread();
     }
 }
 
-void Engine::write_to_log( std::string message )
+void Engine::reload()
 {
-    std::cout << message;
+    MBPro* _mbpro = new MBPro( mbproXmlUrl );
 
-    std::string logUrl = "/opt/modbusengine/log/modbusengine.log";
+    try
+    {
+        if( !_mbpro->readMBPro() )
+        {
+            Logger::log( Logger::LEVEL_WARNING, "MBPro cache cannot be written: " +
+                                                MBProCache::cacheUrl( mbproXmlUrl ) );
+        }
+    }
+    catch( std::string ex )
+    {
+        Logger::log( Logger::LEVEL_ERROR, "Reload failed: " + ex );
+        delete _mbpro;
+        return;
+    }
+
+    /// these sections are read only at the start
+    const MBPro_DB& _db = _mbpro->db;
+    if( _db.dbType != mbpro->db.dbType || _db.dbUrl != mbpro->db.dbUrl || _db.dbPort != mbpro->db.dbPort ||
+        _db.dbName != mbpro->db.dbName || _db.dbUser != mbpro->db.dbUser || _db.dbPass != mbpro->db.dbPass ||
+        _mbpro->log.file != mbpro->log.file || _mbpro->log.level != mbpro->log.level ||
+        _mbpro->log.maxSize != mbpro->log.maxSize || _mbpro->log.files != mbpro->log.files ||
+        _mbpro->metrics.address != mbpro->metrics.address || _mbpro->metrics.port != mbpro->metrics.port ||
+        _mbpro->trace.enabled != mbpro->trace.enabled || _mbpro->trace.events != mbpro->trace.events ||
+        _mbpro->state.file != mbpro->state.file || _mbpro->state.period != mbpro->state.period ||
+        _mbpro->sinks.sql.policy != mbpro->sinks.sql.policy || _mbpro->sinks.sql.queueSize != mbpro->sinks.sql.queueSize )
+    {
+        Logger::log( Logger::LEVEL_WARNING, "Reload: db, log, metrics, trace, state and sinks changes need a restart" );
+    }
 
-    /// opening log file...
-    std::ofstream logFile;
-    logFile.open( logUrl, logFile.out | logFile.app );
-    if( !logFile.is_open() ) return;
+    driver->reload( _mbpro );
+
+    /// the unchanged blocks keep their saved images
+    if( stateFile != NULL )
+    {
+        stateFile->relayout( _mbpro );
+    }
+    tagSynchronizer->reload( _mbpro );
+    monitorSynchronizer->reload( _mbpro );
 
-    /// write...
-    std::cout << message;
-    logFile.write( message.c_str(), message.length() );
+    /// the modules copied what they need from the old project
+    delete mbpro;
+    mbpro = _mbpro;
 
-    /// close file
-    logFile.close();
+    Logger::log( Logger::LEVEL_INFO, "Project reloaded: " + mbproXmlUrl );
 }
 
-void Engine::empty_log()
+void Engine::loop()
 {
-    std::string logUrl = "/opt/modbusengine/log/modbusengine.log";
+    while( true )
+    {
+        Thread::msleep( 200 );
 
-    /// opening log file...
-    std::ofstream logFile;
-    logFile.open( logUrl, logFile.out | logFile.trunc );
-    if( !logFile.is_open() ) return;
+        if( reloadRequested )
+        {
+            reloadRequested = 0;
+            reload();
+        }
 
-    /// emptying
-    logFile.write( "", 0 );
+        if( stateFile != NULL && stateFile->isDue() )
+        {
+            stateFile->save( driver );
+        }
 
-    /// close file
-    logFile.close();
-}
+        if( Trace::dumpRequested() )
+        {
+            std::stringstream _url;
+            _url << "/opt/modbusengine/log/trace-" << std::time( NULL ) << ".json";
 
-std::string Engine::get_timestamp()
-{
-    std::time_t dt = std::time( NULL );
-    std::string asciiTime = std::asctime( std::localtime( &dt ) );
-    return asciiTime.substr( 0, asciiTime.length() - 1 );
+            if( Trace::dump( _url.str() ) )
+            {
+                Logger::log( Logger::LEVEL_INFO, "Trace dumped: " + _url.str() );
+            }
+        }
+    }
 }
 
 } // namespace ModbusEngine
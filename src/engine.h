@@ -4,6 +4,11 @@
 #include "ModbusDriver/modbusdriver.h"
 #include "TagSynchronizer/tagsynchronizer.h"
 #include "MonitorSynchronizer/monitorsynchronizer.h"
+#include "Core/logger.h"
+#include "Core/metrics.h"
+#include "Core/metricsserver.h"
+#include "Core/trace.h"
+#include "statefile.h"
 
 namespace ModbusEngine
 {
@@ -22,36 +27,33 @@ private:
     TagSynchronizer* tagSynchronizer;
     /// inner created monitor synchronizer object
     MonitorSynchronizer* monitorSynchronizer;
+    /// the metrics of the modules
+    MetricsRegistry* metrics;
+    /// inner created metrics endpoint, NULL when it is not configured
+    MetricsServer* metricsServer;
+    /// inner created state file of the warm restart, NULL when it is not configured
+    StateFile* stateFile;
 
     /**
      * @brief readMbproXml
      *
      * Reads the mbpro file.
      *
-     * This function throws std::string exception.
-     */
-    void read_mpro() throw( std::string );
-
-    /**
-     * @brief writeToLog
-     * @param message -> message string
+     * @return false when the mbpro cache cannot be written
      *
-     * Writes message to log and to the standard output.
+     * This function throws std::string exception.
      */
-    void write_to_log( std::string message );
+    bool read_mpro() throw( std::string );
 
     /**
-     * @brief emptyLog
+     * @brief reload
      *
-     * Delete all content of the log file.
-     */
-    void empty_log();
-
-    /**
-     * @brief getDateTime
-     * @return the current timestamp in string
+     * Reads the mbpro file again and hands the new project to the
+     * modules. The devices, blocks and tags are changed without
+     * restarting the polling; the db, log, metrics, trace and state
+     * sections still need a restart. On a parse error the old project stays.
      */
-    std::string get_timestamp();
+    void reload();
 
 public:
     Engine( std::string mbproXmlUrl );
@@ -68,14 +70,18 @@ public:
      * @brief startEngine
      * @return the status of the starting
      *
-     * Starts the engine modules.
+     * Starts the engine modules. The polling does not wait for the
+     * database: the synchronizers build their tables on their own
+     * threads, parallel to the device connects.
      */
     void startEngine();
 
     /**
      * @brief loop
      *
-     * Empty loop for main function to stay in live.
+     * Loop for main function to stay in live. Dumps the trace
+     * buffers when SIGUSR1 asks for it, reloads the mbpro file
+     * on SIGHUP, saves the state file by its period.
      */
     void loop();
 
@@ -10,17 +10,99 @@
 #include <string.h>
 
 #include "engine.h"
+#include "simulator/benchmark.h"
+#include "simulator/rtuslavesimulator.h"
 
 using namespace std;
 
+/**
+ * @brief run_rtu_simulator
+ * @param linkPath      -> the serial port to create
+ * @param baudRate      -> emulated baud rate
+ * @param slaveCount    -> the slaves 1..slaveCount are on the line
+ * @return exit code
+ *
+ * Runs an RTU slave simulator in the foreground for testing.
+ */
+static int run_rtu_simulator( std::string linkPath, int baudRate, int slaveCount )
+{
+    ModbusEngine::RTUSlaveSimulator simulator( linkPath, baudRate > 0 ? baudRate : 19200 );
+
+    for( int i = 1; i <= slaveCount && i <= 247; i++ ) {
+        simulator.addSlave( i, new ModbusEngine::SimulatedSlave() );
+    }
+
+    try {
+        simulator.open();
+    } catch( std::string ex ) {
+        std::cout << "Error: " << ex << " ( " << linkPath << " )" << std::endl;
+        return -1;
+    }
+
+    std::cout << "RTU simulator on " << linkPath << std::endl;
+    simulator.run();
+
+    return 0;
+}
+
+/**
+ * @brief run_tcp_simulator
+ * @param projectXMLPath -> the project, its local TCP devices are simulated
+ * @return exit code
+ *
+ * Runs a TCP slave farm in the foreground for testing.
+ */
+static int run_tcp_simulator( std::string projectXMLPath )
+{
+    ModbusEngine::MBPro mbpro( projectXMLPath );
+
+    try {
+        mbpro.readMBPro();
+    } catch( std::string ex ) {
+        std::cout << "ERROR: " << ex << std::endl;
+        return -1;
+    }
+
+    int devices = 0;
+    ModbusEngine::TCPSlaveFarm* farm = ModbusEngine::Benchmark::buildFarm( &mbpro, devices );
+
+    try {
+        farm->open();
+    } catch( std::string ex ) {
+        std::cout << "Error: " << ex << " ( " << projectXMLPath << " )" << std::endl;
+        return -1;
+    }
+
+    std::cout << "TCP simulator for " << devices << " devices of " << projectXMLPath << std::endl;
+    farm->run();
+
+    return 0;
+}
+
 int main( int argc, char* argv[] )
 {
     /// Read parameters
     std::string projectXMLPath;
 
+    if( argc == 5 && std::string( argv[1] ) == "--rtu-simulator" ) {
+        return run_rtu_simulator( std::string( argv[2] ), atoi( argv[3] ), atoi( argv[4] ) );
+    }
+
+    if( argc == 3 && std::string( argv[1] ) == "--tcp-simulator" ) {
+        return run_tcp_simulator( std::string( argv[2] ) );
+    }
+
+    if( argc == 4 && std::string( argv[1] ) == "--benchmark" ) {
+        ModbusEngine::Benchmark benchmark( std::string( argv[2] ), atoi( argv[3] ) > 0 ? atoi( argv[3] ) : 10 );
+        return benchmark.run();
+    }
+
     if( argc == 1 || argc > 2 ) {
         std::cout << "Usage:" << std::endl;
         std::cout << "modbusengine <path-to-project-xml-file>" << std::endl;
+        std::cout << "modbusengine --rtu-simulator <serial-port-link> <baud-rate> <slave-count>" << std::endl;
+        std::cout << "modbusengine --tcp-simulator <path-to-project-xml-file>" << std::endl;
+        std::cout << "modbusengine --benchmark <path-to-project-xml-file> <seconds>" << std::endl;
         return -1;
     } else {
         projectXMLPath = std::string( argv[1] );
@@ -1,25 +1,55 @@
-#include <iostream>
-#include <sstream>
+#include <cstdlib>
+#include <cstring>
 #include <fstream>
 
 #include "mbpro.h"
+#include "mbprocache.h"
+#include "Core/logger.h"
+#include "Core/mbrtubus.h"
 #include "Core/lib/rapidxml/rapidxml.hpp"
 
 namespace ModbusEngine {
 
-MBPro::MBPro( std::string filename )
+/**
+ * The name and number helpers work on the parsed buffer in place,
+ * no temporary std::string or stringstream is built per node.
+ */
+template<class N>
+static bool is( N* n, const char* name )
 {
-    this->filename = filename;
+    size_t _size = strlen( name );
+    return n->name_size() == _size && memcmp( n->name(), name, _size ) == 0;
+}
+
+template<class N>
+static void to_number( N* n, int& value )
+{
+    value = (int)strtol( n->value(), NULL, 10 );
+}
+
+template<class N>
+static void to_number( N* n, long long& value )
+{
+    value = strtoll( n->value(), NULL, 10 );
 }
 
-void MBPro::readMBPro() throw ( std::string )
+template<class N>
+static void to_number( N* n, bool& value )
 {
-    // sstream for converts
-    std::stringstream ss;
+    value = strtol( n->value(), NULL, 10 ) != 0;
+}
 
+MBPro::MBPro( std::string filename, bool useCache )
+{
+    this->filename = filename;
+    this->useCache = useCache;
+}
+
+bool MBPro::readMBPro() throw ( std::string )
+{
     // opening MBPro file...
     std::ifstream mbproFile;
-    mbproFile.open( filename );
+    mbproFile.open( filename.c_str(), std::ios::binary );
 
     if( !mbproFile.is_open() ) {
         throw "Error: MBPro file cannot read.( " + filename + " )";
@@ -30,16 +60,33 @@ void MBPro::readMBPro() throw ( std::string )
     int size = mbproFile.tellg();
     mbproFile.seekg( 0, mbproFile.beg );
 
-    char* mbproFileContent = new char[ size ];
-    mbproFile.read( mbproFileContent, size );
+    // rapidxml parses a zero terminated buffer
+    std::vector<char> mbproFileContent( size + 1 );
+    mbproFile.read( &mbproFileContent[ 0 ], size );
+    mbproFileContent[ size ] = '\0';
 
     mbproFile.close();
 
-    // parsing the xml file...
+    // the compiled project is reused while the xml is unchanged
+    uint64_t _hash = MBProCache::hash( &mbproFileContent[ 0 ], size );
+    std::string _cache = MBProCache::cacheUrl( filename );
+
+    if( useCache && MBProCache::load( _cache, _hash, this ) ) {
+        return true;
+    }
+
+    parse_xml( &mbproFileContent[ 0 ] );
+
+    return !useCache || MBProCache::save( _cache, _hash, *this );
+}
+
+void MBPro::parse_xml( char* content ) throw ( std::string )
+{
+    // parsing the xml file, the values are read from the elements...
     rapidxml::xml_document<> doc;
 
     try {
-        doc.parse<0>( mbproFileContent );
+        doc.parse<rapidxml::parse_no_data_nodes>( content );
     } catch( rapidxml::parse_error ex ){
         throw "Error: mbpro file not valid.( " + filename + " )\n" + ex.what();
     }
@@ -64,7 +111,7 @@ void MBPro::readMBPro() throw ( std::string )
         throw "Error: missing name tag in mbpro file.( " + filename + " )";
     }
 
-    project.name = std::string( _project_name->value() );
+    project.name.assign( _project_name->value(), _project_name->value_size() );
 
     // read MBPro_DB...
     db.dbType = "null";
@@ -77,18 +124,18 @@ void MBPro::readMBPro() throw ( std::string )
     rapidxml::xml_node<>* _db = _root->first_node( "db" );
     for( rapidxml::xml_node<>* n = _db->first_node();
          n; n = n->next_sibling() ) {
-        if( std::string( n->name() ) == "dbType" ) {
-            db.dbType = std::string( n->value() );
-        } else if( std::string( n->name() ) == "dbUrl" ) {
-            db.dbUrl = std::string( n->value() );
-        } else if( std::string( n->name() ) == "dbPort" ) {
-            db.dbPort = std::string( n->value() );
-        } else if( std::string( n->name() ) == "dbName" ) {
-            db.dbName = std::string( n->value() );
-        } else if( std::string( n->name() ) == "dbUser" ) {
-            db.dbUser = std::string( n->value() );
-        } else if( std::string( n->name() ) == "dbPass" ) {
-            db.dbPass = std::string( n->value() );
+        if( is( n, "dbType" ) ) {
+            db.dbType.assign( n->value(), n->value_size() );
+        } else if( is( n, "dbUrl" ) ) {
+            db.dbUrl.assign( n->value(), n->value_size() );
+        } else if( is( n, "dbPort" ) ) {
+            db.dbPort.assign( n->value(), n->value_size() );
+        } else if( is( n, "dbName" ) ) {
+            db.dbName.assign( n->value(), n->value_size() );
+        } else if( is( n, "dbUser" ) ) {
+            db.dbUser.assign( n->value(), n->value_size() );
+        } else if( is( n, "dbPass" ) ) {
+            db.dbPass.assign( n->value(), n->value_size() );
         }
     }
 
@@ -135,41 +182,74 @@ void MBPro::readMBPro() throw ( std::string )
          d; d = d->next_sibling( "device" ) ) {
         MBPro_Driver_Device device;
         device.deviceId = "null";
+        device.transport = "tcp";
         device.ip = "null";
         device.port = 502;
+        device.serialPort = "null";
+        device.baudRate = 19200;
+        device.parity = "E";
+        device.dataBits = 8;
+        device.stopBits = 1;
         device.slaveId = 1;
         device.responseTimeout = 1000;
         device.connectionTimeout = 3000;
-
-        rapidxml::xml_node<>* blocks;
+        device.maxPipeline = 1;
+        device.reconnectMin = 1000;
+        device.reconnectMax = 60000;
+        device.tcpNoDelay = 1;
+        device.tcpKeepAlive = 0;
+        device.keepAliveIdle = 60;
+        device.keepAliveInterval = 10;
+        device.keepAliveCount = 3;
+        device.tcpUserTimeout = 0;
+
+        rapidxml::xml_node<>* blocks = NULL;
 
         for( rapidxml::xml_node<>* n = d->first_node();
              n; n = n->next_sibling() ) {
-            if( std::string( n->name() ) == "deviceId" ) {
-                device.deviceId = std::string( n->value() );
-            } else if( std::string( n->name() ) == "ip" ) {
-                device.ip = std::string( n->value() );
-            } else if( std::string( n->name() ) == "port" ) {
-                ss.str("");
-                ss.clear();
-                ss << std::string( n->value() );
-                ss >> device.port;
-            } else if( std::string( n->name() ) == "slaveId" ) {
-                ss.str("");
-                ss.clear();
-                ss << std::string( n->value() );
-                ss >> device.slaveId;
-            } else if( std::string( n->name() ) == "responseTimeout" ) {
-                ss.str("");
-                ss.clear();
-                ss << std::string( n->value() );
-                ss >> device.responseTimeout;
-            } else if( std::string( n->name() ) == "connectionTimeout" ) {
-                ss.str("");
-                ss.clear();
-                ss << std::string( n->value() );
-                ss >> device.connectionTimeout;
-            } else if( std::string( n->name() ) == "blocks" ) {
+            if( is( n, "deviceId" ) ) {
+                device.deviceId.assign( n->value(), n->value_size() );
+            } else if( is( n, "transport" ) ) {
+                device.transport.assign( n->value(), n->value_size() );
+            } else if( is( n, "ip" ) ) {
+                device.ip.assign( n->value(), n->value_size() );
+            } else if( is( n, "serialPort" ) ) {
+                device.serialPort.assign( n->value(), n->value_size() );
+            } else if( is( n, "baudRate" ) ) {
+                to_number( n, device.baudRate );
+            } else if( is( n, "parity" ) ) {
+                device.parity.assign( n->value(), n->value_size() );
+            } else if( is( n, "dataBits" ) ) {
+                to_number( n, device.dataBits );
+            } else if( is( n, "stopBits" ) ) {
+                to_number( n, device.stopBits );
+            } else if( is( n, "port" ) ) {
+                to_number( n, device.port );
+            } else if( is( n, "slaveId" ) ) {
+                to_number( n, device.slaveId );
+            } else if( is( n, "responseTimeout" ) ) {
+                to_number( n, device.responseTimeout );
+            } else if( is( n, "connectionTimeout" ) ) {
+                to_number( n, device.connectionTimeout );
+            } else if( is( n, "maxPipeline" ) ) {
+                to_number( n, device.maxPipeline );
+            } else if( is( n, "reconnectMin" ) ) {
+                to_number( n, device.reconnectMin );
+            } else if( is( n, "reconnectMax" ) ) {
+                to_number( n, device.reconnectMax );
+            } else if( is( n, "tcpNoDelay" ) ) {
+                to_number( n, device.tcpNoDelay );
+            } else if( is( n, "tcpKeepAlive" ) ) {
+                to_number( n, device.tcpKeepAlive );
+            } else if( is( n, "keepAliveIdle" ) ) {
+                to_number( n, device.keepAliveIdle );
+            } else if( is( n, "keepAliveInterval" ) ) {
+                to_number( n, device.keepAliveInterval );
+            } else if( is( n, "keepAliveCount" ) ) {
+                to_number( n, device.keepAliveCount );
+            } else if( is( n, "tcpUserTimeout" ) ) {
+                to_number( n, device.tcpUserTimeout );
+            } else if( is( n, "blocks" ) ) {
                 blocks = n;
             }
         }
@@ -178,10 +258,50 @@ void MBPro::readMBPro() throw ( std::string )
             throw "Error: missing deviceId tag in mbpro file.( " + filename + " )";
         }
 
-        if( device.ip == "null" ) {
+        if( device.transport != "tcp" && device.transport != "rtu" && device.transport != "rtu_over_tcp" ) {
+            throw "Error: bad transport tag in mbpro file.( " + filename + " )";
+        }
+
+        if( device.transport == "rtu" ) {
+            if( device.serialPort == "null" ) {
+                throw "Error: missing serialPort tag in mbpro file.( " + filename + " )";
+            }
+
+            if( !MBRTUBus::isValidBaudRate( device.baudRate ) ) {
+                throw "Error: bad baudRate tag in mbpro file.( " + filename + " )";
+            }
+
+            if( device.parity != "N" && device.parity != "E" && device.parity != "O" ) {
+                throw "Error: bad parity tag in mbpro file.( " + filename + " )";
+            }
+
+            if( device.dataBits != 7 && device.dataBits != 8 ) {
+                throw "Error: bad dataBits tag in mbpro file.( " + filename + " )";
+            }
+
+            if( device.stopBits != 1 && device.stopBits != 2 ) {
+                throw "Error: bad stopBits tag in mbpro file.( " + filename + " )";
+            }
+        } else if( device.ip == "null" ) {
             throw "Error: missing ip tag in mbpro file.( " + filename + " )";
         }
 
+        if( device.maxPipeline < 1 ) {
+            throw "Error: bad maxPipeline tag in mbpro file.( " + filename + " )";
+        }
+
+        if( device.reconnectMin < 1 || device.reconnectMax < device.reconnectMin ) {
+            throw "Error: bad reconnectMin or reconnectMax tag in mbpro file.( " + filename + " )";
+        }
+
+        if( device.keepAliveIdle < 1 || device.keepAliveInterval < 1 || device.keepAliveCount < 1 ) {
+            throw "Error: bad keepAliveIdle, keepAliveInterval or keepAliveCount tag in mbpro file.( " + filename + " )";
+        }
+
+        if( device.tcpUserTimeout < 0 ) {
+            throw "Error: bad tcpUserTimeout tag in mbpro file.( " + filename + " )";
+        }
+
         if( blocks == NULL ) {
             throw "Error: missing blocks tag in mbpro file.( " + filename + " )";
         }
@@ -191,35 +311,35 @@ void MBPro::readMBPro() throw ( std::string )
              b; b = b->next_sibling( "block" ) ) {
             MBPro_Driver_Block block;
             block.blockId = "null";
+            block.area = "holding_register";
             block.offset = -1;
             block.count = -1;
             block.cycleTime = 1000;
             block.retries = 3;
+            block.errorSleep = 3000;
+            block.priority = "normal";
+            block.onDemand = 0;
 
             for( rapidxml::xml_node<>* n1 = b->first_node();
                  n1; n1 = n1->next_sibling() ) {
-                if( std::string( n1->name() ) == "blockId" ) {
-                    block.blockId = std::string( n1->value() );
-                } else if( std::string( n1->name() ) == "offset" ) {
-                    ss.str("");
-                    ss.clear();
-                    ss << std::string( n1->value() );
-                    ss >> block.offset;
-                } else if( std::string( n1->name() ) == "count" ) {
-                    ss.str("");
-                    ss.clear();
-                    ss << std::string( n1->value() );
-                    ss >> block.count;
-                } else if( std::string( n1->name() ) == "cycleTime" ) {
-                    ss.str("");
-                    ss.clear();
-                    ss << std::string( n1->value() );
-                    ss >> block.cycleTime;
-                } else if( std::string( n1->name() ) == "retries" ) {
-                    ss.str("");
-                    ss.clear();
-                    ss << std::string( n1->value() );
-                    ss >> block.retries;
+                if( is( n1, "blockId" ) ) {
+                    block.blockId.assign( n1->value(), n1->value_size() );
+                } else if( is( n1, "area" ) ) {
+                    block.area.assign( n1->value(), n1->value_size() );
+                } else if( is( n1, "offset" ) ) {
+                    to_number( n1, block.offset );
+                } else if( is( n1, "count" ) ) {
+                    to_number( n1, block.count );
+                } else if( is( n1, "cycleTime" ) ) {
+                    to_number( n1, block.cycleTime );
+                } else if( is( n1, "retries" ) ) {
+                    to_number( n1, block.retries );
+                } else if( is( n1, "errorSleep" ) ) {
+                    to_number( n1, block.errorSleep );
+                } else if( is( n1, "priority" ) ) {
+                    block.priority.assign( n1->value(), n1->value_size() );
+                } else if( is( n1, "onDemand" ) ) {
+                    to_number( n1, block.onDemand );
                 }
             }
 
@@ -235,6 +355,15 @@ void MBPro::readMBPro() throw ( std::string )
                 throw "Error: missing count tag in mbpro file.( " + filename + " )";
             }
 
+            if( block.area != "coil" && block.area != "discrete_input" &&
+                block.area != "input_register" && block.area != "holding_register" ) {
+                throw "Error: bad area tag in mbpro file.( " + filename + " )";
+            }
+
+            if( block.priority != "high" && block.priority != "normal" && block.priority != "low" ) {
+                throw "Error: bad priority tag in mbpro file.( " + filename + " )";
+            }
+
             device.blocks.push_back( block );
         }
 
@@ -250,6 +379,13 @@ void MBPro::readMBPro() throw ( std::string )
 
     int i = 0;
 
+    size_t _count = 0;
+    for( rapidxml::xml_node<>* t = _taglist->first_node( "tag" );
+         t; t = t->next_sibling( "tag" ) ) {
+        _count++;
+    }
+    taglist.tags.reserve( _count );
+
     for( rapidxml::xml_node<>* t = _taglist->first_node( "tag" );
          t; t = t->next_sibling( "tag" ) ) {
         MBPro_Tag tag;
@@ -264,41 +400,32 @@ void MBPro::readMBPro() throw ( std::string )
         tag.add = "0";
         tag.divider = 1;
         tag.wordSwap = 0;
+        tag.rate = 0;
 
         for( rapidxml::xml_attribute<>* attr = t->first_attribute();
              attr; attr = attr->next_attribute() ) {
-            if( std::string( attr->name() ) == "name" ) {
-                tag.name = std::string( attr->value() );
-            } else if( std::string( attr->name() ) == "deviceId" ) {
-                tag.deviceId = std::string( attr->value() );
-            } else if( std::string( attr->name() ) == "blockId" ) {
-                tag.blockId = std::string( attr->value() );
-            } else if( std::string( attr->name() ) == "address" ) {
-                ss.str( "" );
-                ss.clear();
-                ss << std::string( attr->value() );
-                ss >> tag.address;
-            } else if( std::string( attr->name() ) == "subAddress" ) {
-                ss.str( "" );
-                ss.clear();
-                ss << std::string( attr->value() );
-                ss >> tag.subAddress;
-            } else if( std::string( attr->name() ) == "type" ) {
-                tag.type = std::string( attr->value() );
-            } else if( std::string( attr->name() ) == "multiple" ) {
-                tag.multiple = std::string( attr->value() );
-            } else if( std::string( attr->name() ) == "_add" ) {
-                tag.add = std::string( attr->value() );
-            } else if( std::string( attr->name() ) == "divider" ) {
-                ss.str( "" );
-                ss.clear();
-                ss << std::string( attr->value() );
-                ss >> tag.divider;
-            } else if( std::string( attr->name() ) == "wordSwap" ) {
-                ss.str( "" );
-                ss.clear();
-                ss << std::string( attr->value() );
-                ss >> tag.wordSwap;
+            if( is( attr, "name" ) ) {
+                tag.name.assign( attr->value(), attr->value_size() );
+            } else if( is( attr, "deviceId" ) ) {
+                tag.deviceId.assign( attr->value(), attr->value_size() );
+            } else if( is( attr, "blockId" ) ) {
+                tag.blockId.assign( attr->value(), attr->value_size() );
+            } else if( is( attr, "address" ) ) {
+                to_number( attr, tag.address );
+            } else if( is( attr, "subAddress" ) ) {
+                to_number( attr, tag.subAddress );
+            } else if( is( attr, "type" ) ) {
+                tag.type.assign( attr->value(), attr->value_size() );
+            } else if( is( attr, "multiple" ) ) {
+                tag.multiple.assign( attr->value(), attr->value_size() );
+            } else if( is( attr, "_add" ) ) {
+                tag.add.assign( attr->value(), attr->value_size() );
+            } else if( is( attr, "divider" ) ) {
+                to_number( attr, tag.divider );
+            } else if( is( attr, "wordSwap" ) ) {
+                to_number( attr, tag.wordSwap );
+            } else if( is( attr, "rate" ) ) {
+                to_number( attr, tag.rate );
             }
         }
 
@@ -322,10 +449,184 @@ void MBPro::readMBPro() throw ( std::string )
             throw "Error: missing type attribute at tags in mbpro file.( " + filename + " )";
         }
 
+        if( tag.rate < 0 ) {
+            throw "Error: bad rate attribute at tags in mbpro file.( " + filename + " )";
+        }
+
         taglist.tags.push_back( tag );
     }
 
-    delete mbproFileContent;
+    // read MBPro_Metrics (optional, port 0 -> no metrics endpoint)
+    metrics.address = "127.0.0.1";
+    metrics.port = 0;
+
+    rapidxml::xml_node<>* _metrics = _root->first_node( "metrics" );
+    if( _metrics != NULL ) {
+        for( rapidxml::xml_node<>* n = _metrics->first_node();
+             n; n = n->next_sibling() ) {
+            if( is( n, "address" ) ) {
+                metrics.address.assign( n->value(), n->value_size() );
+            } else if( is( n, "port" ) ) {
+                to_number( n, metrics.port );
+            }
+        }
+    }
+
+    if( metrics.port < 0 || metrics.port > 65535 ) {
+        throw "Error: bad port tag at metrics in mbpro file.( " + filename + " )";
+    }
+
+    // read MBPro_Trace (optional)
+    trace.enabled = 0;
+    trace.events = 16384;
+
+    rapidxml::xml_node<>* _trace = _root->first_node( "trace" );
+    if( _trace != NULL ) {
+        for( rapidxml::xml_node<>* n = _trace->first_node();
+             n; n = n->next_sibling() ) {
+            if( is( n, "enabled" ) ) {
+                to_number( n, trace.enabled );
+            } else if( is( n, "events" ) ) {
+                to_number( n, trace.events );
+            }
+        }
+    }
+
+    if( trace.events < 16 ) {
+        throw "Error: bad events tag at trace in mbpro file.( " + filename + " )";
+    }
+
+    // read MBPro_State (optional, empty file -> no warm restart)
+    state.file = "";
+    state.period = 10000;
+
+    rapidxml::xml_node<>* _state = _root->first_node( "state" );
+    if( _state != NULL ) {
+        for( rapidxml::xml_node<>* n = _state->first_node();
+             n; n = n->next_sibling() ) {
+            if( is( n, "file" ) ) {
+                state.file.assign( n->value(), n->value_size() );
+            } else if( is( n, "period" ) ) {
+                to_number( n, state.period );
+            }
+        }
+    }
+
+    if( state.period < 100 ) {
+        throw "Error: bad period tag at state in mbpro file.( " + filename + " )";
+    }
+
+    // read MBPro_Monitor (optional)
+    monitor.statsPeriod = 1000;
+
+    rapidxml::xml_node<>* _monitor = _root->first_node( "monitor" );
+    if( _monitor != NULL ) {
+        for( rapidxml::xml_node<>* n = _monitor->first_node();
+             n; n = n->next_sibling() ) {
+            if( is( n, "statsPeriod" ) ) {
+                to_number( n, monitor.statsPeriod );
+            }
+        }
+    }
+
+    if( monitor.statsPeriod < 100 ) {
+        throw "Error: bad statsPeriod tag at monitor in mbpro file.( " + filename + " )";
+    }
+
+    // read MBPro_Sinks (optional, the sql sink always exists)
+    sinks.sql.policy = "latest";
+    sinks.sql.queueSize = 8192;
+
+    rapidxml::xml_node<>* _sinks = _root->first_node( "sinks" );
+    if( _sinks != NULL ) {
+        rapidxml::xml_node<>* _sql = _sinks->first_node( "sql" );
+        if( _sql != NULL ) {
+            for( rapidxml::xml_node<>* n = _sql->first_node();
+                 n; n = n->next_sibling() ) {
+                if( is( n, "policy" ) ) {
+                    sinks.sql.policy.assign( n->value(), n->value_size() );
+                } else if( is( n, "queueSize" ) ) {
+                    to_number( n, sinks.sql.queueSize );
+                }
+            }
+        }
+    }
+
+    if( sinks.sql.policy != "latest" && sinks.sql.policy != "block" ) {
+        throw "Error: bad policy tag at sinks in mbpro file.( " + filename + " )";
+    }
+
+    if( sinks.sql.queueSize < 16 ) {
+        throw "Error: bad queueSize tag at sinks in mbpro file.( " + filename + " )";
+    }
+
+    // read MBPro_Log (optional)
+    log.file = "/opt/modbusengine/log/modbusengine.log";
+    log.level = "info";
+    log.maxSize = 10485760;
+    log.files = 5;
+
+    rapidxml::xml_node<>* _log = _root->first_node( "log" );
+    if( _log != NULL ) {
+        for( rapidxml::xml_node<>* n = _log->first_node();
+             n; n = n->next_sibling() ) {
+            if( is( n, "file" ) ) {
+                log.file.assign( n->value(), n->value_size() );
+            } else if( is( n, "level" ) ) {
+                log.level.assign( n->value(), n->value_size() );
+            } else if( is( n, "maxSize" ) ) {
+                to_number( n, log.maxSize );
+            } else if( is( n, "files" ) ) {
+                to_number( n, log.files );
+            }
+        }
+    }
+
+    if( log.file.empty() ) {
+        throw "Error: bad file tag at log in mbpro file.( " + filename + " )";
+    }
+
+    if( Logger::toLevel( log.level ) < 0 ) {
+        throw "Error: bad level tag at log in mbpro file.( " + filename + " )";
+    }
+
+    if( log.maxSize < 0 || log.files < 0 ) {
+        throw "Error: bad maxSize or files tag at log in mbpro file.( " + filename + " )";
+    }
+
+    // read MBPro_Simulator (optional, used by the tcp simulator and the benchmark)
+    simulator.latency = 0;
+    simulator.jitter = 0;
+    simulator.exceptionRate = 0;
+    simulator.dropRate = 0;
+    simulator.dynamic = false;
+
+    rapidxml::xml_node<>* _simulator = _root->first_node( "simulator" );
+    if( _simulator != NULL ) {
+        for( rapidxml::xml_node<>* n = _simulator->first_node();
+             n; n = n->next_sibling() ) {
+            if( is( n, "latency" ) ) {
+                to_number( n, simulator.latency );
+            } else if( is( n, "jitter" ) ) {
+                to_number( n, simulator.jitter );
+            } else if( is( n, "exceptionRate" ) ) {
+                to_number( n, simulator.exceptionRate );
+            } else if( is( n, "dropRate" ) ) {
+                to_number( n, simulator.dropRate );
+            } else if( is( n, "dynamic" ) ) {
+                to_number( n, simulator.dynamic );
+            }
+        }
+    }
+
+    if( simulator.latency < 0 || simulator.jitter < 0 ) {
+        throw "Error: bad latency or jitter tag at simulator in mbpro file.( " + filename + " )";
+    }
+
+    if( simulator.exceptionRate < 0 || simulator.dropRate < 0 ||
+        simulator.exceptionRate + simulator.dropRate > 1000 ) {
+        throw "Error: bad exceptionRate or dropRate tag at simulator in mbpro file.( " + filename + " )";
+    }
 }
 
 }
@@ -10,21 +10,40 @@ class MBPro_Driver_Block
 {
 public:
     std::string blockId;
+    std::string area;
     int offset;
     int count;
     int cycleTime;
     int retries;
+    int errorSleep;
+    std::string priority;
+    bool onDemand;
 };
 
 class MBPro_Driver_Device
 {
 public:
     std::string deviceId;
+    std::string transport;
     std::string ip;
     int port;
+    std::string serialPort;
+    int baudRate;
+    std::string parity;
+    int dataBits;
+    int stopBits;
     int slaveId;
     int responseTimeout;
     int connectionTimeout;
+    int maxPipeline;
+    int reconnectMin;
+    int reconnectMax;
+    bool tcpNoDelay;
+    bool tcpKeepAlive;
+    int keepAliveIdle;
+    int keepAliveInterval;
+    int keepAliveCount;
+    int tcpUserTimeout;
     std::vector<MBPro_Driver_Block> blocks;
 };
 
@@ -48,6 +67,7 @@ public:
     std::string add;
     int divider;
     bool wordSwap;
+    int rate;
 };
 
 class MBPro_Taglist
@@ -73,6 +93,65 @@ public:
     std::string name;
 };
 
+class MBPro_Metrics
+{
+public:
+    std::string address;
+    int port;
+};
+
+class MBPro_Trace
+{
+public:
+    int enabled;
+    int events;
+};
+
+class MBPro_State
+{
+public:
+    std::string file;
+    int period;
+};
+
+class MBPro_Monitor
+{
+public:
+    int statsPeriod;
+};
+
+class MBPro_Sink
+{
+public:
+    std::string policy;
+    int queueSize;
+};
+
+class MBPro_Sinks
+{
+public:
+    MBPro_Sink sql;
+};
+
+class MBPro_Log
+{
+public:
+    std::string file;
+    std::string level;
+    long long maxSize;
+    int files;
+};
+
+class MBPro_Simulator
+{
+public:
+    int latency;
+    int jitter;
+    int exceptionRate;
+    int dropRate;
+    bool dynamic;
+};
+
 class MBPro
 {
 
@@ -81,11 +160,41 @@ public:
     MBPro_DB db;
     MBPro_Driver driver;
     MBPro_Taglist taglist;
+    MBPro_Metrics metrics;
+    MBPro_Trace trace;
+    MBPro_Log log;
+    MBPro_State state;
+    MBPro_Monitor monitor;
+    MBPro_Sinks sinks;
+    MBPro_Simulator simulator;
     std::string filename;
 
+private:
+    /// read and write the compiled "<filename>.cache"
+    bool useCache;
+
+    /**
+     * @brief parse_xml
+     * @param content -> the zero terminated file, parsed in place
+     *
+     * This function throws std::string exception.
+     */
+    void parse_xml( char* content ) throw ( std::string );
+
 public:
-    MBPro( std::string filename );
-    void readMBPro() throw ( std::string );
+    MBPro( std::string filename, bool useCache = true );
+
+    /**
+     * @brief readMBPro
+     *
+     * Loads the compiled cache when it belongs to the current xml,
+     * otherwise parses the xml and writes the cache.
+     *
+     * @return false when the cache cannot be written ( the caller reports it )
+     *
+     * This function throws std::string exception.
+     */
+    bool readMBPro() throw ( std::string );
 
 };
 
@@ -0,0 +1,460 @@
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "mbprocache.h"
+
+namespace ModbusEngine {
+
+const uint32_t MBProCache::VERSION;
+
+/// the fixed part of the file
+struct MBProCacheHeader
+{
+    char magic[ 4 ];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint32_t reserved;
+    uint64_t xmlHash;
+    uint64_t payloadSize;
+    uint64_t payloadHash;
+};
+
+static const char CACHE_MAGIC[ 4 ] = { 'M', 'B', 'P', 'C' };
+static const uint32_t CACHE_BYTE_ORDER = 0x01020304;
+
+/**
+ ############################################################################
+ # Payload writer
+ ############################################################################
+*/
+
+class CacheWriter
+{
+
+public:
+    std::string data;
+
+    void putInt( int32_t value )
+    {
+        this->data.append( (const char*)&value, sizeof( value ) );
+    }
+
+    void putLong( int64_t value )
+    {
+        this->data.append( (const char*)&value, sizeof( value ) );
+    }
+
+    void putString( const std::string& value )
+    {
+        this->putInt( (int32_t)value.size() );
+        this->data.append( value );
+    }
+
+};
+
+/**
+ ############################################################################
+ # Payload reader, an overrun makes it invalid
+ ############################################################################
+*/
+
+class CacheReader
+{
+
+private:
+    const char* pos;
+    const char* end;
+
+public:
+    bool ok;
+
+    CacheReader( const char* data, size_t size )
+    {
+        this->pos = data;
+        this->end = data + size;
+        this->ok = true;
+    }
+
+    int32_t getInt()
+    {
+        int32_t _value = 0;
+        if( this->end - this->pos < (long)sizeof( _value ) )
+        {
+            this->ok = false;
+            return 0;
+        }
+        memcpy( &_value, this->pos, sizeof( _value ) );
+        this->pos += sizeof( _value );
+        return _value;
+    }
+
+    int64_t getLong()
+    {
+        int64_t _value = 0;
+        if( this->end - this->pos < (long)sizeof( _value ) )
+        {
+            this->ok = false;
+            return 0;
+        }
+        memcpy( &_value, this->pos, sizeof( _value ) );
+        this->pos += sizeof( _value );
+        return _value;
+    }
+
+    void getString( std::string& value )
+    {
+        int32_t _size = this->getInt();
+        if( _size < 0 || this->end - this->pos < _size )
+        {
+            this->ok = false;
+            return;
+        }
+        value.assign( this->pos, _size );
+        this->pos += _size;
+    }
+
+    /// a sane element count, it is checked against the remaining bytes
+    int getCount( int minSize )
+    {
+        int32_t _count = this->getInt();
+        if( _count < 0 || (long)_count * minSize > this->end - this->pos )
+        {
+            this->ok = false;
+            return 0;
+        }
+        return _count;
+    }
+
+    bool atEnd()
+    {
+        return this->ok && this->pos == this->end;
+    }
+
+};
+
+uint64_t MBProCache::hash( const char* data, size_t size )
+{
+    uint64_t _hash = 14695981039346656037ULL;
+    size_t i = 0;
+
+    /// 8 bytes per step, the xml of a big project is megabytes
+    for( ; i + 8 <= size; i += 8 )
+    {
+        uint64_t _word;
+        memcpy( &_word, data + i, sizeof( _word ) );
+        _hash ^= _word;
+        _hash *= 1099511628211ULL;
+        _hash ^= _hash >> 29;
+    }
+
+    for( ; i < size; i++ )
+    {
+        _hash ^= (unsigned char)data[ i ];
+        _hash *= 1099511628211ULL;
+    }
+
+    return _hash;
+}
+
+std::string MBProCache::cacheUrl( const std::string& mbproUrl )
+{
+    return mbproUrl + ".cache";
+}
+
+bool MBProCache::save( const std::string& url, uint64_t xmlHash, const MBPro& mbpro )
+{
+    CacheWriter _w;
+
+    _w.putString( mbpro.project.name );
+
+    _w.putString( mbpro.db.dbType );
+    _w.putString( mbpro.db.dbUrl );
+    _w.putString( mbpro.db.dbPort );
+    _w.putString( mbpro.db.dbName );
+    _w.putString( mbpro.db.dbUser );
+    _w.putString( mbpro.db.dbPass );
+
+    _w.putInt( (int32_t)mbpro.driver.devices.size() );
+    for( size_t i = 0; i < mbpro.driver.devices.size(); i++ )
+    {
+        const MBPro_Driver_Device& _d = mbpro.driver.devices[ i ];
+
+        _w.putString( _d.deviceId );
+        _w.putString( _d.transport );
+        _w.putString( _d.ip );
+        _w.putInt( _d.port );
+        _w.putString( _d.serialPort );
+        _w.putInt( _d.baudRate );
+        _w.putString( _d.parity );
+        _w.putInt( _d.dataBits );
+        _w.putInt( _d.stopBits );
+        _w.putInt( _d.slaveId );
+        _w.putInt( _d.responseTimeout );
+        _w.putInt( _d.connectionTimeout );
+        _w.putInt( _d.maxPipeline );
+        _w.putInt( _d.reconnectMin );
+        _w.putInt( _d.reconnectMax );
+        _w.putInt( _d.tcpNoDelay );
+        _w.putInt( _d.tcpKeepAlive );
+        _w.putInt( _d.keepAliveIdle );
+        _w.putInt( _d.keepAliveInterval );
+        _w.putInt( _d.keepAliveCount );
+        _w.putInt( _d.tcpUserTimeout );
+
+        _w.putInt( (int32_t)_d.blocks.size() );
+        for( size_t j = 0; j < _d.blocks.size(); j++ )
+        {
+            const MBPro_Driver_Block& _b = _d.blocks[ j ];
+
+            _w.putString( _b.blockId );
+            _w.putString( _b.area );
+            _w.putInt( _b.offset );
+            _w.putInt( _b.count );
+            _w.putInt( _b.cycleTime );
+            _w.putInt( _b.retries );
+            _w.putInt( _b.errorSleep );
+            _w.putString( _b.priority );
+            _w.putInt( _b.onDemand );
+        }
+    }
+
+    _w.putInt( (int32_t)mbpro.taglist.tags.size() );
+    for( size_t i = 0; i < mbpro.taglist.tags.size(); i++ )
+    {
+        const MBPro_Tag& _t = mbpro.taglist.tags[ i ];
+
+        _w.putInt( _t.id );
+        _w.putString( _t.name );
+        _w.putString( _t.deviceId );
+        _w.putString( _t.blockId );
+        _w.putInt( _t.address );
+        _w.putInt( _t.subAddress );
+        _w.putString( _t.type );
+        _w.putString( _t.multiple );
+        _w.putString( _t.add );
+        _w.putInt( _t.divider );
+        _w.putInt( _t.wordSwap );
+        _w.putInt( _t.rate );
+    }
+
+    _w.putString( mbpro.metrics.address );
+    _w.putInt( mbpro.metrics.port );
+
+    _w.putInt( mbpro.trace.enabled );
+    _w.putInt( mbpro.trace.events );
+
+    _w.putString( mbpro.log.file );
+    _w.putString( mbpro.log.level );
+    _w.putLong( mbpro.log.maxSize );
+    _w.putInt( mbpro.log.files );
+
+    _w.putString( mbpro.state.file );
+    _w.putInt( mbpro.state.period );
+
+    _w.putInt( mbpro.monitor.statsPeriod );
+
+    _w.putString( mbpro.sinks.sql.policy );
+    _w.putInt( mbpro.sinks.sql.queueSize );
+
+    _w.putInt( mbpro.simulator.latency );
+    _w.putInt( mbpro.simulator.jitter );
+    _w.putInt( mbpro.simulator.exceptionRate );
+    _w.putInt( mbpro.simulator.dropRate );
+    _w.putInt( mbpro.simulator.dynamic );
+
+    MBProCacheHeader _header;
+    memset( &_header, 0, sizeof( _header ) );
+    memcpy( _header.magic, CACHE_MAGIC, sizeof( CACHE_MAGIC ) );
+    _header.version = VERSION;
+    _header.byteOrder = CACHE_BYTE_ORDER;
+    _header.xmlHash = xmlHash;
+    _header.payloadSize = _w.data.size();
+    _header.payloadHash = hash( _w.data.data(), _w.data.size() );
+
+    /// a reader never sees a half written file
+    std::string _tmp = url + ".tmp";
+    FILE* _f = fopen( _tmp.c_str(), "wb" );
+
+    if( _f == NULL ) return false;
+
+    bool _ok = fwrite( &_header, sizeof( _header ), 1, _f ) == 1 &&
+               fwrite( _w.data.data(), 1, _w.data.size(), _f ) == _w.data.size();
+    _ok = ( fclose( _f ) == 0 ) && _ok;
+
+    if( !_ok || rename( _tmp.c_str(), url.c_str() ) != 0 )
+    {
+        unlink( _tmp.c_str() );
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * @brief read_payload
+ * @param r     -> the reader of the payload
+ * @param mbpro -> the filled project
+ */
+static void read_payload( CacheReader& r, MBPro* mbpro )
+{
+    r.getString( mbpro->project.name );
+
+    r.getString( mbpro->db.dbType );
+    r.getString( mbpro->db.dbUrl );
+    r.getString( mbpro->db.dbPort );
+    r.getString( mbpro->db.dbName );
+    r.getString( mbpro->db.dbUser );
+    r.getString( mbpro->db.dbPass );
+
+    int _devices = r.getCount( 4 );
+    mbpro->driver.devices.resize( _devices );
+    for( int i = 0; i < _devices && r.ok; i++ )
+    {
+        MBPro_Driver_Device& _d = mbpro->driver.devices[ i ];
+
+        r.getString( _d.deviceId );
+        r.getString( _d.transport );
+        r.getString( _d.ip );
+        _d.port = r.getInt();
+        r.getString( _d.serialPort );
+        _d.baudRate = r.getInt();
+        r.getString( _d.parity );
+        _d.dataBits = r.getInt();
+        _d.stopBits = r.getInt();
+        _d.slaveId = r.getInt();
+        _d.responseTimeout = r.getInt();
+        _d.connectionTimeout = r.getInt();
+        _d.maxPipeline = r.getInt();
+        _d.reconnectMin = r.getInt();
+        _d.reconnectMax = r.getInt();
+        _d.tcpNoDelay = r.getInt() != 0;
+        _d.tcpKeepAlive = r.getInt() != 0;
+        _d.keepAliveIdle = r.getInt();
+        _d.keepAliveInterval = r.getInt();
+        _d.keepAliveCount = r.getInt();
+        _d.tcpUserTimeout = r.getInt();
+
+        int _blocks = r.getCount( 4 );
+        _d.blocks.resize( _blocks );
+        for( int j = 0; j < _blocks && r.ok; j++ )
+        {
+            MBPro_Driver_Block& _b = _d.blocks[ j ];
+
+            r.getString( _b.blockId );
+            r.getString( _b.area );
+            _b.offset = r.getInt();
+            _b.count = r.getInt();
+            _b.cycleTime = r.getInt();
+            _b.retries = r.getInt();
+            _b.errorSleep = r.getInt();
+            r.getString( _b.priority );
+            _b.onDemand = r.getInt() != 0;
+        }
+    }
+
+    int _tags = r.getCount( 4 );
+    mbpro->taglist.tags.resize( _tags );
+    for( int i = 0; i < _tags && r.ok; i++ )
+    {
+        MBPro_Tag& _t = mbpro->taglist.tags[ i ];
+
+        _t.id = r.getInt();
+        r.getString( _t.name );
+        r.getString( _t.deviceId );
+        r.getString( _t.blockId );
+        _t.address = r.getInt();
+        _t.subAddress = r.getInt();
+        r.getString( _t.type );
+        r.getString( _t.multiple );
+        r.getString( _t.add );
+        _t.divider = r.getInt();
+        _t.wordSwap = r.getInt() != 0;
+        _t.rate = r.getInt();
+    }
+
+    r.getString( mbpro->metrics.address );
+    mbpro->metrics.port = r.getInt();
+
+    mbpro->trace.enabled = r.getInt();
+    mbpro->trace.events = r.getInt();
+
+    r.getString( mbpro->log.file );
+    r.getString( mbpro->log.level );
+    mbpro->log.maxSize = r.getLong();
+    mbpro->log.files = r.getInt();
+
+    r.getString( mbpro->state.file );
+    mbpro->state.period = r.getInt();
+
+    mbpro->monitor.statsPeriod = r.getInt();
+
+    r.getString( mbpro->sinks.sql.policy );
+    mbpro->sinks.sql.queueSize = r.getInt();
+
+    mbpro->simulator.latency = r.getInt();
+    mbpro->simulator.jitter = r.getInt();
+    mbpro->simulator.exceptionRate = r.getInt();
+    mbpro->simulator.dropRate = r.getInt();
+    mbpro->simulator.dynamic = r.getInt() != 0;
+}
+
+bool MBProCache::load( const std::string& url, uint64_t xmlHash, MBPro* mbpro )
+{
+    int _fd = open( url.c_str(), O_RDONLY );
+
+    if( _fd < 0 ) return false;
+
+    struct stat _st;
+    if( fstat( _fd, &_st ) != 0 || _st.st_size < (off_t)sizeof( MBProCacheHeader ) )
+    {
+        close( _fd );
+        return false;
+    }
+
+    size_t _size = _st.st_size;
+    void* _map = mmap( NULL, _size, PROT_READ, MAP_PRIVATE, _fd, 0 );
+    close( _fd );
+
+    if( _map == MAP_FAILED ) return false;
+
+    const char* _data = (const char*)_map;
+    MBProCacheHeader _header;
+    memcpy( &_header, _data, sizeof( _header ) );
+
+    bool _ok = memcmp( _header.magic, CACHE_MAGIC, sizeof( CACHE_MAGIC ) ) == 0 &&
+               _header.version == VERSION &&
+               _header.byteOrder == CACHE_BYTE_ORDER &&
+               _header.xmlHash == xmlHash &&
+               _header.payloadSize == _size - sizeof( _header );
+
+    const char* _payload = _data + sizeof( _header );
+
+    if( _ok )
+    {
+        _ok = hash( _payload, _header.payloadSize ) == _header.payloadHash;
+    }
+
+    if( _ok )
+    {
+        CacheReader _r( _payload, _header.payloadSize );
+        read_payload( _r, mbpro );
+        _ok = _r.atEnd();
+    }
+
+    munmap( _map, _size );
+
+    if( !_ok )
+    {
+        /// the xml parser starts from empty lists
+        mbpro->driver.devices.clear();
+        mbpro->taglist.tags.clear();
+    }
+
+    return _ok;
+}
+
+}
@@ -0,0 +1,76 @@
+#ifndef MBPROCACHE_H
+#define MBPROCACHE_H
+
+#include <stdint.h>
+#include <string>
+
+#include "mbpro.h"
+
+namespace ModbusEngine {
+
+/**
+ * @brief The MBProCache class
+ *
+ * Compiled binary form of a parsed mbpro file, written next to the xml
+ * ( "<mbpro file>.cache" ) and reused while the hash of the xml is
+ * unchanged. The cache holds only validated projects, the checks of the
+ * xml parser are not repeated.
+ *
+ * Layout ( host byte order ):
+ *
+ * header:  magic "MBPC", version, byte order mark, reserved,
+ *          xml hash, payload size, payload hash ( 64 bit FNV-1a
+ *          over 8 byte words )
+ * payload: the MBPro sections in declaration order, the integers
+ *          as 32/64 bit words, the strings as length + bytes
+ *
+ * The file is memory mapped at load. A bad magic, version, byte order,
+ * size or hash is a miss, the xml is parsed and the cache is rewritten.
+ * It is a library class.
+ */
+class MBProCache
+{
+
+private:
+    /// bump it when an MBPro class changes
+    static const uint32_t VERSION = 5;
+
+public:
+    /**
+     * @brief hash
+     * @param data -> the bytes
+     * @param size -> number of the bytes
+     * @return 64 bit FNV-1a hash of the bytes, taken by 8 byte words
+     */
+    static uint64_t hash( const char* data, size_t size );
+
+    /**
+     * @brief cacheUrl
+     * @param mbproUrl -> the url of the xml
+     * @return the url of the cache file
+     */
+    static std::string cacheUrl( const std::string& mbproUrl );
+
+    /**
+     * @brief load
+     * @param url       -> the cache file
+     * @param xmlHash   -> the hash of the current xml
+     * @param mbpro     -> filled on hit
+     * @return the cache is valid and it is loaded
+     */
+    static bool load( const std::string& url, uint64_t xmlHash, MBPro* mbpro );
+
+    /**
+     * @brief save
+     * @param url       -> the cache file
+     * @param xmlHash   -> the hash of the parsed xml
+     * @param mbpro     -> the parsed project
+     * @return the cache is written ( through a temp file and rename )
+     */
+    static bool save( const std::string& url, uint64_t xmlHash, const MBPro& mbpro );
+
+};
+
+}
+
+#endif // MBPROCACHE_H
@@ -0,0 +1,129 @@
+#include "circuitbreaker.h"
+
+namespace ModbusEngine
+{
+
+CircuitBreaker::CircuitBreaker( int minDelay, int maxDelay ) : random( std::random_device()() )
+{
+    this->minDelay = ( minDelay < 1 ) ? 1 : minDelay;
+    this->maxDelay = ( maxDelay < this->minDelay ) ? this->minDelay : maxDelay;
+    this->state = STATE_CLOSED;
+    this->failures = 0;
+    this->delay = this->minDelay;
+    this->retryTime = std::chrono::steady_clock::now();
+    this->connectFailures = 0;
+    this->connects = 0;
+    this->lastConnectTime = 0;
+    this->connectTime = 0;
+    this->connectedSince = 0;
+}
+
+bool CircuitBreaker::allowConnect()
+{
+    std::lock_guard<std::mutex> _lock( this->breakerMutex );
+
+    if( this->state == STATE_CLOSED )
+    {
+        return true;
+    }
+
+    if( this->state == STATE_OPEN && std::chrono::steady_clock::now() >= this->retryTime )
+    {
+        this->state = STATE_HALF_OPEN;
+        return true;
+    }
+
+    /// open, or the probe is running
+    return false;
+}
+
+void CircuitBreaker::reportSuccess( long long duration )
+{
+    std::lock_guard<std::mutex> _lock( this->breakerMutex );
+
+    this->connects.fetch_add( 1, std::memory_order_relaxed );
+    this->lastConnectTime.store( duration, std::memory_order_relaxed );
+    this->connectTime.fetch_add( duration, std::memory_order_relaxed );
+    this->connectedSince.store( std::chrono::duration_cast<std::chrono::microseconds>(
+                                    std::chrono::steady_clock::now().time_since_epoch() ).count(),
+                                std::memory_order_relaxed );
+
+    this->state = STATE_CLOSED;
+    this->failures = 0;
+    this->delay = this->minDelay;
+}
+
+void CircuitBreaker::reportFailure( long long duration )
+{
+    std::lock_guard<std::mutex> _lock( this->breakerMutex );
+
+    this->connectFailures.fetch_add( 1, std::memory_order_relaxed );
+    this->lastConnectTime.store( duration, std::memory_order_relaxed );
+    this->connectTime.fetch_add( duration, std::memory_order_relaxed );
+
+    if( this->failures > 0 )
+    {
+        this->delay = ( this->delay > this->maxDelay / 2 ) ? this->maxDelay : this->delay * 2;
+    }
+    this->failures++;
+
+    /// equal jitter: the half of the delay is random
+    std::uniform_int_distribution<int> _jitter( 0, this->delay / 2 );
+    int _wait = this->delay - this->delay / 2 + _jitter( this->random );
+
+    this->retryTime = std::chrono::steady_clock::now() + std::chrono::milliseconds( _wait );
+    this->state = STATE_OPEN;
+}
+
+int CircuitBreaker::readState()
+{
+    return this->state;
+}
+
+std::chrono::steady_clock::time_point CircuitBreaker::readRetryTime()
+{
+    std::lock_guard<std::mutex> _lock( this->breakerMutex );
+    return this->retryTime;
+}
+
+unsigned long long CircuitBreaker::readConnectFailures()
+{
+    return this->connectFailures.load( std::memory_order_relaxed );
+}
+
+unsigned long long CircuitBreaker::readConnects()
+{
+    return this->connects.load( std::memory_order_relaxed );
+}
+
+long long CircuitBreaker::readLastConnectTime()
+{
+    return this->lastConnectTime.load( std::memory_order_relaxed );
+}
+
+long long CircuitBreaker::readConnectTime()
+{
+    return this->connectTime.load( std::memory_order_relaxed );
+}
+
+std::chrono::steady_clock::time_point CircuitBreaker::readConnectedSince()
+{
+    return std::chrono::steady_clock::time_point(
+                std::chrono::microseconds( this->connectedSince.load( std::memory_order_relaxed ) ) );
+}
+
+std::string CircuitBreaker::toString( int state )
+{
+    if( state == STATE_OPEN )
+    {
+        return std::string( "open" );
+    }
+    else if( state == STATE_HALF_OPEN )
+    {
+        return std::string( "half_open" );
+    }
+
+    return std::string( "closed" );
+}
+
+} // namespace ModbusEngine
@@ -0,0 +1,151 @@
+#ifndef CIRCUITBREAKER_H
+#define CIRCUITBREAKER_H
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <random>
+#include <string>
+
+namespace ModbusEngine
+{
+
+/**
+ * @brief The CircuitBreaker class
+ *
+ * Guards the connecting of a device.
+ *
+ * States:
+ *   - closed    -> the device is reachable, connecting is allowed
+ *   - open      -> connecting failed, nobody connects until the retry time
+ *   - half_open -> the retry time is over, exactly one caller (the probe)
+ *                  may connect, the others fail fast
+ *
+ * The retry delay doubles after every failed probe from minDelay up
+ * to maxDelay, with random jitter ( the half of the delay is random ),
+ * so the dead devices are not polled at the same time.
+ */
+
+class CircuitBreaker
+{
+
+public:
+    /// circuit states
+    static const int STATE_CLOSED = 0;
+    static const int STATE_OPEN = 1;
+    static const int STATE_HALF_OPEN = 2;
+
+private:
+    /// delay limits in millisecs
+    int minDelay;
+    int maxDelay;
+
+    /// the state and the consecutive failures
+    std::atomic<int> state;
+    int failures;
+    /// the current delay (without jitter) and the end of the open state
+    int delay;
+    std::chrono::steady_clock::time_point retryTime;
+
+    /// all failed and successful connects
+    std::atomic<unsigned long long> connectFailures;
+    std::atomic<unsigned long long> connects;
+    /// duration of the last connect and of all connects in microsecs
+    std::atomic<long long> lastConnectTime;
+    std::atomic<long long> connectTime;
+    /// the time of the last successful connect ( steady clock microsecs )
+    std::atomic<long long> connectedSince;
+
+    /// jitter source
+    std::mt19937 random;
+
+    /// required mutex for multi threading support
+    std::mutex breakerMutex;
+
+public:
+    /**
+     * @brief CircuitBreaker
+     * @param minDelay -> first retry delay in millisecs
+     * @param maxDelay -> max retry delay in millisecs
+     */
+    CircuitBreaker( int minDelay, int maxDelay );
+
+    /**
+     * @brief allowConnect
+     * @return the caller may connect
+     *
+     * In open state it turns into half_open after the retry time,
+     * and the caller becomes the probe.
+     */
+    bool allowConnect();
+
+    /**
+     * @brief reportSuccess
+     * @param duration -> duration of the connect in microsecs
+     *
+     * Connecting succeeded, closes the circuit.
+     */
+    void reportSuccess( long long duration );
+
+    /**
+     * @brief reportFailure
+     * @param duration -> duration of the connect in microsecs
+     *
+     * Connecting failed, opens the circuit with the next delay.
+     */
+    void reportFailure( long long duration );
+
+    /**
+     * @brief readState
+     * @return the circuit state
+     */
+    int readState();
+
+    /**
+     * @brief readRetryTime
+     * @return the end of the open state
+     */
+    std::chrono::steady_clock::time_point readRetryTime();
+
+    /**
+     * @brief readConnectFailures
+     * @return number of all failed connects
+     */
+    unsigned long long readConnectFailures();
+
+    /**
+     * @brief readConnects
+     * @return number of all successful connects
+     */
+    unsigned long long readConnects();
+
+    /**
+     * @brief readLastConnectTime
+     * @return duration of the last connect in microsecs
+     */
+    long long readLastConnectTime();
+
+    /**
+     * @brief readConnectTime
+     * @return duration of all connects ( failed ones too ) in microsecs
+     */
+    long long readConnectTime();
+
+    /**
+     * @brief readConnectedSince
+     * @return the time of the last successful connect
+     */
+    std::chrono::steady_clock::time_point readConnectedSince();
+
+    /**
+     * @brief toString
+     * @param state -> circuit state
+     * @return the name of the state
+     */
+    static std::string toString( int state );
+
+};
+
+} // namespace ModbusEngine
+
+#endif // CIRCUITBREAKER_H
@@ -1,219 +1,680 @@
 #include "modbusblock.h"
+#include "../Core/logger.h"
+#include "../Core/trace.h"
 
+#include <algorithm>
 #include <iostream>
+#include <sstream>
 
 namespace ModbusEngine {
 
+const int ModbusBlock::LOG_INTERVAL;
+
 ModbusBlock::ModbusBlock( std::string id,
-                          MBTCPMasterConnection* conn,
-                          std::mutex* connMutex,
+                          int area,
+                          MBMasterConnection* conn,
+                          RequestArbiter* arbiter,
+                          CircuitBreaker* breaker,
+                          Histogram* writeLatency,
                           int offset,
                           int count,
                           int cycleTime,
                           int retries,
-                          int errorSleep )
+                          int errorSleep,
+                          int priority,
+                          bool onDemand ) : writeQueue( WRITE_QUEUE_SIZE )
 {
     this->id = id;
+    this->area = area;
     this->conn = conn;
-    this->connMutex = connMutex;
+    this->arbiter = arbiter;
+    this->breaker = breaker;
+    this->writeLatency = writeLatency;
     this->offset = offset;
     this->count = count;
     this->cycleTime = cycleTime;
     this->retries = retries;
     this->errorSleep = errorSleep;
+    this->priority = priority;
+    this->onDemand = onDemand;
+    this->demandUntil = 0;
+    this->demandFlag = false;
+    this->replanned = false;
     this->master = false;
     this->writeFlag = false;
+    this->stopFlag = false;
+    this->stopped = false;
     this->writeReq = false;
-    this->error = "error_init";
-
-    for( int i = 0; i < count; i++ )
+    this->stale = false;
+    this->timeouts = 0;
+    this->name = id;
+    this->events = NULL;
+    this->deviceSymbol = SymbolTable::NONE;
+    this->blockSymbol = SymbolTable::NONE;
+    this->loggedError = MBError::ERROR_INIT;
+    this->loggedTime = std::chrono::steady_clock::now();
+    this->setError( MBError::ERROR_INIT );
+    this->repeats = 0;
+
+    /// the bit areas are packed
+    this->size = this->isBitArea() ? ( count + 15 ) / 16 : count;
+
+    for( int i = 0; i < this->size; i++ )
     {
         this->readList.push_back( 0 );
+        this->writeMask.push_back( 0 );
+        this->writeValue.push_back( 0 );
     }
+
+    /// a part of the block is never longer than the block
+    this->readBuffer.resize( this->size );
+
+    /// the whole block in every cycletime until setPlan()
+    PollRequest _r;
+    _r.offset = 0;
+    _r.count = count;
+    _r.period = cycleTime;
+    this->plan.push_back( _r );
+    this->planReads.push_back( std::chrono::steady_clock::time_point() );
 }
 
-bool ModbusBlock::read()
+bool ModbusBlock::reconnect()
 {
-    /// Connecting...
-    if( !this->conn->isConnected() )
+    if( this->conn->isConnected() )
     {
-        if( !this->master )
-        {
-            this->error = "host_not_reachable";
-            return false;
-        }
+        return true;
+    }
 
-        try
+    if( !this->master )
+    {
+        if( this->breaker->readState() == CircuitBreaker::STATE_CLOSED )
         {
-            this->blockMutex.unlock();
-            this->conn->connect();
-            this->blockMutex.lock();
-            this->master = false;
+            this->setError( MBError::HOST_NOT_REACHABLE );
         }
-        catch( std::string ex )
+        else
         {
-            this->blockMutex.lock();
-            this->error = ex;
-            return false;
+            this->setError( MBError::CIRCUIT_OPEN );
         }
+        return false;
     }
 
-    /// Reading...
-    try
+    if( !this->breaker->allowConnect() )
     {
-        this->readList = this->conn->readHoldingRegisters( this->offset, this->count );
-        this->error = "no_error";
+        this->setError( MBError::CIRCUIT_OPEN );
+        return false;
     }
-    catch ( std::string ex )
-    {
-        this->error = ex;
-        if( this->error == "server_fail" ||
-            this->error == "gateway_path_exception" ||
-            this->error == "gateway_respond_exception" ||
-            this->error == "undefined_exception" )
-        {
-            this->conn->disconnect();
-            this->master = true;
-        }
 
+    std::chrono::steady_clock::time_point _start = std::chrono::steady_clock::now();
+
+    this->blockMutex.unlock();
+    MBError::Code _error = this->conn->connect();
+    this->blockMutex.lock();
+
+    long long _duration = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - _start ).count();
+
+    if( _error != MBError::NO_ERROR )
+    {
+        this->breaker->reportFailure( _duration );
+        this->publish_status( StatusEvent::TYPE_DEVICE );
+        this->setError( _error );
         return false;
     }
 
+    this->master = false;
+    this->breaker->reportSuccess( _duration );
+    this->publish_status( StatusEvent::TYPE_DEVICE );
+
     return true;
 }
 
-bool ModbusBlock::write()
+bool ModbusBlock::read( const PollRequest& request )
 {
     /// Connecting...
-    if( !this->conn->isConnected() )
+    if( !this->reconnect() )
+    {
+        return false;
+    }
+
+    /// Reading... the whole block in place, a part of it through the buffer
+    MBError::Code _error;
+    std::chrono::steady_clock::time_point _start = std::chrono::steady_clock::now();
+    bool _whole = ( request.offset == 0 && request.count == this->count );
+    std::vector<uint16>& _values = _whole ? this->readList : this->readBuffer;
+
+    if( this->area == AREA_COIL )
+    {
+        _error = this->conn->readCoils( this->offset + request.offset, request.count, _values );
+    }
+    else if( this->area == AREA_DISCRETE_INPUT )
+    {
+        _error = this->conn->readDiscreteInputs( this->offset + request.offset, request.count, _values );
+    }
+    else if( this->area == AREA_INPUT_REGISTER )
+    {
+        _error = this->conn->readInputRegisters( this->offset + request.offset, request.count, _values );
+    }
+    else
+    {
+        _error = this->conn->readHoldingRegisters( this->offset + request.offset, request.count, _values );
+    }
+
+    this->setError( _error );
+
+    if( _error != MBError::NO_ERROR )
     {
-        if( !this->master )
+        this->recover( _error );
+        return false;
+    }
+
+    this->timeouts = 0;
+
+    /// the bit requests start at a packed word ( PollPlanner )
+    if( !_whole )
+    {
+        int _first = this->isBitArea() ? request.offset / 16 : request.offset;
+        int _n = this->isBitArea() ? ( request.count + 15 ) / 16 : request.count;
+        std::copy( _values.begin(), _values.begin() + _n, this->readList.begin() + _first );
+    }
+
+    /// request: FC, offset, count; response: FC, byte count, data
+    this->record_request( _start, 5 + 2 + ( this->isBitArea() ? ( request.count + 7 ) / 8 : request.count * 2 ) );
+
+    return true;
+}
+
+bool ModbusBlock::poll( bool all )
+{
+    for( size_t i = 0; i < this->plan.size(); i++ )
+    {
+        PollRequest _r = this->plan[ i ];
+        std::chrono::steady_clock::time_point _due = this->planReads[ i ] + std::chrono::milliseconds( _r.period );
+        std::chrono::steady_clock::time_point _start = std::chrono::steady_clock::now();
+        bool _cyclic = !all;
+
+        if( !all && ( _r.period <= 0 || _start < _due ) )
         {
-            this->error = "host_not_reachable";
-            return false;
+            continue;
         }
 
-        try
+        /// the achieved cycle of the fastest request
+        if( i == 0 )
         {
-            this->blockMutex.unlock();
-            this->conn->connect();
-            this->blockMutex.lock();
-            this->master = false;
+            if( this->lastPoll != std::chrono::steady_clock::time_point() )
+            {
+                this->achievedCycle.set( std::chrono::duration_cast<std::chrono::microseconds>(
+                                             _start - this->lastPoll ).count() );
+            }
+            this->lastPoll = _start;
         }
-        catch( std::string ex )
+
+        Trace::begin( "arbiter" );
+        this->arbiter->acquire( this->priority,
+                                false,
+                                _cyclic ? _due + std::chrono::milliseconds( _r.period ) : _start );
+        Trace::end( "arbiter" );
+        Trace::begin( "read" );
+        bool _ok = this->read( _r );
+        Trace::end( "read" );
+        this->arbiter->release();
+        this->reads.add();
+        if( !_ok ) this->readErrors.add();
+        this->consecutiveFailures.set( _ok ? 0 : this->consecutiveFailures.read() + 1 );
+
+        std::chrono::steady_clock::time_point _now = std::chrono::steady_clock::now();
+
+        /// the cyclic read must be done within one period after its due time
+        if( _cyclic && _now > _due + std::chrono::milliseconds( _r.period ) )
+        {
+            this->arbiter->reportDeadlineMiss( this->priority );
+            Trace::instant( "deadline_miss" );
+        }
+
+        if( !_ok )
         {
-            this->blockMutex.lock();
-            this->error = ex;
             return false;
         }
+
+        /// setPlan() may replace the plan while the block is connecting
+        if( i < this->planReads.size() )
+        {
+            this->planReads[ i ] = _now;
+        }
     }
 
-    /// Merge & write...
-    try
-    {
-        if( !this->writeReq ) return true;
+    return true;
+}
 
-        this->merge();
-        this->conn->writeMultipleRegisters( this->offset, this->count, this->readList );
-        this->error = "no_error";
-        this->writeList.clear();
-        this->writeReq = false;
-    }
-    catch ( std::string ex )
-    {
-        this->error = ex;
-        if( this->error == "server_fail" ||
-            this->error == "gateway_path_exception" ||
-            this->error == "gateway_respond_exception" ||
-            this->error == "undefined_exception" )
+std::chrono::steady_clock::time_point ModbusBlock::next_poll( int idle )
+{
+    std::chrono::steady_clock::time_point _next = std::chrono::steady_clock::now() + std::chrono::milliseconds( idle );
+
+    for( size_t i = 0; i < this->plan.size(); i++ )
+    {
+        if( this->plan[ i ].period > 0 )
         {
-            this->conn->disconnect();
-            this->master = true;
+            _next = std::min( _next, this->planReads[ i ] + std::chrono::milliseconds( this->plan[ i ].period ) );
         }
+    }
+
+    return _next;
+}
+
+bool ModbusBlock::whole_plan()
+{
+    return this->plan.size() == 1 && this->plan[ 0 ].offset == 0 && this->plan[ 0 ].count == this->count;
+}
+
+bool ModbusBlock::write_runs()
+{
+    return !this->whole_plan() || this->onDemand || this->stale;
+}
+
+bool ModbusBlock::interested()
+{
+    return !this->onDemand ||
+           std::chrono::steady_clock::now().time_since_epoch().count() < this->demandUntil;
+}
+
+bool ModbusBlock::write()
+{
+    /// Connecting...
+    if( !this->reconnect() )
+    {
+        return false;
+    }
+
+    /// Drain, merge & write...
+    this->drain();
+    if( !this->writeReq ) return true;
+
+    MBError::Code _error;
+    int _bytes;
+    std::chrono::steady_clock::time_point _start = std::chrono::steady_clock::now();
+
+    if( this->area == AREA_COIL )
+    {
+        _error = this->write_coils( _bytes );
+    }
+    else if( this->write_runs() )
+    {
+        _error = this->write_registers( _bytes );
+    }
+    else
+    {
+        this->merge();
+        _error = this->conn->writeMultipleRegisters( this->offset, this->count, this->readList );
+        /// request: FC, offset, count, byte count, data; response: FC, offset, count
+        _bytes = 6 + this->count * 2 + 5;
+    }
+
+    this->setError( _error );
 
+    if( _error != MBError::NO_ERROR )
+    {
+        this->recover( _error );
         return false;
     }
 
+    this->timeouts = 0;
+    this->record_request( _start, _bytes );
+
+    /// end-to-end latency of every written item
+    std::chrono::steady_clock::time_point _now = std::chrono::steady_clock::now();
+    for( size_t i = 0; i < this->writeTimes.size(); i++ )
+    {
+        this->writeLatency->record(
+            std::chrono::duration_cast<std::chrono::microseconds>( _now - this->writeTimes[ i ] ).count() );
+    }
+
+    this->discard();
+
     return true;
 }
 
-void ModbusBlock::merge()
+void ModbusBlock::recover( MBError::Code error )
 {
-    for( std::vector<DataItem>::iterator _it = writeList.begin();
-         _it != this->writeList.end(); _it++ )
+    MBError::Recovery _recovery = MBError::recovery( error );
+
+    /// a silent peer behind a healthy looking socket (half-open connection)
+    if( error == MBError::RESPONSE_TIMEOUT && ++this->timeouts >= MAX_TIMEOUTS )
     {
-        DataItem _d = *_it;
+        _recovery = MBError::RECOVERY_RECONNECT;
+    }
 
-        if( _d.type == ITEM_TYPE_BIT )
-        {
-            uint16 _pow2[] = { 1, 2, 4, 8, 16, 32, 64, 128,
-                          256, 512, 1024, 2048, 4096, 8192, 16384, 32768 };
+    if( _recovery == MBError::RECOVERY_RECONNECT )
+    {
+        this->timeouts = 0;
+        this->conn->disconnect();
+        this->master = true;
+        this->publish_status( StatusEvent::TYPE_DEVICE );
+    }
+    else if( _recovery == MBError::RECOVERY_FLUSH )
+    {
+        this->conn->flush();
+    }
+}
 
-            if( _d.value )
+MBError::Code ModbusBlock::write_coils( int& bytes )
+{
+    bytes = 0;
+
+    /// the changed range, or the runs of the changed coils when the coils
+    /// between them are not read ( or stale )
+    bool _runs = this->write_runs();
+    std::vector<std::pair<int,int> > _ranges;
+    int _first = -1;
+    int _last = -1;
+    for( int i = 0; i < this->count; i++ )
+    {
+        if( ( this->writeMask[ i / 16 ] >> ( i % 16 ) ) & 1 )
+        {
+            if( _first != -1 && _runs && i != _last + 1 )
             {
-                uint16 _mask = _pow2[ _d.subAddress ];
-                this->readList[ _d.address ] = this->readList[ _d.address ] | _mask;
+                _ranges.push_back( std::make_pair( _first, _last ) );
+                _first = -1;
             }
-            else
+            if( _first == -1 ) _first = i;
+            _last = i;
+        }
+    }
+
+    if( _first == -1 ) return MBError::NO_ERROR;
+
+    _ranges.push_back( std::make_pair( _first, _last ) );
+
+    this->merge();
+
+    for( size_t k = 0; k < _ranges.size(); k++ )
+    {
+        MBError::Code _error;
+        _first = _ranges[ k ].first;
+        _last = _ranges[ k ].second;
+
+        if( _first == _last )
+        {
+            bool _bit = ( this->readList[ _first / 16 ] >> ( _first % 16 ) ) & 1;
+            /// FC 0x05 echoes the request
+            bytes += 5 + 5;
+            _error = this->conn->writeSingleCoil( this->offset + _first, _bit );
+        }
+        else
+        {
+            /// repack the range from bit 0
+            int _n = _last - _first + 1;
+            std::vector<uint16> _values( ( _n + 15 ) / 16, 0 );
+            for( int i = 0; i < _n; i++ )
             {
-                uint16 _mask = 65535 - _pow2[ _d.subAddress ];
-                readList[ _d.address ] = readList[ _d.address ] & _mask;
+                int _b = _first + i;
+                if( ( this->readList[ _b / 16 ] >> ( _b % 16 ) ) & 1 )
+                {
+                    _values[ i / 16 ] |= (uint16)( 1 << ( i % 16 ) );
+                }
             }
 
+            bytes += 6 + ( _n + 7 ) / 8 + 5;
+            _error = this->conn->writeMultipleCoils( this->offset + _first, _n, _values );
         }
-        else if( _d.type == ITEM_TYPE_BYTE )
+
+        if( _error != MBError::NO_ERROR ) return _error;
+    }
+
+    return MBError::NO_ERROR;
+}
+
+MBError::Code ModbusBlock::write_registers( int& bytes )
+{
+    bytes = 0;
+
+    this->merge();
+
+    int i = 0;
+    while( i < this->count )
+    {
+        if( !this->writeMask[ i ] )
+        {
+            i++;
+            continue;
+        }
+
+        /// a run of the changed registers, MAX_WRITE_REGISTERS at most
+        int _first = i;
+        while( i < this->count && this->writeMask[ i ] && i - _first < MAX_WRITE_REGISTERS )
         {
-            uint8 _lowerByte = (uint8)( this->readList[ _d.address ] & 0xff );
-            uint8 _upperByte = (uint8)( this->readList[ _d.address ] >> 0x08 );
+            i++;
+        }
+
+        std::vector<uint16> _values( this->readList.begin() + _first, this->readList.begin() + i );
+        MBError::Code _error = this->conn->writeMultipleRegisters( this->offset + _first, i - _first, _values );
+
+        if( _error != MBError::NO_ERROR ) return _error;
+
+        /// request: FC, offset, count, byte count, data; response: FC, offset, count
+        bytes += 6 + ( i - _first ) * 2 + 5;
+    }
+
+    return MBError::NO_ERROR;
+}
+
+void ModbusBlock::record_request( std::chrono::steady_clock::time_point start, int bytes )
+{
+    long long _rtt = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - start ).count();
+
+    this->rtt.record( _rtt );
+    this->lastRtt.set( _rtt );
+    this->bytes.add( bytes );
+}
+
+bool ModbusBlock::isBitArea()
+{
+    return this->area == AREA_COIL || this->area == AREA_DISCRETE_INPUT;
+}
+
+void ModbusBlock::drain()
+{
+    DataItem _d;
+
+    while( this->writeQueue.pop( _d ) )
+    {
+        uint16 _mask = 0;
+        uint16 _value = 0;
 
-            if ( _d.subAddress == 0 )
+        /// coils: the bit position is the address
+        if( this->isBitArea() )
+        {
+            _d.subAddress = _d.address % 16;
+            _d.address = _d.address / 16;
+        }
+
+        if( _d.type == ITEM_TYPE_BIT )
+        {
+            _mask = (uint16)( 1 << _d.subAddress );
+            _value = _d.value ? _mask : 0;
+        }
+        else if( _d.type == ITEM_TYPE_BYTE )
+        {
+            if( _d.subAddress == 0 )
             {
-                _lowerByte = (uint8)_d.value;
-            } else
+                _mask = 0x00ff;
+                _value = (uint16)( _d.value & 0xff );
+            }
+            else
             {
-                _upperByte = (uint8)_d.value;
+                _mask = 0xff00;
+                _value = (uint16)( ( _d.value & 0xff ) << 0x08 );
             }
+        }
+        else if( _d.type == ITEM_TYPE_WORD )
+        {
+            _mask = 0xffff;
+            _value = (uint16)_d.value;
+        }
 
-            this->readList[ _d.address ] = (uint16)( (uint16)( _upperByte << 0x08 ) +
-                                              (uint16)_lowerByte );
+        /// the later item overwrites the earlier one on the common bits
+        this->writeMask[ _d.address ] |= _mask;
+        this->writeValue[ _d.address ] = ( this->writeValue[ _d.address ] & ~_mask ) |
+                                         ( _value & _mask );
+        this->writeTimes.push_back( _d.time );
+        this->writeReq = true;
+    }
+}
 
+void ModbusBlock::merge()
+{
+    for( int i = 0; i < this->size; i++ )
+    {
+        uint16 _mask = this->writeMask[ i ];
+
+        if( _mask )
+        {
+            this->readList[ i ] = ( this->readList[ i ] & ~_mask ) |
+                                  ( this->writeValue[ i ] & _mask );
         }
-        else if( _d.type == ITEM_TYPE_WORD )
+    }
+}
+
+void ModbusBlock::discard()
+{
+    for( int i = 0; i < this->size; i++ )
+    {
+        this->writeMask[ i ] = 0;
+        this->writeValue[ i ] = 0;
+    }
+
+    this->writeTimes.clear();
+    this->writeReq = false;
+}
+
+void ModbusBlock::setError( MBError::Code error )
+{
+    bool _changed = ( this->events != NULL && error != this->error );
+
+    this->error = error;
+    this->healthy = ( error == MBError::NO_ERROR );
+
+    if( _changed )
+    {
+        this->publish_status( StatusEvent::TYPE_BLOCK );
+    }
+
+    /// the first poll ends the restored image
+    if( error != MBError::ERROR_INIT )
+    {
+        this->stale = false;
+    }
+
+    if( error == this->loggedError )
+    {
+        if( error == MBError::NO_ERROR ) return;
+
+        /// rate-limited: a plant-wide outage must not flood the log
+        this->repeats++;
+        std::chrono::steady_clock::time_point _now = std::chrono::steady_clock::now();
+        if( _now - this->loggedTime < std::chrono::seconds( LOG_INTERVAL ) ) return;
+
+        if( Logger::isLogged( Logger::LEVEL_WARNING ) )
         {
-            this->readList[ _d.address ] = _d.value;
+            std::stringstream _ss;
+            _ss << "Block " << this->name << ": " << MBError::toString( error )
+                << " repeated " << this->repeats << " times";
+            Logger::log( Logger::LEVEL_WARNING, _ss.str() );
         }
+
+        this->loggedTime = _now;
+        this->repeats = 0;
+        return;
+    }
+
+    if( this->repeats > 0 && Logger::isLogged( Logger::LEVEL_WARNING ) )
+    {
+        std::stringstream _ss;
+        _ss << "Block " << this->name << ": " << MBError::toString( this->loggedError )
+            << " repeated " << this->repeats << " times";
+        Logger::log( Logger::LEVEL_WARNING, _ss.str() );
+    }
+
+    if( error == MBError::NO_ERROR )
+    {
+        Logger::log( Logger::LEVEL_INFO, "Block " + this->name + ": communication ok" );
+    }
+    else if( Logger::isLogged( Logger::LEVEL_WARNING ) )
+    {
+        Logger::log( Logger::LEVEL_WARNING, "Block " + this->name + ": " + MBError::toString( error ) );
+    }
+
+    this->loggedError = error;
+    this->loggedTime = std::chrono::steady_clock::now();
+    this->repeats = 0;
+}
+
+void ModbusBlock::publish_status( int type )
+{
+    if( this->events != NULL )
+    {
+        this->events->publish( type, this->deviceSymbol, this->blockSymbol );
+    }
+}
+
+void ModbusBlock::idle( std::chrono::steady_clock::time_point deadline )
+{
+    std::unique_lock<std::mutex> _lock( this->wakeMutex );
+    while( !this->writeFlag && !this->stopFlag && !this->demandFlag && std::chrono::steady_clock::now() < deadline )
+    {
+        this->wakeCond.wait_until( _lock, deadline );
     }
 }
 
 void ModbusBlock::setMaster()
 {
+    this->blockMutex.lock();
     this->master = true;
+    this->blockMutex.unlock();
 }
 
 void ModbusBlock::run()
 {
-    int _time_block = 50;       /// normal sleep time
-    int _time;                  /// time counter
+    int _time_idle = 1000;      /// max idle time without cyclic reading
     bool _read_ok = false;      /// local communication ok flag for read
     bool _write_ok = false;     /// local communication ok flag for write
     int _rsum = 0;              /// summary retries for write
-    bool read_flag = true;      /// read flag
+    bool read_flag = true;      /// read flag ( the whole plan )
+    bool _polled = true;        /// the block is polled in this cycle
+    std::chrono::steady_clock::time_point _wake;
 
-    while( true )
+    Trace::setThreadName( "block " + this->name );
+
+    while( !this->stopFlag )
     {
         /// Lock the block :-)
+        Trace::begin( "block_lock" );
         this->blockMutex.lock();
+        Trace::end( "block_lock" );
 
         /// Writing mechanism...
-        if( this->writeFlag )
+        if( this->writeFlag.exchange( false ) )
+        {
+            this->drain();
+        }
+
+        bool _written = false;
+
+        if( this->writeReq )
         {
-            this->connMutex->lock();
+            Trace::begin( "arbiter" );
+            this->arbiter->acquire( this->priority, true, std::chrono::steady_clock::now() );
+            Trace::end( "arbiter" );
+            Trace::begin( "write" );
             _write_ok = this->write();
-            this->connMutex->unlock();
+            Trace::end( "write" );
+            this->arbiter->release();
+            this->writes.add();
+            if( !_write_ok ) this->writeErrors.add();
+            this->consecutiveFailures.set( _write_ok ? 0 : this->consecutiveFailures.read() + 1 );
             if( _write_ok )
             {
                 read_flag = true;
-                this->writeFlag = false;
+                _written = true;
                 _rsum = 0;
             }
             else if( _rsum <= this->retries )
@@ -226,105 +687,170 @@ void ModbusBlock::run()
             else
             {
                 _rsum = 0;
-                this->writeFlag = false;
-                this->writeList.clear();
+                this->discard();
+            }
+        }
+
+        /// a new plan and the start of an interest read the whole plan at once
+        if( this->replanned || this->demandFlag.exchange( false ) )
+        {
+            this->replanned = false;
+            read_flag = true;
+        }
+
+        /// an on-demand block without interest is not read ( a write is read back ),
+        /// the last values are served stale
+        _polled = _written || this->interested();
+
+        if( !_polled )
+        {
+            read_flag = false;
+            if( this->error == MBError::NO_ERROR )
+            {
+                this->stale = true;
+            }
+
+            /// a recovery may leave the master role here, the other blocks wait for the connection
+            if( this->master && !this->conn->isConnected() )
+            {
+                this->arbiter->acquire( this->priority, false, std::chrono::steady_clock::now() );
+                this->reconnect();
+                this->arbiter->release();
             }
         }
 
-       /// Reading mechanism
-        if( read_flag )
+       /// Reading mechanism: the whole plan, or the due requests of it
+        if( _polled && ( read_flag || _read_ok ) )
         {
-            this->connMutex->lock();
-            _read_ok = this->read();
-            this->connMutex->unlock();
-            _time = 0;
+            _read_ok = this->poll( read_flag );
+
             if( _read_ok )
             {
                 read_flag = false;
             }
             else
             {
+                read_flag = true;
+
+                /// with open circuit there is nothing to do until the next probe
+                _wake = std::chrono::steady_clock::now() + std::chrono::milliseconds( this->errorSleep );
+                if( this->error == MBError::CIRCUIT_OPEN )
+                {
+                    _wake = std::max( _wake, this->breaker->readRetryTime() );
+                }
+
                 this->blockMutex.unlock();
-                Thread::msleep( this->errorSleep );
+                this->idle( _wake );
                 this->blockMutex.lock();
             }
         }
 
-        /// Inner trigger time calculation...
-        if( ( _time >= this->cycleTime ) && _read_ok && ( this->cycleTime > 0 ) )
+        /// Next wake up: the next cyclic request, a retry, a doWrite() or a demand()
+        if( ( read_flag && _polled ) || this->writeReq )
         {
-            read_flag = true;
+            _wake = std::chrono::steady_clock::now();
+        }
+        else if( !_polled )
+        {
+            _wake = std::chrono::steady_clock::now() + std::chrono::milliseconds( _time_idle );
         }
         else
         {
-            _time = _time + _time_block;
+            _wake = this->next_poll( _time_idle );
         }
 
         this->blockMutex.unlock();
-        Thread::msleep( _time_block );
+        this->idle( _wake );
     }
+
+    /// the block may be deleted right after the waiter sees the flag
+    std::lock_guard<std::mutex> _lock( this->wakeMutex );
+    this->stopped = true;
+    this->stopCond.notify_all();
 } // run()
 
-void ModbusBlock::halt(){}
+void ModbusBlock::halt()
+{
+    this->wakeMutex.lock();
+    this->stopFlag = true;
+    this->wakeMutex.unlock();
 
-bool ModbusBlock::readBit( int nReg, int nBit ) throw( std::string )
+    this->wakeCond.notify_one();
+}
+
+bool ModbusBlock::isStopped()
 {
-    this->blockMutex.lock();
+    return this->stopped;
+}
 
-    if( nReg >= this->count )
+bool ModbusBlock::waitStopped( std::chrono::steady_clock::time_point deadline )
+{
+    std::unique_lock<std::mutex> _lock( this->wakeMutex );
+    while( !this->stopped && std::chrono::steady_clock::now() < deadline )
     {
-        this->blockMutex.unlock();
-        throw std::string( "bad_register" );
+        this->stopCond.wait_until( _lock, deadline );
     }
 
-    if( nBit > 15 )
+    return this->stopped;
+}
+
+MBError::Code ModbusBlock::readBit( int nReg, int nBit, bool& bit )
+{
+    if( nReg >= this->count )
     {
-        this->blockMutex.unlock();
-        throw std::string( "bad_bit_number" );
+        return MBError::BAD_REGISTER;
     }
 
-    if( this->error != "no_error" )
+    if( nBit > 15 || ( this->isBitArea() && nBit != 0 ) )
     {
-        this->blockMutex.unlock();
-        throw std::string( "block_error" );
+        return MBError::BAD_BIT_NUMBER;
     }
 
-    uint16 _pow2[] = { 1, 2, 4, 8, 16, 32, 64, 128,
-                      256, 512, 1024, 2048, 4096, 8192, 16384, 32768 };
+    /// in bit areas the register position is the bit position
+    if( this->isBitArea() )
+    {
+        nBit = nReg % 16;
+        nReg = nReg / 16;
+    }
 
-    uint16 _word = this->readList[ nReg ];
-    uint16 _mask = _pow2[ nBit ];
+    this->blockMutex.lock();
 
-    if( ( _word & _mask ) > 0 )
+    if( this->error != MBError::NO_ERROR && !this->stale )
     {
         this->blockMutex.unlock();
-        return 1;
+        return MBError::BLOCK_ERROR;
     }
 
+    /// a restored image is served until the first poll
+    MBError::Code _result = this->stale ? MBError::STALE_DATA : MBError::NO_ERROR;
+
+    bit = ( this->readList[ nReg ] >> nBit ) & 1;
+
     this->blockMutex.unlock();
-    return 0;
+
+    return _result;
 }
 
-void ModbusBlock::writeBit( int nReg, int nBit, bool bit ) throw( std::string )
+MBError::Code ModbusBlock::writeBit( int nReg, int nBit, bool bit )
 {
-    this->blockMutex.lock();
-
     if( nReg >= this->count )
     {
-        this->blockMutex.unlock();
-        throw std::string( "bad_register" );
+        return MBError::BAD_REGISTER;
     }
 
-    if( nBit > 15 )
+    if( nBit > 15 || ( this->isBitArea() && nBit != 0 ) )
     {
-        this->blockMutex.unlock();
-        throw std::string( "bad_bit_number" );
+        return MBError::BAD_BIT_NUMBER;
     }
 
-    if( this->error != "no_error" )
+    if( this->area == AREA_DISCRETE_INPUT || this->area == AREA_INPUT_REGISTER )
     {
-        this->blockMutex.unlock();
-        throw std::string( "block_error" );
+        return MBError::READ_ONLY_AREA;
+    }
+
+    if( !this->healthy )
+    {
+        return MBError::BLOCK_ERROR;
     }
 
     DataItem _d;
@@ -332,60 +858,70 @@ void ModbusBlock::writeBit( int nReg, int nBit, bool bit ) throw( std::string )
     _d.address = nReg;
     _d.subAddress = nBit;
     _d.value = bit;
+    _d.time = std::chrono::steady_clock::now();
 
-    this->writeList.push_back( _d );
+    Trace::instant( "enqueue" );
 
-    this->writeReq = true;
+    if( !this->writeQueue.push( _d ) )
+    {
+        return MBError::WRITE_QUEUE_FULL;
+    }
 
-    this->blockMutex.unlock();
+    return MBError::NO_ERROR;
 }
 
-uint8 ModbusBlock::readByte( int nReg, int nByte ) throw( std::string )
+MBError::Code ModbusBlock::readByte( int nReg, int nByte, uint8& byte )
 {
-    this->blockMutex.lock();
-
     if( nReg >= this->count )
     {
-        this->blockMutex.unlock();
-        throw std::string( "bad_register" );
+        return MBError::BAD_REGISTER;
     }
 
-    if( this->error != "no_error" )
+    if( this->isBitArea() )
     {
-        this->blockMutex.unlock();
-        throw std::string( "block_error" );
+        return MBError::BAD_AREA;
     }
 
-    uint16 _word = this->readList[ nReg ];
-    uint8 _upper_byte = _word >> 0x08;
-    uint8 _lower_byte = _word & 0xff;
+    this->blockMutex.lock();
 
-    if( nByte == 0 )
-    {
-        this->blockMutex.unlock();
-        return _lower_byte;
-    }
-    else
+    if( this->error != MBError::NO_ERROR && !this->stale )
     {
         this->blockMutex.unlock();
-        return _upper_byte;
+        return MBError::BLOCK_ERROR;
     }
+
+    /// a restored image is served until the first poll
+    MBError::Code _result = this->stale ? MBError::STALE_DATA : MBError::NO_ERROR;
+
+    uint16 _word = this->readList[ nReg ];
+
+    this->blockMutex.unlock();
+
+    byte = ( nByte == 0 ) ? (uint8)( _word & 0xff ) : (uint8)( _word >> 0x08 );
+
+    return _result;
 }
 
-void ModbusBlock::writeByte( int nReg, int nByte, uint8 byte ) throw( std::string )
+MBError::Code ModbusBlock::writeByte( int nReg, int nByte, uint8 byte )
 {
-    this->blockMutex.lock();
-
     if( nReg >= this->count )
     {
-        this->blockMutex.unlock();
-        throw std::string( "bad_register" );
+        return MBError::BAD_REGISTER;
     }
 
-    if( this->error != "no_error" )
+    if( this->isBitArea() )
     {
-        this->blockMutex.unlock();
-        throw std::string( "block_error" );
+        return MBError::BAD_AREA;
+    }
+
+    if( this->area == AREA_INPUT_REGISTER )
+    {
+        return MBError::READ_ONLY_AREA;
+    }
+
+    if( !this->healthy )
+    {
+        return MBError::BLOCK_ERROR;
     }
 
     DataItem _d;
@@ -393,51 +929,68 @@ void ModbusBlock::writeByte( int nReg, int nByte, uint8 byte ) throw( std::strin
     _d.address = nReg;
     _d.subAddress = nByte;
     _d.value = byte;
+    _d.time = std::chrono::steady_clock::now();
 
-    this->writeList.push_back( _d );
+    Trace::instant( "enqueue" );
 
-    this->writeReq = true;
+    if( !this->writeQueue.push( _d ) )
+    {
+        return MBError::WRITE_QUEUE_FULL;
+    }
 
-    this->blockMutex.unlock();
+    return MBError::NO_ERROR;
 }
 
-uint16 ModbusBlock::readWord( int nReg ) throw( std::string )
+MBError::Code ModbusBlock::readWord( int nReg, uint16& word )
 {
-    this->blockMutex.lock();
-
     if( nReg >= this->count )
     {
-        this->blockMutex.unlock();
-        throw std::string( "bad_register" );
+        return MBError::BAD_REGISTER;
     }
 
-    if( this->error != "no_error" )
+    if( this->isBitArea() )
+    {
+        return MBError::BAD_AREA;
+    }
+
+    this->blockMutex.lock();
+
+    if( this->error != MBError::NO_ERROR && !this->stale )
     {
         this->blockMutex.unlock();
-        throw std::string( "block_error" );
+        return MBError::BLOCK_ERROR;
     }
 
-    uint16 _r = this->readList[ nReg ];
+    /// a restored image is served until the first poll
+    MBError::Code _result = this->stale ? MBError::STALE_DATA : MBError::NO_ERROR;
+
+    word = this->readList[ nReg ];
 
     this->blockMutex.unlock();
 
-    return _r;
+    return _result;
 }
 
-void ModbusBlock::writeWord( int nReg, uint16 word ) throw( std::string )
+MBError::Code ModbusBlock::writeWord( int nReg, uint16 word )
 {
-    this->blockMutex.lock();
-
     if( nReg >= this->count )
     {
-        this->blockMutex.unlock();
-        throw std::string( "bad_register" );
+        return MBError::BAD_REGISTER;
     }
 
-    if( this->error != "no_error" )
+    if( this->isBitArea() )
     {
-        this->blockMutex.unlock();
-        throw std::string( "block_error" );
+        return MBError::BAD_AREA;
+    }
+
+    if( this->area == AREA_INPUT_REGISTER )
+    {
+        return MBError::READ_ONLY_AREA;
+    }
+
+    if( !this->healthy )
+    {
+        return MBError::BLOCK_ERROR;
     }
 
     DataItem _d;
@@ -445,19 +998,97 @@ void ModbusBlock::writeWord( int nReg, uint16 word ) throw( std::string )
     _d.address = nReg;
     _d.subAddress = 0;
     _d.value = word;
+    _d.time = std::chrono::steady_clock::now();
 
-    this->writeList.push_back( _d );
+    Trace::instant( "enqueue" );
 
-    this->writeReq = true;
+    if( !this->writeQueue.push( _d ) )
+    {
+        return MBError::WRITE_QUEUE_FULL;
+    }
 
-    this->blockMutex.unlock();
+    return MBError::NO_ERROR;
 }
 
 void ModbusBlock::doWrite()
 {
-    this->blockMutex.lock();
+    this->wakeMutex.lock();
     this->writeFlag = true;
-    this->blockMutex.unlock();;
+    this->wakeMutex.unlock();
+
+    this->wakeCond.notify_one();
+}
+
+void ModbusBlock::setPlan( const std::vector<PollRequest>& plan )
+{
+    std::lock_guard<std::mutex> _lock( this->blockMutex );
+
+    if( PollPlanner::samePlan( this->plan, plan ) )
+    {
+        return;
+    }
+
+    this->plan = plan;
+    this->planReads.assign( plan.size(), std::chrono::steady_clock::time_point() );
+    this->replanned = true;
+}
+
+void ModbusBlock::demand( int lease )
+{
+    if( !this->onDemand )
+    {
+        return;
+    }
+
+    long long _now = std::chrono::steady_clock::now().time_since_epoch().count();
+    long long _until = ( std::chrono::steady_clock::now() + std::chrono::milliseconds( lease ) ).time_since_epoch().count();
+    long long _old = this->demandUntil;
+
+    while( _old < _until && !this->demandUntil.compare_exchange_weak( _old, _until ) ){}
+
+    /// the start of an interest wakes the block
+    if( _old <= _now )
+    {
+        this->wakeMutex.lock();
+        this->demandFlag = true;
+        this->wakeMutex.unlock();
+
+        this->wakeCond.notify_one();
+    }
+}
+
+bool ModbusBlock::isOnDemand()
+{
+    return this->onDemand;
+}
+
+bool ModbusBlock::readImage( std::vector<uint16>& image )
+{
+    std::lock_guard<std::mutex> _lock( this->blockMutex );
+
+    if( this->error != MBError::NO_ERROR )
+    {
+        return false;
+    }
+
+    image = this->readList;
+
+    return true;
+}
+
+bool ModbusBlock::restoreImage( const std::vector<uint16>& image )
+{
+    std::lock_guard<std::mutex> _lock( this->blockMutex );
+
+    if( this->error != MBError::ERROR_INIT || (int)image.size() != this->size )
+    {
+        return false;
+    }
+
+    this->readList = image;
+    this->stale = true;
+
+    return true;
 }
 
 std::string ModbusBlock::readId()
@@ -469,6 +1100,15 @@ std::string ModbusBlock::readId()
     return _r;
 }
 
+int ModbusBlock::readArea()
+{
+    this->blockMutex.lock();
+    int _r = this->area;
+    this->blockMutex.unlock();
+
+    return _r;
+}
+
 int ModbusBlock::readOffset()
 {
     this->blockMutex.lock();
@@ -514,13 +1154,132 @@ int ModbusBlock::readErrorSleep()
     return _r;
 }
 
+int ModbusBlock::readPriority()
+{
+    this->blockMutex.lock();
+    int _r = this->priority;
+    this->blockMutex.unlock();
+
+    return _r;
+}
+
+void ModbusBlock::registerMetrics( MetricsRegistry* registry, const std::string& deviceId )
+{
+    std::string _labels = MetricsRegistry::label( "device", deviceId ) + "," +
+                          MetricsRegistry::label( "block", this->id );
+
+    this->name = deviceId + "/" + this->id;
+
+    registry->addCounter( "modbus_block_reads_total",
+                          "Read cycles of the block.", _labels, &this->reads );
+    registry->addCounter( "modbus_block_read_errors_total",
+                          "Failed read cycles of the block.", _labels, &this->readErrors );
+    registry->addCounter( "modbus_block_writes_total",
+                          "Write cycles of the block.", _labels, &this->writes );
+    registry->addCounter( "modbus_block_write_errors_total",
+                          "Failed write cycles of the block.", _labels, &this->writeErrors );
+    registry->addHistogram( "modbus_block_request_duration_seconds",
+                            "Round-trip time of the answered requests of the block.", _labels, &this->rtt );
+    registry->addCounter( "modbus_block_pdu_bytes_total",
+                          "Modbus PDU bytes of the answered requests of the block.", _labels, &this->bytes );
+}
+
+void ModbusBlock::unregisterMetrics( MetricsRegistry* registry )
+{
+    registry->remove( &this->reads );
+    registry->remove( &this->readErrors );
+    registry->remove( &this->writes );
+    registry->remove( &this->writeErrors );
+    registry->remove( &this->rtt );
+    registry->remove( &this->bytes );
+}
+
+void ModbusBlock::setStatusEvents( StatusEvents* events, const std::string& deviceId )
+{
+    this->deviceSymbol = SymbolTable::intern( deviceId );
+    this->blockSymbol = SymbolTable::intern( this->id );
+    this->events = events;
+}
+
+void ModbusBlock::readStats( BlockStats& stats )
+{
+    /// the errors are counted after the cycles, read them first
+    unsigned long long _readErrors = this->readErrors.read();
+    unsigned long long _writeErrors = this->writeErrors.read();
+    unsigned long long _reads = this->reads.read();
+    unsigned long long _writes = this->writes.read();
+
+    stats.failures = _readErrors + _writeErrors;
+    stats.successes = _reads + _writes - stats.failures;
+    stats.consecutiveFailures = this->consecutiveFailures.read();
+    stats.lastRtt = this->lastRtt.read();
+    stats.rttSum = this->rtt.readSum();
+    stats.rttCount = this->rtt.readCount();
+    for( int i = 0; i < Histogram::BUCKET_NUM; i++ )
+    {
+        stats.rttBuckets[ i ] = this->rtt.readBucket( i );
+    }
+    stats.cycleTime = this->achievedCycle.read();
+    stats.bytes = this->bytes.read();
+}
+
 std::string ModbusBlock::readError()
+{
+    return MBError::toString( this->readErrorCode() );
+}
+
+MBError::Code ModbusBlock::readErrorCode()
 {
     this->blockMutex.lock();
-    std::string _r = this->error;
+    MBError::Code _r = this->error;
     this->blockMutex.unlock();
 
     return _r;
 }
 
+std::string ModbusBlock::readErrorCategory()
+{
+    return MBError::categoryToString( MBError::category( this->readErrorCode() ) );
+}
+
+int ModbusBlock::toArea( std::string name )
+{
+    if( name == "coil" )
+    {
+        return AREA_COIL;
+    }
+    else if( name == "discrete_input" )
+    {
+        return AREA_DISCRETE_INPUT;
+    }
+    else if( name == "input_register" )
+    {
+        return AREA_INPUT_REGISTER;
+    }
+    else if( name == "holding_register" )
+    {
+        return AREA_HOLDING_REGISTER;
+    }
+
+    return -1;
+}
+
+std::string ModbusBlock::toString( int area )
+{
+    if( area == AREA_COIL )
+    {
+        return std::string( "coil" );
+    }
+    else if( area == AREA_DISCRETE_INPUT )
+    {
+        return std::string( "discrete_input" );
+    }
+    else if( area == AREA_INPUT_REGISTER )
+    {
+        return std::string( "input_register" );
+    }
+
+    return std::string( "holding_register" );
+}
+
 } // namespace ModbusEngine
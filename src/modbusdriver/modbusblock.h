@@ -1,26 +1,70 @@
 #ifndef MODBUSBLOCK_H
 #define MODBUSBLOCK_H
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <list>
 #include <mutex>
 
-#include "../Core/mbtcpmasterconnection.h"
+#include "../Core/histogram.hpp"
+#include "../Core/mberror.h"
+#include "../Core/metrics.h"
+#include "../Core/mbmasterconnection.h"
+#include "../Core/mpscqueue.hpp"
 #include "../Core/thread.hpp"
+#include "circuitbreaker.h"
+#include "pollplanner.h"
+#include "requestarbiter.h"
+#include "statusevents.h"
 
 namespace ModbusEngine
 {
 
+/**
+ * @brief The BlockStats class
+ *
+ * Snapshot of the request statistics of a block ( ModbusBlock::readStats() ).
+ * The times are microsecs, the counters are totals since the block was created.
+ */
+class BlockStats
+{
+public:
+    /// answered and failed requests ( reads and writes )
+    unsigned long long successes;
+    unsigned long long failures;
+    /// failed requests since the last answered one
+    long long consecutiveFailures;
+    /// round-trip time of the last answered request
+    long long lastRtt;
+    /// round-trip times of all answered requests: summary, number and cumulative buckets
+    unsigned long long rttSum;
+    unsigned long long rttCount;
+    unsigned long long rttBuckets[ Histogram::BUCKET_NUM ];
+    /// the time between the last two polls ( of the fastest request of the plan )
+    long long cycleTime;
+    /// modbus PDU bytes sent and received by the answered requests
+    unsigned long long bytes;
+};
+
 /**
  * @brief The ModbusBlock class
  *
  * Define a modbus block.
  *
  * Features:
- *   - automatic loop working ( write-read-wait )
- *   - read from modbus device to readList via MBTCPMasterConnection
- *   - write to modbus device from writeList via MBTCPMasterConnection
+ *   - automatic loop working ( write-read-wait ), doWrite() wakes the loop immediately
+ *   - read from modbus device to readList via MBMasterConnection by the poll plan
+ *     ( PollPlanner ), every request of the plan is read in its own period
+ *   - on-demand polling: the block is read only while a client is interested
+ *     ( demand() ), the last values are served stale between the interests
+ *   - write to modbus device from the lock-free writeQueue via MBMasterConnection
+ *   - coil, discrete input, input register and holding register areas,
+ *     bit areas are stored packed ( bit i in the bit i%16 of readList[ i/16 ] )
  *   - full multithread design
  *   - error monitor flags
+ *   - lock-free request statistics ( readStats() )
+ *   - restorable register image for the warm restart ( stale until the first poll )
  *   - data interface for read and write data
  *
  * DO NOT ADD MORE DATATYPE SUPPORT HERE. IT'S A FUNDAMENTAL DESIGN IDEA.
@@ -29,11 +73,25 @@ namespace ModbusEngine
 class ModbusBlock : public Thread
 {
 
+public:
+    /// modbus data areas
+    static const int AREA_COIL = 0;
+    static const int AREA_DISCRETE_INPUT = 1;
+    static const int AREA_INPUT_REGISTER = 2;
+    static const int AREA_HOLDING_REGISTER = 3;
+
 private:
     /// defined class constants
     static const int ITEM_TYPE_BIT = 0;
     static const int ITEM_TYPE_BYTE = 1;
     static const int ITEM_TYPE_WORD = 2;
+    static const int WRITE_QUEUE_SIZE = 1024;
+    /// max registers of a FC 0x10 request
+    static const int MAX_WRITE_REGISTERS = 123;
+    /// consecutive response timeouts before the connection is dropped
+    static const int MAX_TIMEOUTS = 3;
+    /// a repeated error is logged once in LOG_INTERVAL secs
+    static const int LOG_INTERVAL = 60;
 
     /// DataItem object for writing
     class DataItem
@@ -43,80 +101,301 @@ private:
         int address;
         int subAddress;
         int value;
+        std::chrono::steady_clock::time_point time;
     };
 
     /// block main parameters
     std::string id;
+    int area;
     int offset;
     int count;
     int cycleTime;
     int retries;
     int errorSleep;
-    std::string error;
+    int priority;
+    bool onDemand;
+    MBError::Code error;
+    /// lock-free mirror of ( error == NO_ERROR ) for the write functions
+    std::atomic<bool> healthy;
+
+    /// number of consecutive response timeouts
+    int timeouts;
 
     /// master is a status (the master tries to connect to device)
     bool master;
     /// this flag indicates the write-request (setted by doWrite() function )
-    bool writeFlag;
-    /// this flag indicates when the block has a writing process and we must to write the changes
+    std::atomic<bool> writeFlag;
+    /// halt() asks the thread to exit, the thread reports it back
+    std::atomic<bool> stopFlag;
+    std::atomic<bool> stopped;
+    /// this flag indicates when the coalesced write image has changes we must to write
     bool writeReq;
+    /// readList holds a restored image ( or the last values of an on-demand block
+    /// without interest ), served as stale data until the next poll
+    bool stale;
 
     /// the modbus connection (by device)
-    MBTCPMasterConnection* conn;
+    MBMasterConnection* conn;
+
+    /// number of words in readList ( count or the packed size of count bits )
+    int size;
 
-    /// read and write lists (contains registers and DataItem objects)
+    /// read list (contains registers or packed bits)
     std::vector<uint16> readList;
-    std::vector<DataItem> writeList;
+    /// the values of a request reading a part of the block
+    std::vector<uint16> readBuffer;
+
+    /// the read requests, the fastest first, and their last reads
+    std::vector<PollRequest> plan;
+    std::vector<std::chrono::steady_clock::time_point> planReads;
+    /// setPlan() asks for reading the new plan at once
+    bool replanned;
+
+    /// on-demand polling: the interest lasts until demandUntil ( steady clock ticks ),
+    /// demandFlag wakes the block at the start of an interest
+    std::atomic<long long> demandUntil;
+    std::atomic<bool> demandFlag;
+
+    /// write queue, filled by any thread, drained by the block thread
+    MPSCQueue<DataItem> writeQueue;
+
+    /// coalesced write image (last writer wins per bit): changed bits and their values
+    std::vector<uint16> writeMask;
+    std::vector<uint16> writeValue;
+    /// enqueue times of the items in the write image
+    std::vector<std::chrono::steady_clock::time_point> writeTimes;
+
+    /// end-to-end write latency (delivered by the driver)
+    Histogram* writeLatency;
+
+    /// "device/block" name in the log and the trace dumps
+    std::string name;
+
+    /// the status transitions are published here ( delivered by the driver, NULL -> not published )
+    StatusEvents* events;
+    Symbol deviceSymbol;
+    Symbol blockSymbol;
+
+    /// the last logged error, its time and the repeats since
+    /// ( touched only by the block thread )
+    MBError::Code loggedError;
+    std::chrono::steady_clock::time_point loggedTime;
+    int repeats;
+
+    /// cycle metrics (lock-free)
+    Counter reads;
+    Counter readErrors;
+    Counter writes;
+    Counter writeErrors;
+
+    /// request statistics (lock-free, written by the block thread)
+    Histogram rtt;
+    Gauge lastRtt;
+    Gauge achievedCycle;
+    Gauge consecutiveFailures;
+    Counter bytes;
+    /// start of the last poll ( block thread only )
+    std::chrono::steady_clock::time_point lastPoll;
+
+    /// the request arbiter of the connection (by device or shared line)
+    RequestArbiter* arbiter;
+
+    /// the circuit breaker of the connecting (by device)
+    CircuitBreaker* breaker;
 
     /// required mutexes for multi threading support
-    std::mutex* connMutex;
     std::mutex blockMutex;
 
+    /// wakes the block thread when a write is requested
+    std::mutex wakeMutex;
+    std::condition_variable wakeCond;
+    /// signals the exit of the thread ( waitStopped() )
+    std::condition_variable stopCond;
+
+    /**
+     * @brief reconnect
+     * @return the connection is usable
+     *
+     * Connects when the block is the master and the circuit breaker allows it.
+     * The other blocks fail fast without touching the socket.
+     */
+    bool reconnect();
+
+    /**
+     * @brief recover
+     * @param error -> the error of the last request
+     *
+     * Applies the recovery policy of the error ( see MBError::recovery() ):
+     * link errors and MAX_TIMEOUTS timeouts in a row drop the connection,
+     * single timeouts and framing errors flush it, the exception
+     * responses keep it.
+     */
+    void recover( MBError::Code error );
+
     /**
      * @brief read
+     * @param request -> a request of the plan
+     * @return the success of reading
+     *
+     * Reads the registers of the request.
+     */
+    bool read( const PollRequest& request );
+
+    /**
+     * @brief poll
+     * @param all -> every request of the plan, not only the due ones
      * @return the success of reading
      *
-     * Reads the block defined registers.
+     * Reads the requests through the request arbiter.
+     */
+    bool poll( bool all );
+
+    /**
+     * @brief next_poll
+     * @param idle -> millisecs without cyclic reading
+     * @return the due time of the next cyclic request
+     */
+    std::chrono::steady_clock::time_point next_poll( int idle );
+
+    /**
+     * @brief whole_plan
+     * @return the plan reads the whole block in one request
+     */
+    bool whole_plan();
+
+    /**
+     * @brief write_runs
+     * @return only the changed runs can be written: the plan does not read
+     *         the whole block, or the image is stale ( an on-demand block
+     *         without interest, a restored image )
      */
-    bool read();
+    bool write_runs();
+
+    /**
+     * @brief interested
+     * @return the block is polled ( not on-demand, or a client is interested )
+     */
+    bool interested();
 
     /**
      * @brief write
      * @return the success of writing
      *
-     * Writes the registers.
+     * Writes the registers or the coils.
      */
     bool write();
 
+    /**
+     * @brief write_coils
+     * @param bytes -> the PDU bytes of the request and the response
+     * @return the error code of the connection
+     *
+     * Writes the changed coils with FC 0x05 ( one coil ) or FC 0x0F. When
+     * the plan does not read the whole block only the runs of the changed
+     * coils are written.
+     */
+    MBError::Code write_coils( int& bytes );
+
+    /**
+     * @brief write_registers
+     * @param bytes -> the PDU bytes of the requests and the responses
+     * @return the error code of the connection
+     *
+     * Writes the runs of the changed registers with FC 0x10, the registers
+     * not read by the plan ( or stale ) are not written.
+     */
+    MBError::Code write_registers( int& bytes );
+
+    /**
+     * @brief record_request
+     * @param start -> the start of the answered request
+     * @param bytes -> the PDU bytes of the request and the response
+     */
+    void record_request( std::chrono::steady_clock::time_point start, int bytes );
+
+    /**
+     * @brief isBitArea
+     * @return the block stores coils or discrete inputs
+     */
+    bool isBitArea();
+
+    /**
+     * @brief drain
+     *
+     * Moves the queued DataItem objects into the coalesced write image.
+     */
+    void drain();
+
     /**
      * @brief merge
      *
-     * Merge DataItem objects into readList before writing.
+     * Merge the coalesced write image into readList before writing.
      */
     void merge();
 
+    /**
+     * @brief discard
+     *
+     * Drops the coalesced write image.
+     */
+    void discard();
+
+    /**
+     * @brief setError
+     * @param error -> the new error status
+     *
+     * Sets the error status and its lock-free mirror. Logs and publishes
+     * the changes of the status, an unchanged error is logged once in
+     * LOG_INTERVAL.
+     */
+    void setError( MBError::Code error );
+
+    /**
+     * @brief publish_status
+     * @param type -> StatusEvent::TYPE_BLOCK or TYPE_DEVICE
+     */
+    void publish_status( int type );
+
+    /**
+     * @brief idle
+     * @param deadline -> wake up time
+     *
+     * Sleeps until the deadline or until doWrite() or halt() is called.
+     */
+    void idle( std::chrono::steady_clock::time_point deadline );
+
 public:
     /**
      * @brief ModbusBlock
      * @param id            -> unique std::string id
+     * @param area          -> modbus data area ( AREA_* constants )
      * @param conn          -> delivered connection
-     * @param connMutex     -> delivered mutex for connection
+     * @param arbiter       -> delivered request arbiter for connection
+     * @param breaker       -> delivered circuit breaker for connecting
+     * @param writeLatency  -> delivered histogram for the write latency
      * @param offset        -> modbus question offset
-     * @param count         -> modbus question count
+     * @param count         -> modbus question count ( registers or bits )
      * @param cycleTime     -> reading cycletime
      * @param retries       -> retries after unsuccesfully writing
      * @param errorSleep    -> sleep after unsuccessfully reading/writing
+     * @param priority      -> priority class for the request arbiter
+     * @param onDemand      -> polled only while a client is interested
      *
-     * Creates the full object.
+     * Creates the full object, the plan reads the whole block.
      */
     ModbusBlock( std::string id,
-                 MBTCPMasterConnection* conn,
-                 std::mutex* connMutex,
+                 int area,
+                 MBMasterConnection* conn,
+                 RequestArbiter* arbiter,
+                 CircuitBreaker* breaker,
+                 Histogram* writeLatency,
                  int offset,
                  int count,
                  int cycleTime,
                  int retries,
-                 int errorSleep );
+                 int errorSleep,
+                 int priority,
+                 bool onDemand );
 
     /**
      * @brief run
@@ -128,10 +407,25 @@ public:
     /**
      * @brief halt
      *
-     * Thread class defined function. Called by stopThread().
+     * Thread class defined function. Called by killThread().
+     * Asks the block thread to exit after its current request,
+     * see isStopped().
      */
     void halt();
 
+    /**
+     * @brief isStopped
+     * @return the thread exited after halt(), the block can be deleted
+     */
+    bool isStopped();
+
+    /**
+     * @brief waitStopped
+     * @param deadline -> end of waiting
+     * @return the thread exited after halt() until the deadline
+     */
+    bool waitStopped( std::chrono::steady_clock::time_point deadline );
+
     /**
      * @brief setMaster
      *
@@ -141,95 +435,167 @@ public:
 
     /**
      * @brief readBit
-     * @param nReg -> register position (offset)
-     * @param nBit -> bit position (bit offset inside register)
-     * @return the stored value
+     * @param nReg -> register position (offset), the bit position in bit areas
+     * @param nBit -> bit position (bit offset inside register), 0 in bit areas
+     * @param bit  -> the stored value
+     * @return error code
      *
-     * The function throws std::string exception when error happens:
+     * Error codes:
      *
-     *      "bad_register"      -> bad register address
-     *      "bad_bit_number"    -> bad bit address
-     *      "block_error"       -> block communication error
+     *      BAD_REGISTER        -> bad register address
+     *      BAD_BIT_NUMBER      -> bad bit address
+     *      BLOCK_ERROR         -> block communication error
+     *      STALE_DATA          -> restored value, the block is not polled yet
      */
-    bool readBit( int nReg, int nBit ) throw( std::string );
+    MBError::Code readBit( int nReg, int nBit, bool& bit );
 
     /**
      * @brief writeBit
-     * @param nReg -> register position (offset)
-     * @param nBit -> bit position (bit offset inside register)
+     * @param nReg -> register position (offset), the bit position in bit areas
+     * @param nBit -> bit position (bit offset inside register), 0 in bit areas
      * @param bit  -> the value to write
+     * @return error code
+     *
+     * Error codes:
      *
-     * The function throws std::string exception when error happens:
+     *      BAD_REGISTER        -> bad register address
+     *      BAD_BIT_NUMBER      -> bad bit address
+     *      BLOCK_ERROR         -> block communication error
+     *      READ_ONLY_AREA      -> discrete input or input register block
+     *      WRITE_QUEUE_FULL    -> too many pending writes
      *
-     *      "bad_register"      -> bad register address
-     *      "bad_bit_number"    -> bad bit address
-     *      "block_error"       -> block communication error
+     * Does not lock the block, the value is queued until the next write.
      */
-    void writeBit( int nReg, int nBit, bool bit ) throw( std::string );
+    MBError::Code writeBit( int nReg, int nBit, bool bit );
 
     /**
      * @brief readByte
      * @param nReg  -> register position (offset)
      * @param nByte -> byte position (byte offset inside register)
-     * @return the stored value
+     * @param byte  -> the stored value
+     * @return error code
      *
-     * The function throws std::string exception when error happens:
+     * Error codes:
      *
-     *      "bad_register"      -> bad register address
-     *      "block_error"       -> block communication error
+     *      BAD_REGISTER        -> bad register address
+     *      BLOCK_ERROR         -> block communication error
+     *      BAD_AREA            -> coil or discrete input block
+     *      STALE_DATA          -> restored value, the block is not polled yet
      */
-    uint8 readByte( int nReg, int nByte ) throw( std::string );
+    MBError::Code readByte( int nReg, int nByte, uint8& byte );
 
     /**
      * @brief writeByte
      * @param nReg  -> register position (offset)
      * @param nByte -> byte position (byte offset inside register)
      * @param byte  -> the value to write
+     * @return error code
      *
-     * The function throws std::string exception when error happens:
+     * Error codes:
      *
-     *      "bad_register"      -> bad register address
-     *      "block_error"       -> block communication error
+     *      BAD_REGISTER        -> bad register address
+     *      BLOCK_ERROR         -> block communication error
+     *      BAD_AREA            -> coil or discrete input block
+     *      READ_ONLY_AREA      -> input register block
+     *      WRITE_QUEUE_FULL    -> too many pending writes
+     *
+     * Does not lock the block, the value is queued until the next write.
      */
-    void writeByte( int nReg, int nByte, uint8 byte ) throw( std::string );
+    MBError::Code writeByte( int nReg, int nByte, uint8 byte );
 
     /**
      * @brief readWord
      * @param nReg -> register position (offset)
-     * @return the stored value
+     * @param word -> the stored value
+     * @return error code
      *
-     * The function throws std::string exception when error happens:
+     * Error codes:
      *
-     *      "bad_register"      -> bad register address
-     *      "block_error"       -> block communication error
+     *      BAD_REGISTER        -> bad register address
+     *      BLOCK_ERROR         -> block communication error
+     *      BAD_AREA            -> coil or discrete input block
+     *      STALE_DATA          -> restored value, the block is not polled yet
      */
-    uint16 readWord( int nReg ) throw( std::string );
+    MBError::Code readWord( int nReg, uint16& word );
 
     /**
      * @brief writeWord
      * @param nReg -> register position (offset)
      * @param word -> the value to write
+     * @return error code
+     *
+     * Error codes:
      *
-     * The function throws std::string exception when error happens:
+     *      BAD_REGISTER        -> bad register address
+     *      BLOCK_ERROR         -> block communication error
+     *      BAD_AREA            -> coil or discrete input block
+     *      READ_ONLY_AREA      -> input register block
+     *      WRITE_QUEUE_FULL    -> too many pending writes
      *
-     *      "bad_register"      -> bad register address
-     *      "block_error"       -> block communication error
+     * Does not lock the block, the value is queued until the next write.
      */
-    void writeWord( int nReg, uint16 word ) throw( std::string );
+    MBError::Code writeWord( int nReg, uint16 word );
 
     /**
      * @brief doWrite
      *
-     * Sets the writeFlag.
+     * Sets the writeFlag and wakes the block thread.
      */
     void doWrite();
 
+    /**
+     * @brief setPlan
+     * @param plan -> the read requests ( PollPlanner::plan() )
+     *
+     * The new plan is read at once, an unchanged plan is kept.
+     */
+    void setPlan( const std::vector<PollRequest>& plan );
+
+    /**
+     * @brief demand
+     * @param lease -> millisecs of the interest
+     *
+     * A client is interested in the values of an on-demand block, the block
+     * is polled until the lease ends ( a new demand() extends it ). The start
+     * of an interest reads the block at once. Does not lock the block.
+     */
+    void demand( int lease );
+
+    /**
+     * @brief isOnDemand
+     * @return the block is polled on demand
+     */
+    bool isOnDemand();
+
+    /**
+     * @brief readImage
+     * @param image -> the copy of readList ( packed bits in bit areas )
+     * @return the block is healthy and the image is copied
+     */
+    bool readImage( std::vector<uint16>& image );
+
+    /**
+     * @brief restoreImage
+     * @param image -> a saved image of the block
+     * @return the image is restored
+     *
+     * Fills readList with the last known values before the first poll,
+     * the reads return STALE_DATA until the first poll ends.
+     */
+    bool restoreImage( const std::vector<uint16>& image );
+
     /**
      * @brief readId
      * @return block id
      */
     std::string readId();
 
+    /**
+     * @brief readArea
+     * @return block data area
+     */
+    int readArea();
+
     /**
      * @brief readOffset
      * @return block offset
@@ -260,12 +626,77 @@ public:
      */
     int readErrorSleep();
 
+    /**
+     * @brief readPriority
+     * @return block priority class
+     */
+    int readPriority();
+
+    /**
+     * @brief registerMetrics
+     * @param registry  -> the metrics registry
+     * @param deviceId  -> id of the device ( label, and the name of the thread in the traces )
+     */
+    void registerMetrics( MetricsRegistry* registry, const std::string& deviceId );
+
+    /**
+     * @brief unregisterMetrics
+     * @param registry -> the metrics registry
+     *
+     * Removes the metrics of the block before it is deleted.
+     */
+    void unregisterMetrics( MetricsRegistry* registry );
+
+    /**
+     * @brief setStatusEvents
+     * @param events    -> the event queue of the driver
+     * @param deviceId  -> id of the device
+     *
+     * The error changes of the block and the connects and disconnects
+     * done by the block are published from now.
+     */
+    void setStatusEvents( StatusEvents* events, const std::string& deviceId );
+
+    /**
+     * @brief readStats
+     * @param stats -> the request statistics of the block
+     *
+     * Does not lock the block.
+     */
+    void readStats( BlockStats& stats );
+
     /**
      * @brief readError
      * @return block error status
      */
     std::string readError();
 
+    /**
+     * @brief readErrorCode
+     * @return block error code
+     */
+    MBError::Code readErrorCode();
+
+    /**
+     * @brief readErrorCategory
+     * @return category of the block error ( "none", "link", "timeout", "protocol", "framing" or "access" )
+     */
+    std::string readErrorCategory();
+
+    /**
+     * @brief toArea
+     * @param name -> "coil", "discrete_input", "input_register" or "holding_register"
+     * @return the data area, -1 when the name is unknown
+     */
+    static int toArea( std::string name );
+
+    /**
+     * @brief toString
+     * @param area -> data area
+     * @return the name of the data area
+     */
+    static std::string toString( int area );
+
 };
 
 } // namespace ModbusEngine
@@ -6,19 +6,27 @@ namespace ModbusEngine
 {
 
 ModbusDevice::ModbusDevice( std::string id,
+                            std::string transport,
                             std::string ip,
                             int port,
                             int slaveId,
                             int responseTimeout,
-                            int connectionTimeout )
+                            int connectionTimeout,
+                            MBMasterConnection* conn,
+                            RequestArbiter* arbiter,
+                            int reconnectMin,
+                            int reconnectMax ) : breaker( reconnectMin, reconnectMax )
 {
     this->id = id;
+    this->transport = transport;
     this->ip = ip;
     this->port = port;
     this->slaveId = slaveId;
     this->responseTimeout = responseTimeout;
     this->connectionTimeout = connectionTimeout;
-    this->conn =  new MBTCPMasterConnection( ip, port, slaveId, responseTimeout, connectionTimeout );
+    this->conn = conn;
+    this->arbiter = arbiter;
+    this->blocks = std::make_shared<const BlockTable>();
 }
 
 ModbusDevice::~ModbusDevice()
@@ -28,169 +36,208 @@ ModbusDevice::~ModbusDevice()
 
 void ModbusDevice::addModbusBlock( std::string blockId, ModbusBlock* block )
 {
-    this->blocks[ blockId ] = block;
+    std::shared_ptr<BlockTable> _blocks = std::make_shared<BlockTable>( *std::atomic_load( &this->blocks ) );
+    ( *_blocks )[ SymbolTable::intern( blockId ) ] = std::shared_ptr<ModbusBlock>( block );
+
+    this->setBlocks( _blocks );
 }
 
-MBTCPMasterConnection* ModbusDevice::delegateConnection()
+std::shared_ptr<const ModbusDevice::BlockTable> ModbusDevice::readBlocks()
 {
-    return this->conn;
+    return std::atomic_load( &this->blocks );
 }
 
-std::mutex* ModbusDevice::delegateConnectionMutex()
+void ModbusDevice::setBlocks( std::shared_ptr<const BlockTable> blocks )
 {
-    return &(this->connMutex);
+    std::atomic_store( &this->blocks, blocks );
 }
 
-void ModbusDevice::startBlockThreads()
+std::shared_ptr<ModbusBlock> ModbusDevice::find_block( const std::string& blockId )
 {
-    std::map<std::string,ModbusBlock*>::iterator _it = this->blocks.begin();
-    for( ; _it != this->blocks.end(); _it++ )
+    std::shared_ptr<const BlockTable> _blocks = std::atomic_load( &this->blocks );
+    BlockTable::const_iterator _it = _blocks->find( SymbolTable::find( blockId ) );
+
+    if( _it == _blocks->end() )
     {
-        std::pair<std::string,ModbusBlock*> _p = *_it;
-        ModbusBlock* _b = _p.second;
-        _b->startThread();
+        return std::shared_ptr<ModbusBlock>();
     }
+
+    return _it->second;
 }
 
-bool ModbusDevice::readBit( std::string blockId, int nReg, int nBit ) throw( std::string )
+MBMasterConnection* ModbusDevice::delegateConnection()
 {
-    this->deviceMutex.lock();
+    return this->conn;
+}
+
+RequestArbiter* ModbusDevice::delegateArbiter()
+{
+    return this->arbiter;
+}
+
+CircuitBreaker* ModbusDevice::delegateBreaker()
+{
+    return &(this->breaker);
+}
 
-    std::map<std::string,ModbusBlock*>::iterator _it = this->blocks.find( blockId );
+void ModbusDevice::startBlockThreads()
+{
+    std::shared_ptr<const BlockTable> _blocks = std::atomic_load( &this->blocks );
 
-    if( _it == this->blocks.end() )
+    BlockTable::const_iterator _it = _blocks->begin();
+    for( ; _it != _blocks->end(); _it++ )
     {
-        this->deviceMutex.unlock();
-        throw std::string( "bad_block" );
+        _it->second->startThread();
     }
-    else
-    {
-        std::pair<std::string,ModbusBlock*> _p = *_it;
-        ModbusBlock* _b = _p.second;
+}
 
-        this->deviceMutex.unlock();
-        return _b->readBit( nReg, nBit );
+void ModbusDevice::electMaster( const BlockTable& blocks )
+{
+    if( blocks.empty() ) return;
+
+    BlockTable::const_iterator _it = blocks.begin();
+    for( ; _it != blocks.end(); _it++ )
+    {
+        if( !_it->second->isOnDemand() )
+        {
+            _it->second->setMaster();
+            return;
+        }
     }
+
+    blocks.begin()->second->setMaster();
 }
 
-void ModbusDevice::writeBit( std::string blockId, int nReg, int nBit, bool bit ) throw( std::string )
+MBError::Code ModbusDevice::readBit( Symbol blockId, int nReg, int nBit, bool& bit )
 {
-    this->deviceMutex.lock();
-
-    std::map<std::string,ModbusBlock*>::iterator _it = this->blocks.find( blockId );
+    std::shared_ptr<const BlockTable> _blocks = std::atomic_load( &this->blocks );
+    BlockTable::const_iterator _it = _blocks->find( blockId );
 
-    if( _it == this->blocks.end() )
+    if( _it == _blocks->end() )
     {
-        this->deviceMutex.unlock();
-        throw std::string( "bad_block" );
+        return MBError::BAD_BLOCK;
     }
-    else
-    {
-        std::pair<std::string,ModbusBlock*> _p = *_it;
-        ModbusBlock* _b = _p.second;
 
-        this->deviceMutex.unlock();
-        _b->writeBit( nReg, nBit, bit );
-    }
+    return _it->second->readBit( nReg, nBit, bit );
 }
 
-uint8 ModbusDevice::readByte( std::string blockId, int nReg, int nByte ) throw( std::string )
+MBError::Code ModbusDevice::writeBit( Symbol blockId, int nReg, int nBit, bool bit )
 {
-    this->deviceMutex.lock();
-
-    std::map<std::string,ModbusBlock*>::iterator _it = this->blocks.find( blockId );
+    std::shared_ptr<const BlockTable> _blocks = std::atomic_load( &this->blocks );
+    BlockTable::const_iterator _it = _blocks->find( blockId );
 
-    if( _it == this->blocks.end() )
+    if( _it == _blocks->end() )
     {
-        this->deviceMutex.unlock();
-        throw std::string( "bad_block" );
+        return MBError::BAD_BLOCK;
     }
-    else
-    {
-        std::pair<std::string,ModbusBlock*> _p = *_it;
-        ModbusBlock* _b = _p.second;
 
-        this->deviceMutex.unlock();
-        return _b->readByte( nReg, nByte );
-    }
+    return _it->second->writeBit( nReg, nBit, bit );
 }
 
-void ModbusDevice::writeByte( std::string blockId, int nReg, int nByte, uint8 byte ) throw( std::string )
+MBError::Code ModbusDevice::readByte( Symbol blockId, int nReg, int nByte, uint8& byte )
 {
-    this->deviceMutex.lock();
-
-    std::map<std::string,ModbusBlock*>::iterator _it = this->blocks.find( blockId );
+    std::shared_ptr<const BlockTable> _blocks = std::atomic_load( &this->blocks );
+    BlockTable::const_iterator _it = _blocks->find( blockId );
 
-    if( _it == this->blocks.end() )
+    if( _it == _blocks->end() )
     {
-        this->deviceMutex.unlock();
-        throw std::string( "bad_block" );
+        return MBError::BAD_BLOCK;
     }
-    else
-    {
-        std::pair<std::string,ModbusBlock*> _p = *_it;
-        ModbusBlock* _b = _p.second;
 
-        this->deviceMutex.unlock();
-        _b->writeByte( nReg, nByte, byte );
-    }
+    return _it->second->readByte( nReg, nByte, byte );
 }
 
-uint16 ModbusDevice::readWord( std::string blockId, int nReg ) throw( std::string )
+MBError::Code ModbusDevice::writeByte( Symbol blockId, int nReg, int nByte, uint8 byte )
 {
-    this->deviceMutex.lock();
+    std::shared_ptr<const BlockTable> _blocks = std::atomic_load( &this->blocks );
+    BlockTable::const_iterator _it = _blocks->find( blockId );
 
-    std::map<std::string,ModbusBlock*>::iterator _it = this->blocks.find( blockId );
-
-    if( _it == this->blocks.end() )
+    if( _it == _blocks->end() )
     {
-        this->deviceMutex.unlock();
-        throw std::string( "bad_block" );
+        return MBError::BAD_BLOCK;
     }
-    else
-    {
-        std::pair<std::string,ModbusBlock*> _p = *_it;
-        ModbusBlock* _b = _p.second;
 
-        this->deviceMutex.unlock();
-        return _b->readWord( nReg );
-    }
+    return _it->second->writeByte( nReg, nByte, byte );
 }
 
-void ModbusDevice::writeWord( std::string blockId, int nReg, uint16 word ) throw( std::string )
+MBError::Code ModbusDevice::readWord( Symbol blockId, int nReg, uint16& word )
 {
-    this->deviceMutex.lock();
+    std::shared_ptr<const BlockTable> _blocks = std::atomic_load( &this->blocks );
+    BlockTable::const_iterator _it = _blocks->find( blockId );
+
+    if( _it == _blocks->end() )
+    {
+        return MBError::BAD_BLOCK;
+    }
 
-    std::map<std::string,ModbusBlock*>::iterator _it = this->blocks.find( blockId );
+    return _it->second->readWord( nReg, word );
+}
 
-    if( _it == this->blocks.end() )
+MBError::Code ModbusDevice::writeWord( Symbol blockId, int nReg, uint16 word )
+{
+    std::shared_ptr<const BlockTable> _blocks = std::atomic_load( &this->blocks );
+    BlockTable::const_iterator _it = _blocks->find( blockId );
+
+    if( _it == _blocks->end() )
     {
-        this->deviceMutex.unlock();
-        throw std::string( "bad_block" );
+        return MBError::BAD_BLOCK;
     }
-    else
+
+    return _it->second->writeWord( nReg, word );
+}
+
+void ModbusDevice::doWrite()
+{
+    std::shared_ptr<const BlockTable> _blocks = std::atomic_load( &this->blocks );
+
+    BlockTable::const_iterator _it = _blocks->begin();
+    for( ; _it != _blocks->end(); _it++ )
     {
-        std::pair<std::string,ModbusBlock*> _p = *_it;
-        ModbusBlock* _b = _p.second;
+        _it->second->doWrite();
+    }
+}
 
-        this->deviceMutex.unlock();
-        _b->writeWord( nReg, word );
+MBError::Code ModbusDevice::demand( Symbol blockId, int lease )
+{
+    std::shared_ptr<const BlockTable> _blocks = std::atomic_load( &this->blocks );
+    BlockTable::const_iterator _it = _blocks->find( blockId );
+
+    if( _it == _blocks->end() )
+    {
+        return MBError::BAD_BLOCK;
     }
+
+    _it->second->demand( lease );
+
+    return MBError::NO_ERROR;
 }
 
-void ModbusDevice::doWrite()
+bool ModbusDevice::setBlockPlan( const std::string& blockId, const std::vector<PollRequest>& plan )
 {
-    this->deviceMutex.lock();
+    std::shared_ptr<ModbusBlock> _b = this->find_block( blockId );
 
-    std::map<std::string,ModbusBlock*>::iterator _it = this->blocks.begin();
-    for( ; _it != this->blocks.end(); _it++ )
+    if( !_b )
     {
-        std::pair<std::string,ModbusBlock*> p = *_it;
-        ModbusBlock* b = p.second;
-        b->doWrite();
+        return false;
     }
 
-    this->deviceMutex.unlock();
+    _b->setPlan( plan );
+
+    return true;
+}
+
+bool ModbusDevice::readBlockImage( const std::string& blockId, std::vector<uint16>& image )
+{
+    std::shared_ptr<ModbusBlock> _b = this->find_block( blockId );
+
+    return _b && _b->readImage( image );
+}
+
+bool ModbusDevice::restoreBlockImage( const std::string& blockId, const std::vector<uint16>& image )
+{
+    std::shared_ptr<ModbusBlock> _b = this->find_block( blockId );
+
+    return _b && _b->restoreImage( image );
 }
 
 std::string ModbusDevice::readId()
@@ -202,6 +249,15 @@ std::string ModbusDevice::readId()
     return _r;
 }
 
+std::string ModbusDevice::readTransport()
+{
+    this->deviceMutex.lock();
+    std::string _r = this->transport;
+    this->deviceMutex.unlock();
+
+    return _r;
+}
+
 std::string ModbusDevice::readIp()
 {
     this->deviceMutex.lock();
@@ -263,169 +319,194 @@ std::string ModbusDevice::readConnStatus()
     }
 }
 
+std::string ModbusDevice::readCircuitState()
+{
+    return CircuitBreaker::toString( this->breaker.readState() );
+}
+
+unsigned long long ModbusDevice::readConnectFailures()
+{
+    return this->breaker.readConnectFailures();
+}
+
+unsigned long long ModbusDevice::readConnects()
+{
+    return this->breaker.readConnects();
+}
+
+long long ModbusDevice::readLastConnectTime()
+{
+    return this->breaker.readLastConnectTime();
+}
+
+long long ModbusDevice::readConnectTime()
+{
+    return this->breaker.readConnectTime();
+}
+
+unsigned long long ModbusDevice::readDeadlineMisses( int priority )
+{
+    return this->arbiter->readDeadlineMisses( priority );
+}
+
+long long ModbusDevice::readUptime()
+{
+    std::lock_guard<std::mutex> _lock( this->deviceMutex );
+
+    if( !this->conn->isConnected() )
+    {
+        return 0;
+    }
+
+    return std::chrono::duration_cast<std::chrono::seconds>(
+                std::chrono::steady_clock::now() - this->breaker.readConnectedSince() ).count();
+}
+
 std::vector<std::string> ModbusDevice::getAllBlockId()
 {
-    this->deviceMutex.lock();
+    std::shared_ptr<const BlockTable> _blocks = std::atomic_load( &this->blocks );
 
     std::vector<std::string> _block_ids;
 
     // get all block id
-    for( std::map<std::string,ModbusBlock*>::iterator _it = this->blocks.begin();
-        _it != this->blocks.end(); _it++ ) {
-        std::pair<std::string,ModbusBlock*> _p = *_it;
-        _block_ids.push_back( _p.first );
+    for( BlockTable::const_iterator _it = _blocks->begin();
+        _it != _blocks->end(); _it++ ) {
+        _block_ids.push_back( SymbolTable::name( _it->first ) );
     }
 
-    this->deviceMutex.unlock();
-
     return _block_ids;
 }
 
 std::string ModbusDevice::readBlockId( std::string blockId ) throw( std::string )
 {
-    this->deviceMutex.lock();
-
-    std::map<std::string,ModbusBlock*>::iterator _it = this->blocks.find( blockId );
+    std::shared_ptr<ModbusBlock> _b = this->find_block( blockId );
 
-    if( _it == this->blocks.end() )
+    if( !_b )
     {
-        this->deviceMutex.unlock();
         throw std::string( "bad_block" );
     }
-    else
-    {
-        std::pair<std::string,ModbusBlock*> _p = *_it;
-        ModbusBlock* _b = _p.second;
 
-        this->deviceMutex.unlock();
-        return _b->readId();
+    return _b->readId();
+}
+
+std::string ModbusDevice::readBlockArea( std::string blockId ) throw( std::string )
+{
+    std::shared_ptr<ModbusBlock> _b = this->find_block( blockId );
+
+    if( !_b )
+    {
+        throw std::string( "bad_block" );
     }
+
+    return ModbusBlock::toString( _b->readArea() );
 }
 
 int ModbusDevice::readBlockOffset( std::string blockId ) throw( std::string )
 {
-    this->deviceMutex.lock();
+    std::shared_ptr<ModbusBlock> _b = this->find_block( blockId );
 
-    std::map<std::string,ModbusBlock*>::iterator _it = this->blocks.find( blockId );
-
-    if( _it == this->blocks.end() )
+    if( !_b )
     {
-        this->deviceMutex.unlock();
         throw std::string( "bad_block" );
     }
-    else
-    {
-        std::pair<std::string,ModbusBlock*> _p = *_it;
-        ModbusBlock* _b = _p.second;
 
-        this->deviceMutex.unlock();
-        return _b->readOffset();
-    }
+    return _b->readOffset();
 }
 
 int ModbusDevice::readBlockCount( std::string blockId ) throw( std::string )
 {
-    this->deviceMutex.lock();
-
-    std::map<std::string,ModbusBlock*>::iterator _it = this->blocks.find( blockId );
+    std::shared_ptr<ModbusBlock> _b = this->find_block( blockId );
 
-    if( _it == this->blocks.end() )
+    if( !_b )
     {
-        this->deviceMutex.unlock();
         throw std::string( "bad_block" );
     }
-    else
-    {
-        std::pair<std::string,ModbusBlock*> _p = *_it;
-        ModbusBlock* _b = _p.second;
 
-        this->deviceMutex.unlock();
-        return _b->readCount();
-    }
+    return _b->readCount();
 }
 
 int ModbusDevice::readBlockCycleTime( std::string blockId ) throw( std::string )
 {
-    this->deviceMutex.lock();
-
-    std::map<std::string,ModbusBlock*>::iterator _it = this->blocks.find( blockId );
+    std::shared_ptr<ModbusBlock> _b = this->find_block( blockId );
 
-    if( _it == this->blocks.end() )
+    if( !_b )
     {
-        this->deviceMutex.unlock();
         throw std::string( "bad_block" );
     }
-    else
-    {
-        std::pair<std::string,ModbusBlock*> _p = *_it;
-        ModbusBlock* _b = _p.second;
 
-        this->deviceMutex.unlock();
-        return _b->readCycleTime();
-    }
+    return _b->readCycleTime();
 }
 
 int ModbusDevice::readBlockRetries( std::string blockId ) throw( std::string )
 {
-    this->deviceMutex.lock();
-
-    std::map<std::string,ModbusBlock*>::iterator _it = this->blocks.find( blockId );
+    std::shared_ptr<ModbusBlock> _b = this->find_block( blockId );
 
-    if( _it == this->blocks.end() )
+    if( !_b )
     {
-        this->deviceMutex.unlock();
         throw std::string( "bad_block" );
     }
-    else
-    {
-        std::pair<std::string,ModbusBlock*> _p = *_it;
-        ModbusBlock* _b = _p.second;
 
-        this->deviceMutex.unlock();
-        return _b->readRetries();
-    }
+    return _b->readRetries();
 }
 
 int ModbusDevice::readBlockErrorSleep( std::string blockId ) throw( std::string )
 {
-    this->deviceMutex.lock();
+    std::shared_ptr<ModbusBlock> _b = this->find_block( blockId );
 
-    std::map<std::string,ModbusBlock*>::iterator _it = this->blocks.find( blockId );
-
-    if( _it == this->blocks.end() )
+    if( !_b )
     {
-        this->deviceMutex.unlock();
         throw std::string( "bad_block" );
     }
-    else
-    {
-        std::pair<std::string,ModbusBlock*> _p = *_it;
-        ModbusBlock* _b = _p.second;
 
-        this->deviceMutex.unlock();
-        return _b->readErrorSleep();
+    return _b->readErrorSleep();
+}
+
+std::string ModbusDevice::readBlockPriority( std::string blockId ) throw( std::string )
+{
+    std::shared_ptr<ModbusBlock> _b = this->find_block( blockId );
+
+    if( !_b )
+    {
+        throw std::string( "bad_block" );
     }
+
+    return RequestArbiter::toString( _b->readPriority() );
 }
 
 std::string ModbusDevice::readBlockError( std::string blockId ) throw( std::string )
 {
-    this->deviceMutex.lock();
+    std::shared_ptr<ModbusBlock> _b = this->find_block( blockId );
 
-    std::map<std::string,ModbusBlock*>::iterator _it = this->blocks.find( blockId );
-
-    if( _it == this->blocks.end() )
+    if( !_b )
     {
-        this->deviceMutex.unlock();
         throw std::string( "bad_block" );
     }
-    else
+
+    return _b->readError();
+}
+
+std::string ModbusDevice::readBlockErrorCategory( std::string blockId ) throw( std::string )
+{
+    std::shared_ptr<ModbusBlock> _b = this->find_block( blockId );
+
+    if( !_b )
     {
-        std::pair<std::string,ModbusBlock*> _p = *_it;
-        ModbusBlock* _b = _p.second;
+        throw std::string( "bad_block" );
+    }
 
-        this->deviceMutex.unlock();
-        return _b->readError();
+    return _b->readErrorCategory();
+}
+
+void ModbusDevice::readBlockStats( std::string blockId, BlockStats& stats ) throw( std::string )
+{
+    std::shared_ptr<ModbusBlock> _b = this->find_block( blockId );
+
+    if( !_b )
+    {
+        throw std::string( "bad_block" );
     }
+
+    _b->readStats( stats );
 }
 
 } // namespace ModbusEngine
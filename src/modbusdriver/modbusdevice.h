@@ -2,8 +2,10 @@
 #define MODBUSDEVICE_H
 
 #include <map>
+#include <memory>
 
 #include "modbusblock.h"
+#include "../Core/symboltable.h"
 
 namespace ModbusEngine
 {
@@ -18,48 +20,77 @@ namespace ModbusEngine
  *   - store connection
  *   - multithread design
  *   - build functions for add ModbusBlock
+ *   - the block table is swapped as a whole ( copy on write ), the readers
+ *     take a snapshot without locking and keep its blocks alive
  */
 
 class ModbusDevice
 {
 
+public:
+    /// the blocks by the symbol of the block id
+    typedef std::map<Symbol,std::shared_ptr<ModbusBlock> > BlockTable;
+
 private:
     /// Device main parameters
     std::string id;
+    std::string transport;
     std::string ip;
     int port;
     int slaveId;
     int responseTimeout;
     int connectionTimeout;
 
-    /// The modbus tcp connection
-    MBTCPMasterConnection* conn;
+    /// The modbus connection (tcp or rtu)
+    MBMasterConnection* conn;
+
+    /// Map when we store modbus blocks ( read and swapped by std::atomic_load/store )
+    std::shared_ptr<const BlockTable> blocks;
+
+    /// the request arbiter for the connection (shared by the devices of a line)
+    RequestArbiter* arbiter;
 
-    /// Map when we store modbus blocks
-    std::map<std::string,ModbusBlock*> blocks;
+    /// the circuit breaker of the connecting
+    CircuitBreaker breaker;
 
     /// required mutexes for multithreading support
-    std::mutex connMutex;
     std::mutex deviceMutex;
 
+    /**
+     * @brief find_block
+     * @param blockId -> block id
+     * @return the block, empty when the id is unknown
+     */
+    std::shared_ptr<ModbusBlock> find_block( const std::string& blockId );
+
 public:
     /**
      * @brief ModbusDevice
      * @param id                -> uinque std::string id
-     * @param ip                -> ip address of device
+     * @param transport         -> "tcp", "rtu" or "rtu_over_tcp"
+     * @param ip                -> ip address of device (serial port for rtu)
      * @param port              -> port of device
      * @param slaveId           -> slaveId of device
      * @param responseTimeout   -> timeout for response
      * @param connectionTimeout -> timeout for connection
+     * @param conn              -> the connection of the device (owned by the device)
+     * @param arbiter           -> delivered request arbiter of the connection
+     * @param reconnectMin      -> first reconnect delay in millisecs
+     * @param reconnectMax      -> max reconnect delay in millisecs
      *
      * Creates the full object but not fill this->blocks map.
      */
     ModbusDevice( std::string id,
+                  std::string transport,
                   std::string ip,
                   int port,
                   int slaveId,
                   int responseTimeout,
-                  int connectionTimeout );
+                  int connectionTimeout,
+                  MBMasterConnection* conn,
+                  RequestArbiter* arbiter,
+                  int reconnectMin,
+                  int reconnectMax );
 
     /**
       * @brief ~ModbusDevice
@@ -77,17 +108,38 @@ public:
      */
     void addModbusBlock( std::string blockId, ModbusBlock* block );
 
+    /**
+     * @brief readBlocks
+     * @return snapshot of the block table
+     */
+    std::shared_ptr<const BlockTable> readBlocks();
+
+    /**
+     * @brief setBlocks
+     * @param blocks -> the new block table
+     *
+     * Swaps the block table. The readers of the old table finish with
+     * the old blocks, the removed blocks must be halted by the caller.
+     */
+    void setBlocks( std::shared_ptr<const BlockTable> blocks );
+
     /**
      * @brief delegateConnection
      * @return pointer to this->conn
      */
-    MBTCPMasterConnection* delegateConnection();
+    MBMasterConnection* delegateConnection();
 
     /**
-     * @brief delegateConnectionMutex
-     * @return pointer to this->connMutex.
+     * @brief delegateArbiter
+     * @return this->arbiter
      */
-    std::mutex* delegateConnectionMutex();
+    RequestArbiter* delegateArbiter();
+
+    /**
+     * @brief delegateBreaker
+     * @return pointer to this->breaker
+     */
+    CircuitBreaker* delegateBreaker();
 
     /**
      * @brief startBlockThreads
@@ -96,21 +148,32 @@ public:
      */
     void startBlockThreads();
 
+    /**
+     * @brief electMaster
+     * @param blocks -> the block table of a device
+     *
+     * Gives the master role to the first cyclic block of the table ( to the
+     * first block when all of them are on-demand ), an on-demand block
+     * without interest would not connect for the others.
+     */
+    static void electMaster( const BlockTable& blocks );
+
     /**
      * @brief readBit
      * @param blockId   -> block id
      * @param nReg      -> register position (offset)
      * @param nBit      -> bit position (bit offset inside register)
-     * @return the stored value
+     * @param bit       -> the stored value
+     * @return error code
      *
-     * The function throws std::string exception when error happens:
+     * Error codes:
      *
-     *      "bad_block"         -> bad block id
-     *      "bad_register"      -> bad register address
-     *      "bad_bit_number"    -> bad bit address
-     *      "block_error"       -> block communication error
+     *      BAD_BLOCK           -> bad block id
+     *      BAD_REGISTER        -> bad register address
+     *      BAD_BIT_NUMBER      -> bad bit address
+     *      BLOCK_ERROR         -> block communication error
      */
-    bool readBit( std::string blockId, int nReg, int nBit ) throw( std::string );
+    MBError::Code readBit( Symbol blockId, int nReg, int nBit, bool& bit );
 
     /**
      * @brief writeBit
@@ -118,30 +181,35 @@ public:
      * @param nReg      -> register position (offset)
      * @param nBit      -> bit position (bit offset inside register)
      * @param bit       -> the value to write
+     * @return error code
      *
-     * The function throws std::string exception when error happens:
+     * Error codes:
      *
-     *      "bad_block"         -> bad block id
-     *      "bad_register"      -> bad register address
-     *      "bad_bit_number"    -> bad bit address
-     *      "block_error"       -> block communication error
+     *      BAD_BLOCK           -> bad block id
+     *      BAD_REGISTER        -> bad register address
+     *      BAD_BIT_NUMBER      -> bad bit address
+     *      BLOCK_ERROR         -> block communication error
+     *      READ_ONLY_AREA      -> discrete input or input register block
+     *      WRITE_QUEUE_FULL    -> too many pending writes
      */
-    void writeBit( std::string blockId, int nReg, int nBit, bool bit ) throw( std::string );
+    MBError::Code writeBit( Symbol blockId, int nReg, int nBit, bool bit );
 
     /**
      * @brief readByte
      * @param blockId   -> block id
      * @param nReg      -> register position (offset)
      * @param nByte     -> byte position (byte offset inside register)
-     * @return the stored value
+     * @param byte      -> the stored value
+     * @return error code
      *
-     * The function throws std::string exception when error happens:
+     * Error codes:
      *
-     *      "bad_block"         -> bad block id
-     *      "bad_register"      -> bad register address
-     *      "block_error"       -> block communication error
+     *      BAD_BLOCK           -> bad block id
+     *      BAD_REGISTER        -> bad register address
+     *      BLOCK_ERROR         -> block communication error
+     *      BAD_AREA            -> coil or discrete input block
      */
-    uint8 readByte( std::string blockId, int nReg, int nByte ) throw( std::string );
+    MBError::Code readByte( Symbol blockId, int nReg, int nByte, uint8& byte );
 
     /**
      * @brief writeByte
@@ -149,42 +217,52 @@ public:
      * @param nReg      -> register position (offset)
      * @param nByte     -> byte position (byte offset inside register)
      * @param byte      -> the value to write
+     * @return error code
      *
-     * The function throws std::string exception when error happens:
+     * Error codes:
      *
-     *      "bad_block"         -> bad block id
-     *      "bad_register"      -> bad register address
-     *      "block_error"       -> block communication error
+     *      BAD_BLOCK           -> bad block id
+     *      BAD_REGISTER        -> bad register address
+     *      BLOCK_ERROR         -> block communication error
+     *      BAD_AREA            -> coil or discrete input block
+     *      READ_ONLY_AREA      -> input register block
+     *      WRITE_QUEUE_FULL    -> too many pending writes
      */
-    void writeByte( std::string blockId, int nReg, int nByte, uint8 byte ) throw( std::string );
+    MBError::Code writeByte( Symbol blockId, int nReg, int nByte, uint8 byte );
 
     /**
      * @brief readWord
      * @param blockId   -> block id
      * @param nReg      -> register position (offset)
-     * @return the stored value
+     * @param word      -> the stored value
+     * @return error code
      *
-     * The function throws std::string exception when error happens:
+     * Error codes:
      *
-     *      "bad_block"         -> bad block id
-     *      "bad_register"      -> bad register address
-     *      "block_error"       -> block communication error
+     *      BAD_BLOCK           -> bad block id
+     *      BAD_REGISTER        -> bad register address
+     *      BLOCK_ERROR         -> block communication error
+     *      BAD_AREA            -> coil or discrete input block
      */
-    uint16 readWord( std::string blockId, int nReg ) throw( std::string );
+    MBError::Code readWord( Symbol blockId, int nReg, uint16& word );
 
     /**
      * @brief writeWord
      * @param blockId   -> block id
      * @param nReg      -> register position (offset)
      * @param word      -> the value to write
+     * @return error code
      *
-     * The function throws std::string exception when error happens:
+     * Error codes:
      *
-     *      "bad_block"         -> bad block id
-     *      "bad_register"      -> bad register address
-     *      "block_error"       -> block communication error
+     *      BAD_BLOCK           -> bad block id
+     *      BAD_REGISTER        -> bad register address
+     *      BLOCK_ERROR         -> block communication error
+     *      BAD_AREA            -> coil or discrete input block
+     *      READ_ONLY_AREA      -> input register block
+     *      WRITE_QUEUE_FULL    -> too many pending writes
      */
-    void writeWord( std::string blockId, int nReg, uint16 word ) throw( std::string );
+    MBError::Code writeWord( Symbol blockId, int nReg, uint16 word );
 
     /**
      * @brief doWrite
@@ -193,12 +271,56 @@ public:
      */
     void doWrite();
 
+    /**
+     * @brief demand
+     * @param blockId   -> block id
+     * @param lease     -> millisecs of the interest
+     * @return error code
+     *
+     * Error codes:
+     *
+     *      BAD_BLOCK           -> bad block id
+     *
+     * See ModbusBlock::demand().
+     */
+    MBError::Code demand( Symbol blockId, int lease );
+
+    /**
+     * @brief setBlockPlan
+     * @param blockId   -> block id
+     * @param plan      -> the read requests of the block
+     * @return the block exists and its plan is set ( see ModbusBlock::setPlan() )
+     */
+    bool setBlockPlan( const std::string& blockId, const std::vector<PollRequest>& plan );
+
+    /**
+     * @brief readBlockImage
+     * @param blockId   -> block id
+     * @param image     -> the copy of the registers
+     * @return the block exists, it is healthy and the image is copied
+     */
+    bool readBlockImage( const std::string& blockId, std::vector<uint16>& image );
+
+    /**
+     * @brief restoreBlockImage
+     * @param blockId   -> block id
+     * @param image     -> a saved image of the block
+     * @return the block exists and the image is restored ( see ModbusBlock::restoreImage() )
+     */
+    bool restoreBlockImage( const std::string& blockId, const std::vector<uint16>& image );
+
     /**
      * @brief readId
      * @return device id
      */
     std::string readId();
 
+    /**
+     * @brief readTransport
+     * @return device transport
+     */
+    std::string readTransport();
+
     /**
      * @brief readIp
      * @return device ip
@@ -235,6 +357,49 @@ public:
      */
     std::string readConnStatus();
 
+    /**
+     * @brief readCircuitState
+     * @return the state of the circuit breaker
+     */
+    std::string readCircuitState();
+
+    /**
+     * @brief readConnectFailures
+     * @return number of failed connects
+     */
+    unsigned long long readConnectFailures();
+
+    /**
+     * @brief readConnects
+     * @return number of successful connects
+     */
+    unsigned long long readConnects();
+
+    /**
+     * @brief readLastConnectTime
+     * @return duration of the last connect in microsecs
+     */
+    long long readLastConnectTime();
+
+    /**
+     * @brief readConnectTime
+     * @return duration of all connects in microsecs
+     */
+    long long readConnectTime();
+
+    /**
+     * @brief readDeadlineMisses
+     * @param priority -> priority class
+     * @return number of deadline misses in the priority class
+     */
+    unsigned long long readDeadlineMisses( int priority );
+
+    /**
+     * @brief readUptime
+     * @return secs since the connection is up, 0 when disconnected
+     */
+    long long readUptime();
+
     /**
      * @brief getAllBlockId
      * @return device all block id
@@ -252,6 +417,17 @@ public:
      */
     std::string readBlockId( std::string blockId ) throw( std::string );
 
+    /**
+     * @brief readBlockArea
+     * @param blockId -> block id
+     * @return block data area name
+     *
+     * The function throws std::string exception when error happens:
+     *
+     *      "bad_block" -> bad block id
+     */
+    std::string readBlockArea( std::string blockId ) throw( std::string );
+
     /**
      * @brief readBlockOffset
      * @param blockId -> block id
@@ -307,6 +483,17 @@ public:
      */
     int readBlockErrorSleep( std::string blockId ) throw( std::string );
 
+    /**
+     * @brief readBlockPriority
+     * @param blockId -> block id
+     * @return block priority class name
+     *
+     * The function throws std::string exception when error happens:
+     *
+     *      "bad_block" -> bad block id
+     */
+    std::string readBlockPriority( std::string blockId ) throw( std::string );
+
     /**
      * @brief readBlockError
      * @param blockId -> block id
@@ -318,6 +505,28 @@ public:
      */
     std::string readBlockError( std::string blockId ) throw( std::string );
 
+    /**
+     * @brief readBlockErrorCategory
+     * @param blockId -> block id
+     * @return category of the block error
+     *
+     * The function throws std::string exception when error happens:
+     *
+     *      "bad_block" -> bad block id
+     */
+    std::string readBlockErrorCategory( std::string blockId ) throw( std::string );
+
+    /**
+     * @brief readBlockStats
+     * @param blockId -> block id
+     * @param stats   -> the request statistics of the block
+     *
+     * The function throws std::string exception when error happens:
+     *
+     *      "bad_block" -> bad block id
+     */
+    void readBlockStats( std::string blockId, BlockStats& stats ) throw( std::string );
+
 };
 
 } // namespace ModbusEngine
@@ -1,623 +1,1214 @@
+#include <algorithm>
+#include <set>
+#include <sstream>
+
 #include "modbusdriver.h"
+#include "../Core/logger.h"
+#include "../Core/mblinemasterconnection.h"
+#include "../Core/mbrtubus.h"
+#include "../Core/mbtcpline.h"
+#include "../Core/mbtcpmasterconnection.h"
 
 namespace ModbusEngine
 {
 
-ModbusDriver::ModbusDriver( MBPro* mbpro )
+const int ModbusDriver::RETIRE_WAIT;
+
+ModbusDriver::ModbusDriver( MBPro* mbpro, MetricsRegistry* metrics )
 {
     this->mbpro = mbpro;
+    this->metrics = metrics;
+    this->started = false;
+    this->metrics->addHistogram( "modbus_write_latency_seconds",
+                                 "End-to-end latency of the written items.",
+                                 "",
+                                 &this->writeLatency );
+    this->build_spans();
     this->build_the_tree();
 }
 
-void ModbusDriver::build_the_tree()
+void ModbusDriver::build_spans()
+{
+    this->tagSpans.clear();
+
+    std::vector<MBPro_Tag>::iterator _it = this->mbpro->taglist.tags.begin();
+    for( ; _it != this->mbpro->taglist.tags.end(); _it++ ) {
+        PollSpan _span;
+        _span.position = _it->address;
+        _span.width = PollPlanner::tagWidth( _it->type );
+        _span.rate = _it->rate;
+
+        this->tagSpans[ std::make_pair( SymbolTable::intern( _it->deviceId ),
+                                        SymbolTable::intern( _it->blockId ) ) ].push_back( _span );
+    }
+}
+
+std::vector<PollRequest> ModbusDriver::plan_block( const std::string& deviceId, const MBPro_Driver_Block& b )
+{
+    int _area = ModbusBlock::toArea( b.area );
+    std::vector<PollSpan> _spans;
+
+    std::map<std::pair<Symbol,Symbol>,std::vector<PollSpan> >::iterator _it =
+            this->tagSpans.find( std::make_pair( SymbolTable::intern( deviceId ), SymbolTable::intern( b.blockId ) ) );
+    if( _it != this->tagSpans.end() )
+    {
+        _spans = _it->second;
+    }
+
+    return PollPlanner::plan( _area == ModbusBlock::AREA_COIL || _area == ModbusBlock::AREA_DISCRETE_INPUT,
+                              b.count,
+                              b.cycleTime,
+                              _spans );
+}
+
+void ModbusDriver::replan_blocks()
 {
     std::vector<MBPro_Driver_Device>::iterator _it = this->mbpro->driver.devices.begin();
-    for( ;_it != this->mbpro->driver.devices.end(); _it++ ) {
-        MBPro_Driver_Device _d = *_it;
-        ModbusDevice* _device = new ModbusDevice( _d.deviceId,
-                                                  _d.ip,
-                                                  _d.port,
-                                                  _d.slaveId,
-                                                  _d.responseTimeout,
-                                                  _d.connectionTimeout );
-
-        bool _first_block = true;
-        std::vector<MBPro_Driver_Block>::iterator _it_2 = _d.blocks.begin();
-        for( ;_it_2 != _d.blocks.end(); _it_2++ ) {
-            MBPro_Driver_Block _b = *_it_2;
-            ModbusBlock* _block = new ModbusBlock( _b.blockId,
-                                                   _device->delegateConnection(),
-                                                   _device->delegateConnectionMutex(),
-                                                   _b.offset,
-                                                   _b.count,
-                                                   _b.cycleTime,
-                                                   _b.retries,
-                                                   3000 );
-
-            if( _first_block ) {
-                _first_block = false;
-                _block->setMaster();
-            }
+    for( ; _it != this->mbpro->driver.devices.end(); _it++ ) {
+        std::shared_ptr<ModbusDevice> _device = this->find_device( _it->deviceId );
+        if( !_device ) continue;
 
-            _device->addModbusBlock( _b.blockId, _block );
+        std::vector<MBPro_Driver_Block>::iterator _b = _it->blocks.begin();
+        for( ; _b != _it->blocks.end(); _b++ ) {
+            _device->setBlockPlan( _b->blockId, this->plan_block( _it->deviceId, *_b ) );
         }
-
-       this->add_modbus_device( _d.deviceId, _device );
     }
 }
 
-void ModbusDriver::add_modbus_device( std::string deviceId, ModbusDevice* device )
+void ModbusDriver::build_the_tree()
 {
-    this->devices[ deviceId ] = device;
+    std::shared_ptr<DeviceTable> _devices = std::make_shared<DeviceTable>();
+
+    std::vector<MBPro_Driver_Device>::iterator _it = this->mbpro->driver.devices.begin();
+    for( ;_it != this->mbpro->driver.devices.end(); _it++ ) {
+        ( *_devices )[ SymbolTable::intern( _it->deviceId ) ] = this->create_device( *_it );
+    }
+
+    std::atomic_store( &this->devices, std::shared_ptr<const DeviceTable>( _devices ) );
 }
 
-void ModbusDriver::startBlockThreads()
+std::shared_ptr<ModbusDevice> ModbusDriver::create_device( MBPro_Driver_Device d )
 {
-    std::map<std::string,ModbusDevice*>::iterator _it = this->devices.begin();
-    for( ; _it != this->devices.end(); _it++ ) {
-        std::pair<std::string,ModbusDevice*> _p = *_it;
-        ModbusDevice* _device = _p.second;
-        _device->startBlockThreads();
+    RequestArbiter* _arbiter;
+    MBMasterConnection* _conn = this->create_connection( d, &_arbiter );
+    _conn->registerMetrics( this->metrics, MetricsRegistry::label( "device", d.deviceId ) );
+    std::shared_ptr<ModbusDevice> _device( new ModbusDevice( d.deviceId,
+                                                             d.transport,
+                                                             ( d.transport == "rtu" ) ? d.serialPort : d.ip,
+                                                             d.port,
+                                                             d.slaveId,
+                                                             d.responseTimeout,
+                                                             d.connectionTimeout,
+                                                             _conn,
+                                                             _arbiter,
+                                                             d.reconnectMin,
+                                                             d.reconnectMax ) );
+
+    std::vector<MBPro_Driver_Block>::iterator _it = d.blocks.begin();
+    for( ;_it != d.blocks.end(); _it++ ) {
+        _device->addModbusBlock( _it->blockId, this->create_block( _device.get(), d.deviceId, *_it ) );
     }
+
+    ModbusDevice::electMaster( *_device->readBlocks() );
+
+    return _device;
 }
 
-bool ModbusDriver::readBit( std::string deviceId,
-                            std::string blockId,
-                            int nReg,
-                            int nBit ) throw( std::string )
+ModbusBlock* ModbusDriver::create_block( ModbusDevice* device,
+                                         const std::string& deviceId,
+                                         const MBPro_Driver_Block& b )
 {
-    this->driverMutex.lock();
+    ModbusBlock* _block = new ModbusBlock( b.blockId,
+                                           ModbusBlock::toArea( b.area ),
+                                           device->delegateConnection(),
+                                           device->delegateArbiter(),
+                                           device->delegateBreaker(),
+                                           &(this->writeLatency),
+                                           b.offset,
+                                           b.count,
+                                           b.cycleTime,
+                                           b.retries,
+                                           b.errorSleep,
+                                           RequestArbiter::toPriority( b.priority ),
+                                           b.onDemand );
+
+    _block->setPlan( this->plan_block( deviceId, b ) );
+    _block->registerMetrics( this->metrics, deviceId );
+    _block->setStatusEvents( &this->statusEvents, deviceId );
+
+    return _block;
+}
 
-    try
-    {
-        std::map<std::string,ModbusDevice*>::iterator _it = this->devices.find( deviceId );
+MBMasterConnection* ModbusDriver::create_connection( MBPro_Driver_Device& d, RequestArbiter** arbiter )
+{
+    std::stringstream _ss;
+
+    /// tcp devices on the same ip:port share one gateway connection
+    int _gateway_devices = 0;
+    int _pipeline = d.maxPipeline;
 
-        if( _it == this->devices.end() )
+    if( d.transport == "tcp" )
+    {
+        std::vector<MBPro_Driver_Device>::iterator _it = this->mbpro->driver.devices.begin();
+        for( ; _it != this->mbpro->driver.devices.end(); _it++ )
         {
-            throw std::string( "bad_device" );
+            if( _it->transport == "tcp" && _it->ip == d.ip && _it->port == d.port )
+            {
+                _gateway_devices++;
+                _pipeline = std::min( _pipeline, _it->maxPipeline );
+            }
         }
-        else
-        {
-            std::pair<std::string,ModbusDevice*> _p = *_it;
-            ModbusDevice* _d = _p.second;
-            bool _bit = _d->readBit( blockId, nReg, nBit );
+    }
 
-            this->driverMutex.unlock();
-            return _bit;
+    SocketOptions _options;
+    _options.noDelay = d.tcpNoDelay;
+    _options.keepAlive = d.tcpKeepAlive;
+    _options.keepAliveIdle = d.keepAliveIdle;
+    _options.keepAliveInterval = d.keepAliveInterval;
+    _options.keepAliveCount = d.keepAliveCount;
+    _options.userTimeout = d.tcpUserTimeout;
+
+    /// tcp: own connection and arbiter for a lonely device
+    /// ( a device rebuilt by a reload gets its arbiter back )
+    if( d.transport == "tcp" && _gateway_devices < 2 )
+    {
+        _ss << "tcp:" << d.deviceId;
+        if( this->arbiters.find( _ss.str() ) == this->arbiters.end() )
+        {
+            this->arbiters[ _ss.str() ] = new RequestArbiter();
         }
+        *arbiter = this->arbiters[ _ss.str() ];
+
+        return new MBTCPMasterConnection( d.ip,
+                                          d.port,
+                                          d.slaveId,
+                                          d.responseTimeout,
+                                          d.connectionTimeout,
+                                          _options );
     }
-    catch( std::string ex )
+
+    if( d.transport == "rtu" )
     {
-        this->driverMutex.unlock();
-        throw std::string( ex );
+        _ss << "rtu:" << d.serialPort;
+    }
+    else if( d.transport == "rtu_over_tcp" )
+    {
+        _ss << "rtu_over_tcp:" << d.ip << ":" << d.port;
+    }
+    else
+    {
+        _ss << "tcp:" << d.ip << ":" << d.port;
     }
-}
 
-void ModbusDriver::writeBit( std::string deviceId,
-                             std::string blockId,
-                             int nReg,
-                             int nBit,
-                             bool bit ) throw( std::string )
-{
-    this->driverMutex.lock();
+    std::string _key = _ss.str();
 
-    try
+    std::stringstream _params;
+    _params << d.baudRate << "," << d.parity << "," << d.dataBits << "," << d.stopBits << ","
+            << _pipeline << "," << _options.noDelay << "," << _options.keepAlive << ","
+            << _options.keepAliveIdle << "," << _options.keepAliveInterval << ","
+            << _options.keepAliveCount << "," << _options.userTimeout;
+
+    if( this->lines.find( _key ) != this->lines.end() && this->lineParameters[ _key ] != _params.str() )
     {
-        std::map<std::string,ModbusDevice*>::iterator _it = this->devices.find( deviceId );
+        Logger::log( Logger::LEVEL_WARNING, "Line " + _key + " keeps its parameters while a device uses it ( device " +
+                                            d.deviceId + " )" );
+    }
 
-        if( _it == this->devices.end() )
+    if( this->lines.find( _key ) == this->lines.end() )
+    {
+        this->lineParameters[ _key ] = _params.str();
+
+        if( d.transport == "rtu" )
+        {
+            this->lines[ _key ] = new MBRTUBus( d.serialPort,
+                                                d.baudRate,
+                                                d.parity[ 0 ],
+                                                d.dataBits,
+                                                d.stopBits );
+        }
+        else if( d.transport == "rtu_over_tcp" )
         {
-            throw std::string( "bad_device" );
+            this->lines[ _key ] = new MBRTUBus( d.ip, d.port, _options );
         }
         else
         {
-            std::pair<std::string,ModbusDevice*> _p = *_it;
-            ModbusDevice* _d = _p.second;
-            _d->writeBit( blockId, nReg, nBit, bit );
-            this->driverMutex.unlock();
+            this->lines[ _key ] = new MBTCPLine( d.ip, d.port, _pipeline, _options );
+        }
+    }
+
+    /// the serialized lines share the arbiter, a pipelining gateway
+    /// gets the requests of the devices at the same time
+    if( d.transport == "tcp" && _pipeline > 1 )
+    {
+        std::stringstream _device_key;
+        _device_key << "tcp:" << d.deviceId;
+        if( this->arbiters.find( _device_key.str() ) == this->arbiters.end() )
+        {
+            this->arbiters[ _device_key.str() ] = new RequestArbiter();
         }
+        *arbiter = this->arbiters[ _device_key.str() ];
     }
-    catch( std::string ex )
+    else
     {
-        this->driverMutex.unlock();
-        throw std::string( ex );
+        if( this->arbiters.find( _key ) == this->arbiters.end() )
+        {
+            this->arbiters[ _key ] = new RequestArbiter();
+        }
+        *arbiter = this->arbiters[ _key ];
     }
+
+    return new MBLineMasterConnection( this->lines[ _key ],
+                                       d.slaveId,
+                                       d.responseTimeout,
+                                       d.connectionTimeout );
 }
 
-uint8 ModbusDriver::readByte( std::string deviceId,
-                              std::string blockId,
-                              int nReg,
-                              int nByte ) throw( std::string )
+std::shared_ptr<ModbusDevice> ModbusDriver::find_device( const std::string& deviceId )
+{
+    std::shared_ptr<const DeviceTable> _devices = std::atomic_load( &this->devices );
+    DeviceTable::const_iterator _it = _devices->find( SymbolTable::find( deviceId ) );
+
+    if( _it == _devices->end() )
+    {
+        return std::shared_ptr<ModbusDevice>();
+    }
+
+    return _it->second;
+}
+
+void ModbusDriver::startBlockThreads()
+{
+    std::lock_guard<std::mutex> _lock( this->driverMutex );
+
+    std::shared_ptr<const DeviceTable> _devices = std::atomic_load( &this->devices );
+
+    DeviceTable::const_iterator _it = _devices->begin();
+    for( ; _it != _devices->end(); _it++ ) {
+        _it->second->startBlockThreads();
+    }
+
+    this->started = true;
+}
+
+bool ModbusDriver::same_device( const MBPro_Driver_Device& a, const MBPro_Driver_Device& b )
+{
+    return a.transport == b.transport &&
+           a.ip == b.ip &&
+           a.port == b.port &&
+           a.serialPort == b.serialPort &&
+           a.baudRate == b.baudRate &&
+           a.parity == b.parity &&
+           a.dataBits == b.dataBits &&
+           a.stopBits == b.stopBits &&
+           a.slaveId == b.slaveId &&
+           a.responseTimeout == b.responseTimeout &&
+           a.connectionTimeout == b.connectionTimeout &&
+           a.maxPipeline == b.maxPipeline &&
+           a.reconnectMin == b.reconnectMin &&
+           a.reconnectMax == b.reconnectMax &&
+           a.tcpNoDelay == b.tcpNoDelay &&
+           a.tcpKeepAlive == b.tcpKeepAlive &&
+           a.keepAliveIdle == b.keepAliveIdle &&
+           a.keepAliveInterval == b.keepAliveInterval &&
+           a.keepAliveCount == b.keepAliveCount &&
+           a.tcpUserTimeout == b.tcpUserTimeout;
+}
+
+bool ModbusDriver::same_block( const MBPro_Driver_Block& a, const MBPro_Driver_Block& b )
+{
+    return a.area == b.area &&
+           a.offset == b.offset &&
+           a.count == b.count &&
+           a.cycleTime == b.cycleTime &&
+           a.retries == b.retries &&
+           a.errorSleep == b.errorSleep &&
+           a.priority == b.priority &&
+           a.onDemand == b.onDemand;
+}
+
+bool ModbusDriver::is_gateway_device( const MBPro_Driver_Device& d, MBPro* mbpro )
 {
-    this->driverMutex.lock();
+    if( d.transport != "tcp" ) return false;
+
+    int _n = 0;
+    std::vector<MBPro_Driver_Device>::iterator _it = mbpro->driver.devices.begin();
+    for( ; _it != mbpro->driver.devices.end(); _it++ )
+    {
+        if( _it->transport == "tcp" && _it->ip == d.ip && _it->port == d.port ) _n++;
+    }
+
+    return _n > 1;
+}
+
+void ModbusDriver::retire( const std::vector<std::shared_ptr<ModbusBlock> >& blocks,
+                           const std::vector<std::shared_ptr<ModbusDevice> >& devices )
+{
+    for( size_t i = 0; i < blocks.size(); i++ )
+    {
+        blocks[ i ]->killThread();
+    }
+
+    /// a block thread exits after its current request
+    std::chrono::steady_clock::time_point _deadline =
+            std::chrono::steady_clock::now() + std::chrono::milliseconds( RETIRE_WAIT );
+
+    for( size_t i = 0; i < blocks.size() && this->started; i++ )
+    {
+        blocks[ i ]->waitStopped( _deadline );
+    }
+
+    this->retiringBlocks.insert( this->retiringBlocks.end(), blocks.begin(), blocks.end() );
+    this->retiringDevices.insert( this->retiringDevices.end(), devices.begin(), devices.end() );
+
+    this->release_retired();
 
-    try
+    if( !this->retiringBlocks.empty() )
     {
-        std::map<std::string,ModbusDevice*>::iterator _it = this->devices.find( deviceId );
+        std::stringstream _log;
+        _log << "Driver reload: " << this->retiringBlocks.size() << " retired blocks are still stopping";
+        Logger::log( Logger::LEVEL_WARNING, _log.str() );
+    }
+}
+
+void ModbusDriver::release_retired()
+{
+    std::vector<std::shared_ptr<ModbusBlock> > _running_blocks;
 
-        if( _it == this->devices.end() )
+    for( size_t i = 0; i < this->retiringBlocks.size(); i++ )
+    {
+        if( this->started && !this->retiringBlocks[ i ]->isStopped() )
         {
-            throw std::string( "bad_device" );
+            _running_blocks.push_back( this->retiringBlocks[ i ] );
+            continue;
         }
-        else
+
+        this->retiringBlocks[ i ]->unregisterMetrics( this->metrics );
+    }
+
+    this->retiringBlocks.swap( _running_blocks );
+
+    std::vector<std::shared_ptr<ModbusDevice> > _running_devices;
+    std::vector<std::shared_ptr<ModbusDevice> > _released;
+
+    for( size_t i = 0; i < this->retiringDevices.size(); i++ )
+    {
+        std::shared_ptr<ModbusDevice> _device = this->retiringDevices[ i ];
+        std::shared_ptr<const ModbusDevice::BlockTable> _blocks = _device->readBlocks();
+        bool _stopped = true;
+
+        for( ModbusDevice::BlockTable::const_iterator _b = _blocks->begin(); _b != _blocks->end(); _b++ )
         {
-            std::pair<std::string,ModbusDevice*> _p = *_it;
-            ModbusDevice* _d = _p.second;
-            uint8 _byte = _d->readByte( blockId, nReg, nByte );
+            if( this->started && !_b->second->isStopped() ) _stopped = false;
+        }
 
-            this->driverMutex.unlock();
-            return _byte;
+        /// the blocks use the connection and the arbiter until they stop
+        if( !_stopped )
+        {
+            _running_devices.push_back( _device );
+            continue;
         }
+
+        _device->delegateConnection()->disconnect();
+        _device->delegateConnection()->unregisterMetrics( this->metrics );
+        _released.push_back( _device );
     }
-    catch( std::string ex )
+
+    this->retiringDevices.swap( _running_devices );
+
+    /// the last device of an arbiter ( a line ) releases it
+    for( size_t i = 0; i < _released.size(); i++ )
     {
-        this->driverMutex.unlock();
-        throw std::string( ex );
+        this->release_arbiter( _released[ i ]->delegateArbiter() );
+        this->release_line( _released[ i ]->delegateConnection()->delegateLine() );
     }
 }
 
-void ModbusDriver::writeByte( std::string deviceId,
-                              std::string blockId,
-                              int nReg,
-                              int nByte,
-                              uint8 byte ) throw( std::string )
+void ModbusDriver::release_arbiter( RequestArbiter* arbiter )
 {
-    this->driverMutex.lock();
+    std::shared_ptr<const DeviceTable> _devices = std::atomic_load( &this->devices );
 
-    try
+    for( DeviceTable::const_iterator _it = _devices->begin(); _it != _devices->end(); _it++ )
     {
-        std::map<std::string,ModbusDevice*>::iterator _it = this->devices.find( deviceId );
+        if( _it->second->delegateArbiter() == arbiter ) return;
+    }
 
-        if( _it == this->devices.end() )
-        {
-            throw std::string( "bad_device" );
-        }
-        else
+    for( size_t i = 0; i < this->retiringDevices.size(); i++ )
+    {
+        if( this->retiringDevices[ i ]->delegateArbiter() == arbiter ) return;
+    }
+
+    std::map<std::string,RequestArbiter*>::iterator _it = this->arbiters.begin();
+    for( ; _it != this->arbiters.end(); _it++ )
+    {
+        if( _it->second == arbiter )
         {
-            std::pair<std::string,ModbusDevice*> _p = *_it;
-            ModbusDevice* _d = _p.second;
-            _d->writeByte( blockId, nReg, nByte, byte );
-            this->driverMutex.unlock();
+            this->arbiters.erase( _it );
+            delete arbiter;
+            return;
         }
     }
-    catch( std::string ex )
+}
+
+void ModbusDriver::release_line( MBLine* line )
+{
+    if( line == NULL ) return;
+
+    std::shared_ptr<const DeviceTable> _devices = std::atomic_load( &this->devices );
+
+    for( DeviceTable::const_iterator _it = _devices->begin(); _it != _devices->end(); _it++ )
+    {
+        if( _it->second->delegateConnection()->delegateLine() == line ) return;
+    }
+
+    for( size_t i = 0; i < this->retiringDevices.size(); i++ )
+    {
+        if( this->retiringDevices[ i ]->delegateConnection()->delegateLine() == line ) return;
+    }
+
+    std::map<std::string,MBLine*>::iterator _it = this->lines.begin();
+    for( ; _it != this->lines.end(); _it++ )
     {
-        this->driverMutex.unlock();
-        throw std::string( ex );
+        if( _it->second == line )
+        {
+            Logger::log( Logger::LEVEL_INFO, "Driver reload: line " + _it->first + " closed, no device uses it" );
+
+            this->lineParameters.erase( _it->first );
+            this->lines.erase( _it );
+            line->close();
+            delete line;
+            return;
+        }
     }
 }
 
-uint16 ModbusDriver::readWord( std::string deviceId,
-                               std::string blockId,
-                               int nReg ) throw( std::string )
+void ModbusDriver::reload( MBPro* mbpro )
 {
-    this->driverMutex.lock();
+    std::lock_guard<std::mutex> _lock( this->driverMutex );
+
+    MBPro* _old = this->mbpro;
+    this->mbpro = mbpro;
+    this->build_spans();
+
+    std::map<std::string,MBPro_Driver_Device*> _old_devices;
+    std::vector<MBPro_Driver_Device>::iterator _it = _old->driver.devices.begin();
+    for( ; _it != _old->driver.devices.end(); _it++ )
+    {
+        _old_devices[ _it->deviceId ] = &( *_it );
+    }
+
+    std::shared_ptr<const DeviceTable> _current = std::atomic_load( &this->devices );
+
+    /// the devices and the blocks staying in the tables
+    std::shared_ptr<DeviceTable> _kept = std::make_shared<DeviceTable>();
+    std::map<Symbol,std::shared_ptr<ModbusDevice::BlockTable> > _kept_blocks;
+
+    /// the devices and the blocks to build
+    std::vector<MBPro_Driver_Device*> _new_devices;
+    std::map<Symbol,std::vector<MBPro_Driver_Block*> > _new_blocks;
 
-    try
+    /// the devices and the blocks to halt
+    std::vector<std::shared_ptr<ModbusDevice> > _retired_devices;
+    std::vector<std::shared_ptr<ModbusBlock> > _retired_blocks;
+    std::set<Symbol> _new_masters;
+
+    int _added = 0;
+    int _removed = 0;
+    int _changed = 0;
+    int _blocks = 0;
+
+    for( _it = mbpro->driver.devices.begin(); _it != mbpro->driver.devices.end(); _it++ )
     {
-        std::map<std::string,ModbusDevice*>::iterator _it = this->devices.find( deviceId );
+        Symbol _device = SymbolTable::intern( _it->deviceId );
+        DeviceTable::const_iterator _d = _current->find( _device );
 
-        if( _it == this->devices.end() )
+        if( _d == _current->end() || _old_devices.find( _it->deviceId ) == _old_devices.end() )
         {
-            throw std::string( "bad_device" );
+            _new_devices.push_back( &( *_it ) );
+            _added++;
+            continue;
         }
-        else
+
+        MBPro_Driver_Device* _o = _old_devices[ _it->deviceId ];
+
+        /// a lonely tcp device joining a gateway ( or leaving it ) changes its connection
+        if( !same_device( *_o, *_it ) || is_gateway_device( *_o, _old ) != is_gateway_device( *_it, mbpro ) )
+        {
+            _retired_devices.push_back( _d->second );
+            _new_devices.push_back( &( *_it ) );
+            _changed++;
+            continue;
+        }
+
+        ( *_kept )[ _device ] = _d->second;
+
+        /// the blocks of an unchanged device
+        std::map<std::string,MBPro_Driver_Block*> _old_blocks;
+        for( std::vector<MBPro_Driver_Block>::iterator _b = _o->blocks.begin(); _b != _o->blocks.end(); _b++ )
+        {
+            _old_blocks[ _b->blockId ] = &( *_b );
+        }
+
+        std::shared_ptr<const ModbusDevice::BlockTable> _running = _d->second->readBlocks();
+        std::shared_ptr<ModbusDevice::BlockTable> _staying = std::make_shared<ModbusDevice::BlockTable>();
+        std::set<Symbol> _ids;
+
+        for( std::vector<MBPro_Driver_Block>::iterator _b = _it->blocks.begin(); _b != _it->blocks.end(); _b++ )
+        {
+            Symbol _block = SymbolTable::intern( _b->blockId );
+            ModbusDevice::BlockTable::const_iterator _r = _running->find( _block );
+            _ids.insert( _block );
+
+            if( _r != _running->end() && _old_blocks.find( _b->blockId ) != _old_blocks.end() &&
+                same_block( *_old_blocks[ _b->blockId ], *_b ) )
+            {
+                ( *_staying )[ _block ] = _r->second;
+                continue;
+            }
+
+            if( _r != _running->end() )
+            {
+                _retired_blocks.push_back( _r->second );
+                _new_masters.insert( _device );
+            }
+
+            _new_blocks[ _device ].push_back( &( *_b ) );
+            _blocks++;
+        }
+
+        for( ModbusDevice::BlockTable::const_iterator _r = _running->begin(); _r != _running->end(); _r++ )
         {
-            std::pair<std::string,ModbusDevice*> _p = *_it;
-            ModbusDevice* _d = _p.second;
-            uint16 _word = _d->readWord( blockId, nReg );
+            if( _ids.find( _r->first ) == _ids.end() )
+            {
+                _retired_blocks.push_back( _r->second );
+                _new_masters.insert( _device );
+                _blocks++;
+            }
+        }
 
-            this->driverMutex.unlock();
-            return _word;
+        if( _staying->size() != _running->size() || _new_blocks.find( _device ) != _new_blocks.end() )
+        {
+            _kept_blocks[ _device ] = _staying;
         }
     }
-    catch( std::string ex )
+
+    std::set<Symbol> _device_ids;
+    for( _it = mbpro->driver.devices.begin(); _it != mbpro->driver.devices.end(); _it++ )
     {
-        this->driverMutex.unlock();
-        throw std::string( ex );
+        _device_ids.insert( SymbolTable::intern( _it->deviceId ) );
     }
-}
 
-void ModbusDriver::writeWord( std::string deviceId,
-                              std::string blockId,
-                              int nReg,
-                              uint16 word ) throw( std::string )
-{
-    this->driverMutex.lock();
+    for( DeviceTable::const_iterator _d = _current->begin(); _d != _current->end(); _d++ )
+    {
+        if( _device_ids.find( _d->first ) == _device_ids.end() )
+        {
+            _retired_devices.push_back( _d->second );
+            _removed++;
+        }
+    }
 
-    try
+    /// first swap: the removed and the changed devices and blocks disappear
+    std::atomic_store( &this->devices, std::shared_ptr<const DeviceTable>( _kept ) );
+
+    std::map<Symbol,std::shared_ptr<ModbusDevice::BlockTable> >::iterator _k = _kept_blocks.begin();
+    for( ; _k != _kept_blocks.end(); _k++ )
     {
-        std::map<std::string,ModbusDevice*>::iterator _it = this->devices.find( deviceId );
+        ( *_kept )[ _k->first ]->setBlocks( _k->second );
+    }
 
-        if( _it == this->devices.end() )
+    /// halt them ( a changed device may allow one connection only, so the old one goes first )
+    for( size_t i = 0; i < _retired_devices.size(); i++ )
+    {
+        std::shared_ptr<const ModbusDevice::BlockTable> _r = _retired_devices[ i ]->readBlocks();
+        for( ModbusDevice::BlockTable::const_iterator _b = _r->begin(); _b != _r->end(); _b++ )
         {
-            throw std::string( "bad_device" );
+            _retired_blocks.push_back( _b->second );
         }
-        else
+    }
+
+    this->retire( _retired_blocks, _retired_devices );
+
+    /// second swap: the new and the changed devices and blocks appear
+    std::shared_ptr<DeviceTable> _final = std::make_shared<DeviceTable>( *_kept );
+
+    for( _k = _kept_blocks.begin(); _k != _kept_blocks.end(); _k++ )
+    {
+        std::shared_ptr<ModbusDevice> _device = ( *_kept )[ _k->first ];
+        std::shared_ptr<ModbusDevice::BlockTable> _table = std::make_shared<ModbusDevice::BlockTable>( *_k->second );
+
+        std::vector<MBPro_Driver_Block*>& _build = _new_blocks[ _k->first ];
+        for( size_t i = 0; i < _build.size(); i++ )
+        {
+            std::shared_ptr<ModbusBlock> _block( this->create_block( _device.get(), SymbolTable::name( _k->first ), *_build[ i ] ) );
+            if( this->started ) _block->startThread();
+            ( *_table )[ SymbolTable::intern( _build[ i ]->blockId ) ] = _block;
+        }
+
+        /// the removed block may have been the one reconnecting
+        if( _new_masters.find( _k->first ) != _new_masters.end() )
         {
-            std::pair<std::string,ModbusDevice*> _p = *_it;
-            ModbusDevice* _d = _p.second;
-            _d->writeWord( blockId, nReg, word );
-            this->driverMutex.unlock();
+            ModbusDevice::electMaster( *_table );
         }
+
+        _device->setBlocks( _table );
     }
-    catch( std::string ex )
+
+    for( size_t i = 0; i < _new_devices.size(); i++ )
     {
-        this->driverMutex.unlock();
-        throw std::string( ex );
+        std::shared_ptr<ModbusDevice> _device = this->create_device( *_new_devices[ i ] );
+        if( this->started ) _device->startBlockThreads();
+        ( *_final )[ SymbolTable::intern( _new_devices[ i ]->deviceId ) ] = _device;
     }
+
+    std::atomic_store( &this->devices, std::shared_ptr<const DeviceTable>( _final ) );
+
+    /// the tags of the unchanged blocks may have new rates
+    this->replan_blocks();
+
+    std::stringstream _log;
+    _log << "Driver reloaded: " << _added << " devices added, " << _removed << " removed, "
+         << _changed << " changed, " << _blocks << " blocks of the other devices changed";
+    Logger::log( Logger::LEVEL_INFO, _log.str() );
 }
 
-void ModbusDriver::doWrite()
+MBError::Code ModbusDriver::tryReadBit( Symbol deviceId,
+                                        Symbol blockId,
+                                        int nReg,
+                                        int nBit,
+                                        bool& bit )
 {
-    this->driverMutex.lock();
+    std::shared_ptr<const DeviceTable> _devices = std::atomic_load( &this->devices );
+    DeviceTable::const_iterator _it = _devices->find( deviceId );
 
-    std::map<std::string,ModbusDevice*>::iterator _it = this->devices.begin();
-    for( ; _it != this->devices.end(); _it++ )
+    if( _it == _devices->end() )
     {
-        std::pair<std::string,ModbusDevice*> p = *_it;
-        ModbusDevice* d = p.second;
-        d->doWrite();
+        return MBError::BAD_DEVICE;
     }
 
-    this->driverMutex.unlock();
+    return _it->second->readBit( blockId, nReg, nBit, bit );
 }
 
-std::vector<std::string> ModbusDriver::getAllDeviceId()
+MBError::Code ModbusDriver::tryWriteBit( Symbol deviceId,
+                                         Symbol blockId,
+                                         int nReg,
+                                         int nBit,
+                                         bool bit )
 {
-    this->driverMutex.lock();
+    std::shared_ptr<const DeviceTable> _devices = std::atomic_load( &this->devices );
+    DeviceTable::const_iterator _it = _devices->find( deviceId );
 
-    std::vector<std::string> _device_ids;
+    if( _it == _devices->end() )
+    {
+        return MBError::BAD_DEVICE;
+    }
 
-    // get all device id
-    for( std::map<std::string,ModbusDevice*>::iterator _it = this->devices.begin();
-        _it != this->devices.end(); _it++ ) {
-        std::pair<std::string,ModbusDevice*> _p = *_it;
-        _device_ids.push_back( _p.first );
+    return _it->second->writeBit( blockId, nReg, nBit, bit );
+}
+
+MBError::Code ModbusDriver::tryReadByte( Symbol deviceId,
+                                         Symbol blockId,
+                                         int nReg,
+                                         int nByte,
+                                         uint8& byte )
+{
+    std::shared_ptr<const DeviceTable> _devices = std::atomic_load( &this->devices );
+    DeviceTable::const_iterator _it = _devices->find( deviceId );
+
+    if( _it == _devices->end() )
+    {
+        return MBError::BAD_DEVICE;
     }
 
-    this->driverMutex.unlock();
+    return _it->second->readByte( blockId, nReg, nByte, byte );
+}
+
+MBError::Code ModbusDriver::tryWriteByte( Symbol deviceId,
+                                          Symbol blockId,
+                                          int nReg,
+                                          int nByte,
+                                          uint8 byte )
+{
+    std::shared_ptr<const DeviceTable> _devices = std::atomic_load( &this->devices );
+    DeviceTable::const_iterator _it = _devices->find( deviceId );
 
-    return _device_ids;
+    if( _it == _devices->end() )
+    {
+        return MBError::BAD_DEVICE;
+    }
+
+    return _it->second->writeByte( blockId, nReg, nByte, byte );
 }
 
-std::vector<std::string> ModbusDriver::getAllBlockId( std::string deviceId ) throw( std::string )
+MBError::Code ModbusDriver::tryReadWord( Symbol deviceId,
+                                         Symbol blockId,
+                                         int nReg,
+                                         uint16& word )
 {
-    this->driverMutex.lock();
+    std::shared_ptr<const DeviceTable> _devices = std::atomic_load( &this->devices );
+    DeviceTable::const_iterator _it = _devices->find( deviceId );
 
-    try
+    if( _it == _devices->end() )
     {
-        std::map<std::string,ModbusDevice*>::iterator _it = this->devices.find( deviceId );
+        return MBError::BAD_DEVICE;
+    }
 
-        if( _it == this->devices.end() )
-        {
-            throw std::string( "bad_device" );
-        }
-        else
-        {
-            std::pair<std::string,ModbusDevice*> _p = *_it;
-            ModbusDevice* _d = _p.second;
+    return _it->second->readWord( blockId, nReg, word );
+}
 
-            std::vector<std::string> _block_ids;
-            _block_ids = _d->getAllBlockId();
+MBError::Code ModbusDriver::tryWriteWord( Symbol deviceId,
+                                          Symbol blockId,
+                                          int nReg,
+                                          uint16 word )
+{
+    std::shared_ptr<const DeviceTable> _devices = std::atomic_load( &this->devices );
+    DeviceTable::const_iterator _it = _devices->find( deviceId );
 
-            this->driverMutex.unlock();
-            return _block_ids;
-        }
+    if( _it == _devices->end() )
+    {
+        return MBError::BAD_DEVICE;
     }
-    catch( std::string ex )
+
+    return _it->second->writeWord( blockId, nReg, word );
+}
+
+bool ModbusDriver::readBit( std::string deviceId,
+                            std::string blockId,
+                            int nReg,
+                            int nBit ) throw( std::string )
+{
+    bool _bit = false;
+    MBError::Code _error = this->tryReadBit( SymbolTable::find( deviceId ), SymbolTable::find( blockId ), nReg, nBit, _bit );
+
+    if( _error != MBError::NO_ERROR )
     {
-        this->driverMutex.unlock();
-        throw std::string( ex );
+        throw MBError::toString( _error );
     }
+
+    return _bit;
 }
 
-std::string ModbusDriver::readDeviceIp( std::string deviceId ) throw( std::string )
+void ModbusDriver::writeBit( std::string deviceId,
+                             std::string blockId,
+                             int nReg,
+                             int nBit,
+                             bool bit ) throw( std::string )
 {
-    this->driverMutex.lock();
+    MBError::Code _error = this->tryWriteBit( SymbolTable::find( deviceId ), SymbolTable::find( blockId ), nReg, nBit, bit );
 
-    try
+    if( _error != MBError::NO_ERROR )
     {
-        std::map<std::string,ModbusDevice*>::iterator _it = this->devices.find( deviceId );
+        throw MBError::toString( _error );
+    }
+}
 
-        if( _it == this->devices.end() )
-        {
-            throw std::string( "bad_device" );
-        }
-        else
-        {
-            std::pair<std::string,ModbusDevice*> _p = *_it;
-            ModbusDevice* _d = _p.second;
+uint8 ModbusDriver::readByte( std::string deviceId,
+                              std::string blockId,
+                              int nReg,
+                              int nByte ) throw( std::string )
+{
+    uint8 _byte = 0;
+    MBError::Code _error = this->tryReadByte( SymbolTable::find( deviceId ), SymbolTable::find( blockId ), nReg, nByte, _byte );
 
-            driverMutex.unlock();
-            return _d->readIp();
-        }
+    if( _error != MBError::NO_ERROR )
+    {
+        throw MBError::toString( _error );
     }
-    catch( std::string ex )
+
+    return _byte;
+}
+
+void ModbusDriver::writeByte( std::string deviceId,
+                              std::string blockId,
+                              int nReg,
+                              int nByte,
+                              uint8 byte ) throw( std::string )
+{
+    MBError::Code _error = this->tryWriteByte( SymbolTable::find( deviceId ), SymbolTable::find( blockId ), nReg, nByte, byte );
+
+    if( _error != MBError::NO_ERROR )
     {
-        this->driverMutex.unlock();
-        throw std::string( ex );
+        throw MBError::toString( _error );
     }
 }
 
-int ModbusDriver::readDevicePort( std::string deviceId ) throw( std::string )
+uint16 ModbusDriver::readWord( std::string deviceId,
+                               std::string blockId,
+                               int nReg ) throw( std::string )
 {
-    this->driverMutex.lock();
+    uint16 _word = 0;
+    MBError::Code _error = this->tryReadWord( SymbolTable::find( deviceId ), SymbolTable::find( blockId ), nReg, _word );
 
-    try
+    if( _error != MBError::NO_ERROR )
     {
-        std::map<std::string,ModbusDevice*>::iterator _it = this->devices.find( deviceId );
+        throw MBError::toString( _error );
+    }
 
-        if( _it == this->devices.end() )
-        {
-            throw std::string( "bad_device" );
-        }
-        else
-        {
-            std::pair<std::string,ModbusDevice*> _p = *_it;
-            ModbusDevice* _d = _p.second;
+    return _word;
+}
 
-            this->driverMutex.unlock();
-            return _d->readPort();
-        }
+void ModbusDriver::writeWord( std::string deviceId,
+                              std::string blockId,
+                              int nReg,
+                              uint16 word ) throw( std::string )
+{
+    MBError::Code _error = this->tryWriteWord( SymbolTable::find( deviceId ), SymbolTable::find( blockId ), nReg, word );
+
+    if( _error != MBError::NO_ERROR )
+    {
+        throw MBError::toString( _error );
     }
-    catch( std::string ex )
+}
+
+MBError::Code ModbusDriver::tryDemand( Symbol deviceId,
+                                       Symbol blockId,
+                                       int lease )
+{
+    std::shared_ptr<const DeviceTable> _devices = std::atomic_load( &this->devices );
+    DeviceTable::const_iterator _it = _devices->find( deviceId );
+
+    if( _it == _devices->end() )
     {
-        this->driverMutex.unlock();
-        throw std::string( ex );
+        return MBError::BAD_DEVICE;
     }
+
+    return _it->second->demand( blockId, lease );
 }
 
-int ModbusDriver::readDeviceSlaveId( std::string deviceId ) throw( std::string )
+void ModbusDriver::doWrite()
 {
-    this->driverMutex.lock();
+    std::shared_ptr<const DeviceTable> _devices = std::atomic_load( &this->devices );
 
-    try
+    DeviceTable::const_iterator _it = _devices->begin();
+    for( ; _it != _devices->end(); _it++ )
     {
-        std::map<std::string,ModbusDevice*>::iterator _it = this->devices.find( deviceId );
+        _it->second->doWrite();
+    }
+}
 
-        if( _it == this->devices.end() )
-        {
-            throw std::string( "bad_device" );
-        }
-        else
-        {
-            std::pair<std::string,ModbusDevice*> _p = *_it;
-            ModbusDevice* _d = _p.second;
+bool ModbusDriver::readBlockImage( const std::string& deviceId, const std::string& blockId, std::vector<uint16>& image )
+{
+    std::shared_ptr<ModbusDevice> _d = this->find_device( deviceId );
 
-            this->driverMutex.unlock();
-            return _d->readSlaveId();
-        }
+    return _d && _d->readBlockImage( blockId, image );
+}
+
+bool ModbusDriver::restoreBlockImage( const std::string& deviceId, const std::string& blockId, const std::vector<uint16>& image )
+{
+    std::shared_ptr<ModbusDevice> _d = this->find_device( deviceId );
+
+    return _d && _d->restoreBlockImage( blockId, image );
+}
+
+std::vector<std::string> ModbusDriver::getAllDeviceId()
+{
+    std::shared_ptr<const DeviceTable> _devices = std::atomic_load( &this->devices );
+
+    std::vector<std::string> _device_ids;
+
+    // get all device id
+    for( DeviceTable::const_iterator _it = _devices->begin();
+        _it != _devices->end(); _it++ ) {
+        _device_ids.push_back( SymbolTable::name( _it->first ) );
     }
-    catch( std::string ex )
+
+    return _device_ids;
+}
+
+std::vector<std::string> ModbusDriver::getAllBlockId( std::string deviceId ) throw( std::string )
+{
+    std::shared_ptr<ModbusDevice> _d = this->find_device( deviceId );
+
+    if( !_d )
     {
-        this->driverMutex.unlock();
-        throw std::string( ex );
+        throw std::string( "bad_device" );
     }
+
+    return _d->getAllBlockId();
 }
 
-int ModbusDriver::readDeviceResponseTimeout( std::string deviceId ) throw( std::string )
+std::string ModbusDriver::readDeviceTransport( std::string deviceId ) throw( std::string )
 {
-    this->driverMutex.lock();
+    std::shared_ptr<ModbusDevice> _d = this->find_device( deviceId );
 
-    try
+    if( !_d )
     {
-        std::map<std::string,ModbusDevice*>::iterator _it = this->devices.find( deviceId );
+        throw std::string( "bad_device" );
+    }
 
-        if( _it == this->devices.end() )
-        {
-            throw std::string( "bad_device" );
-        }
-        else
-        {
-            std::pair<std::string,ModbusDevice*> _p = *_it;
-            ModbusDevice* _d = _p.second;
+    return _d->readTransport();
+}
 
-            this->driverMutex.unlock();
-            return _d->readResponseTimeout();
-        }
+std::string ModbusDriver::readDeviceIp( std::string deviceId ) throw( std::string )
+{
+    std::shared_ptr<ModbusDevice> _d = this->find_device( deviceId );
+
+    if( !_d )
+    {
+        throw std::string( "bad_device" );
     }
-    catch( std::string ex )
+
+    return _d->readIp();
+}
+
+int ModbusDriver::readDevicePort( std::string deviceId ) throw( std::string )
+{
+    std::shared_ptr<ModbusDevice> _d = this->find_device( deviceId );
+
+    if( !_d )
     {
-        this->driverMutex.unlock();
-        throw std::string( ex );
+        throw std::string( "bad_device" );
     }
+
+    return _d->readPort();
 }
 
-int ModbusDriver::readDeviceConnectionTimeout( std::string deviceId ) throw( std::string )
+int ModbusDriver::readDeviceSlaveId( std::string deviceId ) throw( std::string )
 {
-    this->driverMutex.lock();
+    std::shared_ptr<ModbusDevice> _d = this->find_device( deviceId );
 
-    try
+    if( !_d )
     {
-        std::map<std::string,ModbusDevice*>::iterator _it = this->devices.find( deviceId );
+        throw std::string( "bad_device" );
+    }
 
-        if( _it == this->devices.end() )
-        {
-            throw std::string( "bad_device" );
-        }
-        else
-        {
-            std::pair<std::string,ModbusDevice*> _p = *_it;
-            ModbusDevice* _d = _p.second;
+    return _d->readSlaveId();
+}
 
-            this->driverMutex.unlock();
-            return _d->readConnectionTimeout();
-        }
+int ModbusDriver::readDeviceResponseTimeout( std::string deviceId ) throw( std::string )
+{
+    std::shared_ptr<ModbusDevice> _d = this->find_device( deviceId );
+
+    if( !_d )
+    {
+        throw std::string( "bad_device" );
     }
-    catch( std::string ex )
+
+    return _d->readResponseTimeout();
+}
+
+int ModbusDriver::readDeviceConnectionTimeout( std::string deviceId ) throw( std::string )
+{
+    std::shared_ptr<ModbusDevice> _d = this->find_device( deviceId );
+
+    if( !_d )
     {
-        this->driverMutex.unlock();
-        throw std::string( ex );
+        throw std::string( "bad_device" );
     }
+
+    return _d->readConnectionTimeout();
 }
 
 std::string ModbusDriver::readDeviceConnStatus( std::string deviceId ) throw( std::string )
 {
-    this->driverMutex.lock();
+    std::shared_ptr<ModbusDevice> _d = this->find_device( deviceId );
 
-    try
+    if( !_d )
     {
-        std::map<std::string,ModbusDevice*>::iterator _it = this->devices.find( deviceId );
+        throw std::string( "bad_device" );
+    }
 
-        if( _it == this->devices.end() )
-        {
-            throw std::string( "bad_device" );
-        }
-        else
-        {
-            std::pair<std::string,ModbusDevice*> _p = *_it;
-            ModbusDevice* _d = _p.second;
+    return _d->readConnStatus();
+}
 
-            this->driverMutex.unlock();
-            return _d->readConnStatus();
-        }
-    }
-    catch( std::string ex )
+std::string ModbusDriver::readDeviceCircuitState( std::string deviceId ) throw( std::string )
+{
+    std::shared_ptr<ModbusDevice> _d = this->find_device( deviceId );
+
+    if( !_d )
     {
-        this->driverMutex.unlock();
-        throw std::string( ex );
+        throw std::string( "bad_device" );
     }
+
+    return _d->readCircuitState();
 }
 
-int ModbusDriver::readBlockOffset( std::string deviceId, std::string blockId ) throw( std::string )
+unsigned long long ModbusDriver::readDeviceConnectFailures( std::string deviceId ) throw( std::string )
 {
-    this->driverMutex.lock();
+    std::shared_ptr<ModbusDevice> _d = this->find_device( deviceId );
 
-    try
+    if( !_d )
     {
-        std::map<std::string,ModbusDevice*>::iterator _it = this->devices.find( deviceId );
+        throw std::string( "bad_device" );
+    }
 
-        if( _it == this->devices.end() )
-        {
-            throw std::string( "bad_device" );
-        }
-        else
-        {
-            std::pair<std::string,ModbusDevice*> _p = *_it;
-            ModbusDevice* _d = _p.second;
+    return _d->readConnectFailures();
+}
 
-            this->driverMutex.unlock();
-            return _d->readBlockOffset( blockId );
-        }
+unsigned long long ModbusDriver::readDeviceConnects( std::string deviceId ) throw( std::string )
+{
+    std::shared_ptr<ModbusDevice> _d = this->find_device( deviceId );
+
+    if( !_d )
+    {
+        throw std::string( "bad_device" );
     }
-    catch( std::string ex )
+
+    return _d->readConnects();
+}
+
+long long ModbusDriver::readDeviceLastConnectTime( std::string deviceId ) throw( std::string )
+{
+    std::shared_ptr<ModbusDevice> _d = this->find_device( deviceId );
+
+    if( !_d )
     {
-        this->driverMutex.unlock();
-        throw std::string( ex );
+        throw std::string( "bad_device" );
     }
+
+    return _d->readLastConnectTime();
 }
 
-int ModbusDriver::readBlockCount( std::string deviceId, std::string blockId ) throw( std::string )
+long long ModbusDriver::readDeviceConnectTime( std::string deviceId ) throw( std::string )
 {
-    this->driverMutex.lock();
+    std::shared_ptr<ModbusDevice> _d = this->find_device( deviceId );
 
-    try
+    if( !_d )
     {
-        std::map<std::string,ModbusDevice*>::iterator _it = this->devices.find( deviceId );
+        throw std::string( "bad_device" );
+    }
 
-        if( _it == this->devices.end() )
-        {
-            throw std::string( "bad_device" );
-        }
-        else
-        {
-            std::pair<std::string,ModbusDevice*> _p = *_it;
-            ModbusDevice* _d = _p.second;
+    return _d->readConnectTime();
+}
 
-            this->driverMutex.unlock();
-            return _d->readBlockCount( blockId );
-        }
+int ModbusDriver::readBlockOffset( std::string deviceId, std::string blockId ) throw( std::string )
+{
+    std::shared_ptr<ModbusDevice> _d = this->find_device( deviceId );
+
+    if( !_d )
+    {
+        throw std::string( "bad_device" );
     }
-    catch( std::string ex )
+
+    return _d->readBlockOffset( blockId );
+}
+
+int ModbusDriver::readBlockCount( std::string deviceId, std::string blockId ) throw( std::string )
+{
+    std::shared_ptr<ModbusDevice> _d = this->find_device( deviceId );
+
+    if( !_d )
     {
-        this->driverMutex.unlock();
-        throw std::string( ex );
+        throw std::string( "bad_device" );
     }
+
+    return _d->readBlockCount( blockId );
 }
 
 int ModbusDriver::readBlockCycleTime( std::string deviceId, std::string blockId ) throw( std::string )
 {
-    this->driverMutex.lock();
+    std::shared_ptr<ModbusDevice> _d = this->find_device( deviceId );
 
-    try
+    if( !_d )
     {
-        std::map<std::string,ModbusDevice*>::iterator _it = this->devices.find( deviceId );
+        throw std::string( "bad_device" );
+    }
 
-        if( _it == this->devices.end() )
-        {
-            throw std::string( "bad_device" );
-        }
-        else
-        {
-            std::pair<std::string,ModbusDevice*> _p = *_it;
-            ModbusDevice* _d = _p.second;
+    return _d->readBlockCycleTime( blockId );
+}
 
-            this->driverMutex.unlock();
-            return _d->readBlockCycleTime( blockId );
-        }
+int ModbusDriver::readBlockRetries( std::string deviceId, std::string blockId ) throw( std::string )
+{
+    std::shared_ptr<ModbusDevice> _d = this->find_device( deviceId );
+
+    if( !_d )
+    {
+        throw std::string( "bad_device" );
     }
-    catch( std::string ex )
+
+    return _d->readBlockRetries( blockId );
+}
+
+unsigned long long ModbusDriver::readWriteLatencyBucket( int bucket )
+{
+    return this->writeLatency.readBucket( bucket );
+}
+
+StatusEvents* ModbusDriver::delegateStatusEvents()
+{
+    return &this->statusEvents;
+}
+
+unsigned long long ModbusDriver::readDeviceDeadlineMisses( std::string deviceId, int priority ) throw( std::string )
+{
+    std::shared_ptr<ModbusDevice> _d = this->find_device( deviceId );
+
+    if( !_d )
     {
-        this->driverMutex.unlock();
-        throw std::string( ex );
+        throw std::string( "bad_device" );
     }
+
+    return _d->readDeadlineMisses( priority );
 }
 
-int ModbusDriver::readBlockRetries( std::string deviceId, std::string blockId ) throw( std::string )
+long long ModbusDriver::readDeviceUptime( std::string deviceId ) throw( std::string )
 {
-    this->driverMutex.lock();
+    std::shared_ptr<ModbusDevice> _d = this->find_device( deviceId );
 
-    try
+    if( !_d )
     {
-        std::map<std::string,ModbusDevice*>::iterator _it = this->devices.find( deviceId );
+        throw std::string( "bad_device" );
+    }
 
-        if( _it == this->devices.end() )
-        {
-            throw std::string( "bad_device" );
-        }
-        else
-        {
-            std::pair<std::string,ModbusDevice*> _p = *_it;
-            ModbusDevice* _d = _p.second;
+    return _d->readUptime();
+}
 
-            this->driverMutex.unlock();
-            return _d->readBlockRetries( blockId );
-        }
+std::string ModbusDriver::readBlockPriority( std::string deviceId, std::string blockId ) throw( std::string )
+{
+    std::shared_ptr<ModbusDevice> _d = this->find_device( deviceId );
+
+    if( !_d )
+    {
+        throw std::string( "bad_device" );
     }
-    catch( std::string ex )
+
+    return _d->readBlockPriority( blockId );
+}
+
+std::string ModbusDriver::readBlockArea( std::string deviceId, std::string blockId ) throw( std::string )
+{
+    std::shared_ptr<ModbusDevice> _d = this->find_device( deviceId );
+
+    if( !_d )
     {
-        this->driverMutex.unlock();
-        throw std::string( ex );
+        throw std::string( "bad_device" );
     }
+
+    return _d->readBlockArea( blockId );
 }
 
 std::string ModbusDriver::readBlockError( std::string deviceId, std::string blockId ) throw( std::string )
 {
-    this->driverMutex.lock();
+    std::shared_ptr<ModbusDevice> _d = this->find_device( deviceId );
 
-    try
+    if( !_d )
     {
-        std::map<std::string,ModbusDevice*>::iterator _it = this->devices.find( deviceId );
+        throw std::string( "bad_device" );
+    }
 
-        if( _it == this->devices.end() )
-        {
-            throw std::string( "bad_device" );
-        }
-        else
-        {
-            std::pair<std::string,ModbusDevice*> _p = *_it;
-            ModbusDevice* _d = _p.second;
+    return _d->readBlockError( blockId );
+}
 
-            this->driverMutex.unlock();
-            return _d->readBlockError( blockId );
-        }
+std::string ModbusDriver::readBlockErrorCategory( std::string deviceId, std::string blockId ) throw( std::string )
+{
+    std::shared_ptr<ModbusDevice> _d = this->find_device( deviceId );
+
+    if( !_d )
+    {
+        throw std::string( "bad_device" );
     }
-    catch( std::string ex )
+
+    return _d->readBlockErrorCategory( blockId );
+}
+
+void ModbusDriver::readBlockStats( std::string deviceId, std::string blockId, BlockStats& stats ) throw( std::string )
+{
+    std::shared_ptr<ModbusDevice> _d = this->find_device( deviceId );
+
+    if( !_d )
     {
-        this->driverMutex.unlock();
-        throw std::string( ex );
+        throw std::string( "bad_device" );
     }
+
+    _d->readBlockStats( blockId, stats );
 }
 
 } // namespace ModbusEngine
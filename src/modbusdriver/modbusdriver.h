@@ -1,9 +1,13 @@
 #ifndef MODBUSDRIVER_H
 #define MODBUSDRIVER_H
 
+#include <memory>
+
 #include "modbusdevice.h"
 #include "modbusdriverdatainterface.h"
 #include "modbusdrivermonitorinterface.h"
+#include "../Core/mbline.h"
+#include "../Core/metrics.h"
 #include "../mbpro.h"
 
 namespace ModbusEngine
@@ -16,11 +20,22 @@ namespace ModbusEngine
  *   - stores ModbusDevices
  *   - multithread design
  *   - build function for add ModbusDevices
+ *   - the rtu devices on the same line share the line and its arbiter
+ *   - the tcp devices on the same ip:port share one gateway connection
+ *   - hot reload: reload() diffs a new project against the running one,
+ *     only the added, removed and changed devices and blocks are touched
+ *   - the device table is swapped as a whole ( copy on write ), the readers
+ *     take a snapshot without locking and keep its devices alive
+ *   - the blocks publish their status transitions ( delegateStatusEvents() )
+ *   - the read requests of the blocks are planned by the rates of their tags
+ *     ( PollPlanner ), a reload replans the running blocks too
+ *   - the on-demand blocks are polled while a client is interested ( tryDemand() )
  *
  * Usage:
  *
  * 1. Create instance
  * 2. Call startBlockThreads()
+ * 3. Call reload() with the new project when the mbpro file changed
  */
 
 class ModbusDriver :
@@ -28,13 +43,62 @@ class ModbusDriver :
         public ModbusDriverMonitorInterface
 {
 
+public:
+    /// the devices by the symbol of the device id
+    typedef std::map<Symbol,std::shared_ptr<ModbusDevice> > DeviceTable;
+
 private:
+    /// max millisecs of waiting for the threads of the retired blocks
+    static const int RETIRE_WAIT = 1000;
+
     /// Delivered mbpro file
     MBPro* mbpro;
-    /// Map where we stores devices
-    std::map<std::string,ModbusDevice*> devices;
-    /// Required mutex for multi thread design
+    /// Map where we stores devices ( read and swapped by std::atomic_load/store )
+    std::shared_ptr<const DeviceTable> devices;
+    /// The shared lines (rtu lines, tcp gateways) by serial port or ip:port
+    std::map<std::string,MBLine*> lines;
+    /// The parameters of the lines at their creation ( kept while a device uses the line )
+    std::map<std::string,std::string> lineParameters;
+    /// The request arbiters by connection (device id or line)
+    std::map<std::string,RequestArbiter*> arbiters;
+    /// Serializes startBlockThreads() and reload(), the readers do not lock
     std::mutex driverMutex;
+    /// The retired blocks and devices still running after RETIRE_WAIT ( a connect,
+    /// an RTU transaction ), kept alive until their threads stop
+    std::vector<std::shared_ptr<ModbusBlock> > retiringBlocks;
+    std::vector<std::shared_ptr<ModbusDevice> > retiringDevices;
+    /// the block threads are started
+    bool started;
+    /// End-to-end write latency of all blocks (lock-free)
+    Histogram writeLatency;
+    /// The status transitions of all blocks (lock-free publish)
+    StatusEvents statusEvents;
+    /// Delivered metrics registry
+    MetricsRegistry* metrics;
+    /// The registers and rates of the tags by device and block ( build_spans() )
+    std::map<std::pair<Symbol,Symbol>,std::vector<PollSpan> > tagSpans;
+
+    /**
+     * @brief build_spans
+     *
+     * Collects the registers and the rates of the tags of the project.
+     */
+    void build_spans();
+
+    /**
+     * @brief plan_block
+     * @param deviceId  -> id of the device
+     * @param b         -> the block parameters
+     * @return the read requests of the block
+     */
+    std::vector<PollRequest> plan_block( const std::string& deviceId, const MBPro_Driver_Block& b );
+
+    /**
+     * @brief replan_blocks
+     *
+     * Sets the plans of the running blocks after a reload.
+     */
+    void replan_blocks();
 
     /**
      * @brief build
@@ -44,22 +108,108 @@ private:
     void build_the_tree();
 
     /**
-     * @brief add_modbus_device
-     * @param deviceId  -> device id
-     * @param device    -> the device
+     * @brief create_connection
+     * @param d         -> the device parameters
+     * @param arbiter   -> the arbiter of the connection (out)
+     * @return the new connection of the device
+     *
+     * Helper function for build_the_tree(). Creates the shared line
+     * and the arbiter at the first use.
+     */
+    MBMasterConnection* create_connection( MBPro_Driver_Device& d, RequestArbiter** arbiter );
+
+    /**
+     * @brief create_device
+     * @param d -> the device parameters
+     * @return the new device with its blocks, the threads are not started
+     */
+    std::shared_ptr<ModbusDevice> create_device( MBPro_Driver_Device d );
+
+    /**
+     * @brief create_block
+     * @param device    -> the device of the block
+     * @param deviceId  -> id of the device
+     * @param b         -> the block parameters
+     * @return the new block, its metrics are registered
+     */
+    ModbusBlock* create_block( ModbusDevice* device, const std::string& deviceId, const MBPro_Driver_Block& b );
+
+    /**
+     * @brief find_device
+     * @param deviceId -> device id
+     * @return the device, empty when the id is unknown
+     */
+    std::shared_ptr<ModbusDevice> find_device( const std::string& deviceId );
+
+    /**
+     * @brief retire
+     * @param blocks  -> blocks already removed from the tables
+     * @param devices -> devices already removed from the table
      *
-     *  Helper function for add device to devices map.
+     * Halts the blocks and waits RETIRE_WAIT at most for their threads
+     * ( reload() holds driverMutex on the main loop ), the blocks still
+     * running are released by a later reload. See release_retired().
      */
-    void add_modbus_device( std::string deviceId, ModbusDevice* device );
+    void retire( const std::vector<std::shared_ptr<ModbusBlock> >& blocks,
+                 const std::vector<std::shared_ptr<ModbusDevice> >& devices );
+
+    /**
+     * @brief release_retired
+     *
+     * Removes the metrics of the stopped retired blocks, disconnects the
+     * retired devices whose blocks all stopped and releases their arbiters
+     * and lines.
+     * The last snapshot holding a block ( device ) deletes it.
+     */
+    void release_retired();
+
+    /**
+     * @brief release_arbiter
+     * @param arbiter -> the arbiter of a released device
+     *
+     * Deletes the arbiter when no other device uses it.
+     */
+    void release_arbiter( RequestArbiter* arbiter );
+
+    /**
+     * @brief release_line
+     * @param line -> the line of a released device, NULL for a plain tcp device
+     *
+     * Closes and deletes the line when no other device uses it, a device
+     * added later on the port opens a new one with its parameters.
+     */
+    void release_line( MBLine* line );
+
+    /**
+     * @brief same_device
+     * @return the connection parameters of the devices are equal ( the blocks are not compared )
+     */
+    static bool same_device( const MBPro_Driver_Device& a, const MBPro_Driver_Device& b );
+
+    /**
+     * @brief same_block
+     * @return the parameters of the blocks are equal
+     */
+    static bool same_block( const MBPro_Driver_Block& a, const MBPro_Driver_Block& b );
+
+    /**
+     * @brief is_gateway_device
+     * @param d     -> the device parameters
+     * @param mbpro -> the project of the device
+     * @return the device shares its ip:port with other tcp devices
+     */
+    static bool is_gateway_device( const MBPro_Driver_Device& d, MBPro* mbpro );
 
 public:
     /**
      * @brief ModbusDriver
-     * @param mbpro -> delivered mbpro file
+     * @param mbpro     -> delivered mbpro file
+     * @param metrics   -> delivered metrics registry
      *
-     * Creates full object.
+     * Creates full object and adds the metrics of the connections
+     * and the blocks to the registry.
      */
-    ModbusDriver( MBPro* mbpro );
+    ModbusDriver( MBPro* mbpro, MetricsRegistry* metrics );
 
     /**
      * @brief startBlockThreads
@@ -68,6 +218,19 @@ public:
      */
     void startBlockThreads();
 
+    /**
+     * @brief reload
+     * @param mbpro -> the new project, the driver uses it from now on
+     *
+     * Applies the changes of the driver section. The unchanged devices and
+     * blocks keep polling; the removed and changed ones are swapped out of
+     * the tables and halted ( RETIRE_WAIT at most, see retire() ), then the
+     * new and changed ones are built, started and swapped in. A changed
+     * device is rebuilt with its blocks.
+     * The parameters of a shared line are kept while a device uses it.
+     */
+    void reload( MBPro* mbpro );
+
     /**
      * @brief readBit
      * @param deviceId  -> device id
@@ -76,13 +239,15 @@ public:
      * @param nBit      -> bit position (bit offset inside register)
      * @return the stored value
      *
-     * The function throws std::string exception when error happens:
+     * Compatibility function of the status variant, it throws
+     * the name of the error code ( see MBError::toString() ):
      *
      *      "bad_device"        -> bad device id
      *      "bad_block"         -> bad block id
      *      "bad_register"      -> bad register address
      *      "bad_bit_number"    -> bad bit address
      *      "block_error"       -> block communication error
+     *      "write_queue_full"  -> too many pending writes
      */
     bool readBit( std::string deviceId, std::string blockId, int nReg, int nBit ) throw( std::string );
 
@@ -94,13 +259,16 @@ public:
      * @param nBit      -> bit position (bit offset inside register)
      * @param bit       -> the value to write
      *
-     * The function throws std::string exception when error happens:
+     * Compatibility function of the status variant, it throws
+     * the name of the error code ( see MBError::toString() ):
      *
      *      "bad_device"        -> bad device id
      *      "bad_block"         -> bad block id
      *      "bad_register"      -> bad register address
      *      "bad_bit_number"    -> bad bit address
      *      "block_error"       -> block communication error
+     *      "read_only_area"    -> discrete input or input register block
+     *      "write_queue_full"  -> too many pending writes
      */
     void writeBit( std::string deviceId, std::string blockId, int nReg, int nBit, bool bit ) throw( std::string );
 
@@ -112,12 +280,15 @@ public:
      * @param nByte     -> byte position (byte offset inside register)
      * @return the stored value
      *
-     * The function throws std::string exception when error happens:
+     * Compatibility function of the status variant, it throws
+     * the name of the error code ( see MBError::toString() ):
      *
      *      "bad_device"        -> bad device id
      *      "bad_block"         -> bad block id
      *      "bad_register"      -> bad register address
      *      "block_error"       -> block communication error
+     *      "bad_area"          -> coil or discrete input block
+     *      "write_queue_full"  -> too many pending writes
      */
     uint8 readByte( std::string deviceId, std::string blockId, int nReg, int nByte ) throw( std::string );
 
@@ -129,12 +300,16 @@ public:
      * @param nByte     -> byte position (byte offset inside register)
      * @return the stored value
      *
-     * The function throws std::string exception when error happens:
+     * Compatibility function of the status variant, it throws
+     * the name of the error code ( see MBError::toString() ):
      *
      *      "bad_device"        -> bad device id
      *      "bad_block"         -> bad block id
      *      "bad_register"      -> bad register address
      *      "block_error"       -> block communication error
+     *      "bad_area"          -> coil or discrete input block
+     *      "read_only_area"    -> input register block
+     *      "write_queue_full"  -> too many pending writes
      */
     void writeByte( std::string deviceId, std::string blockId, int nReg, int nByte, uint8 byte ) throw( std::string );
 
@@ -145,12 +320,15 @@ public:
      * @param nReg      -> register position (offset)
      * @return the stored value
      *
-     * The function throws std::string exception when error happens:
+     * Compatibility function of the status variant, it throws
+     * the name of the error code ( see MBError::toString() ):
      *
      *      "bad_device"        -> bad device id
      *      "bad_block"         -> bad block id
      *      "bad_register"      -> bad register address
      *      "block_error"       -> block communication error
+     *      "bad_area"          -> coil or discrete input block
+     *      "write_queue_full"  -> too many pending writes
      */
     uint16 readWord( std::string deviceId, std::string blockId, int nReg ) throw( std::string );
 
@@ -161,15 +339,119 @@ public:
      * @param nReg      -> register position (offset)
      * @param word      -> the value to write
      *
-     * The function throws std::string exception when error happens:
+     * Compatibility function of the status variant, it throws
+     * the name of the error code ( see MBError::toString() ):
      *
      *      "bad_device"        -> bad device id
      *      "bad_block"         -> bad block id
      *      "bad_register"      -> bad register address
      *      "block_error"       -> block communication error
+     *      "bad_area"          -> coil or discrete input block
+     *      "read_only_area"    -> input register block
+     *      "write_queue_full"  -> too many pending writes
      */
     void writeWord( std::string deviceId, std::string blockId, int nReg, uint16 word ) throw( std::string );
 
+    /**
+     * @brief tryReadBit
+     * @param deviceId  -> device id
+     * @param blockId   -> block id
+     * @param nReg      -> register position (offset)
+     * @param nBit      -> bit position (bit offset inside register)
+     * @param bit       -> the stored value
+     * @return error code, BAD_DEVICE or the codes of ModbusDevice::readBit()
+     */
+    MBError::Code tryReadBit( Symbol deviceId,
+                              Symbol blockId,
+                              int nReg,
+                              int nBit,
+                              bool& bit );
+
+    /**
+     * @brief tryWriteBit
+     * @param deviceId  -> device id
+     * @param blockId   -> block id
+     * @param nReg      -> register position (offset)
+     * @param nBit      -> bit position (bit offset inside register)
+     * @param bit       -> the value to write
+     * @return error code, BAD_DEVICE or the codes of ModbusDevice::writeBit()
+     */
+    MBError::Code tryWriteBit( Symbol deviceId,
+                               Symbol blockId,
+                               int nReg,
+                               int nBit,
+                               bool bit );
+
+    /**
+     * @brief tryReadByte
+     * @param deviceId  -> device id
+     * @param blockId   -> block id
+     * @param nReg      -> register position (offset)
+     * @param nByte     -> byte position (byte offset inside register)
+     * @param byte      -> the stored value
+     * @return error code, BAD_DEVICE or the codes of ModbusDevice::readByte()
+     */
+    MBError::Code tryReadByte( Symbol deviceId,
+                               Symbol blockId,
+                               int nReg,
+                               int nByte,
+                               uint8& byte );
+
+    /**
+     * @brief tryWriteByte
+     * @param deviceId  -> device id
+     * @param blockId   -> block id
+     * @param nReg      -> register position (offset)
+     * @param nByte     -> byte position (byte offset inside register)
+     * @param byte      -> the value to write
+     * @return error code, BAD_DEVICE or the codes of ModbusDevice::writeByte()
+     */
+    MBError::Code tryWriteByte( Symbol deviceId,
+                                Symbol blockId,
+                                int nReg,
+                                int nByte,
+                                uint8 byte );
+
+    /**
+     * @brief tryReadWord
+     * @param deviceId  -> device id
+     * @param blockId   -> block id
+     * @param nReg      -> register position (offset)
+     * @param word      -> the stored value
+     * @return error code, BAD_DEVICE or the codes of ModbusDevice::readWord()
+     */
+    MBError::Code tryReadWord( Symbol deviceId,
+                               Symbol blockId,
+                               int nReg,
+                               uint16& word );
+
+    /**
+     * @brief tryWriteWord
+     * @param deviceId  -> device id
+     * @param blockId   -> block id
+     * @param nReg      -> register position (offset)
+     * @param word      -> the value to write
+     * @return error code, BAD_DEVICE or the codes of ModbusDevice::writeWord()
+     */
+    MBError::Code tryWriteWord( Symbol deviceId,
+                                Symbol blockId,
+                                int nReg,
+                                uint16 word );
+
+    /**
+     * @brief tryDemand
+     * @param deviceId  -> device id
+     * @param blockId   -> block id
+     * @param lease     -> millisecs of the interest
+     * @return error code, BAD_DEVICE or the codes of ModbusDevice::demand()
+     *
+     * A client is interested in the block, an on-demand block is polled
+     * until the lease ends. The other blocks are always polled.
+     */
+    MBError::Code tryDemand( Symbol deviceId,
+                             Symbol blockId,
+                             int lease );
+
     /**
      * @brief doWrite
      *
@@ -177,6 +459,24 @@ public:
      */
     void doWrite();
 
+    /**
+     * @brief readBlockImage
+     * @param deviceId  -> device id
+     * @param blockId   -> block id
+     * @param image     -> the copy of the registers ( packed bits in bit areas )
+     * @return the block exists, it is healthy and the image is copied
+     */
+    bool readBlockImage( const std::string& deviceId, const std::string& blockId, std::vector<uint16>& image );
+
+    /**
+     * @brief restoreBlockImage
+     * @param deviceId  -> device id
+     * @param blockId   -> block id
+     * @param image     -> a saved image of the block
+     * @return the image is restored, the block serves it as STALE_DATA until its first poll
+     */
+    bool restoreBlockImage( const std::string& deviceId, const std::string& blockId, const std::vector<uint16>& image );
+
     /**
      * @brief getAllDeviceId
      * @return all device id in vector
@@ -194,10 +494,21 @@ public:
      */
     std::vector<std::string> getAllBlockId( std::string deviceId ) throw( std::string );
 
+    /**
+     * @brief readDeviceTransport
+     * @param deviceId
+     * @return device transport ("tcp", "rtu" or "rtu_over_tcp")
+     *
+     * The function throws std::string exception when error happens:
+     *
+     *      "bad_device" -> bad device id
+     */
+    std::string readDeviceTransport( std::string deviceId ) throw( std::string );
+
     /**
      * @brief readDeviceIp
      * @param deviceId
-     * @return device ip address
+     * @return device ip address (serial port for rtu)
      *
      * The function throws std::string exception when error happens:
      *
@@ -260,6 +571,97 @@ public:
      */
     std::string readDeviceConnStatus( std::string deviceId ) throw( std::string );
 
+    /**
+     * @brief readDeviceCircuitState
+     * @param deviceId
+     * @return circuit breaker state ("closed", "open" or "half_open")
+     *
+     * The function throws std::string exception when error happens:
+     *
+     *      "bad_device" -> bad device id
+     */
+    std::string readDeviceCircuitState( std::string deviceId ) throw( std::string );
+
+    /**
+     * @brief readDeviceConnectFailures
+     * @param deviceId
+     * @return number of failed connects of the device
+     *
+     * The function throws std::string exception when error happens:
+     *
+     *      "bad_device" -> bad device id
+     */
+    unsigned long long readDeviceConnectFailures( std::string deviceId ) throw( std::string );
+
+    /**
+     * @brief readDeviceConnects
+     * @param deviceId
+     * @return number of successful connects
+     *
+     * The function throws std::string exception when error happens:
+     *
+     *      "bad_device" -> bad device id
+     */
+    unsigned long long readDeviceConnects( std::string deviceId ) throw( std::string );
+
+    /**
+     * @brief readDeviceLastConnectTime
+     * @param deviceId
+     * @return duration of the last connect in microsecs
+     *
+     * The function throws std::string exception when error happens:
+     *
+     *      "bad_device" -> bad device id
+     */
+    long long readDeviceLastConnectTime( std::string deviceId ) throw( std::string );
+
+    /**
+     * @brief readDeviceConnectTime
+     * @param deviceId
+     * @return duration of all connects in microsecs
+     *
+     * The function throws std::string exception when error happens:
+     *
+     *      "bad_device" -> bad device id
+     */
+    long long readDeviceConnectTime( std::string deviceId ) throw( std::string );
+
+    /**
+     * @brief readDeviceDeadlineMisses
+     * @param deviceId
+     * @param priority
+     * @return number of deadline misses in the priority class of the device
+     *
+     * The function throws std::string exception when error happens:
+     *
+     *      "bad_device" -> bad device id
+     */
+    unsigned long long readDeviceDeadlineMisses( std::string deviceId, int priority ) throw( std::string );
+
+    /**
+     * @brief readDeviceUptime
+     * @param deviceId
+     * @return secs since the connection of the device is up, 0 when disconnected
+     *
+     * The function throws std::string exception when error happens:
+     *
+     *      "bad_device" -> bad device id
+     */
+    long long readDeviceUptime( std::string deviceId ) throw( std::string );
+
+    /**
+     * @brief readBlockArea
+     * @param deviceId
+     * @param blockId
+     * @return block data area name
+     *
+     * The function throws std::string exception when error happens:
+     *
+     *      "bad_device"    -> bad device id
+     *      "bad_block"     -> bad block id
+     */
+    std::string readBlockArea( std::string deviceId, std::string blockId ) throw( std::string );
+
     /**
      * @brief readBlockOffset
      * @param deviceId
@@ -312,6 +714,19 @@ public:
      */
     int readBlockRetries( std::string deviceId, std::string blockId ) throw( std::string );
 
+    /**
+     * @brief readBlockPriority
+     * @param deviceId
+     * @param blockId
+     * @return block priority class name
+     *
+     * The function throws std::string exception when error happens:
+     *
+     *      "bad_device"    -> bad device id
+     *      "bad_block"     -> bad block id
+     */
+    std::string readBlockPriority( std::string deviceId, std::string blockId ) throw( std::string );
+
     /**
      * @brief readBlockError
      * @param deviceId
@@ -325,6 +740,45 @@ public:
      */
     std::string readBlockError( std::string deviceId, std::string blockId ) throw( std::string );
 
+    /**
+     * @brief readBlockErrorCategory
+     * @param deviceId
+     * @param blockId
+     * @return category of the block error ( see MBError::Category )
+     *
+     * The function throws std::string exception when error happens:
+     *
+     *      "bad_device"    -> bad device id
+     *      "bad_block"     -> bad block id
+     */
+    std::string readBlockErrorCategory( std::string deviceId, std::string blockId ) throw( std::string );
+
+    /**
+     * @brief readBlockStats
+     * @param deviceId
+     * @param blockId
+     * @param stats -> the request statistics of the block
+     *
+     * The function throws std::string exception when error happens:
+     *
+     *      "bad_device"    -> bad device id
+     *      "bad_block"     -> bad block id
+     */
+    void readBlockStats( std::string deviceId, std::string blockId, BlockStats& stats ) throw( std::string );
+
+    /**
+     * @brief readWriteLatencyBucket
+     * @param bucket -> histogram bucket index ( see Histogram )
+     * @return number of writes finished within the bucket bound, measured from enqueue
+     */
+    unsigned long long readWriteLatencyBucket( int bucket );
+
+    /**
+     * @brief delegateStatusEvents
+     * @return the status transitions of the blocks and the connections
+     */
+    StatusEvents* delegateStatusEvents();
+
 };
 
 }
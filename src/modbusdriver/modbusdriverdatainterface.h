@@ -3,6 +3,8 @@
 
 #include <string>
 
+#include "../Core/mberror.h"
+#include "../Core/symboltable.h"
 #include "../Core/types.h"
 
 namespace ModbusEngine
@@ -13,6 +15,10 @@ namespace ModbusEngine
  *
  * Define the data interface of the modbus driver.
  *
+ * The functions returning MBError::Code are the polling path, they take
+ * the interned ids ( SymbolTable ). The throwing functions are the
+ * compatibility layer above them.
+ *
  * DO NOT ADD MORE DATATYPE SUPPORT HERE. IT'S A FUNDAMENTAL DESIGN IDEA.
  */
 
@@ -51,6 +57,44 @@ public:
                             int nReg,
                             uint16 word ) throw( std::string ) = 0;
 
+    MBError::Code virtual tryReadBit( Symbol deviceId,
+                                      Symbol blockId,
+                                      int nReg,
+                                      int nBit,
+                                      bool& bit ) = 0;
+
+    MBError::Code virtual tryWriteBit( Symbol deviceId,
+                                       Symbol blockId,
+                                       int nReg,
+                                       int nBit,
+                                       bool bit ) = 0;
+
+    MBError::Code virtual tryReadByte( Symbol deviceId,
+                                       Symbol blockId,
+                                       int nReg,
+                                       int nByte,
+                                       uint8& byte ) = 0;
+
+    MBError::Code virtual tryWriteByte( Symbol deviceId,
+                                        Symbol blockId,
+                                        int nReg,
+                                        int nByte,
+                                        uint8 byte ) = 0;
+
+    MBError::Code virtual tryReadWord( Symbol deviceId,
+                                       Symbol blockId,
+                                       int nReg,
+                                       uint16& word ) = 0;
+
+    MBError::Code virtual tryWriteWord( Symbol deviceId,
+                                        Symbol blockId,
+                                        int nReg,
+                                        uint16 word ) = 0;
+
+    MBError::Code virtual tryDemand( Symbol deviceId,
+                                     Symbol blockId,
+                                     int lease ) = 0;
+
     void virtual doWrite() = 0;
 
 };
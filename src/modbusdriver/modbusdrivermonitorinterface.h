@@ -4,6 +4,9 @@
 #include <vector>
 #include <string>
 
+#include "modbusblock.h"
+#include "statusevents.h"
+
 namespace ModbusEngine
 {
 
@@ -20,18 +23,34 @@ public:
     std::vector<std::string> virtual getAllDeviceId() = 0;
     std::vector<std::string> virtual getAllBlockId( std::string deviceId ) = 0;
 
+    std::string virtual readDeviceTransport( std::string deviceId ) = 0;
     std::string virtual readDeviceIp( std::string deviceId ) = 0;
     int virtual readDevicePort( std::string deviceId ) = 0;
     int virtual readDeviceSlaveId( std::string deviceId ) = 0;
     int virtual readDeviceResponseTimeout( std::string deviceId ) = 0;
     int virtual readDeviceConnectionTimeout( std::string deviceId ) = 0;
     std::string virtual readDeviceConnStatus( std::string deviceId ) = 0;
-
+    std::string virtual readDeviceCircuitState( std::string deviceId ) = 0;
+    unsigned long long virtual readDeviceConnectFailures( std::string deviceId ) = 0;
+    unsigned long long virtual readDeviceConnects( std::string deviceId ) = 0;
+    long long virtual readDeviceLastConnectTime( std::string deviceId ) = 0;
+    long long virtual readDeviceConnectTime( std::string deviceId ) = 0;
+    unsigned long long virtual readDeviceDeadlineMisses( std::string deviceId, int priority ) = 0;
+    long long virtual readDeviceUptime( std::string deviceId ) = 0;
+
+    std::string virtual readBlockArea( std::string deviceId, std::string blockId ) = 0;
     int virtual readBlockOffset( std::string deviceId, std::string blockId ) = 0;
     int virtual readBlockCount( std::string deviceId, std::string blockId ) = 0;
     int virtual readBlockCycleTime( std::string deviceId, std::string blockId ) = 0;
     int virtual readBlockRetries( std::string deviceId, std::string blockId ) = 0;
+    std::string virtual readBlockPriority( std::string deviceId, std::string blockId ) = 0;
     std::string virtual readBlockError( std::string deviceId, std::string blockId ) = 0;
+    std::string virtual readBlockErrorCategory( std::string deviceId, std::string blockId ) = 0;
+    void virtual readBlockStats( std::string deviceId, std::string blockId, BlockStats& stats ) = 0;
+
+    unsigned long long virtual readWriteLatencyBucket( int bucket ) = 0;
+
+    StatusEvents virtual *delegateStatusEvents() = 0;
 
 };
 
@@ -0,0 +1,137 @@
+#include <algorithm>
+#include <set>
+
+#include "pollplanner.h"
+
+namespace ModbusEngine
+{
+
+const int PollPlanner::MAX_GAP;
+const int PollPlanner::MAX_REGISTERS;
+
+/// the faster of two periods, 0 ( not cyclic ) is the slowest
+static int faster( int a, int b )
+{
+    if( a == 0 ) return b;
+    if( b == 0 ) return a;
+
+    return std::min( a, b );
+}
+
+/// the request of the units first..last ( unit: register or packed word )
+static PollRequest request( int first, int last, int unit, int count, int period )
+{
+    PollRequest _r;
+    _r.offset = first * unit;
+    _r.count = std::min( ( last + 1 ) * unit, count ) - _r.offset;
+    _r.period = period;
+
+    return _r;
+}
+
+std::vector<PollRequest> PollPlanner::plan( bool bitArea, int count, int cycleTime, const std::vector<PollSpan>& spans )
+{
+    std::vector<PollRequest> _plan;
+
+    bool _rated = false;
+    for( size_t i = 0; i < spans.size(); i++ )
+    {
+        if( spans[ i ].rate > 0 ) _rated = true;
+    }
+
+    /// the period of every unit ( a register, or a packed word of 16 bits ), -1 -> not read
+    int _unit = bitArea ? 16 : 1;
+    int _size = ( count + _unit - 1 ) / _unit;
+    std::vector<int> _periods( _size, -1 );
+
+    for( size_t i = 0; _rated && i < spans.size(); i++ )
+    {
+        int _period = spans[ i ].rate > 0 ? spans[ i ].rate : cycleTime;
+
+        for( int p = spans[ i ].position; p < spans[ i ].position + spans[ i ].width; p++ )
+        {
+            if( p < 0 || p >= count ) continue;
+
+            int& _u = _periods[ p / _unit ];
+            _u = ( _u == -1 ) ? _period : faster( _u, _period );
+        }
+    }
+
+    /// the fastest first, the not cyclic last
+    std::set<int> _rates;
+    for( int i = 0; i < _size; i++ )
+    {
+        if( _periods[ i ] > 0 ) _rates.insert( _periods[ i ] );
+    }
+
+    std::vector<int> _order( _rates.begin(), _rates.end() );
+    if( std::find( _periods.begin(), _periods.end(), 0 ) != _periods.end() )
+    {
+        _order.push_back( 0 );
+    }
+
+    for( size_t k = 0; k < _order.size(); k++ )
+    {
+        int _first = -1;
+        int _last = -1;
+
+        for( int i = 0; i < _size; i++ )
+        {
+            if( _periods[ i ] != _order[ k ] ) continue;
+
+            /// a long gap or a full request starts a new one
+            if( _first != -1 && ( i - _last - 1 > MAX_GAP || i - _first + 1 > MAX_REGISTERS ) )
+            {
+                _plan.push_back( request( _first, _last, _unit, count, _order[ k ] ) );
+                _first = -1;
+            }
+
+            if( _first == -1 ) _first = i;
+            _last = i;
+        }
+
+        if( _first != -1 )
+        {
+            _plan.push_back( request( _first, _last, _unit, count, _order[ k ] ) );
+        }
+    }
+
+    /// no rates ( or no tag inside the block ): the whole block
+    if( _plan.empty() )
+    {
+        PollRequest _r;
+        _r.offset = 0;
+        _r.count = count;
+        _r.period = cycleTime;
+        _plan.push_back( _r );
+    }
+
+    return _plan;
+}
+
+bool PollPlanner::samePlan( const std::vector<PollRequest>& a, const std::vector<PollRequest>& b )
+{
+    if( a.size() != b.size() ) return false;
+
+    for( size_t i = 0; i < a.size(); i++ )
+    {
+        if( a[ i ].offset != b[ i ].offset || a[ i ].count != b[ i ].count || a[ i ].period != b[ i ].period )
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int PollPlanner::tagWidth( const std::string& type )
+{
+    if( type == "dword" || type == "udword" )
+    {
+        return 2;
+    }
+
+    return 1;
+}
+
+}
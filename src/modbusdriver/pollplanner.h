@@ -0,0 +1,88 @@
+#ifndef POLLPLANNER_H
+#define POLLPLANNER_H
+
+#include <string>
+#include <vector>
+
+namespace ModbusEngine
+{
+
+/**
+ * @brief The PollSpan class
+ *
+ * The registers ( bits in bit areas ) of a tag and its desired rate.
+ */
+class PollSpan
+{
+public:
+    /// position in the block and number of registers
+    int position;
+    int width;
+    /// millisecs between two reads, 0 -> the cycletime of the block
+    int rate;
+};
+
+/**
+ * @brief The PollRequest class
+ *
+ * A read request of a block: a part of the block read in every period.
+ */
+class PollRequest
+{
+public:
+    /// position in the block and number of registers ( bits in bit areas )
+    int offset;
+    int count;
+    /// millisecs between two reads, 0 -> not read cyclically
+    int period;
+};
+
+/**
+ * @brief The PollPlanner class
+ *
+ * Derives the read requests of a block from the rates of its tags.
+ *
+ * A block without tag rates is read whole in every cycletime. Otherwise
+ * only the registers of the tags are read: every register belongs to
+ * the fastest rate requested for it, the registers of a rate are grouped
+ * into requests ( the gaps up to MAX_GAP are read with them, a request
+ * is MAX_REGISTERS long at most ). The requests of the bit areas are
+ * aligned to 16 bits, the packed words are copied into the block.
+ */
+class PollPlanner
+{
+
+public:
+    /// gap in registers ( 16 bit words in bit areas ) read instead of a new request
+    static const int MAX_GAP = 8;
+    /// max registers ( 16 bit words in bit areas ) of a read request
+    static const int MAX_REGISTERS = 125;
+
+    /**
+     * @brief plan
+     * @param bitArea   -> the block stores coils or discrete inputs
+     * @param count     -> registers ( bits ) of the block
+     * @param cycleTime -> cycletime of the block
+     * @param spans     -> the tags of the block
+     * @return the read requests, the fastest first
+     */
+    static std::vector<PollRequest> plan( bool bitArea, int count, int cycleTime, const std::vector<PollSpan>& spans );
+
+    /**
+     * @brief samePlan
+     * @return the requests are equal
+     */
+    static bool samePlan( const std::vector<PollRequest>& a, const std::vector<PollRequest>& b );
+
+    /**
+     * @brief tagWidth
+     * @param type -> tag type
+     * @return registers of the tag type
+     */
+    static int tagWidth( const std::string& type );
+
+};
+
+}
+
+#endif // POLLPLANNER_H
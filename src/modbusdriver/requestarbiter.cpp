@@ -0,0 +1,137 @@
+#include "requestarbiter.h"
+
+namespace ModbusEngine
+{
+
+RequestArbiter::RequestArbiter()
+{
+    this->busy = false;
+    this->nextTicket = 1;
+    this->granted = 0;
+
+    for( int i = 0; i < PRIORITY_NUM; i++ )
+    {
+        this->deadlineMisses[ i ] = 0;
+    }
+}
+
+void RequestArbiter::grant_next()
+{
+    if( this->waiters.empty() )
+    {
+        return;
+    }
+
+    std::chrono::steady_clock::time_point _now = std::chrono::steady_clock::now();
+    std::list<Waiter>::iterator _best = this->waiters.end();
+    long long _best_rank = 0;
+    std::chrono::steady_clock::time_point _best_deadline;
+
+    for( std::list<Waiter>::iterator _it = this->waiters.begin();
+         _it != this->waiters.end(); _it++ )
+    {
+        /// the oldest write wins
+        if( _it->write )
+        {
+            _best = _it;
+            break;
+        }
+
+        /// aged priority of the read, smaller is better
+        long long _waited = std::chrono::duration_cast<std::chrono::milliseconds>( _now - _it->since ).count();
+        long long _rank = _it->priority - _waited / AGING_TIME;
+
+        /// earliest deadline first inside the class
+        if( _best == this->waiters.end() ||
+            _rank < _best_rank ||
+            ( _rank == _best_rank && _it->deadline < _best_deadline ) )
+        {
+            _best = _it;
+            _best_rank = _rank;
+            _best_deadline = _it->deadline;
+        }
+    }
+
+    this->granted = _best->ticket;
+    this->busy = true;
+    this->waiters.erase( _best );
+}
+
+void RequestArbiter::acquire( int priority,
+                              bool write,
+                              std::chrono::steady_clock::time_point deadline )
+{
+    std::unique_lock<std::mutex> _lock( this->arbiterMutex );
+
+    Waiter _w;
+    _w.ticket = this->nextTicket++;
+    _w.priority = priority;
+    _w.write = write;
+    _w.since = std::chrono::steady_clock::now();
+    _w.deadline = deadline;
+    this->waiters.push_back( _w );
+
+    if( !this->busy )
+    {
+        this->grant_next();
+    }
+
+    while( this->granted != _w.ticket )
+    {
+        this->arbiterCond.wait( _lock );
+    }
+}
+
+void RequestArbiter::release()
+{
+    this->arbiterMutex.lock();
+    this->busy = false;
+    this->grant_next();
+    this->arbiterMutex.unlock();
+
+    this->arbiterCond.notify_all();
+}
+
+void RequestArbiter::reportDeadlineMiss( int priority )
+{
+    this->deadlineMisses[ priority ].fetch_add( 1, std::memory_order_relaxed );
+}
+
+unsigned long long RequestArbiter::readDeadlineMisses( int priority )
+{
+    return this->deadlineMisses[ priority ].load( std::memory_order_relaxed );
+}
+
+int RequestArbiter::toPriority( std::string name )
+{
+    if( name == "high" )
+    {
+        return PRIORITY_HIGH;
+    }
+    else if( name == "normal" )
+    {
+        return PRIORITY_NORMAL;
+    }
+    else if( name == "low" )
+    {
+        return PRIORITY_LOW;
+    }
+
+    return -1;
+}
+
+std::string RequestArbiter::toString( int priority )
+{
+    if( priority == PRIORITY_HIGH )
+    {
+        return std::string( "high" );
+    }
+    else if( priority == PRIORITY_LOW )
+    {
+        return std::string( "low" );
+    }
+
+    return std::string( "normal" );
+}
+
+} // namespace ModbusEngine
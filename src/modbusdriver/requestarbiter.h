@@ -0,0 +1,131 @@
+#ifndef REQUESTARBITER_H
+#define REQUESTARBITER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <list>
+#include <mutex>
+#include <string>
+
+namespace ModbusEngine
+{
+
+/**
+ * @brief The RequestArbiter class
+ *
+ * Grants the connection of a device, or a serial line shared by
+ * more devices, to one block at a time.
+ *
+ * Scheduling:
+ *   - waiting writes are always served first (in arrival order)
+ *   - reads are served by block priority class (high, normal, low)
+ *   - a waiting read climbs one class in every AGING_TIME millisecs,
+ *     so low priority reads can not starve
+ *   - inside a class the read with the earliest deadline goes first
+ *   - the next block is granted in release(), so the requests
+ *     follow each other without gaps
+ *
+ * Counts the deadline misses per priority class.
+ */
+
+class RequestArbiter
+{
+
+public:
+    /// block priority classes
+    static const int PRIORITY_HIGH = 0;
+    static const int PRIORITY_NORMAL = 1;
+    static const int PRIORITY_LOW = 2;
+    static const int PRIORITY_NUM = 3;
+
+    /// waiting time in millisecs for climbing one priority class
+    static const int AGING_TIME = 1000;
+
+private:
+    /// a block waiting for the connection
+    class Waiter
+    {
+    public:
+        unsigned long long ticket;
+        int priority;
+        bool write;
+        std::chrono::steady_clock::time_point since;
+        std::chrono::steady_clock::time_point deadline;
+    };
+
+    /// the connection is in use
+    bool busy;
+    /// the waiting blocks
+    std::list<Waiter> waiters;
+    /// ticket counter and the currently granted ticket
+    unsigned long long nextTicket;
+    unsigned long long granted;
+
+    /// deadline misses per priority class
+    std::atomic<unsigned long long> deadlineMisses[ PRIORITY_NUM ];
+
+    /// required mutex and condition variable for multi threading support
+    std::mutex arbiterMutex;
+    std::condition_variable arbiterCond;
+
+    /**
+     * @brief grant_next
+     *
+     * Chooses the next waiter and grants the connection to it.
+     * Called with locked arbiterMutex.
+     */
+    void grant_next();
+
+public:
+    RequestArbiter();
+
+    /**
+     * @brief acquire
+     * @param priority  -> priority class of the block
+     * @param write     -> the block wants to write
+     * @param deadline  -> the request must be done until this
+     *
+     * Blocks until the connection is granted to the caller.
+     */
+    void acquire( int priority, bool write, std::chrono::steady_clock::time_point deadline );
+
+    /**
+     * @brief release
+     *
+     * Gives back the connection.
+     */
+    void release();
+
+    /**
+     * @brief reportDeadlineMiss
+     * @param priority -> priority class of the late block
+     */
+    void reportDeadlineMiss( int priority );
+
+    /**
+     * @brief readDeadlineMisses
+     * @param priority -> priority class
+     * @return number of deadline misses in the class
+     */
+    unsigned long long readDeadlineMisses( int priority );
+
+    /**
+     * @brief toPriority
+     * @param name -> "high", "normal" or "low"
+     * @return the priority class, -1 when the name is unknown
+     */
+    static int toPriority( std::string name );
+
+    /**
+     * @brief toString
+     * @param priority -> priority class
+     * @return the name of the priority class
+     */
+    static std::string toString( int priority );
+
+};
+
+} // namespace ModbusEngine
+
+#endif // REQUESTARBITER_H
@@ -0,0 +1,60 @@
+#include <chrono>
+
+#include "statusevents.h"
+
+namespace ModbusEngine
+{
+
+const int StatusEvent::TYPE_BLOCK;
+const int StatusEvent::TYPE_DEVICE;
+const int StatusEvents::QUEUE_SIZE;
+
+StatusEvents::StatusEvents() : queue( QUEUE_SIZE )
+{
+    this->overflow = false;
+    this->pending = false;
+}
+
+void StatusEvents::publish( int type, Symbol deviceId, Symbol blockId )
+{
+    StatusEvent _event;
+    _event.type = type;
+    _event.deviceId = deviceId;
+    _event.blockId = blockId;
+
+    if( !this->queue.push( _event ) )
+    {
+        this->overflow = true;
+    }
+
+    /// the transitions are rare, the lock does not hurt the polling
+    {
+        std::lock_guard<std::mutex> _lock( this->waitMutex );
+        this->pending = true;
+    }
+    this->waitCond.notify_one();
+}
+
+bool StatusEvents::pop( StatusEvent& event )
+{
+    return this->queue.pop( event );
+}
+
+bool StatusEvents::takeOverflow()
+{
+    return this->overflow.exchange( false );
+}
+
+void StatusEvents::wait( int millisecs )
+{
+    std::unique_lock<std::mutex> _lock( this->waitMutex );
+
+    if( !this->pending )
+    {
+        this->waitCond.wait_for( _lock, std::chrono::milliseconds( millisecs ) );
+    }
+
+    this->pending = false;
+}
+
+}
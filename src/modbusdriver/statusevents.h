@@ -0,0 +1,95 @@
+#ifndef STATUSEVENTS_H
+#define STATUSEVENTS_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+
+#include "../Core/mpscqueue.hpp"
+#include "../Core/symboltable.h"
+
+namespace ModbusEngine
+{
+
+/**
+ * @brief The StatusEvent class
+ *
+ * A status transition: the error of a block or the connection of a device
+ * changed. It carries the ids only, the consumer reads the new status.
+ */
+class StatusEvent
+{
+
+public:
+    /// the error code of the block changed
+    static const int TYPE_BLOCK = 0;
+    /// the connection, the circuit or the connect counters of the device changed
+    static const int TYPE_DEVICE = 1;
+
+    int type;
+    Symbol deviceId;
+    Symbol blockId;
+
+};
+
+/**
+ * @brief The StatusEvents class
+ *
+ * The status transitions of the blocks and the connections, published by
+ * the block threads into a lock-free MPSCQueue and consumed by one thread
+ * ( the monitor synchronizer ). The publishers do not wait: a full queue
+ * sets the overflow flag, the consumer then refreshes everything once.
+ */
+class StatusEvents
+{
+
+private:
+    static const int QUEUE_SIZE = 4096;
+
+    MPSCQueue<StatusEvent> queue;
+    std::atomic<bool> overflow;
+
+    /// wakes up the consumer
+    std::mutex waitMutex;
+    std::condition_variable waitCond;
+    bool pending;
+
+public:
+    StatusEvents();
+
+    /**
+     * @brief publish
+     * @param type      -> StatusEvent::TYPE_BLOCK or TYPE_DEVICE
+     * @param deviceId  -> the device
+     * @param blockId   -> the block, SymbolTable::NONE for a device event
+     *
+     * Can be called from any thread.
+     */
+    void publish( int type, Symbol deviceId, Symbol blockId );
+
+    /**
+     * @brief pop
+     * @param event -> the next event
+     * @return false when there is no event ( consumer thread only )
+     */
+    bool pop( StatusEvent& event );
+
+    /**
+     * @brief takeOverflow
+     * @return events were lost since the last call, the flag is cleared
+     */
+    bool takeOverflow();
+
+    /**
+     * @brief wait
+     * @param millisecs -> the max wait
+     *
+     * Waits for a publish() ( consumer thread only ).
+     */
+    void wait( int millisecs );
+
+};
+
+}
+
+#endif // STATUSEVENTS_H
@@ -12,31 +12,58 @@ CONFIG -= qt
 ##############################################
 
 # Core headers
+HEADERS += core/arena.hpp
 HEADERS += core/conversion.hpp
+HEADERS += core/histogram.hpp
+HEADERS += core/logger.h
+HEADERS += core/mberror.h
+HEADERS += core/mbline.h
+HEADERS += core/mblinemasterconnection.h
+HEADERS += core/mbmasterconnection.h
+HEADERS += core/mbrtubus.h
+HEADERS += core/mbtcpline.h
 HEADERS += core/mbtcpmasterconnection.h
+HEADERS += core/metrics.h
+HEADERS += core/metricsserver.h
+HEADERS += core/modbuspdu.h
+HEADERS += core/mpscqueue.hpp
 HEADERS += core/networktester.hpp
+HEADERS += core/symboltable.h
 HEADERS += core/thread.hpp
+HEADERS += core/trace.h
 HEADERS += core/types.h
 
 # Modbus Driver modul headers
+HEADERS += modbusdriver/circuitbreaker.h
 HEADERS += modbusdriver/modbusblock.h
+HEADERS += modbusdriver/pollplanner.h
 HEADERS += modbusdriver/modbusdevice.h
 HEADERS += modbusdriver/modbusdriver.h
 HEADERS += modbusdriver/modbusdriverdatainterface.h
 HEADERS += modbusdriver/modbusdrivermonitorinterface.h
+HEADERS += modbusdriver/requestarbiter.h
+HEADERS += modbusdriver/statusevents.h
 
 # Tag Synchronizer modul headers
 HEADERS += tagsynchronizer/bittag.h
 HEADERS += tagsynchronizer/bytetag.h
 HEADERS += tagsynchronizer/dwordtag.h
 HEADERS += tagsynchronizer/real16tag.h
+HEADERS += tagsynchronizer/sqltagsink.h
 HEADERS += tagsynchronizer/tag.h
+HEADERS += tagsynchronizer/tagsink.h
 HEADERS += tagsynchronizer/tagsynchronizer.h
 HEADERS += tagsynchronizer/ubytetag.h
 HEADERS += tagsynchronizer/udwordtag.h
 HEADERS += tagsynchronizer/uwordtag.h
 HEADERS += tagsynchronizer/wordtag.h
 
+# Simulator modul headers
+HEADERS += simulator/benchmark.h
+HEADERS += simulator/rtuslavesimulator.h
+HEADERS += simulator/simulatedslave.h
+HEADERS += simulator/tcpslavefarm.h
+
 # SQL Driver modul headers
 HEADERS += sqldriver/mysqldriver.h
 HEADERS += sqldriver/sqldriver.h
@@ -49,31 +76,55 @@ HEADERS += monitorsynchronizer/monitorsynchronizer.h
 # mbpro file and engine headers
 HEADERS += engine.h
 HEADERS += mbpro.h
+HEADERS += mbprocache.h
+HEADERS += statefile.h
 
 ##############################################
 # project source files
 ##############################################
 
 # Core source files
+SOURCES += core/logger.cpp
+SOURCES += core/mberror.cpp
+SOURCES += core/mblinemasterconnection.cpp
+SOURCES += core/mbrtubus.cpp
+SOURCES += core/mbtcpline.cpp
 SOURCES += core/mbtcpmasterconnection.cpp
+SOURCES += core/metrics.cpp
+SOURCES += core/metricsserver.cpp
+SOURCES += core/modbuspdu.cpp
+SOURCES += core/symboltable.cpp
+SOURCES += core/trace.cpp
 
 # Modbus Driver modul sources
+SOURCES += modbusdriver/circuitbreaker.cpp
 SOURCES += modbusdriver/modbusblock.cpp
+SOURCES += modbusdriver/pollplanner.cpp
 SOURCES += modbusdriver/modbusdevice.cpp
 SOURCES += modbusdriver/modbusdriver.cpp
+SOURCES += modbusdriver/requestarbiter.cpp
+SOURCES += modbusdriver/statusevents.cpp
 
 # Tag Synchronizer modul sources
 SOURCES += tagsynchronizer/bittag.cpp
 SOURCES += tagsynchronizer/bytetag.cpp
 SOURCES += tagsynchronizer/dwordtag.cpp
 SOURCES += tagsynchronizer/real16tag.cpp
+SOURCES += tagsynchronizer/sqltagsink.cpp
 SOURCES += tagsynchronizer/tag.cpp
+SOURCES += tagsynchronizer/tagsink.cpp
 SOURCES += tagsynchronizer/tagsynchronizer.cpp
 SOURCES += tagsynchronizer/ubytetag.cpp
 SOURCES += tagsynchronizer/udwordtag.cpp
 SOURCES += tagsynchronizer/uwordtag.cpp
 SOURCES += tagsynchronizer/wordtag.cpp
 
+# Simulator modul sources
+SOURCES += simulator/benchmark.cpp
+SOURCES += simulator/rtuslavesimulator.cpp
+SOURCES += simulator/simulatedslave.cpp
+SOURCES += simulator/tcpslavefarm.cpp
+
 # SQL Driver modul sources
 SOURCES += sqldriver/mysqldriver.cpp
 
@@ -83,6 +134,8 @@ SOURCES += monitorsynchronizer/monitorsynchronizer.cpp
 # mbpro and engine sources and the main
 SOURCES += engine.cpp
 SOURCES += mbpro.cpp
+SOURCES += mbprocache.cpp
+SOURCES += statefile.cpp
 SOURCES += main.cpp
 
 ##############################################
@@ -1,17 +1,58 @@
+#include <algorithm>
+#include <chrono>
 #include <sstream>
 
 #include "monitorsynchronizer.h"
 #include "../Core/conversion.hpp"
+#include "../Core/histogram.hpp"
+#include "../ModbusDriver/requestarbiter.h"
 
 namespace ModbusEngine {
 
+/// p99 round-trip time of the requests between two snapshots, -1 without requests
+static long long window_p99( const BlockStats& now, const BlockStats& last )
+{
+    unsigned long long _total = now.rttCount - last.rttCount;
+
+    if( _total == 0 ) return -1;
+
+    /// the first bucket with 99% of the requests
+    unsigned long long _rank = ( _total * 99 + 99 ) / 100;
+    int i = 0;
+    while( i < Histogram::BUCKET_NUM - 1 && now.rttBuckets[ i ] - last.rttBuckets[ i ] < _rank )
+    {
+        i++;
+    }
+
+    /// the +Inf bucket is shown as its lower bound
+    if( i == Histogram::BUCKET_NUM - 1 )
+    {
+        i--;
+    }
+
+    return Histogram::readBound( i );
+}
+
 MonitorSynchronizer::MonitorSynchronizer( MBPro* mbpro,
-                                          ModbusDriverMonitorInterface* monitorInterface )
+                                          ModbusDriverMonitorInterface* monitorInterface,
+                                          MetricsRegistry* metrics )
                                           throw( std::string )
 {
     this->monitorInterface = monitorInterface;
+    this->statusEvents = monitorInterface->delegateStatusEvents();
     this->mbpro = mbpro;
     this->cycleTime = 500;
+    this->statsPeriod = mbpro->monitor.statsPeriod;
+    this->countersRefresh = std::chrono::steady_clock::now();
+    this->statsRefresh = this->countersRefresh;
+
+    /// register the metrics
+    metrics->addHistogram( "monitor_refresh_duration_seconds",
+                           "Duration of refreshing the monitor tables.", "", &this->refreshDuration );
+    metrics->addCounter( "monitor_refreshes_total",
+                         "Refresh cycles of the monitor tables.", "", &this->refreshes );
+    metrics->addCounter( "monitor_db_errors_total",
+                         "Failed database cycles of the monitor synchronizer.", "", &this->dbErrors );
 
     /// create the sql driver object
     try
@@ -27,12 +68,8 @@ MonitorSynchronizer::MonitorSynchronizer( MBPro* mbpro,
         throw "Error: " + ex.description;
     }
 
-    /// create required tables
-    try{
-         this->build_tables();
-    } catch( std::string ex ) {
-        throw "Error: " + ex;
-    }
+    /// the required tables are created by the thread
+    this->tablesFlag = true;
 }
 
 void MonitorSynchronizer::build_tables() throw( std::string )
@@ -63,6 +100,17 @@ void MonitorSynchronizer::build_tables() throw( std::string )
         /// doing nothing :-)
     }
 
+    try
+    {
+        sql.str("");
+        sql << "DROP TABLE write_latency;";
+        this->mysqlDriver->execute( sql.str() );
+    }
+    catch( SQLDriverException )
+    {
+        /// doing nothing :-)
+    }
+
     /// create and fill tables
     try
     {
@@ -71,12 +119,23 @@ void MonitorSynchronizer::build_tables() throw( std::string )
         sql << "(";
         sql << "id int(11) NOT NULL,";
         sql << "device_id varchar(500) DEFAULT NULL,";
+        sql << "transport varchar(100) DEFAULT NULL,";
         sql << "ip varchar(100) DEFAULT NULL,";
         sql << "port int(11) DEFAULT NULL,";
         sql << "slave_id int(11) DEFAULT NULL,";
         sql << "response_timeout int(11) DEFAULT NULL,";
         sql << "connection_timeout int(11) DEFAULT NULL,";
         sql << "conn_status varchar(100) DEFAULT NULL,";
+        sql << "circuit varchar(100) DEFAULT NULL,";
+        sql << "connect_failures bigint(20) DEFAULT 0,";
+        sql << "connects bigint(20) DEFAULT 0,";
+        sql << "connect_us_last bigint(20) DEFAULT 0,";
+        sql << "connect_us_total bigint(20) DEFAULT 0,";
+        for( int p = 0; p < RequestArbiter::PRIORITY_NUM; p++ )
+        {
+            sql << "misses_" << RequestArbiter::toString( p ) << " bigint(20) DEFAULT 0,";
+        }
+        sql << "uptime_s bigint(20) DEFAULT 0,";
         sql << "PRIMARY KEY (id)";
         sql << ")";
         sql << "DEFAULT CHARSET=utf8 COLLATE=utf8_hungarian_ci ENGINE=MEMORY;";
@@ -88,16 +147,30 @@ void MonitorSynchronizer::build_tables() throw( std::string )
         sql << "id int(11),";
         sql << "block_id varchar(500) COLLATE utf8_hungarian_ci,";
         sql << "device_id varchar(500) COLLATE utf8_hungarian_ci,";
+        sql << "area varchar(100) COLLATE utf8_hungarian_ci DEFAULT NULL,";
         sql << "offset int(11) DEFAULT NULL,";
         sql << "count int(11) DEFAULT NULL,";
         sql << "cycle_time int(11) DEFAULT NULL,";
         sql << "retries int(11) DEFAULT NULL,";
+        sql << "priority varchar(100) COLLATE utf8_hungarian_ci DEFAULT NULL,";
         sql << "error varchar(100) COLLATE utf8_hungarian_ci DEFAULT NULL,";
+        sql << "error_category varchar(100) COLLATE utf8_hungarian_ci DEFAULT NULL,";
+        sql << "successes bigint(20) DEFAULT 0,";
+        sql << "failures bigint(20) DEFAULT 0,";
+        sql << "consecutive_failures bigint(20) DEFAULT 0,";
+        sql << "rtt_us_last bigint(20) DEFAULT 0,";
+        sql << "rtt_us_avg bigint(20) DEFAULT 0,";
+        sql << "rtt_us_p99 bigint(20) DEFAULT 0,";
+        sql << "cycle_us bigint(20) DEFAULT 0,";
+        sql << "bytes bigint(20) DEFAULT 0,";
         sql << "PRIMARY KEY (id)";
         sql << ")";
         sql << "DEFAULT CHARSET=utf8 COLLATE=utf8_hungarian_ci ENGINE=MEMORY;";
         this->mysqlDriver->execute( sql.str() );
 
+        this->deviceRows.clear();
+        this->blockRows.clear();
+
         std::vector<std::string> deviceIds = monitorInterface->getAllDeviceId();
         int id = 0;
         for( std::vector<std::string>::iterator it = deviceIds.begin();
@@ -111,16 +184,35 @@ void MonitorSynchronizer::build_tables() throw( std::string )
             sql << "(";
             sql << id << ",";
             sql << "'" << deviceId << "',";
+            sql << "'" << monitorInterface->readDeviceTransport( deviceId ) << "',";
             sql << "'" << monitorInterface->readDeviceIp( deviceId ) << "',";
             sql << monitorInterface->readDevicePort( deviceId ) << ",";
             sql << monitorInterface->readDeviceSlaveId( deviceId ) << ",";
             sql << monitorInterface->readDeviceResponseTimeout( deviceId ) << ",";
             sql << monitorInterface->readDeviceConnectionTimeout( deviceId ) << ",";
-            sql << "'" << monitorInterface->readDeviceConnStatus( deviceId ) << "'";
+            sql << "'" << monitorInterface->readDeviceConnStatus( deviceId ) << "',";
+            sql << "'" << monitorInterface->readDeviceCircuitState( deviceId ) << "',";
+            sql << monitorInterface->readDeviceConnectFailures( deviceId ) << ",";
+            sql << monitorInterface->readDeviceConnects( deviceId ) << ",";
+            sql << monitorInterface->readDeviceLastConnectTime( deviceId ) << ",";
+            sql << monitorInterface->readDeviceConnectTime( deviceId );
+            for( int p = 0; p < RequestArbiter::PRIORITY_NUM; p++ )
+            {
+                unsigned long long misses = monitorInterface->readDeviceDeadlineMisses( deviceId, p );
+                sql << "," << misses;
+                this->missesUpdateCache[ id * RequestArbiter::PRIORITY_NUM + p ] = misses;
+            }
+            long long uptime = monitorInterface->readDeviceUptime( deviceId );
+            sql << "," << uptime;
             sql << ");";
             this->mysqlDriver->execute( sql.str() );
 
             /// fill the devices cache...
+            this->deviceRows[ SymbolTable::intern( deviceId ) ] = id;
+            this->uptimeUpdateCache[ id ] = uptime;
+            this->circuitUpdateCache[ id ] = monitorInterface->readDeviceCircuitState( deviceId );
+            this->failuresUpdateCache[ id ] = monitorInterface->readDeviceConnectFailures( deviceId );
+            this->connectsUpdateCache[ id ] = monitorInterface->readDeviceConnects( deviceId );
             this->devicesUpdateCache[ id++ ] = monitorInterface->readDeviceConnStatus( deviceId );
         }
 
@@ -133,6 +225,8 @@ void MonitorSynchronizer::build_tables() throw( std::string )
             for( std::vector<std::string>::iterator it_1 = blockIds.begin(); it_1 != blockIds.end(); it_1++ )
             {
                 std::string blockId = *it_1;
+                BlockStats stats;
+                monitorInterface->readBlockStats( deviceId, blockId, stats );
 
                 sql.str("");
                 sql << "INSERT INTO blocks";
@@ -141,18 +235,68 @@ void MonitorSynchronizer::build_tables() throw( std::string )
                 sql << id << ",";
                 sql << "'" << blockId << "',";
                 sql << "'" << deviceId << "',";
+                sql << "'" << monitorInterface->readBlockArea( deviceId, blockId ) << "',";
                 sql << monitorInterface->readBlockOffset( deviceId, blockId ) << ",";
                 sql << monitorInterface->readBlockCount( deviceId, blockId ) << ",";
                 sql << monitorInterface->readBlockCycleTime( deviceId, blockId ) << ",";
                 sql << monitorInterface->readBlockRetries( deviceId, blockId ) << ",";
-                sql << "'" << monitorInterface->readBlockError( deviceId, blockId ) << "'";
+                sql << "'" << monitorInterface->readBlockPriority( deviceId, blockId ) << "',";
+                sql << "'" << monitorInterface->readBlockError( deviceId, blockId ) << "',";
+                sql << "'" << monitorInterface->readBlockErrorCategory( deviceId, blockId ) << "',";
+                sql << stats.successes << ",";
+                sql << stats.failures << ",";
+                sql << stats.consecutiveFailures << ",";
+                sql << stats.lastRtt << ",";
+                sql << ( stats.rttCount > 0 ? stats.rttSum / stats.rttCount : 0 ) << ",";
+                sql << 0 << ",";
+                sql << stats.cycleTime << ",";
+                sql << stats.bytes;
                 sql << ");";
                 this->mysqlDriver->execute( sql.str() );
 
                 /// fill te blocks cache...
+                this->blockRows[ std::make_pair( SymbolTable::intern( deviceId ), SymbolTable::intern( blockId ) ) ] = id;
+                this->statsUpdateCache[ id ] = stats;
                 this->blocksUpdateCache[ id++ ] = monitorInterface->readBlockError( deviceId, blockId );
            }
         }
+
+        sql.str("");
+        sql << "CREATE TABLE write_latency";
+        sql << "(";
+        sql << "id int(11) NOT NULL,";
+        sql << "le_ms varchar(100) DEFAULT NULL,";
+        sql << "count bigint(20) DEFAULT 0,";
+        sql << "PRIMARY KEY (id)";
+        sql << ")";
+        sql << "DEFAULT CHARSET=utf8 COLLATE=utf8_hungarian_ci ENGINE=MEMORY;";
+        this->mysqlDriver->execute( sql.str() );
+
+        for( int i = 0; i < Histogram::BUCKET_NUM; i++ )
+        {
+            long long bound = Histogram::readBound( i );
+            unsigned long long count = monitorInterface->readWriteLatencyBucket( i );
+
+            sql.str("");
+            sql << "INSERT INTO write_latency";
+            sql << " VALUES ";
+            sql << "(";
+            sql << i << ",";
+            if( bound < 0 )
+            {
+                sql << "'+Inf',";
+            }
+            else
+            {
+                sql << "'" << Conversion::toString( bound / 1000.0, 1 ) << "',";
+            }
+            sql << count;
+            sql << ");";
+            this->mysqlDriver->execute( sql.str() );
+
+            /// fill the latency cache...
+            this->latencyUpdateCache[ i ] = count;
+        }
     }
     catch( SQLDriverException ex )
     {
@@ -164,8 +308,157 @@ void MonitorSynchronizer::build_tables() throw( std::string )
     this->mysqlDriver->close();
 }
 
-void MonitorSynchronizer::refresh_tables()
+void MonitorSynchronizer::refresh_device( const std::string& deviceId, int row )
+{
+    std::string connStatus = monitorInterface->readDeviceConnStatus( deviceId );
+
+    if( this->devicesUpdateCache[ row ] != connStatus )
+    {
+        std::stringstream sql;
+        sql << "UPDATE devices SET conn_status='" << connStatus << "'";
+        sql << " WHERE device_id='" << deviceId << "';";
+        this->mysqlDriver->execute( sql.str() );
+        this->devicesUpdateCache[ row ] = connStatus;
+    }
+
+    std::string circuit = monitorInterface->readDeviceCircuitState( deviceId );
+    unsigned long long failures = monitorInterface->readDeviceConnectFailures( deviceId );
+
+    unsigned long long connects = monitorInterface->readDeviceConnects( deviceId );
+
+    if( this->circuitUpdateCache[ row ] != circuit ||
+        this->failuresUpdateCache[ row ] != failures ||
+        this->connectsUpdateCache[ row ] != connects )
+    {
+        std::stringstream sql;
+        sql << "UPDATE devices SET circuit='" << circuit << "',";
+        sql << "connect_failures=" << failures << ",";
+        sql << "connects=" << connects << ",";
+        sql << "connect_us_last=" << monitorInterface->readDeviceLastConnectTime( deviceId ) << ",";
+        sql << "connect_us_total=" << monitorInterface->readDeviceConnectTime( deviceId );
+        sql << " WHERE device_id='" << deviceId << "';";
+        this->mysqlDriver->execute( sql.str() );
+        this->circuitUpdateCache[ row ] = circuit;
+        this->failuresUpdateCache[ row ] = failures;
+        this->connectsUpdateCache[ row ] = connects;
+    }
+}
+
+void MonitorSynchronizer::refresh_block( const std::string& deviceId, const std::string& blockId, int row )
 {
+    std::string error = monitorInterface->readBlockError( deviceId, blockId );
+
+    if( this->blocksUpdateCache[ row ] != error )
+    {
+        std::stringstream sql;
+        sql << "UPDATE blocks SET error='" << error << "'";
+        sql << ", error_category='" << monitorInterface->readBlockErrorCategory( deviceId, blockId ) << "'";
+        sql << " WHERE device_id='" << deviceId << "' AND " << "block_id='" << blockId << "';";
+        this->mysqlDriver->execute( sql.str() );
+        this->blocksUpdateCache[ row ] = error;
+    }
+}
+
+void MonitorSynchronizer::refresh_counters()
+{
+    /// refresh the deadline misses
+    for( std::map<Symbol,int>::iterator it = this->deviceRows.begin(); it != this->deviceRows.end(); it++ )
+    {
+        std::string deviceId = SymbolTable::name( it->first );
+        int di = it->second;
+
+        for( int p = 0; p < RequestArbiter::PRIORITY_NUM; p++ )
+        {
+            unsigned long long misses = monitorInterface->readDeviceDeadlineMisses( deviceId, p );
+
+            if( this->missesUpdateCache[ di * RequestArbiter::PRIORITY_NUM + p ] != misses )
+            {
+                std::stringstream sql;
+                sql << "UPDATE devices SET misses_" << RequestArbiter::toString( p ) << "=" << misses;
+                sql << " WHERE device_id='" << deviceId << "';";
+                this->mysqlDriver->execute( sql.str() );
+                this->missesUpdateCache[ di * RequestArbiter::PRIORITY_NUM + p ] = misses;
+            }
+        }
+    }
+
+    /// refresh the write latency histogram
+    for( int i = 0; i < Histogram::BUCKET_NUM; i++ )
+    {
+        unsigned long long count = monitorInterface->readWriteLatencyBucket( i );
+
+        if( this->latencyUpdateCache[ i ] != count )
+        {
+            std::stringstream sql;
+            sql << "UPDATE write_latency SET count=" << count;
+            sql << " WHERE id=" << i << ";";
+            this->mysqlDriver->execute( sql.str() );
+            this->latencyUpdateCache[ i ] = count;
+        }
+    }
+}
+
+void MonitorSynchronizer::refresh_stats()
+{
+    /// refresh the uptime of the devices
+    for( std::map<Symbol,int>::iterator it = this->deviceRows.begin(); it != this->deviceRows.end(); it++ )
+    {
+        std::string deviceId = SymbolTable::name( it->first );
+        long long uptime = monitorInterface->readDeviceUptime( deviceId );
+
+        if( this->uptimeUpdateCache[ it->second ] != uptime )
+        {
+            std::stringstream sql;
+            sql << "UPDATE devices SET uptime_s=" << uptime;
+            sql << " WHERE device_id='" << deviceId << "';";
+            this->mysqlDriver->execute( sql.str() );
+            this->uptimeUpdateCache[ it->second ] = uptime;
+        }
+    }
+
+    /// refresh the statistics of the polled blocks
+    for( std::map<std::pair<Symbol,Symbol>,int>::iterator it = this->blockRows.begin(); it != this->blockRows.end(); it++ )
+    {
+        std::string deviceId = SymbolTable::name( it->first.first );
+        std::string blockId = SymbolTable::name( it->first.second );
+        BlockStats& last = this->statsUpdateCache[ it->second ];
+        BlockStats stats;
+
+        monitorInterface->readBlockStats( deviceId, blockId, stats );
+
+        if( stats.successes == last.successes && stats.failures == last.failures )
+        {
+            continue;
+        }
+
+        std::stringstream sql;
+        sql << "UPDATE blocks SET successes=" << stats.successes << ",";
+        sql << "failures=" << stats.failures << ",";
+        sql << "consecutive_failures=" << stats.consecutiveFailures << ",";
+        sql << "cycle_us=" << stats.cycleTime << ",";
+        sql << "bytes=" << stats.bytes;
+
+        /// the round-trip times of the period, only answered requests have one
+        if( stats.rttCount > last.rttCount )
+        {
+            sql << ",rtt_us_last=" << stats.lastRtt;
+            sql << ",rtt_us_avg=" << ( stats.rttSum - last.rttSum ) / ( stats.rttCount - last.rttCount );
+            sql << ",rtt_us_p99=" << window_p99( stats, last );
+        }
+
+        sql << " WHERE device_id='" << deviceId << "' AND " << "block_id='" << blockId << "';";
+        this->mysqlDriver->execute( sql.str() );
+        last = stats;
+    }
+}
+
+bool MonitorSynchronizer::refresh_tables( const std::set<Symbol>& devices,
+                                          const std::set<std::pair<Symbol,Symbol> >& blocks,
+                                          bool all, bool counters, bool stats )
+{
+    std::chrono::steady_clock::time_point _start = std::chrono::steady_clock::now();
+    bool _done = false;
+
     /// connect to db...
     try
     {
@@ -179,64 +472,127 @@ void MonitorSynchronizer::refresh_tables()
     try
     {
         /// refresh device connection statuses
-        int di = 0;
-        std::vector<std::string> deviceIds = monitorInterface->getAllDeviceId();
-        for( std::vector<std::string>::iterator it = deviceIds.begin(); it != deviceIds.end(); it++ )
+        for( std::map<Symbol,int>::iterator it = this->deviceRows.begin(); it != this->deviceRows.end(); it++ )
         {
-            std::string deviceId = *it;
-            std::string connStatus = monitorInterface->readDeviceConnStatus( deviceId );
-
-            if( this->devicesUpdateCache[ di ] != connStatus )
+            if( all || devices.count( it->first ) > 0 )
             {
-                std::stringstream sql;
-                sql << "UPDATE devices SET conn_status='" << connStatus << "'";
-                sql << " WHERE device_id='" << deviceId << "';";
-                this->mysqlDriver->execute( sql.str() );
-                this->devicesUpdateCache[ di ] = connStatus;
+                this->refresh_device( SymbolTable::name( it->first ), it->second );
             }
-            di++;
         }
 
         /// refresh block error statuses
-        int bi = 0;
-        for( std::vector<std::string>::iterator it = deviceIds.begin(); it != deviceIds.end(); it++ )
+        for( std::map<std::pair<Symbol,Symbol>,int>::iterator it = this->blockRows.begin(); it != this->blockRows.end(); it++ )
         {
-            std::string deviceId = *it;
-            std::vector<std::string> blockIds = monitorInterface->getAllBlockId( deviceId );
-            for( std::vector<std::string>::iterator it_1 = blockIds.begin(); it_1 != blockIds.end(); it_1++ )
+            if( all || blocks.count( it->first ) > 0 )
             {
-                std::string blockId = *it_1;
-                std::string error = monitorInterface->readBlockError( deviceId, blockId );
-
-                if( this->blocksUpdateCache[ bi ] != error )
-                {
-                    std::stringstream sql;
-                    sql << "UPDATE blocks SET error='" << error << "'";
-                    sql << " WHERE device_id='" << deviceId << "' AND " << "block_id='" << blockId << "';";
-                    this->mysqlDriver->execute( sql.str() );
-                    this->blocksUpdateCache[ bi ] = error;
-                }
-                bi++;
+                this->refresh_block( SymbolTable::name( it->first.first ), SymbolTable::name( it->first.second ), it->second );
             }
         }
+
+        if( counters )
+        {
+            this->refresh_counters();
+        }
+
+        if( stats )
+        {
+            this->refresh_stats();
+        }
+
+        _done = true;
     }
     catch( SQLDriverException )
     {
+        this->dbErrors.add();
         this->mysqlDriver->close();
     }
+    catch( std::string )
+    {
+        /// a device or a block removed by a reload, the tables are rebuilt
+    }
 
     /// close the connection
     this->mysqlDriver->close();
+
+    this->refreshes.add();
+    this->refreshDuration.record( std::chrono::duration_cast<std::chrono::microseconds>(
+                                      std::chrono::steady_clock::now() - _start ).count() );
+
+    return _done;
+}
+
+void MonitorSynchronizer::reload( MBPro* mbpro )
+{
+    this->mbpro = mbpro;
+    this->statsPeriod = mbpro->monitor.statsPeriod;
+    this->tablesFlag = true;
 }
 
 void MonitorSynchronizer::run()
 {
+    /// the transitions of a failed refresh are lost, a full refresh corrects their rows
+    bool _retry = false;
+
     while( true ) {
-        /// refresh monitor data...
-        this->refresh_tables();
+        /// build the tables at start and after a reload...
+        if( this->tablesFlag.exchange( false ) )
+        {
+            try
+            {
+                this->build_tables();
+            }
+            catch( std::string ex )
+            {
+                this->dbErrors.add();
+                this->tablesFlag = true;
+                Thread::msleep( this->cycleTime );
+                continue;
+            }
+        }
 
-        /// wait a bit...
-        Thread::msleep( this->cycleTime );
+        /// wait for the transitions...
+        int _statsPeriod = this->statsPeriod;
+        this->statusEvents->wait( std::min( this->cycleTime, _statsPeriod ) );
+
+        /// collect them, a device or block once
+        std::set<Symbol> _devices;
+        std::set<std::pair<Symbol,Symbol> > _blocks;
+        bool _all = this->statusEvents->takeOverflow() || _retry;
+        StatusEvent _event;
+
+        while( this->statusEvents->pop( _event ) )
+        {
+            if( _event.type == StatusEvent::TYPE_DEVICE )
+            {
+                _devices.insert( _event.deviceId );
+            }
+            else
+            {
+                _blocks.insert( std::make_pair( _event.deviceId, _event.blockId ) );
+            }
+        }
+
+        /// the counters have no transitions
+        std::chrono::steady_clock::time_point _now = std::chrono::steady_clock::now();
+        bool _counters = _now - this->countersRefresh >= std::chrono::milliseconds( this->cycleTime );
+
+        if( _counters )
+        {
+            this->countersRefresh = _now;
+        }
+
+        bool _stats = _now - this->statsRefresh >= std::chrono::milliseconds( _statsPeriod );
+
+        if( _stats )
+        {
+            this->statsRefresh = _now;
+        }
+
+        /// refresh monitor data...
+        if( _all || _counters || _stats || !_devices.empty() || !_blocks.empty() )
+        {
+            _retry = !this->refresh_tables( _devices, _blocks, _all, _counters, _stats );
+        }
     }
 }
 
@@ -1,8 +1,14 @@
 #ifndef MONITORSYNCHRONIZER_H
 #define MONITORSYNCHRONIZER_H
 
+#include <atomic>
+#include <chrono>
+#include <set>
+#include <utility>
+
 #include "../ModbusDriver/modbusdrivermonitorinterface.h"
 #include "../mbpro.h"
+#include "../Core/metrics.h"
 #include "../Core/thread.hpp"
 #include "../SQLDriver/mysqldriver.h"
 
@@ -14,6 +20,21 @@ namespace ModbusEngine
  *
  * Synchronizes monitor values to database.
  * Uses the delivered monitor interface.
+ * The thread builds the monitor tables at start and after a reload(),
+ * the refresh waits for them.
+ *
+ * The device and block statuses are event driven: the thread sleeps on the
+ * StatusEvents of the driver and updates only the rows of the published
+ * transitions, right after they happen. Lost events ( full queue ) and
+ * the events of a failed refresh ( database error ) are followed by one
+ * full refresh. The counters ( deadline misses, write
+ * latency ) have no transitions, they are refreshed every cycleTime.
+ *
+ * The request statistics of the blocks and the uptime of the devices are
+ * read from the lock-free counters of the driver and flushed every
+ * statsPeriod ( <monitor> section ), the idle blocks are skipped. The
+ * average and the p99 round-trip times are of the last period, the p99
+ * is the upper bound of its Histogram bucket.
  */
 class MonitorSynchronizer : public Thread
 {
@@ -21,9 +42,13 @@ class MonitorSynchronizer : public Thread
 private:
     /// working cycletime in millisecs
     int cycleTime;
+    /// millisecs between two flushes of the statistics ( reloadable )
+    std::atomic<int> statsPeriod;
 
     /// delivered monitor interface (the driver itself)
     ModbusDriverMonitorInterface* monitorInterface;
+    /// the status transitions of the driver
+    StatusEvents* statusEvents;
     /// delivered mbpro file
     MBPro* mbpro;
     /// inner created mysql driver
@@ -32,26 +57,107 @@ private:
     /// caches for devices and blocks
     std::map<int,std::string> devicesUpdateCache;
     std::map<int,std::string> blocksUpdateCache;
+    /// caches for the circuit breakers
+    std::map<int,std::string> circuitUpdateCache;
+    std::map<int,unsigned long long> failuresUpdateCache;
+    std::map<int,unsigned long long> connectsUpdateCache;
+    /// cache for the deadline misses ( device index * priority classes + class )
+    std::map<int,unsigned long long> missesUpdateCache;
+    /// cache for the write latency histogram
+    std::map<int,unsigned long long> latencyUpdateCache;
+
+    /// the rows ( cache indexes ) of the devices and the blocks
+    std::map<Symbol,int> deviceRows;
+    std::map<std::pair<Symbol,Symbol>,int> blockRows;
+    /// the last refresh of the counters and the statistics
+    std::chrono::steady_clock::time_point countersRefresh;
+    std::chrono::steady_clock::time_point statsRefresh;
+    /// caches for the statistics
+    std::map<int,long long> uptimeUpdateCache;
+    std::map<int,BlockStats> statsUpdateCache;
+
+    /// the tables are ( re )built by the thread
+    std::atomic<bool> tablesFlag;
+
+    /// metrics (lock-free)
+    Histogram refreshDuration;
+    Counter refreshes;
+    Counter dbErrors;
 
     /**
      * @brief build_tables
      *
      * Build the required sql data tables.
-     * Called by the constructor.
+     * Called by the thread.
      *
      * The function throws std::string exception.
      */
     void build_tables() throw( std::string );
 
+    /**
+     * @brief refresh_device
+     * @param deviceId  -> device id
+     * @param row       -> the row of the device
+     *
+     * Updates the connection and circuit columns of a device if they changed.
+     * The function throws SQLDriverException and std::string exception.
+     */
+    void refresh_device( const std::string& deviceId, int row );
+
+    /**
+     * @brief refresh_block
+     * @param deviceId  -> device id
+     * @param blockId   -> block id
+     * @param row       -> the row of the block
+     *
+     * Updates the error columns of a block if they changed.
+     * The function throws SQLDriverException and std::string exception.
+     */
+    void refresh_block( const std::string& deviceId, const std::string& blockId, int row );
+
+    /**
+     * @brief refresh_counters
+     *
+     * Updates the changed deadline misses and write latency buckets.
+     * The function throws SQLDriverException and std::string exception.
+     */
+    void refresh_counters();
+
+    /**
+     * @brief refresh_stats
+     *
+     * Updates the uptime of the devices and the statistics of the polled blocks.
+     * The function throws SQLDriverException and std::string exception.
+     */
+    void refresh_stats();
+
     /**
      * @brief refresh_tables
+     * @param devices   -> the devices with a transition
+     * @param blocks    -> the blocks with a transition
+     * @param all       -> refresh every device and block
+     * @param counters  -> refresh the counters
+     * @param stats     -> flush the statistics
+     * @return false when the refresh is cut short ( database error, removed id ),
+     *         the popped transitions are not applied
      *
      * Refresh datatables.
      */
-    void refresh_tables();
+    bool refresh_tables( const std::set<Symbol>& devices,
+                         const std::set<std::pair<Symbol,Symbol> >& blocks,
+                         bool all, bool counters, bool stats );
 
 public:
-    MonitorSynchronizer( MBPro*, ModbusDriverMonitorInterface* ) throw( std::string );
+    MonitorSynchronizer( MBPro*, ModbusDriverMonitorInterface*, MetricsRegistry* ) throw( std::string );
+
+    /**
+     * @brief reload
+     * @param mbpro -> the new project
+     *
+     * The next cycle rebuilds the devices and blocks tables,
+     * the new statsPeriod is used from now.
+     */
+    void reload( MBPro* mbpro );
 
     /**
      * @brief run
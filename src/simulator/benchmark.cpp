@@ -0,0 +1,278 @@
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "benchmark.h"
+#include "../ModbusDriver/modbusdriver.h"
+
+namespace ModbusEngine
+{
+
+Benchmark::Benchmark( std::string mbproUrl, int seconds )
+{
+    this->mbproUrl = mbproUrl;
+    this->seconds = seconds;
+}
+
+bool Benchmark::isLocal( const std::string& ip )
+{
+    return ip == "localhost" || ip.compare( 0, 4, "127." ) == 0;
+}
+
+TCPSlaveFarm* Benchmark::buildFarm( MBPro* mbpro, int& devices )
+{
+    TCPSlaveFarm::Profile _profile;
+    _profile.latency = mbpro->simulator.latency;
+    _profile.jitter = mbpro->simulator.jitter;
+    _profile.exceptionRate = mbpro->simulator.exceptionRate;
+    _profile.dropRate = mbpro->simulator.dropRate;
+
+    /// the devices of a port share one slave, it is sized to the highest block
+    std::map<int,int> _sizes;
+    devices = 0;
+
+    std::vector<MBPro_Driver_Device>::iterator _d = mbpro->driver.devices.begin();
+    for( ; _d != mbpro->driver.devices.end(); _d++ )
+    {
+        if( _d->transport != "tcp" || !isLocal( _d->ip ) ) continue;
+
+        int& _size = _sizes[ _d->port ];
+        std::vector<MBPro_Driver_Block>::iterator _b = _d->blocks.begin();
+        for( ; _b != _d->blocks.end(); _b++ )
+        {
+            _size = std::max( _size, std::min( _b->offset + _b->count, 65536 ) );
+        }
+
+        devices++;
+    }
+
+    TCPSlaveFarm* _farm = new TCPSlaveFarm( "127.0.0.1", _profile );
+
+    std::map<int,int>::iterator _it = _sizes.begin();
+    for( ; _it != _sizes.end(); _it++ )
+    {
+        _farm->addSlave( _it->first, new SimulatedSlave( std::max( _it->second, 1 ), mbpro->simulator.dynamic ) );
+    }
+
+    return _farm;
+}
+
+Benchmark::Sample Benchmark::take_sample( MetricsRegistry* metrics )
+{
+    Sample _s;
+
+    struct rusage _usage;
+    getrusage( RUSAGE_SELF, &_usage );
+
+    _s.time = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now().time_since_epoch() ).count() / 1e6;
+    _s.cpu = _usage.ru_utime.tv_sec + _usage.ru_utime.tv_usec / 1e6 +
+             _usage.ru_stime.tv_sec + _usage.ru_stime.tv_usec / 1e6;
+    _s.polls = metrics->readCounter( "modbus_block_reads_total" );
+    _s.pollErrors = metrics->readCounter( "modbus_block_read_errors_total" );
+    _s.requests = metrics->readCounter( "modbus_requests_total" );
+    _s.requestErrors = metrics->readCounter( "modbus_request_errors_total" );
+    _s.latency = metrics->readBuckets( "modbus_request_duration_seconds" );
+
+    return _s;
+}
+
+double Benchmark::percentile( const std::vector<unsigned long long>& buckets, double q )
+{
+    unsigned long long _total = buckets[ Histogram::BUCKET_NUM - 1 ];
+    if( _total == 0 ) return 0;
+
+    double _target = q * _total;
+
+    for( int b = 0; b < Histogram::BUCKET_NUM; b++ )
+    {
+        if( buckets[ b ] < _target ) continue;
+
+        long long _upper = Histogram::readBound( b );
+        if( _upper < 0 ) return -1;
+
+        /// linear inside the bucket
+        long long _lower = ( b == 0 ) ? 0 : Histogram::readBound( b - 1 );
+        unsigned long long _below = ( b == 0 ) ? 0 : buckets[ b - 1 ];
+        double _in = (double)( buckets[ b ] - _below );
+
+        return ( _lower + ( _upper - _lower ) * ( _in > 0 ? ( _target - _below ) / _in : 1.0 ) ) / 1000.0;
+    }
+
+    return -1;
+}
+
+long Benchmark::resident_memory()
+{
+    std::ifstream _status( "/proc/self/status" );
+    std::string _line;
+
+    while( std::getline( _status, _line ) )
+    {
+        if( _line.compare( 0, 6, "VmRSS:" ) == 0 )
+        {
+            return atol( _line.c_str() + 6 );
+        }
+    }
+
+    return 0;
+}
+
+int Benchmark::run()
+{
+    MBPro* _mbpro = new MBPro( this->mbproUrl );
+
+    try
+    {
+        _mbpro->readMBPro();
+    }
+    catch( std::string ex )
+    {
+        std::cout << "ERROR: " << ex << std::endl;
+        return -1;
+    }
+
+    /// one descriptor per connection on both sides
+    struct rlimit _limit;
+    if( getrlimit( RLIMIT_NOFILE, &_limit ) == 0 && _limit.rlim_cur < _limit.rlim_max )
+    {
+        _limit.rlim_cur = _limit.rlim_max;
+        setrlimit( RLIMIT_NOFILE, &_limit );
+    }
+
+    int _devices = 0;
+    TCPSlaveFarm* _farm = buildFarm( _mbpro, _devices );
+
+    /// the farm in a child process, it reports back when it listens
+    int _ready[ 2 ];
+    if( pipe( _ready ) == -1 )
+    {
+        std::cout << "ERROR: pipe failed" << std::endl;
+        return -1;
+    }
+
+    pid_t _child = fork();
+
+    if( _child < 0 )
+    {
+        std::cout << "ERROR: fork failed" << std::endl;
+        return -1;
+    }
+
+    if( _child == 0 )
+    {
+        close( _ready[ 0 ] );
+
+        char _status = 'R';
+        try
+        {
+            _farm->open();
+        }
+        catch( std::string ex )
+        {
+            _status = 'E';
+        }
+
+        if( write( _ready[ 1 ], &_status, 1 ) != 1 || _status != 'R' )
+        {
+            _exit( EXIT_FAILURE );
+        }
+        close( _ready[ 1 ] );
+
+        _farm->run();
+        _exit( EXIT_SUCCESS );
+    }
+
+    close( _ready[ 1 ] );
+
+    char _status = 0;
+    if( read( _ready[ 0 ], &_status, 1 ) != 1 || _status != 'R' )
+    {
+        std::cout << "ERROR: the simulator can not listen on the ports of the project" << std::endl;
+        waitpid( _child, NULL, 0 );
+        return -1;
+    }
+    close( _ready[ 0 ] );
+
+    std::cout << "Benchmark: '" << this->mbproUrl << "' "
+              << _devices << "/" << _mbpro->driver.devices.size() << " devices simulated, "
+              << _mbpro->taglist.tags.size() << " tags, "
+              << this->seconds << " s ( " << WARMUP << " s warm-up )" << std::endl;
+
+    MetricsRegistry _metrics;
+    ModbusDriver* _driver = new ModbusDriver( _mbpro, &_metrics );
+    _driver->startBlockThreads();
+
+    Thread::sleep( WARMUP );
+    Sample _a = take_sample( &_metrics );
+
+    Thread::sleep( this->seconds );
+    Sample _b = take_sample( &_metrics );
+
+    long _rss = resident_memory();
+    struct rusage _usage;
+    getrusage( RUSAGE_SELF, &_usage );
+
+    kill( _child, SIGTERM );
+    waitpid( _child, NULL, 0 );
+
+    /// the report
+    double _elapsed = _b.time - _a.time;
+    double _cpu = ( _b.cpu - _a.cpu ) / _elapsed * 100.0;
+    double _tags = _mbpro->taglist.tags.size() / 1000.0;
+
+    std::vector<unsigned long long> _latency( Histogram::BUCKET_NUM, 0 );
+    for( int i = 0; i < Histogram::BUCKET_NUM; i++ )
+    {
+        _latency[ i ] = _b.latency[ i ] - _a.latency[ i ];
+    }
+
+    char _line[ 256 ];
+
+    snprintf( _line, sizeof( _line ), "polls:    %.1f /s ( %.1f errors /s )",
+              ( _b.polls - _a.polls ) / _elapsed, ( _b.pollErrors - _a.pollErrors ) / _elapsed );
+    std::cout << _line << std::endl;
+
+    snprintf( _line, sizeof( _line ), "requests: %.1f /s ( %.1f errors /s )",
+              ( _b.requests - _a.requests ) / _elapsed, ( _b.requestErrors - _a.requestErrors ) / _elapsed );
+    std::cout << _line << std::endl;
+
+    static const double _quantiles[] = { 0.5, 0.9, 0.99, 0.999 };
+    std::cout << "latency: ";
+    for( int i = 0; i < 4; i++ )
+    {
+        double _p = percentile( _latency, _quantiles[ i ] );
+
+        if( _p < 0 )
+        {
+            snprintf( _line, sizeof( _line ), " p%g > %.1f ms", _quantiles[ i ] * 100,
+                      Histogram::readBound( Histogram::BUCKET_NUM - 2 ) / 1000.0 );
+        }
+        else
+        {
+            snprintf( _line, sizeof( _line ), " p%g %.3f ms", _quantiles[ i ] * 100, _p );
+        }
+        std::cout << _line;
+    }
+    std::cout << std::endl;
+
+    snprintf( _line, sizeof( _line ), "cpu:      %.1f %% of one core, %.2f %% per 1000 tags",
+              _cpu, _tags > 0 ? _cpu / _tags : 0.0 );
+    std::cout << _line << std::endl;
+
+    snprintf( _line, sizeof( _line ), "memory:   %.1f MiB resident, %.1f MiB peak, %.1f KiB per 1000 tags",
+              _rss / 1024.0, _usage.ru_maxrss / 1024.0, _tags > 0 ? _rss / _tags : 0.0 );
+    std::cout << _line << std::endl;
+
+    return 0;
+}
+
+} // namespace ModbusEngine
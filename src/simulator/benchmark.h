@@ -0,0 +1,113 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <string>
+#include <vector>
+
+#include "tcpslavefarm.h"
+#include "../Core/metrics.h"
+#include "../mbpro.h"
+
+namespace ModbusEngine
+{
+
+/**
+ * @brief The Benchmark class
+ *
+ * Load test of the modbus driver against a TCPSlaveFarm.
+ *
+ * The farm serves the TCP devices of the mbpro file on the local address
+ * ( 127.x.x.x or localhost ) with the behaviour of the <simulator> section,
+ * it runs in a child process so the CPU time of the engine is measured alone.
+ * After a warm-up the driver is measured for the given seconds and the
+ * report goes to the standard output:
+ *
+ *   - polls ( block reads ) and requests per second, error rates
+ *   - request latency percentiles ( estimated from the histogram buckets )
+ *   - CPU time of the engine in total and per 1000 tags
+ *   - resident and peak memory
+ *
+ * The database side ( tag and monitor synchronizers ) is not started.
+ */
+
+class Benchmark
+{
+
+private:
+    /// defined class constants
+    static const int WARMUP = 2;
+
+    /// the url of the mbpro file and the measured time in seconds
+    std::string mbproUrl;
+    int seconds;
+
+    /// one measurement point
+    class Sample
+    {
+    public:
+        double time;
+        double cpu;
+        unsigned long long polls;
+        unsigned long long pollErrors;
+        unsigned long long requests;
+        unsigned long long requestErrors;
+        std::vector<unsigned long long> latency;
+    };
+
+    /**
+     * @brief take_sample
+     * @param metrics -> the registry of the driver
+     * @return the counters and the CPU time now
+     */
+    static Sample take_sample( MetricsRegistry* metrics );
+
+    /**
+     * @brief percentile
+     * @param buckets   -> cumulative histogram buckets ( see Histogram )
+     * @param q         -> quantile ( 0..1 )
+     * @return the estimated value in millisecs, -1 when it is above the last bound
+     */
+    static double percentile( const std::vector<unsigned long long>& buckets, double q );
+
+    /**
+     * @brief resident_memory
+     * @return the resident set size in KiB
+     */
+    static long resident_memory();
+
+public:
+    /**
+     * @brief Benchmark
+     * @param mbproUrl  -> the mbpro file
+     * @param seconds   -> measured time
+     */
+    Benchmark( std::string mbproUrl, int seconds );
+
+    /**
+     * @brief run
+     * @return exit code
+     *
+     * Runs the farm and the driver, prints the report.
+     */
+    int run();
+
+    /**
+     * @brief isLocal
+     * @param ip -> device address
+     * @return the address is served by the farm
+     */
+    static bool isLocal( const std::string& ip );
+
+    /**
+     * @brief buildFarm
+     * @param mbpro     -> the project
+     * @param devices   -> number of the simulated devices ( output )
+     * @return the farm with one slave per local port, sized to the blocks
+     */
+    static TCPSlaveFarm* buildFarm( MBPro* mbpro, int& devices );
+
+};
+
+} // namespace ModbusEngine
+
+#endif // BENCHMARK_H
@@ -0,0 +1,189 @@
+#include <cerrno>
+#include <cstdlib>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "rtuslavesimulator.h"
+#include "../Core/modbuspdu.h"
+
+namespace ModbusEngine
+{
+
+RTUSlaveSimulator::RTUSlaveSimulator( std::string linkPath, int baudRate )
+{
+    this->linkPath = linkPath;
+    this->baudRate = baudRate;
+    this->master = -1;
+    this->slave = -1;
+    this->running = false;
+}
+
+RTUSlaveSimulator::~RTUSlaveSimulator()
+{
+    if( this->master != -1 )
+    {
+        close( this->master );
+        close( this->slave );
+        unlink( this->linkPath.c_str() );
+    }
+
+    std::map<int,SimulatedSlave*>::iterator _it = this->slaves.begin();
+    for( ; _it != this->slaves.end(); _it++ )
+    {
+        delete _it->second;
+    }
+}
+
+void RTUSlaveSimulator::addSlave( int slaveId, SimulatedSlave* slave )
+{
+    this->slaves[ slaveId ] = slave;
+}
+
+void RTUSlaveSimulator::open() throw( std::string )
+{
+    this->master = posix_openpt( O_RDWR | O_NOCTTY );
+
+    if( this->master == -1 || grantpt( this->master ) == -1 || unlockpt( this->master ) == -1 )
+    {
+        throw std::string( "pty_failed" );
+    }
+
+    std::string _name( ptsname( this->master ) );
+
+    /// the kept open slave side in raw mode: no echo, no hangup between the engine sessions
+    this->slave = ::open( _name.c_str(), O_RDWR | O_NOCTTY );
+
+    if( this->slave == -1 )
+    {
+        throw std::string( "pty_failed" );
+    }
+
+    struct termios _tio;
+    tcgetattr( this->slave, &_tio );
+    cfmakeraw( &_tio );
+    tcsetattr( this->slave, TCSANOW, &_tio );
+
+    unlink( this->linkPath.c_str() );
+
+    if( symlink( _name.c_str(), this->linkPath.c_str() ) == -1 )
+    {
+        throw std::string( "pty_failed" );
+    }
+}
+
+int RTUSlaveSimulator::request_length( const std::vector<uint8>& frame )
+{
+    if( frame.size() < 2 )
+    {
+        return 0;
+    }
+
+    switch( frame[ 1 ] )
+    {
+        case ModbusPDU::FC_WRITE_MULTIPLE_COILS :
+        case ModbusPDU::FC_WRITE_MULTIPLE_REGISTERS :
+            return ( frame.size() < 7 ) ? 0 : 9 + frame[ 6 ];
+
+        default :
+            return 8;
+    }
+}
+
+void RTUSlaveSimulator::wire_sleep( int bytes )
+{
+    Thread::usleep( (int)( (long long)bytes * 11 * 1000000 / this->baudRate ) );
+}
+
+void RTUSlaveSimulator::serve( const std::vector<uint8>& frame )
+{
+    uint16 _crc = (uint16)( frame[ frame.size() - 2 ] | ( frame[ frame.size() - 1 ] << 8 ) );
+
+    if( ModbusPDU::crc16( &frame[ 0 ], frame.size() - 2 ) != _crc )
+    {
+        return;
+    }
+
+    std::map<int,SimulatedSlave*>::iterator _it = this->slaves.find( frame[ 0 ] );
+
+    if( _it == this->slaves.end() )
+    {
+        /// an other slave or broadcast
+        return;
+    }
+
+    std::vector<uint8> _response =
+            _it->second->process( std::vector<uint8>( frame.begin() + 1, frame.end() - 2 ) );
+
+    std::vector<uint8> _answer;
+    _answer.push_back( frame[ 0 ] );
+    _answer.insert( _answer.end(), _response.begin(), _response.end() );
+    _crc = ModbusPDU::crc16( &_answer[ 0 ], _answer.size() );
+    _answer.push_back( (uint8)( _crc & 0xFF ) );
+    _answer.push_back( (uint8)( _crc >> 8 ) );
+
+    /// the request and the answer on the wire
+    this->wire_sleep( frame.size() + _answer.size() );
+
+    size_t _sent = 0;
+    while( _sent < _answer.size() )
+    {
+        ssize_t _n = write( this->master, &_answer[ _sent ], _answer.size() - _sent );
+        if( _n <= 0 ) return;
+        _sent += _n;
+    }
+}
+
+void RTUSlaveSimulator::run()
+{
+    std::vector<uint8> _frame;
+    uint8 _buffer[ 256 ];
+
+    this->running = true;
+
+    while( this->running )
+    {
+        struct pollfd _pfd;
+        _pfd.fd = this->master;
+        _pfd.events = POLLIN;
+        _pfd.revents = 0;
+
+        int _ready = poll( &_pfd, 1, 100 );
+
+        if( _ready == 0 )
+        {
+            /// a silent line ends the broken frames
+            _frame.clear();
+            continue;
+        }
+
+        ssize_t _n = read( this->master, _buffer, sizeof( _buffer ) );
+
+        if( _n <= 0 )
+        {
+            if( _n == -1 && errno != EAGAIN && errno != EINTR && errno != EIO )
+            {
+                break;
+            }
+            Thread::msleep( 10 );
+            continue;
+        }
+
+        _frame.insert( _frame.end(), _buffer, _buffer + _n );
+
+        int _length;
+        while( ( _length = request_length( _frame ) ) != 0 && (int)_frame.size() >= _length )
+        {
+            this->serve( std::vector<uint8>( _frame.begin(), _frame.begin() + _length ) );
+            _frame.erase( _frame.begin(), _frame.begin() + _length );
+        }
+    }
+}
+
+void RTUSlaveSimulator::halt()
+{
+    this->running = false;
+}
+
+} // namespace ModbusEngine
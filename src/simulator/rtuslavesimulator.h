@@ -0,0 +1,113 @@
+#ifndef RTUSLAVESIMULATOR_H
+#define RTUSLAVESIMULATOR_H
+
+#include <atomic>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "simulatedslave.h"
+#include "../Core/thread.hpp"
+
+namespace ModbusEngine
+{
+
+/**
+ * @brief The RTUSlaveSimulator class
+ *
+ * Simulates an RTU line with SimulatedSlaves on a pseudo terminal.
+ * The slave side of the terminal is linked to linkPath, so the engine
+ * can use it as a serial port.
+ *
+ * Features:
+ *   - RTU framing with CRC check
+ *   - the wire time of the frames is emulated by the baud rate
+ *   - answers only the slaves on the line, broadcast is not answered
+ *
+ * Usage:
+ *
+ * 1. Create instance
+ * 2. Call open()
+ * 3. Call startThread()
+ */
+
+class RTUSlaveSimulator : public Thread
+{
+
+private:
+    /// Line parameters
+    std::string linkPath;
+    int baudRate;
+
+    /// pseudo terminal master and the kept open slave
+    int master;
+    int slave;
+
+    /// the slaves by slave id
+    std::map<int,SimulatedSlave*> slaves;
+
+    /// thread stop flag
+    std::atomic<bool> running;
+
+    /**
+     * @brief request_length
+     * @param frame -> the received bytes
+     * @return full length of the request frame, 0 when it is not known yet
+     */
+    static int request_length( const std::vector<uint8>& frame );
+
+    /**
+     * @brief serve
+     * @param frame -> a full request frame
+     *
+     * Checks the frame and sends the answer of the slave.
+     */
+    void serve( const std::vector<uint8>& frame );
+
+    /**
+     * @brief wire_sleep
+     * @param bytes -> number of bytes on the line
+     */
+    void wire_sleep( int bytes );
+
+public:
+    /**
+     * @brief RTUSlaveSimulator
+     * @param linkPath  -> the path of the serial port to create
+     * @param baudRate  -> emulated baud rate
+     */
+    RTUSlaveSimulator( std::string linkPath, int baudRate );
+
+    /**
+     * @brief ~RTUSlaveSimulator
+     *
+     * Closes the terminal and removes the link. Deletes the slaves.
+     */
+    ~RTUSlaveSimulator();
+
+    /**
+     * @brief addSlave
+     * @param slaveId   -> slave id
+     * @param slave     -> the slave (owned by the simulator)
+     */
+    void addSlave( int slaveId, SimulatedSlave* slave );
+
+    /**
+     * @brief open
+     *
+     * Creates the pseudo terminal and the link.
+     *
+     * The function throws std::string exception when error happens:
+     *
+     *      "pty_failed" -> the terminal or the link can not be created
+     */
+    void open() throw( std::string );
+
+    void run();
+    void halt();
+
+};
+
+} // namespace ModbusEngine
+
+#endif // RTUSLAVESIMULATOR_H
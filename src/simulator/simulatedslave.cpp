@@ -0,0 +1,201 @@
+#include "simulatedslave.h"
+#include "../Core/modbuspdu.h"
+
+namespace ModbusEngine
+{
+
+SimulatedSlave::SimulatedSlave( int size, bool dynamic ) :
+    coils( size, 0 ),
+    discreteInputs( size, 0 ),
+    holdingRegisters( size, 0 ),
+    inputRegisters( size, 0 )
+{
+    this->size = size;
+    this->dynamic = dynamic;
+    this->start = std::chrono::steady_clock::now();
+
+    for( int i = 0; i < size; i++ )
+    {
+        this->discreteInputs[ i ] = i % 2;
+        this->inputRegisters[ i ] = (uint16)i;
+    }
+}
+
+std::vector<uint8> SimulatedSlave::exception_response( int function, int code )
+{
+    std::vector<uint8> _pdu;
+
+    _pdu.push_back( (uint8)( function | ModbusPDU::EXCEPTION_BIT ) );
+    _pdu.push_back( (uint8)code );
+
+    return _pdu;
+}
+
+int SimulatedSlave::ticks()
+{
+    if( !this->dynamic ) return 0;
+
+    return (int)( std::chrono::duration_cast<std::chrono::milliseconds>(
+                      std::chrono::steady_clock::now() - this->start ).count() / 100 );
+}
+
+std::vector<uint8> SimulatedSlave::process( const std::vector<uint8>& request )
+{
+    if( request.empty() )
+    {
+        return exception_response( 0, 1 );
+    }
+
+    int _function = request[ 0 ];
+
+    if( request.size() < 5 )
+    {
+        return exception_response( _function, 3 );
+    }
+
+    int _offset = ( request[ 1 ] << 8 ) | request[ 2 ];
+    int _count = ( request[ 3 ] << 8 ) | request[ 4 ];
+    std::vector<uint8> _pdu;
+
+    std::lock_guard<std::mutex> _lock( this->slaveMutex );
+
+    switch( _function )
+    {
+        case ModbusPDU::FC_READ_COILS :
+        case ModbusPDU::FC_READ_DISCRETE_INPUTS :
+        {
+            if( _count < 1 || _count > ModbusPDU::MAX_READ_BITS )
+            {
+                return exception_response( _function, 3 );
+            }
+            if( _offset + _count > this->size )
+            {
+                return exception_response( _function, 2 );
+            }
+
+            std::vector<uint8>& _bits = ( _function == ModbusPDU::FC_READ_COILS ) ?
+                        this->coils : this->discreteInputs;
+            int _bytes = ( _count + 7 ) / 8;
+            int _toggle = ( _function == ModbusPDU::FC_READ_DISCRETE_INPUTS ) ? this->ticks() / 10 % 2 : 0;
+
+            _pdu.push_back( (uint8)_function );
+            _pdu.push_back( (uint8)_bytes );
+            _pdu.resize( 2 + _bytes, 0 );
+
+            for( int i = 0; i < _count; i++ )
+            {
+                if( _bits[ _offset + i ] ^ _toggle )
+                {
+                    _pdu[ 2 + i / 8 ] |= (uint8)( 1 << ( i % 8 ) );
+                }
+            }
+
+            return _pdu;
+        }
+
+        case ModbusPDU::FC_READ_HOLDING_REGISTERS :
+        case ModbusPDU::FC_READ_INPUT_REGISTERS :
+        {
+            if( _count < 1 || _count > ModbusPDU::MAX_READ_REGISTERS )
+            {
+                return exception_response( _function, 3 );
+            }
+            if( _offset + _count > this->size )
+            {
+                return exception_response( _function, 2 );
+            }
+
+            std::vector<uint16>& _regs = ( _function == ModbusPDU::FC_READ_HOLDING_REGISTERS ) ?
+                        this->holdingRegisters : this->inputRegisters;
+            uint16 _step = ( _function == ModbusPDU::FC_READ_INPUT_REGISTERS ) ? (uint16)this->ticks() : 0;
+
+            _pdu.push_back( (uint8)_function );
+            _pdu.push_back( (uint8)( _count * 2 ) );
+
+            for( int i = 0; i < _count; i++ )
+            {
+                uint16 _value = (uint16)( _regs[ _offset + i ] + _step );
+                _pdu.push_back( (uint8)( _value >> 8 ) );
+                _pdu.push_back( (uint8)( _value & 0xFF ) );
+            }
+
+            return _pdu;
+        }
+
+        case ModbusPDU::FC_WRITE_SINGLE_COIL :
+        {
+            if( _offset >= this->size )
+            {
+                return exception_response( _function, 2 );
+            }
+            if( _count != 0xFF00 && _count != 0x0000 )
+            {
+                return exception_response( _function, 3 );
+            }
+
+            this->coils[ _offset ] = ( _count == 0xFF00 ) ? 1 : 0;
+
+            return std::vector<uint8>( request.begin(), request.begin() + 5 );
+        }
+
+        case ModbusPDU::FC_WRITE_SINGLE_REGISTER :
+        {
+            if( _offset >= this->size )
+            {
+                return exception_response( _function, 2 );
+            }
+
+            this->holdingRegisters[ _offset ] = (uint16)_count;
+
+            return std::vector<uint8>( request.begin(), request.begin() + 5 );
+        }
+
+        case ModbusPDU::FC_WRITE_MULTIPLE_COILS :
+        {
+            if( _count < 1 || _count > ModbusPDU::MAX_WRITE_BITS ||
+                request.size() < 6 || (int)request.size() != 6 + request[ 5 ] ||
+                request[ 5 ] != ( _count + 7 ) / 8 )
+            {
+                return exception_response( _function, 3 );
+            }
+            if( _offset + _count > this->size )
+            {
+                return exception_response( _function, 2 );
+            }
+
+            for( int i = 0; i < _count; i++ )
+            {
+                this->coils[ _offset + i ] = ( request[ 6 + i / 8 ] >> ( i % 8 ) ) & 1;
+            }
+
+            return std::vector<uint8>( request.begin(), request.begin() + 5 );
+        }
+
+        case ModbusPDU::FC_WRITE_MULTIPLE_REGISTERS :
+        {
+            if( _count < 1 || _count > ModbusPDU::MAX_WRITE_REGISTERS ||
+                request.size() < 6 || (int)request.size() != 6 + request[ 5 ] ||
+                request[ 5 ] != _count * 2 )
+            {
+                return exception_response( _function, 3 );
+            }
+            if( _offset + _count > this->size )
+            {
+                return exception_response( _function, 2 );
+            }
+
+            for( int i = 0; i < _count; i++ )
+            {
+                this->holdingRegisters[ _offset + i ] =
+                        (uint16)( ( request[ 6 + 2 * i ] << 8 ) | request[ 7 + 2 * i ] );
+            }
+
+            return std::vector<uint8>( request.begin(), request.begin() + 5 );
+        }
+
+        default :
+            return exception_response( _function, 1 );
+    }
+}
+
+} // namespace ModbusEngine
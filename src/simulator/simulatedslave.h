@@ -0,0 +1,80 @@
+#ifndef SIMULATEDSLAVE_H
+#define SIMULATEDSLAVE_H
+
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+#include "../Core/types.h"
+
+namespace ModbusEngine
+{
+
+/**
+ * @brief The SimulatedSlave class
+ *
+ * In-memory modbus slave for testing the engine without real devices.
+ *
+ * Features:
+ *   - the first size addresses of the four data areas ( 65536 by default )
+ *   - answers the function codes 1, 2, 3, 4, 5, 6, 15 and 16
+ *   - discrete input i is i%2, input register i is i
+ *   - dynamic mode: the input registers count up in every 100 ms and
+ *     the discrete inputs toggle in every second
+ *   - multithread design
+ */
+
+class SimulatedSlave
+{
+
+private:
+    /// the data areas
+    std::vector<uint8> coils;
+    std::vector<uint8> discreteInputs;
+    std::vector<uint16> holdingRegisters;
+    std::vector<uint16> inputRegisters;
+
+    /// number of addresses in the data areas
+    int size;
+
+    /// the inputs change by the time since start
+    bool dynamic;
+    std::chrono::steady_clock::time_point start;
+
+    /// required mutex for multi threading support
+    std::mutex slaveMutex;
+
+    /**
+     * @brief exception_response
+     * @param function  -> function code of the request
+     * @param code      -> modbus exception code
+     * @return the exception response pdu
+     */
+    static std::vector<uint8> exception_response( int function, int code );
+
+    /**
+     * @brief ticks
+     * @return 100 ms ticks since start, 0 when the slave is not dynamic
+     */
+    int ticks();
+
+public:
+    /**
+     * @brief SimulatedSlave
+     * @param size      -> number of addresses in the data areas ( 1..65536 )
+     * @param dynamic   -> the inputs change by the time
+     */
+    SimulatedSlave( int size = 65536, bool dynamic = false );
+
+    /**
+     * @brief process
+     * @param request -> the request pdu
+     * @return the response pdu
+     */
+    std::vector<uint8> process( const std::vector<uint8>& request );
+
+};
+
+} // namespace ModbusEngine
+
+#endif // SIMULATEDSLAVE_H
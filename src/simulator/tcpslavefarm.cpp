@@ -0,0 +1,365 @@
+#include <arpa/inet.h>
+#include <cerrno>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "tcpslavefarm.h"
+#include "../Core/modbuspdu.h"
+
+namespace ModbusEngine
+{
+
+TCPSlaveFarm::TCPSlaveFarm( std::string address, Profile profile ) : random( std::random_device()() )
+{
+    this->address = address;
+    this->profile = profile;
+    this->epoll = -1;
+    this->serials = 0;
+    this->running = false;
+}
+
+TCPSlaveFarm::~TCPSlaveFarm()
+{
+    std::map<int,Connection*>::iterator _c = this->connections.begin();
+    for( ; _c != this->connections.end(); _c++ )
+    {
+        close( _c->first );
+        delete _c->second;
+    }
+
+    std::map<int,int>::iterator _l = this->listeners.begin();
+    for( ; _l != this->listeners.end(); _l++ )
+    {
+        close( _l->first );
+    }
+
+    if( this->epoll != -1 )
+    {
+        close( this->epoll );
+    }
+
+    std::map<int,SimulatedSlave*>::iterator _it = this->slaves.begin();
+    for( ; _it != this->slaves.end(); _it++ )
+    {
+        delete _it->second;
+    }
+}
+
+void TCPSlaveFarm::addSlave( int port, SimulatedSlave* slave )
+{
+    this->slaves[ port ] = slave;
+}
+
+void TCPSlaveFarm::open() throw( std::string )
+{
+    /// one descriptor per port and per connection
+    struct rlimit _limit;
+    if( getrlimit( RLIMIT_NOFILE, &_limit ) == 0 && _limit.rlim_cur < _limit.rlim_max )
+    {
+        _limit.rlim_cur = _limit.rlim_max;
+        setrlimit( RLIMIT_NOFILE, &_limit );
+    }
+
+    this->epoll = epoll_create1( EPOLL_CLOEXEC );
+    if( this->epoll == -1 )
+    {
+        throw std::string( "listen_failed" );
+    }
+
+    std::map<int,SimulatedSlave*>::iterator _it = this->slaves.begin();
+    for( ; _it != this->slaves.end(); _it++ )
+    {
+        int _fd = socket( AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0 );
+        if( _fd == -1 )
+        {
+            throw std::string( "listen_failed" );
+        }
+
+        int _on = 1;
+        setsockopt( _fd, SOL_SOCKET, SO_REUSEADDR, &_on, sizeof( _on ) );
+
+        struct sockaddr_in _addr;
+        _addr.sin_family = AF_INET;
+        _addr.sin_port = htons( (uint16_t)_it->first );
+        if( inet_pton( AF_INET, this->address.c_str(), &_addr.sin_addr ) != 1 ||
+            bind( _fd, (struct sockaddr*)&_addr, sizeof( _addr ) ) == -1 ||
+            listen( _fd, 128 ) == -1 )
+        {
+            close( _fd );
+            throw std::string( "listen_failed" );
+        }
+
+        struct epoll_event _ev;
+        _ev.events = EPOLLIN;
+        _ev.data.fd = _fd;
+        epoll_ctl( this->epoll, EPOLL_CTL_ADD, _fd, &_ev );
+
+        this->listeners[ _fd ] = _it->first;
+    }
+}
+
+void TCPSlaveFarm::accept_all( int listener, SimulatedSlave* slave )
+{
+    while( true )
+    {
+        int _fd = accept4( listener, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC );
+        if( _fd == -1 ) return;
+
+        int _on = 1;
+        setsockopt( _fd, IPPROTO_TCP, TCP_NODELAY, &_on, sizeof( _on ) );
+
+        Connection* _c = new Connection();
+        _c->fd = _fd;
+        _c->serial = ++this->serials;
+        _c->slave = slave;
+        _c->writing = false;
+        _c->last = std::chrono::steady_clock::now();
+
+        struct epoll_event _ev;
+        _ev.events = EPOLLIN;
+        _ev.data.fd = _fd;
+        epoll_ctl( this->epoll, EPOLL_CTL_ADD, _fd, &_ev );
+
+        this->connections[ _fd ] = _c;
+    }
+}
+
+bool TCPSlaveFarm::receive( Connection* c )
+{
+    uint8 _buffer[ 4096 ];
+
+    while( true )
+    {
+        ssize_t _n = read( c->fd, _buffer, sizeof( _buffer ) );
+
+        if( _n == 0 ) return false;
+        if( _n < 0 )
+        {
+            if( errno == EINTR ) continue;
+            if( errno == EAGAIN || errno == EWOULDBLOCK ) break;
+            return false;
+        }
+
+        c->in.insert( c->in.end(), _buffer, _buffer + _n );
+    }
+
+    /// cut the complete ADUs
+    size_t _pos = 0;
+    while( c->in.size() - _pos >= (size_t)MBAP_SIZE )
+    {
+        int _length = ( c->in[ _pos + 4 ] << 8 ) | c->in[ _pos + 5 ];
+
+        /// unit id + function code at least, a PDU is max 253 bytes
+        if( _length < 2 || _length > 254 )
+        {
+            return false;
+        }
+
+        if( c->in.size() - _pos < (size_t)( 6 + _length ) ) break;
+
+        this->serve( c, std::vector<uint8>( c->in.begin() + _pos, c->in.begin() + _pos + 6 + _length ) );
+        _pos += 6 + _length;
+    }
+
+    c->in.erase( c->in.begin(), c->in.begin() + _pos );
+
+    return true;
+}
+
+void TCPSlaveFarm::serve( Connection* c, const std::vector<uint8>& frame )
+{
+    std::uniform_int_distribution<int> _permille( 0, 999 );
+    int _dice = _permille( this->random );
+
+    if( _dice < this->profile.dropRate )
+    {
+        /// lost answer, the master times out
+        return;
+    }
+
+    std::vector<uint8> _response;
+
+    if( _dice < this->profile.dropRate + this->profile.exceptionRate )
+    {
+        _response.push_back( (uint8)( frame[ MBAP_SIZE ] | ModbusPDU::EXCEPTION_BIT ) );
+        _response.push_back( (uint8)EXCEPTION_SLAVE_DEVICE_FAILURE );
+    }
+    else
+    {
+        _response = c->slave->process( std::vector<uint8>( frame.begin() + MBAP_SIZE, frame.end() ) );
+    }
+
+    Answer _answer;
+    _answer.fd = c->fd;
+    _answer.serial = c->serial;
+    _answer.frame.push_back( frame[ 0 ] );
+    _answer.frame.push_back( frame[ 1 ] );
+    _answer.frame.push_back( 0 );
+    _answer.frame.push_back( 0 );
+    _answer.frame.push_back( (uint8)( ( _response.size() + 1 ) >> 8 ) );
+    _answer.frame.push_back( (uint8)( ( _response.size() + 1 ) & 0xFF ) );
+    _answer.frame.push_back( frame[ 6 ] );
+    _answer.frame.insert( _answer.frame.end(), _response.begin(), _response.end() );
+
+    int _delay = this->profile.latency;
+    if( this->profile.jitter > 0 )
+    {
+        std::uniform_int_distribution<int> _jitter( 0, this->profile.jitter );
+        _delay += _jitter( this->random );
+    }
+
+    std::chrono::steady_clock::time_point _due =
+            std::chrono::steady_clock::now() + std::chrono::milliseconds( _delay );
+
+    /// the answers of a connection are not reordered
+    if( _due < c->last )
+    {
+        _due = c->last;
+    }
+    c->last = _due;
+
+    this->answers.insert( std::make_pair( _due, _answer ) );
+}
+
+bool TCPSlaveFarm::send_pending( Connection* c )
+{
+    size_t _sent = 0;
+
+    while( _sent < c->out.size() )
+    {
+        ssize_t _n = send( c->fd, &c->out[ _sent ], c->out.size() - _sent, MSG_NOSIGNAL );
+
+        if( _n < 0 )
+        {
+            if( errno == EINTR ) continue;
+            if( errno == EAGAIN || errno == EWOULDBLOCK ) break;
+            return false;
+        }
+
+        _sent += _n;
+    }
+
+    c->out.erase( c->out.begin(), c->out.begin() + _sent );
+
+    /// wait for the socket buffer while the answers do not fit
+    bool _writing = !c->out.empty();
+    if( _writing != c->writing )
+    {
+        struct epoll_event _ev;
+        _ev.events = _writing ? ( EPOLLIN | EPOLLOUT ) : EPOLLIN;
+        _ev.data.fd = c->fd;
+        epoll_ctl( this->epoll, EPOLL_CTL_MOD, c->fd, &_ev );
+
+        c->writing = _writing;
+    }
+
+    return true;
+}
+
+void TCPSlaveFarm::drop( Connection* c )
+{
+    epoll_ctl( this->epoll, EPOLL_CTL_DEL, c->fd, NULL );
+    close( c->fd );
+
+    this->connections.erase( c->fd );
+    delete c;
+}
+
+int TCPSlaveFarm::release_due()
+{
+    std::chrono::steady_clock::time_point _now = std::chrono::steady_clock::now();
+
+    while( !this->answers.empty() && this->answers.begin()->first <= _now )
+    {
+        Answer& _answer = this->answers.begin()->second;
+
+        std::map<int,Connection*>::iterator _c = this->connections.find( _answer.fd );
+
+        /// the connection can be closed ( and the fd reused ) meanwhile
+        if( _c != this->connections.end() && _c->second->serial == _answer.serial )
+        {
+            _c->second->out.insert( _c->second->out.end(), _answer.frame.begin(), _answer.frame.end() );
+
+            if( !this->send_pending( _c->second ) )
+            {
+                this->drop( _c->second );
+            }
+        }
+
+        this->answers.erase( this->answers.begin() );
+    }
+
+    if( this->answers.empty() ) return -1;
+
+    long long _wait = std::chrono::duration_cast<std::chrono::microseconds>(
+                this->answers.begin()->first - _now ).count();
+
+    return (int)( ( _wait + 999 ) / 1000 );
+}
+
+void TCPSlaveFarm::run()
+{
+    struct epoll_event _events[ MAX_EVENTS ];
+
+    this->running = true;
+
+    while( this->running )
+    {
+        int _timeout = this->release_due();
+        if( _timeout < 0 || _timeout > 100 )
+        {
+            /// checks the stop flag
+            _timeout = 100;
+        }
+
+        int _n = epoll_wait( this->epoll, _events, MAX_EVENTS, _timeout );
+
+        for( int i = 0; i < _n; i++ )
+        {
+            int _fd = _events[ i ].data.fd;
+
+            std::map<int,int>::iterator _l = this->listeners.find( _fd );
+            if( _l != this->listeners.end() )
+            {
+                this->accept_all( _fd, this->slaves[ _l->second ] );
+                continue;
+            }
+
+            std::map<int,Connection*>::iterator _c = this->connections.find( _fd );
+            if( _c == this->connections.end() ) continue;
+
+            Connection* _conn = _c->second;
+            bool _alive = true;
+
+            if( _events[ i ].events & ( EPOLLERR | EPOLLHUP ) )
+            {
+                _alive = false;
+            }
+            if( _alive && ( _events[ i ].events & EPOLLOUT ) )
+            {
+                _alive = this->send_pending( _conn );
+            }
+            if( _alive && ( _events[ i ].events & EPOLLIN ) )
+            {
+                _alive = this->receive( _conn );
+            }
+
+            if( !_alive )
+            {
+                this->drop( _conn );
+            }
+        }
+    }
+}
+
+void TCPSlaveFarm::halt()
+{
+    this->running = false;
+}
+
+} // namespace ModbusEngine
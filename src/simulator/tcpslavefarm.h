@@ -0,0 +1,190 @@
+#ifndef TCPSLAVEFARM_H
+#define TCPSLAVEFARM_H
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "simulatedslave.h"
+#include "../Core/thread.hpp"
+
+namespace ModbusEngine
+{
+
+/**
+ * @brief The TCPSlaveFarm class
+ *
+ * Simulates Modbus TCP devices with SimulatedSlaves, one listening port
+ * per slave, for load tests of the engine without real PLCs.
+ *
+ * Features:
+ *   - thousands of slaves and connections served by one epoll thread
+ *   - MBAP framing, pipelined requests, every unit id is answered
+ *   - emulated response latency with uniform jitter, the answers of a
+ *     connection keep the order of the requests
+ *   - error injection: exception responses and lost answers ( timeouts )
+ *     by the given rates
+ *
+ * Usage:
+ *
+ * 1. Create instance
+ * 2. Call addSlave() for every port
+ * 3. Call open()
+ * 4. Call startThread() or run()
+ */
+
+class TCPSlaveFarm : public Thread
+{
+
+public:
+    /// the behaviour of the slaves
+    class Profile
+    {
+    public:
+        /// response latency and its max jitter in millisecs
+        int latency;
+        int jitter;
+        /// exception responses ( slave device failure ) per 1000 requests
+        int exceptionRate;
+        /// unanswered requests per 1000 requests
+        int dropRate;
+    };
+
+private:
+    /// defined class constants
+    static const int MBAP_SIZE = 7;
+    static const int MAX_EVENTS = 256;
+    static const int EXCEPTION_SLAVE_DEVICE_FAILURE = 4;
+
+    /// one accepted connection
+    class Connection
+    {
+    public:
+        int fd;
+        unsigned long long serial;
+        SimulatedSlave* slave;
+        std::vector<uint8> in;
+        std::vector<uint8> out;
+        /// EPOLLOUT is watched
+        bool writing;
+        /// the due time of the last queued answer
+        std::chrono::steady_clock::time_point last;
+    };
+
+    /// one delayed answer
+    class Answer
+    {
+    public:
+        int fd;
+        unsigned long long serial;
+        std::vector<uint8> frame;
+    };
+
+    /// listening address and the slaves by port
+    std::string address;
+    std::map<int,SimulatedSlave*> slaves;
+    Profile profile;
+
+    /// epoll instance and the listening sockets ( fd -> port )
+    int epoll;
+    std::map<int,int> listeners;
+
+    /// the connections by fd and the number of the accepted ones
+    std::map<int,Connection*> connections;
+    unsigned long long serials;
+
+    /// the answers by due time
+    std::multimap<std::chrono::steady_clock::time_point,Answer> answers;
+
+    /// random source of the jitter and the error injection
+    std::mt19937 random;
+
+    /// thread stop flag
+    std::atomic<bool> running;
+
+    /**
+     * @brief accept_all
+     * @param listener -> listening socket
+     * @param slave    -> the slave of the port
+     */
+    void accept_all( int listener, SimulatedSlave* slave );
+
+    /**
+     * @brief receive
+     * @param c -> the connection
+     * @return false when the connection is closed
+     */
+    bool receive( Connection* c );
+
+    /**
+     * @brief serve
+     * @param c     -> the connection
+     * @param frame -> a full request ADU
+     *
+     * Queues the answer of the slave with the emulated latency.
+     */
+    void serve( Connection* c, const std::vector<uint8>& frame );
+
+    /**
+     * @brief send_pending
+     * @param c -> the connection
+     * @return false when the connection is broken
+     */
+    bool send_pending( Connection* c );
+
+    /**
+     * @brief drop
+     * @param c -> the connection to close
+     */
+    void drop( Connection* c );
+
+    /**
+     * @brief release_due
+     * @return millisecs until the next answer is due, -1 when there is none
+     */
+    int release_due();
+
+public:
+    /**
+     * @brief TCPSlaveFarm
+     * @param address   -> listening address ( e.g. "127.0.0.1" )
+     * @param profile   -> behaviour of the slaves
+     */
+    TCPSlaveFarm( std::string address, Profile profile );
+
+    /**
+     * @brief ~TCPSlaveFarm
+     *
+     * Closes the sockets. Deletes the slaves.
+     */
+    ~TCPSlaveFarm();
+
+    /**
+     * @brief addSlave
+     * @param port  -> listening port
+     * @param slave -> the slave (owned by the farm)
+     */
+    void addSlave( int port, SimulatedSlave* slave );
+
+    /**
+     * @brief open
+     *
+     * Opens the listening sockets.
+     *
+     * The function throws std::string exception when error happens:
+     *
+     *      "listen_failed" -> a port can not be opened
+     */
+    void open() throw( std::string );
+
+    void run();
+    void halt();
+
+};
+
+} // namespace ModbusEngine
+
+#endif // TCPSLAVEFARM_H
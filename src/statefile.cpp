@@ -0,0 +1,349 @@
+#include <cstring>
+#include <fcntl.h>
+#include <sstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "statefile.h"
+#include "mbprocache.h"
+#include "Core/logger.h"
+
+namespace ModbusEngine {
+
+const uint32_t StateFile::VERSION;
+
+/// the fixed part of the file
+struct StateFileHeader
+{
+    char magic[ 4 ];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint32_t blocks;
+    uint64_t payloadSize;
+    uint64_t payloadHash;
+};
+
+/// the fixed part of a block record
+struct StateFileRecord
+{
+    uint32_t keySize;
+    uint32_t words;
+    uint32_t valid;
+    uint32_t reserved;
+};
+
+static const char STATE_MAGIC[ 4 ] = { 'M', 'B', 'S', 'T' };
+static const uint32_t STATE_BYTE_ORDER = 0x01020304;
+
+/// the key and the words are padded to 4 bytes
+static size_t padded( size_t bytes )
+{
+    return ( bytes + 3 ) & ~(size_t)3;
+}
+
+StateFile::StateFile( const std::string& url, int period )
+{
+    this->url = url;
+    this->period = period;
+    this->fd = -1;
+    this->data = NULL;
+    this->size = 0;
+    this->lastSave = std::chrono::steady_clock::now();
+}
+
+StateFile::~StateFile()
+{
+    this->unmap();
+
+    if( this->fd >= 0 )
+    {
+        close( this->fd );
+    }
+}
+
+std::string StateFile::block_key( const std::string& deviceId, const MBPro_Driver_Block& block )
+{
+    std::stringstream _key;
+    _key << deviceId << "/" << block.blockId << "/" << block.area << "/" << block.offset << "/" << block.count;
+
+    return _key.str();
+}
+
+void StateFile::unmap()
+{
+    if( this->data != NULL )
+    {
+        munmap( this->data, this->size );
+        this->data = NULL;
+        this->size = 0;
+    }
+}
+
+void StateFile::seal()
+{
+    StateFileHeader _header;
+    memcpy( &_header, this->data, sizeof( _header ) );
+
+    _header.payloadHash = MBProCache::hash( this->data + sizeof( _header ), _header.payloadSize );
+    memcpy( this->data, &_header, sizeof( _header ) );
+}
+
+bool StateFile::read_images( std::map<std::string,std::vector<uint16> >& images )
+{
+    StateFileHeader _header;
+
+    if( this->data == NULL || this->size < sizeof( _header ) ) return false;
+
+    memcpy( &_header, this->data, sizeof( _header ) );
+
+    if( memcmp( _header.magic, STATE_MAGIC, sizeof( STATE_MAGIC ) ) != 0 ||
+        _header.version != VERSION ||
+        _header.byteOrder != STATE_BYTE_ORDER ||
+        _header.payloadSize != this->size - sizeof( _header ) )
+    {
+        return false;
+    }
+
+    const char* _pos = this->data + sizeof( _header );
+    const char* _end = _pos + _header.payloadSize;
+
+    if( MBProCache::hash( _pos, _header.payloadSize ) != _header.payloadHash ) return false;
+
+    for( uint32_t i = 0; i < _header.blocks; i++ )
+    {
+        StateFileRecord _record;
+
+        if( (size_t)( _end - _pos ) < sizeof( _record ) ) return false;
+
+        memcpy( &_record, _pos, sizeof( _record ) );
+        _pos += sizeof( _record );
+
+        size_t _keyBytes = padded( _record.keySize );
+        size_t _wordBytes = padded( (size_t)_record.words * sizeof( uint16 ) );
+
+        if( (size_t)( _end - _pos ) < _keyBytes + _wordBytes ) return false;
+
+        if( _record.valid != 0 )
+        {
+            std::vector<uint16>& _image = images[ std::string( _pos, _record.keySize ) ];
+            _image.resize( _record.words );
+            memcpy( _image.data(), _pos + _keyBytes, _record.words * sizeof( uint16 ) );
+        }
+
+        _pos += _keyBytes + _wordBytes;
+    }
+
+    return _pos == _end;
+}
+
+bool StateFile::layout( MBPro* mbpro, const std::map<std::string,std::vector<uint16> >& images )
+{
+    std::vector<std::string> _keys;
+    size_t _size = sizeof( StateFileHeader );
+
+    this->slots.clear();
+
+    /// the records of the project...
+    for( size_t i = 0; i < mbpro->driver.devices.size(); i++ )
+    {
+        const MBPro_Driver_Device& _d = mbpro->driver.devices[ i ];
+
+        for( size_t j = 0; j < _d.blocks.size(); j++ )
+        {
+            const MBPro_Driver_Block& _b = _d.blocks[ j ];
+            int _area = ModbusBlock::toArea( _b.area );
+
+            Slot _slot;
+            _slot.deviceId = _d.deviceId;
+            _slot.blockId = _b.blockId;
+            _slot.record = _size;
+            _slot.words = ( _area == ModbusBlock::AREA_COIL || _area == ModbusBlock::AREA_DISCRETE_INPUT ) ?
+                          ( _b.count + 15 ) / 16 : _b.count;
+
+            _keys.push_back( block_key( _d.deviceId, _b ) );
+            this->slots.push_back( _slot );
+
+            _size += sizeof( StateFileRecord ) + padded( _keys.back().size() ) +
+                     padded( _slot.words * sizeof( uint16 ) );
+        }
+    }
+
+    /// resize and map the file...
+    this->unmap();
+
+    if( ftruncate( this->fd, _size ) != 0 ) return false;
+
+    void* _map = mmap( NULL, _size, PROT_READ | PROT_WRITE, MAP_SHARED, this->fd, 0 );
+
+    if( _map == MAP_FAILED ) return false;
+
+    this->data = (char*)_map;
+    this->size = _size;
+    memset( this->data, 0, this->size );
+
+    /// write the records, prefilled with the known images...
+    for( size_t i = 0; i < this->slots.size(); i++ )
+    {
+        Slot& _slot = this->slots[ i ];
+        std::map<std::string,std::vector<uint16> >::const_iterator _it = images.find( _keys[ i ] );
+
+        StateFileRecord _record;
+        memset( &_record, 0, sizeof( _record ) );
+        _record.keySize = _keys[ i ].size();
+        _record.words = _slot.words;
+        _record.valid = ( _it != images.end() && _it->second.size() == _slot.words ) ? 1 : 0;
+
+        char* _pos = this->data + _slot.record;
+        memcpy( _pos, &_record, sizeof( _record ) );
+        memcpy( _pos + sizeof( _record ), _keys[ i ].data(), _keys[ i ].size() );
+
+        if( _record.valid != 0 )
+        {
+            memcpy( _pos + sizeof( _record ) + padded( _record.keySize ),
+                    _it->second.data(), _slot.words * sizeof( uint16 ) );
+        }
+    }
+
+    StateFileHeader _header;
+    memset( &_header, 0, sizeof( _header ) );
+    memcpy( _header.magic, STATE_MAGIC, sizeof( STATE_MAGIC ) );
+    _header.version = VERSION;
+    _header.byteOrder = STATE_BYTE_ORDER;
+    _header.blocks = this->slots.size();
+    _header.payloadSize = this->size - sizeof( _header );
+    memcpy( this->data, &_header, sizeof( _header ) );
+
+    this->seal();
+    msync( this->data, this->size, MS_ASYNC );
+
+    return true;
+}
+
+int StateFile::restore( MBPro* mbpro, ModbusDriver* driver )
+{
+    this->fd = open( this->url.c_str(), O_RDWR | O_CREAT, 0644 );
+
+    if( this->fd < 0 )
+    {
+        Logger::log( Logger::LEVEL_WARNING, "State file can not be opened: " + this->url );
+        return 0;
+    }
+
+    /// read the previous snapshot...
+    std::map<std::string,std::vector<uint16> > _images;
+    struct stat _st;
+
+    if( fstat( this->fd, &_st ) == 0 && _st.st_size > 0 )
+    {
+        void* _map = mmap( NULL, _st.st_size, PROT_READ, MAP_SHARED, this->fd, 0 );
+
+        if( _map != MAP_FAILED )
+        {
+            this->data = (char*)_map;
+            this->size = _st.st_size;
+        }
+
+        if( !this->read_images( _images ) )
+        {
+            _images.clear();
+            Logger::log( Logger::LEVEL_WARNING, "State file is not valid, cold start: " + this->url );
+        }
+
+        this->unmap();
+    }
+
+    /// restore the unchanged blocks...
+    int _restored = 0;
+
+    for( size_t i = 0; i < mbpro->driver.devices.size(); i++ )
+    {
+        const MBPro_Driver_Device& _d = mbpro->driver.devices[ i ];
+
+        for( size_t j = 0; j < _d.blocks.size(); j++ )
+        {
+            std::map<std::string,std::vector<uint16> >::iterator _it = _images.find( block_key( _d.deviceId, _d.blocks[ j ] ) );
+
+            if( _it != _images.end() && driver->restoreBlockImage( _d.deviceId, _d.blocks[ j ].blockId, _it->second ) )
+            {
+                _restored++;
+            }
+        }
+    }
+
+    if( !this->layout( mbpro, _images ) )
+    {
+        this->unmap();
+        Logger::log( Logger::LEVEL_WARNING, "State file can not be written: " + this->url );
+    }
+
+    std::stringstream _log;
+    _log << "State restored: " << _restored << " blocks";
+    Logger::log( Logger::LEVEL_INFO, _log.str() );
+
+    return _restored;
+}
+
+void StateFile::relayout( MBPro* mbpro )
+{
+    if( this->fd < 0 ) return;
+
+    std::map<std::string,std::vector<uint16> > _images;
+    this->read_images( _images );
+
+    if( !this->layout( mbpro, _images ) )
+    {
+        this->unmap();
+        Logger::log( Logger::LEVEL_WARNING, "State file can not be written: " + this->url );
+    }
+}
+
+bool StateFile::isDue()
+{
+    return std::chrono::steady_clock::now() - this->lastSave >= std::chrono::milliseconds( this->period );
+}
+
+bool StateFile::save( ModbusDriver* driver )
+{
+    this->lastSave = std::chrono::steady_clock::now();
+
+    if( this->data == NULL ) return false;
+
+    /// a crash before the seal leaves a bad hash
+    StateFileHeader _header;
+    memcpy( &_header, this->data, sizeof( _header ) );
+    _header.payloadHash = 0;
+    memcpy( this->data, &_header, sizeof( _header ) );
+
+    std::vector<uint16> _image;
+
+    for( size_t i = 0; i < this->slots.size(); i++ )
+    {
+        Slot& _slot = this->slots[ i ];
+
+        /// the blocks in error keep their last known image
+        if( !driver->readBlockImage( _slot.deviceId, _slot.blockId, _image ) || _image.size() != _slot.words )
+        {
+            continue;
+        }
+
+        StateFileRecord _record;
+        char* _pos = this->data + _slot.record;
+        memcpy( &_record, _pos, sizeof( _record ) );
+
+        memcpy( _pos + sizeof( _record ) + padded( _record.keySize ), _image.data(), _slot.words * sizeof( uint16 ) );
+
+        if( _record.valid == 0 )
+        {
+            _record.valid = 1;
+            memcpy( _pos, &_record, sizeof( _record ) );
+        }
+    }
+
+    this->seal();
+    msync( this->data, this->size, MS_ASYNC );
+
+    return true;
+}
+
+}
@@ -0,0 +1,143 @@
+#ifndef STATEFILE_H
+#define STATEFILE_H
+
+#include <chrono>
+#include <map>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "mbpro.h"
+#include "ModbusDriver/modbusdriver.h"
+
+namespace ModbusEngine {
+
+/**
+ * @brief The StateFile class
+ *
+ * Memory mapped snapshot of the block register images for the warm
+ * restart. The engine saves the images of the healthy blocks periodically,
+ * at the next start the images of the unchanged blocks are restored before
+ * the polling starts. The restored values are served as STALE_DATA ( the
+ * tags are "stale" ) until the first poll of their block, so the tags table
+ * is loaded with the last known values and the first cycle writes only the
+ * real changes.
+ *
+ * Layout ( host byte order ):
+ *
+ * header:  magic "MBST", version, byte order mark, number of the blocks,
+ *          payload size, payload hash ( MBProCache::hash() )
+ * payload: one record per block: key size, word count, valid flag,
+ *          reserved, the key ( "device/block/area/offset/count" ) and
+ *          the words, both padded to 4 bytes
+ *
+ * The records are laid out once ( at start and reload ), a save rewrites
+ * the words in place. The hash is cleared before and written after the
+ * words, a snapshot torn by a crash is rejected and the engine starts cold.
+ * A block that is not healthy at a save keeps its previous image.
+ */
+class StateFile
+{
+
+private:
+    /// bump it when the layout changes
+    static const uint32_t VERSION = 1;
+
+    /// a block record of the mapped file
+    class Slot
+    {
+    public:
+        std::string deviceId;
+        std::string blockId;
+        size_t record;
+        size_t words;
+    };
+
+    /// the file
+    std::string url;
+    /// millisecs between two saves
+    int period;
+    int fd;
+    /// the mapped file, NULL when the state file is not usable
+    char* data;
+    size_t size;
+    std::vector<Slot> slots;
+    std::chrono::steady_clock::time_point lastSave;
+
+    /**
+     * @brief block_key
+     * @param deviceId  -> device id
+     * @param block     -> block parameters
+     * @return the key of the block's record, a changed block gets a new key
+     */
+    static std::string block_key( const std::string& deviceId, const MBPro_Driver_Block& block );
+
+    /**
+     * @brief read_images
+     * @param images -> the valid images of the mapped file by key
+     * @return the mapped file is a valid state file
+     */
+    bool read_images( std::map<std::string,std::vector<uint16> >& images );
+
+    /**
+     * @brief layout
+     * @param mbpro     -> the project
+     * @param images    -> the images to prefill the records with
+     * @return the file is resized, mapped and written
+     */
+    bool layout( MBPro* mbpro, const std::map<std::string,std::vector<uint16> >& images );
+
+    /// unmaps the file
+    void unmap();
+
+    /// writes the payload hash of the mapped file
+    void seal();
+
+public:
+    /**
+     * @brief StateFile
+     * @param url       -> the state file
+     * @param period    -> millisecs between two saves
+     */
+    StateFile( const std::string& url, int period );
+
+    ~StateFile();
+
+    /**
+     * @brief restore
+     * @param mbpro     -> the project
+     * @param driver    -> the driver, before startBlockThreads()
+     * @return number of the restored blocks
+     *
+     * Restores the images of the unchanged blocks and lays out the file
+     * for the project. An invalid file is a cold start.
+     */
+    int restore( MBPro* mbpro, ModbusDriver* driver );
+
+    /**
+     * @brief relayout
+     * @param mbpro -> the reloaded project
+     *
+     * Lays out the file for the reloaded project, the unchanged blocks
+     * keep their images.
+     */
+    void relayout( MBPro* mbpro );
+
+    /**
+     * @brief isDue
+     * @return the period is elapsed since the last save
+     */
+    bool isDue();
+
+    /**
+     * @brief save
+     * @param driver -> the driver
+     * @return the images are written ( the file is flushed asynchronously )
+     */
+    bool save( ModbusDriver* driver );
+
+};
+
+}
+
+#endif // STATEFILE_H
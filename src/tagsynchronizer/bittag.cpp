@@ -22,60 +22,58 @@ BitTag::BitTag( int id,
 
 void BitTag::readValueFromModbusDriver( ModbusDriverDataInterface* interface )
 {
-    try
+    // get data from modbus driver
+    bool _bit;
+    MBError::Code _error = interface->tryReadBit( deviceId, blockId, address, subAddress, _bit );
+
+    if( !Tag::isReadable( _error ) )
     {
-        // get data from modbus driver
-        int _value = interface->readBit( deviceId, blockId, address, subAddress );
+        this->setInvalid( _error );
+        return;
+    }
 
-        // convert data to string
-        this->value = Conversion::convert<int,std::string>( _value );
+    int _value = _bit;
 
-        // set validity
-        this->validity = "valid";
-    }
-    catch( std::string _ex )
-    {
-        this->validity = _ex;
-        this->value = "#";
+    // convert data to string
+    this->value = Conversion::convert<int,std::string>( _value );
 
-    }
+    // set validity
+    this->setValid( _error );
 }
 
 void BitTag::writeValueToModbusDriver( ModbusDriverDataInterface* interface )
 {
-    try
-    {
-        // get own data to numeric value
-        int _value = Conversion::convert<std::string, int>( this->value );
+    // get own data to numeric value
+    int _value = Conversion::convert<std::string, int>( this->value );
 
-        // if the input is a string we returns...
-        if( _value == 0 && this->value != "0" )
-        {
-            return;
-        }
+    // if the input is a string we returns...
+    if( _value == 0 && this->value != "0" )
+    {
+        return;
+    }
 
-        // limits
-        if( _value < 0 )
-        {
-            _value = 0;
-        }
+    // limits
+    if( _value < 0 )
+    {
+        _value = 0;
+    }
 
-        if( _value > 1 )
-        {
-            _value = 1;
-        }
+    if( _value > 1 )
+    {
+        _value = 1;
+    }
 
-        // write to modbus driver
-        interface->writeBit( deviceId, blockId, address, subAddress, _value );
+    // write to modbus driver
+    MBError::Code _error = interface->tryWriteBit( deviceId, blockId, address, subAddress, _value );
 
-        // set validity
-        this->validity = "valid";
-    }
-    catch( std::string _ex )
+    if( _error != MBError::NO_ERROR )
     {
-        this->validity = _ex;
-        this->value = "#";
+        this->setInvalid( _error );
+        return;
     }
+
+    // set validity
+    this->validity = "valid";
 }
 
 }
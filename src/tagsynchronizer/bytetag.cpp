@@ -22,94 +22,93 @@ ByteTag::ByteTag( int id,
 
 void ByteTag::readValueFromModbusDriver( ModbusDriverDataInterface* interface )
 {
-    try
+    // get data from interface
+    uint8 _byte;
+    MBError::Code _error = interface->tryReadByte( deviceId, blockId, address, subAddress, _byte );
+
+    if( !Tag::isReadable( _error ) )
+    {
+        this->setInvalid( _error );
+        return;
+    }
+
+    int _value = _byte;
+
+    // format to signed value
+    if( _value > 127 )
+    {
+        _value = 127 - _value;
+    }
+
+    // multiple and add operations before set this->value
+    int _multiple = Conversion::convert<std::string,int>( this->multiple );
+    int _add = Conversion::convert<std::string,int>( this->add );
+    _value *= _multiple;
+    _value += _add;
+
+    // set limits
+    if( _value < -128 )
     {
-        // get data from interface
-        int _value = interface->readByte( deviceId, blockId, address, subAddress );
-
-        // format to signed value
-        if( _value > 127 )
-        {
-            _value = 127 - _value;
-        }
-
-        // multiple and add operations before set this->value
-        int _multiple = Conversion::convert<std::string,int>( this->multiple );
-        int _add = Conversion::convert<std::string,int>( this->add );
-        _value *= _multiple;
-        _value += _add;
-
-        // set limits
-        if( _value < -128 )
-        {
-            _value = -128;
-        }
-
-        if( _value > 127 )
-        {
-            _value = 127;
-        }
-
-        // refresh value
-        this->value = Conversion::convert<int,std::string>( _value );
-
-        // set validity flag
-        this->validity = "valid";
+        _value = -128;
     }
-    catch( std::string _ex )
+
+    if( _value > 127 )
     {
-        this->validity = _ex;
-        this->value = "#";
+        _value = 127;
     }
+
+    // refresh value
+    this->value = Conversion::convert<int,std::string>( _value );
+
+    // set validity flag
+    this->setValid( _error );
 }
 
 void ByteTag::writeValueToModbusDriver( ModbusDriverDataInterface* interface )
 {
-    try
+    // get value to numeric data
+    int _value = Conversion::convert<std::string,int>( this->value );
+
+    // if the input is a string we returns...
+    if( _value == 0 && this->value != "0" )
     {
-        // get value to numeric data
-        int _value = Conversion::convert<std::string,int>( this->value );
-
-        // if the input is a string we returns...
-        if( _value == 0 && this->value != "0" )
-        {
-            return;
-        }
-
-        // add and multiple reverse operations
-        int _add = Conversion::convert<std::string,int>( this->add );
-        int _multiple = Conversion::convert<std::string,int>( this->multiple );
-        _value =_value - _add;
-        _value = _value / _multiple;
-
-        // set limits
-        if( _value < -128 )
-        {
-            _value = -128;
-        }
-
-        if( _value > 127 )
-        {
-            _value = 127;
-        }
-
-        // format to unsigned value for the modbus driver
-        if( _value < 0 )
-        {
-            _value = 127 - _value;
-        }
-
-        // write to modbus driver
-        interface->writeByte( deviceId, blockId, address, subAddress, _value );
-
-        // set validity
-        this->validity = "valid";
+        return;
     }
-    catch( std::string _ex )
+
+    // add and multiple reverse operations
+    int _add = Conversion::convert<std::string,int>( this->add );
+    int _multiple = Conversion::convert<std::string,int>( this->multiple );
+    _value =_value - _add;
+    _value = _value / _multiple;
+
+    // set limits
+    if( _value < -128 )
+    {
+        _value = -128;
+    }
+
+    if( _value > 127 )
+    {
+        _value = 127;
+    }
+
+    // format to unsigned value for the modbus driver
+    if( _value < 0 )
     {
-        this->validity = _ex;
-        this->value = "#";
+        _value = 127 - _value;
     }
+
+    // write to modbus driver
+    MBError::Code _error = interface->tryWriteByte( deviceId, blockId, address, subAddress, _value );
+
+    if( _error != MBError::NO_ERROR )
+    {
+        this->setInvalid( _error );
+        return;
+    }
+
+    // set validity
+    this->validity = "valid";
 }
 
 }
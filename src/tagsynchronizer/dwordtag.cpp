@@ -22,130 +22,141 @@ DWordTag::DWordTag( int id,
 
 void DWordTag::readValueFromModbusDriver( ModbusDriverDataInterface* interface )
 {
-    try
-    {
-        // get data from interface
-        uint16 _v_1;
-        uint16 _v_2;
-
-        if( this->wordSwap )
-        {
-            _v_1 = interface->readWord( deviceId, blockId, address );
-            _v_2 = interface->readWord( deviceId, blockId, address + 1 );
-        }
-        else
-        {
-            _v_1 = interface->readWord( deviceId, blockId, address + 1 );
-            _v_2 = interface->readWord( deviceId, blockId, address );
-        }
-
-        uint32 _value = _v_1*65536 + _v_2;
-        long long int __value = 0;
+    // get data from interface
+    uint16 _v_1;
+    uint16 _v_2;
+    MBError::Code _error;
 
-        // format to signed value
-        if( _value > 2147483647 )
+    if( this->wordSwap )
+    {
+        _error = interface->tryReadWord( deviceId, blockId, address, _v_1 );
+        if( Tag::isReadable( _error ) )
         {
-            __value = 2147483647 - Conversion::convert<uint32,long long int>( _value );
+            _error = interface->tryReadWord( deviceId, blockId, address + 1, _v_2 );
         }
-        else
+    }
+    else
+    {
+        _error = interface->tryReadWord( deviceId, blockId, address + 1, _v_1 );
+        if( Tag::isReadable( _error ) )
         {
-            __value = Conversion::convert<uint32,long long int>( _value );
+            _error = interface->tryReadWord( deviceId, blockId, address, _v_2 );
         }
+    }
 
-        // multiple and add operations before set this->value
-        int _multiple = Conversion::convert<std::string,int>( this->multiple );
-        int _add = Conversion::convert<std::string,int>( this->add );
-        __value *= _multiple;
-        __value += _add;
+    if( !Tag::isReadable( _error ) )
+    {
+        this->setInvalid( _error );
+        return;
+    }
 
-        // set limits
-        if( __value < -2147483648 )
-        {
-            __value = -2147483648;
-        }
+    uint32 _value = _v_1*65536 + _v_2;
+    long long int __value = 0;
 
-        if( __value > 2147483647 )
-        {
-            __value = 2147483647;
-        }
+    // format to signed value
+    if( _value > 2147483647 )
+    {
+        __value = 2147483647 - Conversion::convert<uint32,long long int>( _value );
+    }
+    else
+    {
+        __value = Conversion::convert<uint32,long long int>( _value );
+    }
 
-        // refresh value
-        this->value = Conversion::convert<long long int,std::string>( __value );
+    // multiple and add operations before set this->value
+    int _multiple = Conversion::convert<std::string,int>( this->multiple );
+    int _add = Conversion::convert<std::string,int>( this->add );
+    __value *= _multiple;
+    __value += _add;
 
-        // set validity flag
-        this->validity = "valid";
+    // set limits
+    if( __value < -2147483648 )
+    {
+        __value = -2147483648;
     }
-    catch( std::string _ex )
+
+    if( __value > 2147483647 )
     {
-        this->validity = _ex;
-        this->value = "#";
+        __value = 2147483647;
     }
+
+    // refresh value
+    this->value = Conversion::convert<long long int,std::string>( __value );
+
+    // set validity flag
+    this->setValid( _error );
 }
 
 void DWordTag::writeValueToModbusDriver( ModbusDriverDataInterface* interface )
 {
-    try
+    // get value to numeric data
+    long long int _value = Conversion::convert<std::string,long long int>( this->value );
+
+    // if the input is a string we return...
+    if( _value == 0 && this->value != "0" )
     {
-        // get value to numeric data
-        long long int _value = Conversion::convert<std::string,long long int>( this->value );
+        return;
+    }
 
-        // if the input is a string we return...
-        if( _value == 0 && this->value != "0" )
-        {
-            return;
-        }
+    // add and multiple reverse operations
+    int _multiple = Conversion::convert<std::string,int>( this->multiple );
+    int _add = Conversion::convert<std::string,int>( this->add );
+    _value = _value - _add;
+    _value /= _multiple;
 
-        // add and multiple reverse operations
-        int _multiple = Conversion::convert<std::string,int>( this->multiple );
-        int _add = Conversion::convert<std::string,int>( this->add );
-        _value = _value - _add;
-        _value /= _multiple;
+    // set limits
+    if( _value < -2147483648 )
+    {
+        _value = -2147483648;
+    }
 
-        // set limits
-        if( _value < -2147483648 )
-        {
-            _value = -2147483648;
-        }
+    if( _value > 2147483647 )
+    {
+        _value = 2147483647;
+    }
 
-        if( _value > 2147483647 )
-        {
-            _value = 2147483647;
-        }
+    // format to unsigned value for the modbus driver
+    uint32 __value = 0;
+    if( _value < 0 )
+    {
+        __value = 2147483647 - _value;
+    }
+    else
+    {
+        __value = _value;
+    }
 
-        // format to unsigned value for the modbus driver
-        uint32 __value = 0;
-        if( _value < 0 )
-        {
-            __value = 2147483647 - _value;
-        }
-        else
-        {
-            __value = _value;
-        }
+    // write to modbus driver
+    uint16 _v_1 = __value/65536;
+    uint16 _v_2 = __value%65536;
 
-        // write to modbus driver
-        uint16 _v_1 = __value/65536;
-        uint16 _v_2 = __value%65536;
+    MBError::Code _error;
 
-        if( this->wordSwap )
+    if( this->wordSwap )
+    {
+        _error = interface->tryWriteWord( deviceId, blockId, address, _v_1 );
+        if( _error == MBError::NO_ERROR )
         {
-            interface->writeWord( deviceId, blockId, address, _v_1 );
-            interface->writeWord( deviceId, blockId, address + 1, _v_2 );
+            _error = interface->tryWriteWord( deviceId, blockId, address + 1, _v_2 );
         }
-        else
+    }
+    else
+    {
+        _error = interface->tryWriteWord( deviceId, blockId, address + 1, _v_1 );
+        if( _error == MBError::NO_ERROR )
         {
-            interface->writeWord( deviceId, blockId, address + 1, _v_1 );
-            interface->writeWord( deviceId, blockId, address, _v_2 );
+            _error = interface->tryWriteWord( deviceId, blockId, address, _v_2 );
         }
-
-        // set validity
-        this->validity = "valid";
     }
-    catch( std::string _ex )
+
+    if( _error != MBError::NO_ERROR )
     {
-        this->validity = _ex;
-        this->value = "#";
+        this->setInvalid( _error );
+        return;
     }
+
+    // set validity
+    this->validity = "valid";
 }
 
 }
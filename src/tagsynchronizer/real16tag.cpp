@@ -22,158 +22,157 @@ Real16Tag::Real16Tag( int id,
 
 void Real16Tag::readValueFromModbusDriver( ModbusDriverDataInterface* interface )
 {
-    try
+    // get data from interface
+    uint16 _word;
+    MBError::Code _error = interface->tryReadWord( deviceId, blockId, address, _word );
+
+    if( !Tag::isReadable( _error ) )
     {
-        // get data from interface
-        uint16 _v = interface->readWord( deviceId, blockId, address );
-        float _value = 0.0;
+        this->setInvalid( _error );
+        return;
+    }
 
-        // format to signed value
-        if( _v > 32767 )
-        {
-            _value = (float)(32767 - _v);
-        }
-        else
-        {
-            _value = (float)_v;
-        }
+    uint16 _v = _word;
+    float _value = 0.0;
 
-        // Convert to fake float
-        _value = (float)(_value / (float)this->divider);
+    // format to signed value
+    if( _v > 32767 )
+    {
+        _value = (float)(32767 - _v);
+    }
+    else
+    {
+        _value = (float)_v;
+    }
 
-        // multiple and add operations before set this->value
-        float _multiple = Conversion::convert<std::string,float>( this->multiple );
-        float _add = Conversion::convert<std::string,float>( this->add );
-        _value *= _multiple;
-        _value += _add;
+    // Convert to fake float
+    _value = (float)(_value / (float)this->divider);
 
-        // calculate precision
-        int precision;
-        if( this->divider == 10 )
-        {
-            precision = 1;
-        }
-        else if( this->divider == 100 )
-        {
-            precision = 2;
-        }
-        else if( this->divider == 1000 )
-        {
-            precision = 3;
-        }
-        else if( this->divider == 10000 )
-        {
-            precision = 4;
-        }
-
-        // refresh value
-        this->value = Conversion::toString( _value, precision );
+    // multiple and add operations before set this->value
+    float _multiple = Conversion::convert<std::string,float>( this->multiple );
+    float _add = Conversion::convert<std::string,float>( this->add );
+    _value *= _multiple;
+    _value += _add;
 
-        // set validity flag
-        this->validity = "valid";
+    // calculate precision
+    int precision;
+    if( this->divider == 10 )
+    {
+        precision = 1;
+    }
+    else if( this->divider == 100 )
+    {
+        precision = 2;
     }
-    catch( std::string _ex )
+    else if( this->divider == 1000 )
     {
-        this->validity = _ex;
-        this->value = "#";
+        precision = 3;
     }
+    else if( this->divider == 10000 )
+    {
+        precision = 4;
+    }
+
+    // refresh value
+    this->value = Conversion::toString( _value, precision );
+
+    // set validity flag
+    this->setValid( _error );
 }
 
 void Real16Tag::writeValueToModbusDriver( ModbusDriverDataInterface* interface )
 {
-    try
+    // get value to numeric data
+    float _value = Conversion::convert<std::string,float>( this->value );
+
+    // if the input is a string we returns...
+    if( _value == 0 && this->value != "0" )
     {
-        // get value to numeric data
-        float _value = Conversion::convert<std::string,float>( this->value );
+        return;
+    }
+
+    // add and multiple reverse operations
+    float _fv = 0.0;
+    float _multiple = Conversion::convert<std::string,float>( this->multiple );
+    float _add = Conversion::convert<std::string,float>( this->add );
+    _fv = _value - _add;
+    _fv /= _multiple;
 
-        // if the input is a string we returns...
-        if( _value == 0 && this->value != "0" )
+    // set limits
+    if( this->divider == 10 )
+    {
+        if( _fv < -3276.8 )
         {
-            return;
+            _fv = -3276.8;
         }
 
-        // add and multiple reverse operations
-        float _fv = 0.0;
-        float _multiple = Conversion::convert<std::string,float>( this->multiple );
-        float _add = Conversion::convert<std::string,float>( this->add );
-        _fv = _value - _add;
-        _fv /= _multiple;
-
-        // set limits
-        if( this->divider == 10 )
+        if( _fv > 3276.7 )
         {
-            if( _fv < -3276.8 )
-            {
-                _fv = -3276.8;
-            }
-
-            if( _fv > 3276.7 )
-            {
-                _fv = 3276.7;
-            }
+            _fv = 3276.7;
         }
-        else if( this->divider == 100 )
+    }
+    else if( this->divider == 100 )
+    {
+        if( _fv < -327.68 )
         {
-            if( _fv < -327.68 )
-            {
-                _fv = -327.68;
-            }
-
-            if( _fv > 327.67 )
-            {
-                _fv = 327.67;
-            }
+            _fv = -327.68;
         }
-        else if( this->divider == 1000 )
+
+        if( _fv > 327.67 )
         {
-            if( _fv < -32.768 )
-            {
-                _fv = -32.768;
-            }
-
-            if( _fv > 32.767 )
-            {
-                _fv = 32.767;
-            }
+            _fv = 327.67;
         }
-        else if( this->divider == 10000 )
+    }
+    else if( this->divider == 1000 )
+    {
+        if( _fv < -32.768 )
         {
-            if( _fv < -3.2768 )
-            {
-                _fv = -3.2768;
-            }
-
-            if( _fv > 3.2767 )
-            {
-                _fv = 3.2767;
-            }
+            _fv = -32.768;
         }
 
-        // format to unsigned value for the modbus driver
-        int16 _v = 0;
-        uint16 _uv = 0;
+        if( _fv > 32.767 )
+        {
+            _fv = 32.767;
+        }
+    }
+    else if( this->divider == 10000 )
+    {
+        if( _fv < -3.2768 )
+        {
+            _fv = -3.2768;
+        }
 
-        _fv = (float)(_fv*(float)this->divider);
+        if( _fv > 3.2767 )
+        {
+            _fv = 3.2767;
+        }
+    }
 
-        _v = (int16)_fv;
+    // format to unsigned value for the modbus driver
+    int16 _v = 0;
+    uint16 _uv = 0;
 
-        if( _v < 0 ) {
-            _uv = 32767 - _v;
-        } else {
-            _uv = _v;
-        }
+    _fv = (float)(_fv*(float)this->divider);
 
-        // write to modbus driver
-        interface->writeWord( deviceId, blockId, address, _uv );
+    _v = (int16)_fv;
 
-        // set validity
-        this->validity = "valid";
+    if( _v < 0 ) {
+        _uv = 32767 - _v;
+    } else {
+        _uv = _v;
     }
-    catch( std::string _ex )
+
+    // write to modbus driver
+    MBError::Code _error = interface->tryWriteWord( deviceId, blockId, address, _uv );
+
+    if( _error != MBError::NO_ERROR )
     {
-        this->validity = _ex;
-        this->value = "#";
+        this->setInvalid( _error );
+        return;
     }
+
+    // set validity
+    this->validity = "valid";
 }
 
 }
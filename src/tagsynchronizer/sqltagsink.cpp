@@ -0,0 +1,481 @@
+#include <sstream>
+
+#include "sqltagsink.h"
+#include "../Core/logger.h"
+
+namespace ModbusEngine {
+
+const int SQLTagSink::BULK_ROWS;
+const int SQLTagSink::TABLE_RETRY;
+const int SQLTagSink::HEARTBEAT_CYCLES;
+const int SQLTagSink::DEMAND_PERIOD;
+
+SQLTagSink::SQLTagSink( SQLDriver* sqlDriver,
+                        TagWriteInterface* writeInterface,
+                        int policy,
+                        int queueSize,
+                        int cycleTime,
+                        MetricsRegistry* metrics ) : TagSink( "sql", policy, queueSize, cycleTime, metrics )
+{
+    this->sqlDriver = sqlDriver;
+    this->writeInterface = writeInterface;
+    this->laidOut = false;
+    this->tablesReady = false;
+    this->tablesRetry = std::chrono::steady_clock::now();
+    this->failed = false;
+    this->heartbeat = 0;
+    this->demandCheck = std::chrono::steady_clock::now();
+
+    /// register the metrics...
+    metrics->addHistogram( "tagsync_read_duration_seconds",
+                           "Duration of refreshing the tags table.", "", &this->readDuration );
+    metrics->addHistogram( "tagsync_write_duration_seconds",
+                           "Duration of writing the flagged tags.", "", &this->writeDuration );
+    metrics->addCounter( "tagsync_tag_updates_total",
+                         "Changed tag values written to the tags table.", "", &this->tagUpdates );
+    metrics->addCounter( "tagsync_db_errors_total",
+                         "Failed database cycles of the tag synchronizer.", "", &this->dbErrors );
+}
+
+void SQLTagSink::apply_layout( const TagLayout& layout )
+{
+    std::map<int,TagRow> _rows;
+
+    for( size_t i = 0; i < layout.rows.size(); i++ )
+    {
+        _rows[ layout.rows[ i ].id ] = layout.rows[ i ];
+    }
+
+    /// the rows of the removed tags are deleted...
+    for( std::map<int,TagRow>::iterator _it = this->rows.begin(); _it != this->rows.end(); _it++ )
+    {
+        if( _rows.find( _it->first ) == _rows.end() )
+        {
+            this->removedRows.insert( _it->first );
+            this->replacedRows.erase( _it->first );
+            this->changedValues.erase( _it->first );
+        }
+    }
+
+    /// ...the new and changed ones replaced, the unchanged ones keep their rows
+    for( std::map<int,TagRow>::iterator _it = _rows.begin(); _it != _rows.end(); _it++ )
+    {
+        std::map<int,TagRow>::iterator _old = this->rows.find( _it->first );
+
+        if( _old != this->rows.end() && _old->second.sameTag( _it->second ) )
+        {
+            if( _old->second.value != _it->second.value || _old->second.validity != _it->second.validity )
+            {
+                this->changedValues.insert( _it->first );
+            }
+            continue;
+        }
+
+        this->replacedRows.insert( _it->first );
+        this->removedRows.erase( _it->first );
+        this->changedValues.erase( _it->first );
+    }
+
+    this->rows.swap( _rows );
+    this->laidOut = true;
+}
+
+void SQLTagSink::apply_value( const TagChange& change )
+{
+    std::map<int,TagRow>::iterator _it = this->rows.find( change.id );
+
+    if( _it == this->rows.end() ) return;
+
+    _it->second.value = change.value;
+    _it->second.validity = change.validity;
+
+    /// a replaced row is written with its value
+    if( this->replacedRows.find( change.id ) == this->replacedRows.end() )
+    {
+        this->changedValues.insert( change.id );
+    }
+}
+
+std::string SQLTagSink::row_sql( const TagRow& row )
+{
+    std::stringstream sql;
+
+    sql << "(";
+    sql << row.id << ",";
+    sql << "'" << row.name << "',";
+    sql << "'" << row.deviceId << "',";
+    sql << "'" << row.blockId << "',";
+    sql << row.address << ",";
+    sql << "'" << row.type << "',";
+    sql << row.subAddress << ",";
+    sql << "'" << row.validity << "',";
+    sql << "'" << row.multiple << "',";
+    sql << "'" << row.add + "',";
+    sql << row.wordSwap << ",";
+    sql << row.divider << ",";
+    sql << "'" << row.value << "',";
+    sql << "'" << row.value << "',";
+    sql << "0,";
+    sql << "0";
+    sql << ")";
+
+    return sql.str();
+}
+
+void SQLTagSink::build_tables() throw( std::string )
+{
+    /// open the connection
+    try
+    {
+        this->sqlDriver->connect();
+    }
+    catch( SQLDriverException ex )
+    {
+        throw ex.description;
+    }
+
+    /// the sql stringstream
+    std::stringstream sql;
+
+    /// delete the existing datatables
+    try
+    {
+        sql << "DROP TABLE tags;";
+        this->sqlDriver->execute( sql.str() );
+        sql.str("");
+
+        sql << "DROP TABLE control;";
+        this->sqlDriver->execute( sql.str() );
+    }
+    catch( SQLDriverException )
+    {
+        /// doing nothing :-)
+    }
+
+    /// create datatables
+    try
+    {
+        /// create tags table
+        sql.str("");
+        sql << "CREATE TABLE tags";
+        sql << "(";
+        sql << "id int(11) NOT NULL,";
+        sql << "name varchar(500) NOT NULL,";
+        sql << "device_id varchar(500) NOT NULL,";
+        sql << "block_id varchar(500) NOT NULL,";
+        sql << "address int(11) NOT NULL,";
+        sql << "type varchar(100) NOT NULL,";
+        sql << "sub_address int(11) DEFAULT 0,";
+        sql << "validity varchar(100) DEFAULT \"undefined\",";
+        sql << "multiple varchar(500) DEFAULT \"1\",";
+        sql << "_add varchar(500) DEFAULT \"0\",";
+        sql << "word_swap int(11) DEFAULT 0,";
+        sql << "divider int(11) DEFAULT 1,";
+        sql << "value varchar(500) DEFAULT \"0\",";
+        sql << "write_value varchar(500) DEFAULT \"0\",";
+        sql << "write_flag int(11) DEFAULT 0,";
+        sql << "demand int(11) DEFAULT 0,";
+        sql << "PRIMARY KEY (id)";
+        sql << ")";
+        sql << "DEFAULT CHARSET=utf8 COLLATE=utf8_hungarian_ci ENGINE=MEMORY;";
+        this->sqlDriver->execute( sql.str() );
+
+        /// create control table
+        sql.str("");
+        sql << "CREATE TABLE control";
+        sql << "(";
+        sql << "row_key int(11) NOT NULL,";
+        sql << "write_flag int(11) NOT NULL,";
+        sql << "heartbeat int(11),";
+        sql << "PRIMARY KEY (row_key)";
+        sql << ")";
+        sql << "DEFAULT CHARSET=utf8 COLLATE=utf8_hungarian_ci ENGINE=MEMORY;";
+        this->sqlDriver->execute( sql.str() );
+
+        /// insert tags to tagtable, BULK_ROWS rows per statement
+        std::map<int,TagRow>::iterator it = this->rows.begin();
+        while( it != this->rows.end() )
+        {
+            sql.str("");
+            sql << "INSERT INTO tags VALUES";
+            for( int i = 0; i < BULK_ROWS && it != this->rows.end(); i++, it++ )
+            {
+                sql << ( i > 0 ? "," : "" ) << row_sql( it->second );
+            }
+            sql << ";";
+
+            this->sqlDriver->execute( sql.str() );
+        }
+
+        /// insert row to control table
+        sql.str("");
+        sql << "INSERT INTO control VALUES(0,0,0);";
+        this->sqlDriver->execute( sql.str() );
+
+    }
+    catch( SQLDriverException ex )
+    {
+        this->sqlDriver->close();
+        throw ex.description;
+    }
+
+    /// close the connection
+    this->sqlDriver->close();
+}
+
+void SQLTagSink::flush_rows()
+{
+    if( this->removedRows.empty() && this->replacedRows.empty() && this->changedValues.empty() )
+    {
+        return;
+    }
+
+    std::chrono::steady_clock::time_point _start = std::chrono::steady_clock::now();
+
+    /// the written rows are dropped from the sets one by one, an error keeps the rest
+    try
+    {
+        /// connect to DB
+        this->sqlDriver->connect();
+
+        while( !this->removedRows.empty() )
+        {
+            std::stringstream sql;
+            sql << "DELETE FROM tags WHERE id=" << *this->removedRows.begin() << ";";
+            this->sqlDriver->execute( sql.str() );
+            this->removedRows.erase( this->removedRows.begin() );
+        }
+
+        while( !this->replacedRows.empty() )
+        {
+            std::stringstream sql;
+            sql << "REPLACE INTO tags VALUES" << row_sql( this->rows[ *this->replacedRows.begin() ] ) << ";";
+            this->sqlDriver->execute( sql.str() );
+            this->replacedRows.erase( this->replacedRows.begin() );
+        }
+
+        while( !this->changedValues.empty() )
+        {
+            const TagRow& _row = this->rows[ *this->changedValues.begin() ];
+
+            std::stringstream sql;
+            sql << "UPDATE tags SET value='" << _row.value << "',validity='" << _row.validity << "' ";
+            sql << "WHERE id=" << _row.id;
+            this->sqlDriver->execute( sql.str() );
+            this->changedValues.erase( this->changedValues.begin() );
+            this->tagUpdates.add();
+        }
+
+        /// close the connection
+        this->sqlDriver->close();
+        this->failed = false;
+    }
+    catch( SQLDriverException ex )
+    {
+        this->dbErrors.add();
+        this->sqlDriver->close();
+
+        if( !this->failed )
+        {
+            this->failed = true;
+            Logger::log( Logger::LEVEL_WARNING, "Tags table update postponed: " + ex.description );
+        }
+    }
+
+    this->readDuration.record( std::chrono::duration_cast<std::chrono::microseconds>(
+                                   std::chrono::steady_clock::now() - _start ).count() );
+}
+
+void SQLTagSink::do_write()
+{
+    std::chrono::steady_clock::time_point _start = std::chrono::steady_clock::now();
+
+    try
+    {
+        /// open the connection
+        this->sqlDriver->connect();
+
+        /// check global write flag
+        std::stringstream sql;
+        sql << "SELECT write_flag FROM control WHERE row_key=0;";
+        SQLResult res = this->sqlDriver->executeQuery( sql.str() );
+        SQLRow row = res.getRow( 0 );
+        int write_flag = row.getInt( "write_flag" );
+
+        /// if write_flag = 0 -> exit
+        if( write_flag == 0 )
+        {
+            this->sqlDriver->close();
+            return;
+        }
+
+        /// get tags for write
+        sql.str("");
+        sql << "SELECT id, write_value FROM tags WHERE write_flag=1;";
+        SQLResult res_2 = this->sqlDriver->executeQuery( sql.str() );
+        bool _complete = true;
+        for( int i = 0; i < res_2.getRowNum(); i++ )
+        {
+            /// the decode stage writes the values to the modbus driver
+            SQLRow row_2 = res_2.getRow( i );
+            if( !this->writeInterface->requestWrite( row_2.getInt( "id" ), row_2.getString( "write_value" ) ) )
+            {
+                _complete = false;
+                break;
+            }
+        }
+
+        /// wake the decode stage, it calls doWrite()
+        this->writeInterface->commitWrites();
+
+        /// a full write queue keeps the flags, the next cycle requests them again
+        if( _complete )
+        {
+            sql.str("");
+            sql << "UPDATE control SET write_flag=0 WHERE row_key=0;";
+            this->sqlDriver->execute( sql.str() );
+            sql.str("");
+            sql << "UPDATE tags SET write_flag=0 WHERE write_flag=1;";
+            this->sqlDriver->execute( sql.str() );
+        }
+
+        /// close connection
+        this->sqlDriver->close();
+    }
+    catch( SQLDriverException )
+    {
+        this->dbErrors.add();
+        this->sqlDriver->close();
+    }
+
+    this->writeDuration.record( std::chrono::duration_cast<std::chrono::microseconds>(
+                                    std::chrono::steady_clock::now() - _start ).count() );
+}
+
+void SQLTagSink::do_demand()
+{
+    try
+    {
+        /// open the connection
+        this->sqlDriver->connect();
+
+        /// get the demanded tags
+        std::string sql = "SELECT id FROM tags WHERE demand=1;";
+        SQLResult res = this->sqlDriver->executeQuery( sql );
+        bool _requested = false;
+        for( int i = 0; i < res.getRowNum(); i++ )
+        {
+            SQLRow row = res.getRow( i );
+            if( !this->writeInterface->requestDemand( row.getInt( "id" ) ) )
+            {
+                break;
+            }
+            _requested = true;
+        }
+
+        /// wake the decode stage
+        if( _requested )
+        {
+            this->writeInterface->commitWrites();
+        }
+
+        /// close connection
+        this->sqlDriver->close();
+    }
+    catch( SQLDriverException )
+    {
+        this->dbErrors.add();
+        this->sqlDriver->close();
+    }
+}
+
+void SQLTagSink::do_heartbeat()
+{
+    try
+    {
+        /// open the connection
+        this->sqlDriver->connect();
+
+        /// do the heartbeat
+        std::string sql = "UPDATE control SET heartbeat=0 WHERE row_key=0;";
+        this->sqlDriver->execute( sql );
+
+        /// close connection
+        this->sqlDriver->close();
+    }
+    catch( SQLDriverException )
+    {
+        this->sqlDriver->close();
+    }
+}
+
+void SQLTagSink::process( std::vector<TagChange>& changes )
+{
+    for( size_t i = 0; i < changes.size(); i++ )
+    {
+        if( changes[ i ].type == TagChange::TYPE_LAYOUT )
+        {
+            this->apply_layout( *changes[ i ].layout );
+        }
+        else
+        {
+            this->apply_value( changes[ i ] );
+        }
+    }
+
+    /// the tables are built from the first layout
+    if( !this->tablesReady )
+    {
+        if( !this->laidOut || std::chrono::steady_clock::now() < this->tablesRetry )
+        {
+            return;
+        }
+
+        try
+        {
+            this->build_tables();
+        }
+        catch( std::string ex )
+        {
+            this->dbErrors.add();
+            this->tablesRetry = std::chrono::steady_clock::now() + std::chrono::milliseconds( TABLE_RETRY );
+
+            if( !this->failed )
+            {
+                this->failed = true;
+                Logger::log( Logger::LEVEL_WARNING, "Tags table is not ready: " + ex );
+            }
+            return;
+        }
+
+        this->removedRows.clear();
+        this->replacedRows.clear();
+        this->changedValues.clear();
+        this->failed = false;
+        this->tablesReady = true;
+
+        std::stringstream _log;
+        _log << "Tags table loaded: " << this->rows.size() << " tags";
+        Logger::log( Logger::LEVEL_INFO, _log.str() );
+    }
+
+    /// values first, then the write flags
+    this->flush_rows();
+    this->do_write();
+
+    /// the demands are renewed before their lease ends
+    if( std::chrono::steady_clock::now() - this->demandCheck >= std::chrono::milliseconds( DEMAND_PERIOD ) )
+    {
+        this->demandCheck = std::chrono::steady_clock::now();
+        this->do_demand();
+    }
+
+    /// heartbeat :-)
+    if( ++this->heartbeat > HEARTBEAT_CYCLES )
+    {
+        this->heartbeat = 0;
+        this->do_heartbeat();
+    }
+}
+
+}
@@ -0,0 +1,145 @@
+#ifndef SQLTAGSINK_H
+#define SQLTAGSINK_H
+
+#include <chrono>
+#include <map>
+#include <set>
+
+#include "tagsink.h"
+#include "../SQLDriver/sqldriver.h"
+
+namespace ModbusEngine
+{
+
+/**
+ * @brief The SQLTagSink class
+ *
+ * The sink of the tags and control tables.
+ *
+ * The tables are built by the sink thread from the first layout ( it
+ * carries the current values, the restored values of a warm restart are
+ * "stale" ), a layout of a reload replaces the changed rows in place.
+ * The sink keeps the rows as they should be in the table, the rows and
+ * values not written yet ( database errors ) are retried in the next
+ * cycle, so the table converges to the latest values.
+ *
+ * The write flags are checked in every cycle ( at most every cycleTime ),
+ * the flagged values are requested from the decode stage
+ * ( TagWriteInterface ). The demand flags ( a client is interested in the
+ * tag, its on-demand block is polled ) are renewed every DEMAND_PERIOD.
+ */
+class SQLTagSink : public TagSink
+{
+
+private:
+    /// rows of one INSERT statement of the tags table load
+    static const int BULK_ROWS = 500;
+    /// millisecs between two tries of building the tables
+    static const int TABLE_RETRY = 1000;
+    /// write checks between two heartbeats
+    static const int HEARTBEAT_CYCLES = 60;
+    /// millisecs between two demand checks
+    static const int DEMAND_PERIOD = 500;
+
+    /// sql driver for access database
+    SQLDriver* sqlDriver;
+    /// delivered write interface ( the decode stage )
+    TagWriteInterface* writeInterface;
+
+    /// the rows of the tags table by tag id
+    std::map<int,TagRow> rows;
+    /// not written yet: the removed rows, the new or changed rows and the changed values
+    std::set<int> removedRows;
+    std::set<int> replacedRows;
+    std::set<int> changedValues;
+
+    /// a layout is taken, the tables can be built
+    bool laidOut;
+    /// the tables are built and loaded
+    bool tablesReady;
+    /// the next try of building the tables
+    std::chrono::steady_clock::time_point tablesRetry;
+    /// the failure of the table build ( or of a row update ) is logged
+    bool failed;
+
+    /// write checks since the last heartbeat
+    int heartbeat;
+    /// the last demand check
+    std::chrono::steady_clock::time_point demandCheck;
+
+    /// metrics (lock-free)
+    Histogram readDuration;
+    Histogram writeDuration;
+    Counter tagUpdates;
+    Counter dbErrors;
+
+    /**
+     * @brief apply_layout
+     * @param layout -> the new tag list
+     */
+    void apply_layout( const TagLayout& layout );
+
+    /**
+     * @brief apply_value
+     * @param change -> a value change
+     */
+    void apply_value( const TagChange& change );
+
+    /**
+     * @brief row_sql
+     * @param row -> the row
+     * @return the values of the tags table row ( "(...)" )
+     */
+    static std::string row_sql( const TagRow& row );
+
+    /**
+     * @brief build_tables
+     *
+     * Builds the tags and control tables and loads the rows.
+     * The function throws std::string exception.
+     */
+    void build_tables() throw( std::string );
+
+    /**
+     * @brief flush_rows
+     *
+     * Writes the removed, replaced rows and the changed values.
+     */
+    void flush_rows();
+
+    /// read the write flags, the demand flags and the heartbeat
+    void do_write();
+    void do_demand();
+    void do_heartbeat();
+
+protected:
+    /**
+     * @brief process
+     * @param changes -> the changes of the cycle
+     *
+     * Inherited function from TagSink class.
+     */
+    void process( std::vector<TagChange>& changes );
+
+public:
+    /**
+     * @brief SQLTagSink
+     * @param sqlDriver         -> delivered sql driver
+     * @param writeInterface    -> delivered write interface
+     * @param policy            -> TagSink::POLICY_LATEST or POLICY_BLOCK
+     * @param queueSize         -> slots of the ring buffer
+     * @param cycleTime         -> millisecs between two write checks
+     * @param metrics           -> delivered metrics registry
+     */
+    SQLTagSink( SQLDriver* sqlDriver,
+                TagWriteInterface* writeInterface,
+                int policy,
+                int queueSize,
+                int cycleTime,
+                MetricsRegistry* metrics );
+
+};
+
+}
+
+#endif // SQLTAGSINK_H
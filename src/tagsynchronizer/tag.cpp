@@ -16,8 +16,8 @@ Tag::Tag( int id,
 {
     this->id = id;
     this->name = name;
-    this->deviceId = deviceId;
-    this->blockId = blockId;
+    this->deviceId = SymbolTable::intern( deviceId );
+    this->blockId = SymbolTable::intern( blockId );
     this->address = address;
     this->subAddress = subAddress;
     this->multiple = multiple;
@@ -26,4 +26,20 @@ Tag::Tag( int id,
     this->divider = divider;
 }
 
+void Tag::setInvalid( MBError::Code error )
+{
+    this->validity = MBError::toString( error );
+    this->value = "#";
+}
+
+void Tag::setValid( MBError::Code error )
+{
+    this->validity = ( error == MBError::STALE_DATA ) ? "stale" : "valid";
+}
+
+bool Tag::isReadable( MBError::Code error )
+{
+    return error == MBError::NO_ERROR || error == MBError::STALE_DATA;
+}
+
 }
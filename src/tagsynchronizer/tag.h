@@ -18,8 +18,8 @@ class Tag
 public:
     int id;                     /// the tag's id
     std::string name;           /// the tag's unique name
-    std::string deviceId;       /// the target device ID
-    std::string blockId;        /// the target block ID of the target device
+    Symbol deviceId;            /// the target device ID ( interned )
+    Symbol blockId;             /// the target block ID of the target device ( interned )
     int address;                /// the target block's offset (word position)
     int subAddress;             /// the target block's subAddress
     std::string multiple;       /// multiple value
@@ -57,6 +57,8 @@ public:
          bool wordSwap,
          int divider );
 
+    virtual ~Tag(){}
+
     /**
      * @brief readValueFromModbusDriver
      * @param interface -> delegated modbus driver data interface object
@@ -73,6 +75,30 @@ public:
      */
     virtual void writeValueToModbusDriver( ModbusDriverDataInterface* interface ) = 0;
 
+protected:
+    /**
+     * @brief setInvalid
+     * @param error -> the error code of the modbus driver
+     *
+     * Sets the validity to the name of the error and invalidates the value.
+     */
+    void setInvalid( MBError::Code error );
+
+    /**
+     * @brief setValid
+     * @param error -> the error code of a successful read ( NO_ERROR or STALE_DATA )
+     *
+     * Sets the validity to "valid", or to "stale" for a restored last-known value.
+     */
+    void setValid( MBError::Code error );
+
+    /**
+     * @brief isReadable
+     * @param error -> the error code of the modbus driver
+     * @return the read value can be used ( NO_ERROR or STALE_DATA )
+     */
+    static bool isReadable( MBError::Code error );
+
 };
 
 } // namespace ModbusEngine
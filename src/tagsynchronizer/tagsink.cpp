@@ -0,0 +1,196 @@
+#include <chrono>
+
+#include "tagsink.h"
+
+namespace ModbusEngine {
+
+const int TagChange::TYPE_VALUE;
+const int TagChange::TYPE_LAYOUT;
+const int TagSink::POLICY_LATEST;
+const int TagSink::POLICY_BLOCK;
+const int TagSink::BLOCK_WAIT;
+
+bool TagRow::sameTag( const TagRow& row ) const
+{
+    return this->type == row.type &&
+           this->name == row.name &&
+           this->deviceId == row.deviceId &&
+           this->blockId == row.blockId &&
+           this->address == row.address &&
+           this->subAddress == row.subAddress &&
+           this->multiple == row.multiple &&
+           this->add == row.add &&
+           this->wordSwap == row.wordSwap &&
+           this->divider == row.divider;
+}
+
+TagSink::TagSink( const std::string& name,
+                  int policy,
+                  int queueSize,
+                  int cycleTime,
+                  MetricsRegistry* metrics ) : ring( queueSize )
+{
+    this->name = name;
+    this->policy = policy;
+    this->cycleTime = cycleTime;
+    this->conflating = false;
+    this->pending = false;
+
+    /// register the metrics
+    std::string _labels = MetricsRegistry::label( "sink", name );
+
+    metrics->addCounter( "tagsink_changes_total",
+                         "Tag changes taken by the sink.", _labels, &this->changes );
+    metrics->addCounter( "tagsink_conflated_total",
+                         "Tag changes conflated by a full ring ( latest policy ).", _labels, &this->conflated );
+    metrics->addCounter( "tagsink_blocked_total",
+                         "Publishes waiting for a full ring ( block policy ).", _labels, &this->blocked );
+}
+
+void TagSink::conflate( const TagChange& change )
+{
+    std::lock_guard<std::mutex> _lock( this->latestMutex );
+
+    if( change.type == TagChange::TYPE_LAYOUT )
+    {
+        /// the layout carries the current values of all tags
+        this->conflated.add( this->latestValues.size() );
+        this->latestValues.clear();
+        this->latestLayout = change.layout;
+    }
+    else
+    {
+        std::map<int,TagChange>::iterator _it = this->latestValues.find( change.id );
+
+        if( _it != this->latestValues.end() )
+        {
+            _it->second = change;
+            this->conflated.add();
+        }
+        else
+        {
+            this->latestValues[ change.id ] = change;
+        }
+    }
+
+    this->conflating = true;
+}
+
+void TagSink::publish( const TagChange& change )
+{
+    if( this->policy == POLICY_LATEST )
+    {
+        /// after a conflation the ring is skipped until the sink takes the conflated changes
+        if( this->conflating || !this->ring.push( change ) )
+        {
+            this->conflate( change );
+        }
+        return;
+    }
+
+    if( this->ring.push( change ) ) return;
+
+    this->blocked.add();
+
+    while( !this->ring.push( change ) )
+    {
+        std::unique_lock<std::mutex> _lock( this->waitMutex );
+        this->pending = true;
+        this->waitCond.notify_one();
+        this->spaceCond.wait_for( _lock, std::chrono::milliseconds( BLOCK_WAIT ) );
+    }
+}
+
+void TagSink::flush()
+{
+    {
+        std::lock_guard<std::mutex> _lock( this->waitMutex );
+        this->pending = true;
+    }
+    this->waitCond.notify_one();
+}
+
+void TagSink::take( std::vector<TagChange>& changes )
+{
+    TagChange _change;
+
+    /// the publisher does not touch the ring while it conflates
+    if( !this->conflating )
+    {
+        while( this->ring.pop( _change ) )
+        {
+            changes.push_back( _change );
+        }
+        return;
+    }
+
+    std::lock_guard<std::mutex> _lock( this->latestMutex );
+
+    while( this->ring.pop( _change ) )
+    {
+        changes.push_back( _change );
+    }
+
+    if( this->latestLayout )
+    {
+        _change.type = TagChange::TYPE_LAYOUT;
+        _change.layout = this->latestLayout;
+        changes.push_back( _change );
+        this->latestLayout.reset();
+    }
+
+    for( std::map<int,TagChange>::iterator _it = this->latestValues.begin(); _it != this->latestValues.end(); _it++ )
+    {
+        changes.push_back( _it->second );
+    }
+
+    this->latestValues.clear();
+    this->conflating = false;
+}
+
+void TagSink::processCycle()
+{
+    std::vector<TagChange> _changes;
+
+    this->take( _changes );
+    this->spaceCond.notify_one();
+    this->changes.add( _changes.size() );
+
+    this->process( _changes );
+}
+
+std::string TagSink::readName()
+{
+    return this->name;
+}
+
+int TagSink::toPolicy( std::string name )
+{
+    if( name == "latest" ) return POLICY_LATEST;
+    if( name == "block" ) return POLICY_BLOCK;
+
+    return -1;
+}
+
+void TagSink::run()
+{
+    while( true )
+    {
+        {
+            std::unique_lock<std::mutex> _lock( this->waitMutex );
+
+            if( !this->pending )
+            {
+                this->waitCond.wait_for( _lock, std::chrono::milliseconds( this->cycleTime ) );
+            }
+
+            this->pending = false;
+        }
+
+        this->processCycle();
+    }
+}
+
+void TagSink::halt(){}
+
+}
@@ -0,0 +1,274 @@
+#ifndef TAGSINK_H
+#define TAGSINK_H
+
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "../Core/metrics.h"
+#include "../Core/mpscqueue.hpp"
+#include "../Core/thread.hpp"
+
+namespace ModbusEngine
+{
+
+/**
+ * @brief The TagRow class
+ *
+ * The parameters and the current value of a tag, as the sinks see it.
+ */
+class TagRow
+{
+
+public:
+    int id;
+    std::string name;
+    std::string deviceId;
+    std::string blockId;
+    int address;
+    int subAddress;
+    std::string type;
+    std::string multiple;
+    std::string add;
+    bool wordSwap;
+    int divider;
+    std::string value;
+    std::string validity;
+
+    /**
+     * @brief sameTag
+     * @param row -> an other row
+     * @return the parameters are equal ( the value is not compared )
+     */
+    bool sameTag( const TagRow& row ) const;
+
+};
+
+/**
+ * @brief The TagLayout class
+ *
+ * Immutable snapshot of the tag list with the current values, published
+ * at start and after every reload. It supersedes the earlier changes.
+ */
+class TagLayout
+{
+
+public:
+    std::vector<TagRow> rows;
+
+};
+
+/**
+ * @brief The TagChange class
+ *
+ * An item of the change stream.
+ */
+class TagChange
+{
+
+public:
+    /// the value or the validity of a tag changed
+    static const int TYPE_VALUE = 0;
+    /// a new tag list ( start, reload )
+    static const int TYPE_LAYOUT = 1;
+
+    int type;
+    /// TYPE_VALUE: the tag and its new value
+    int id;
+    std::string value;
+    std::string validity;
+    /// TYPE_LAYOUT: the tag list
+    std::shared_ptr<const TagLayout> layout;
+
+};
+
+/**
+ * @brief The TagWriteInterface class
+ *
+ * The write and demand requests of the sinks, applied by the decode stage
+ * ( the TagSynchronizer ).
+ */
+class TagWriteInterface
+{
+
+public:
+    /**
+     * @brief requestWrite
+     * @param id    -> the tag
+     * @param value -> the value to write
+     * @return false when the write queue is full
+     *
+     * Can be called from any sink thread.
+     */
+    bool virtual requestWrite( int id, const std::string& value ) = 0;
+
+    /**
+     * @brief requestDemand
+     * @param id -> the tag
+     * @return false when the write queue is full
+     *
+     * A client is interested in the tag, its on-demand block is polled
+     * for a while. Can be called from any sink thread.
+     */
+    bool virtual requestDemand( int id ) = 0;
+
+    /**
+     * @brief commitWrites
+     *
+     * Wakes the decode stage, the requested writes and demands are applied now.
+     */
+    void virtual commitWrites() = 0;
+
+};
+
+/**
+ * @brief The TagSink class
+ *
+ * A consumer of the change stream with its own thread. The decode stage
+ * ( TagSynchronizer ) publishes the changes into the bounded ring buffer
+ * of every sink, so a slow sink does not slow the polling or the other
+ * sinks, its own backpressure policy decides:
+ *
+ *   - POLICY_LATEST -> drop to latest: when the ring is full the changes
+ *                      are conflated by tag ( the older values of a tag
+ *                      are dropped ), the publisher never waits
+ *   - POLICY_BLOCK  -> the publisher waits for free space, every change
+ *                      is delivered ( a slow sink slows the decode stage )
+ *
+ * The order of the changes is kept: after the first conflation the new
+ * changes are conflated too, until the sink takes them after the ring.
+ * A conflated layout drops the conflated changes before it.
+ *
+ * The sinks implement process(), it is called in every cycle of the sink
+ * thread with the changes taken in the cycle ( maybe none ). The cycle
+ * starts at a flush() of the publisher or after cycleTime.
+ */
+class TagSink : public Thread
+{
+
+public:
+    /// backpressure policies
+    static const int POLICY_LATEST = 0;
+    static const int POLICY_BLOCK = 1;
+
+private:
+    /// millisecs a blocked publisher waits before it wakes the sink again
+    static const int BLOCK_WAIT = 10;
+
+    std::string name;
+    int policy;
+    /// max millisecs between two cycles
+    int cycleTime;
+
+    /// the ring buffer ( one producer: the decode stage )
+    MPSCQueue<TagChange> ring;
+
+    /// the conflated changes ( POLICY_LATEST ), they follow the ring
+    std::mutex latestMutex;
+    std::atomic<bool> conflating;
+    std::shared_ptr<const TagLayout> latestLayout;
+    std::map<int,TagChange> latestValues;
+
+    /// wakes the sink thread and the blocked publisher
+    std::mutex waitMutex;
+    std::condition_variable waitCond;
+    std::condition_variable spaceCond;
+    bool pending;
+
+    /// metrics (lock-free)
+    Counter changes;
+    Counter conflated;
+    Counter blocked;
+
+    /**
+     * @brief conflate
+     * @param change -> the change that does not fit into the ring
+     */
+    void conflate( const TagChange& change );
+
+    /**
+     * @brief take
+     * @param changes -> the published changes in order
+     */
+    void take( std::vector<TagChange>& changes );
+
+protected:
+    /**
+     * @brief process
+     * @param changes -> the changes of the cycle in order
+     *
+     * Called by the sink thread in every cycle.
+     */
+    void virtual process( std::vector<TagChange>& changes ) = 0;
+
+public:
+    /**
+     * @brief TagSink
+     * @param name      -> name of the sink ( label of the metrics )
+     * @param policy    -> POLICY_LATEST or POLICY_BLOCK
+     * @param queueSize -> slots of the ring buffer
+     * @param cycleTime -> max millisecs between two cycles
+     * @param metrics   -> delivered metrics registry
+     */
+    TagSink( const std::string& name, int policy, int queueSize, int cycleTime, MetricsRegistry* metrics );
+
+    virtual ~TagSink(){}
+
+    /**
+     * @brief publish
+     * @param change -> a change
+     *
+     * Called by the decode stage only. Waits for free space with POLICY_BLOCK.
+     */
+    void publish( const TagChange& change );
+
+    /**
+     * @brief flush
+     *
+     * Wakes the sink thread after the changes of a decode cycle.
+     */
+    void flush();
+
+    /**
+     * @brief processCycle
+     *
+     * Takes the published changes and processes them in the calling thread.
+     */
+    void processCycle();
+
+    /**
+     * @brief readName
+     * @return name of the sink
+     */
+    std::string readName();
+
+    /**
+     * @brief toPolicy
+     * @param name -> "latest" or "block"
+     * @return the policy, -1 when the name is unknown
+     */
+    static int toPolicy( std::string name );
+
+    /**
+     * @brief run
+     *
+     * Inherited function from Thread class.
+     */
+    void run();
+
+    /**
+     * @brief halt
+     *
+     * Inherited function from Thread class.
+     */
+    void halt();
+
+};
+
+}
+
+#endif // TAGSINK_H
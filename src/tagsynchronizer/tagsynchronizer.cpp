@@ -1,4 +1,7 @@
+#include <chrono>
+
 #include "tagsynchronizer.h"
+#include "sqltagsink.h"
 #include "bittag.h"
 #include "bytetag.h"
 #include "ubytetag.h"
@@ -8,412 +11,447 @@
 #include "udwordtag.h"
 #include "real16tag.h"
 #include "../Core/conversion.hpp"
+#include "../Core/logger.h"
 
 namespace ModbusEngine {
 
-TagSynchronizer::TagSynchronizer( MBPro* mbpro, ModbusDriverDataInterface* driverInterface ) throw( std::string )
+const int TagSynchronizer::WRITE_QUEUE;
+const int TagSynchronizer::SINK_CYCLE;
+const int TagSynchronizer::DEMAND_LEASE;
+
+TagSynchronizer::TagSynchronizer( MBPro* mbpro,
+                                  ModbusDriverDataInterface* driverInterface,
+                                  MetricsRegistry* metrics,
+                                  SQLDriver* sqlDriver ) throw( std::string ) : writeQueue( WRITE_QUEUE )
 {
     this->mbpro = mbpro;
     this->driverInterface = driverInterface;
     this->cycleTime = 50;
+    this->layoutPending = true;
+    this->reloadPending = false;
+    this->writesPending = false;
+    this->tagArena = new Arena();
+
+    /// register the metrics...
+    metrics->addHistogram( "tagsync_decode_duration_seconds",
+                           "Duration of decoding the tags and publishing the changes.", "", &this->decodeDuration );
+    metrics->addCounter( "tagsync_tag_writes_total",
+                         "Tag values written to the modbus driver.", "", &this->tagWrites );
+    metrics->addGauge( "tagsync_tags",
+                       "Number of the synchronized tags.", "", &this->tagCount );
 
     /// create driver object...
     try
     {
-        this->mysqlDriver = new MySQLDriver( this->mbpro->db.dbUrl,
-                                             this->mbpro->db.dbPort,
-                                             this->mbpro->db.dbName,
-                                             this->mbpro->db.dbUser,
-                                             this->mbpro->db.dbPass );
+        this->sqlDriver = sqlDriver;
+        if( this->sqlDriver == NULL )
+        {
+            this->sqlDriver = new MySQLDriver( this->mbpro->db.dbUrl,
+                                               this->mbpro->db.dbPort,
+                                               this->mbpro->db.dbName,
+                                               this->mbpro->db.dbUser,
+                                               this->mbpro->db.dbPass );
+        }
     }
     catch( SQLDriverException ex )
     {
         throw ex.description;
     }
 
+    /// create the sinks, the tables are built by the sink thread...
+    this->sinks.push_back( new SQLTagSink( this->sqlDriver,
+                                           this,
+                                           TagSink::toPolicy( this->mbpro->sinks.sql.policy ),
+                                           this->mbpro->sinks.sql.queueSize,
+                                           SINK_CYCLE,
+                                           metrics ) );
+
     /// build the tag map...
     this->build_tag_map();
-
-    /// build SQL data tables....
-    try
-    {
-        this->build_tables();
-    }
-    catch( std::string ex )
-    {
-        throw ex;
-    }
+    this->tagCount.set( this->tagMap.size() );
 }
 
 void TagSynchronizer::build_tag_map()
 {
-    // build tagMap, writeFlags and tagCache maps
+    // build tagMap, the caches are filled by the first layout
     for( std::vector<MBPro_Tag>::iterator _it = this->mbpro->taglist.tags.begin();
              _it != this->mbpro->taglist.tags.end(); _it++ )
     {
-         MBPro_Tag _t = *_it;
+         Tag* _tag = this->create_tag( *_it, this->tagArena );
 
-         if( _t.type == "bit" )
-         {
-             BitTag* _tag = new BitTag( _t.id,
-                                        _t.name,
-                                        _t.deviceId,
-                                        _t.blockId,
-                                        _t.address,
-                                        _t.subAddress,
-                                        _t.multiple,
-                                        _t.add,
-                                        _t.wordSwap,
-                                        _t.divider );
-
-             this->tagMap[ _t.id ] = _tag;
-             this->tagValueCache[ _t.id ] = _tag->value;
-             this->tagValidityCache[ _t.id ] = _tag->validity;
-         }
-         else if( _t.type == "byte" )
-         {
-             ByteTag* _tag = new ByteTag( _t.id,
-                                          _t.name,
-                                          _t.deviceId,
-                                          _t.blockId,
-                                          _t.address,
-                                          _t.subAddress,
-                                          _t.multiple,
-                                          _t.add,
-                                          _t.wordSwap,
-                                          _t.divider );
-
-             this->tagMap[ _t.id ] = _tag;
-             this->tagValueCache[ _t.id ] = _tag->value;
-             this->tagValidityCache[ _t.id ] = _tag->validity;
-         }
-         else if( _t.type == "ubyte" )
-         {
-             UByteTag* _tag = new UByteTag( _t.id,
-                                            _t.name,
-                                            _t.deviceId,
-                                            _t.blockId,
-                                            _t.address,
-                                            _t.subAddress,
-                                            _t.multiple,
-                                            _t.add,
-                                            _t.wordSwap,
-                                            _t.divider );
-
-             this->tagMap[ _t.id ] = _tag;
-             this->tagValueCache[ _t.id ] = _tag->value;
-             this->tagValidityCache[ _t.id ] = _tag->validity;
-         }
-         else if( _t.type == "word" )
-         {
-             WordTag* _tag = new WordTag( _t.id,
-                                          _t.name,
-                                          _t.deviceId,
-                                          _t.blockId,
-                                          _t.address,
-                                          _t.subAddress,
-                                          _t.multiple,
-                                          _t.add,
-                                          _t.wordSwap,
-                                          _t.divider );
-
-             this->tagMap[ _t.id ] = _tag;
-             this->tagValueCache[ _t.id ] = _tag->value;
-             this->tagValidityCache[ _t.id ] = _tag->validity;
-         }
-         else if( _t.type == "uword" )
-         {
-             UWordTag* _tag = new UWordTag( _t.id,
-                                            _t.name,
-                                            _t.deviceId,
-                                            _t.blockId,
-                                            _t.address,
-                                            _t.subAddress,
-                                            _t.multiple,
-                                            _t.add,
-                                            _t.wordSwap,
-                                            _t.divider );
-
-             this->tagMap[ _t.id ] = _tag;
-             this->tagValueCache[ _t.id ] = _tag->value;
-             this->tagValidityCache[ _t.id ] = _tag->validity;
-         }
-         else if( _t.type == "dword" )
-         {
-             DWordTag* _tag = new DWordTag( _t.id,
-                                            _t.name,
-                                            _t.deviceId,
-                                            _t.blockId,
-                                            _t.address,
-                                            _t.subAddress,
-                                            _t.multiple,
-                                            _t.add,
-                                            _t.wordSwap,
-                                            _t.divider );
-
-             this->tagMap[ _t.id ] = _tag;
-             this->tagValueCache[ _t.id ] = _tag->value;
-             this->tagValidityCache[ _t.id ] = _tag->validity;
-         }
-         else if( _t.type == "udword" )
-         {
-             UDWordTag* _tag = new UDWordTag( _t.id,
-                                              _t.name,
-                                              _t.deviceId,
-                                              _t.blockId,
-                                              _t.address,
-                                              _t.subAddress,
-                                              _t.multiple,
-                                              _t.add,
-                                              _t.wordSwap,
-                                              _t.divider );
-
-             this->tagMap[ _t.id ] = _tag;
-             this->tagValueCache[ _t.id ] = _tag->value;
-             this->tagValidityCache[ _t.id ] = _tag->validity;
-         }
-         else if( _t.type == "real16" )
+         if( _tag != NULL )
          {
-             Real16Tag* _tag = new Real16Tag( _t.id,
-                                              _t.name,
-                                              _t.deviceId,
-                                              _t.blockId,
-                                              _t.address,
-                                              _t.subAddress,
-                                              _t.multiple,
-                                              _t.add,
-                                              _t.wordSwap,
-                                              _t.divider );
-
-             this->tagMap[ _t.id ] = _tag;
-             this->tagValueCache[ _t.id ] = _tag->value;
-             this->tagValidityCache[ _t.id ] = _tag->validity;
+             this->tagMap[ _tag->id ] = _tag;
          }
     }
 }
 
-void TagSynchronizer::build_tables() throw( std::string )
+Tag* TagSynchronizer::create_tag( const MBPro_Tag& t, Arena* arena )
 {
-    /// open the connection
-    try
+    if( t.type == "bit" )
     {
-        this->mysqlDriver->connect();
+        return arena->create<BitTag>( t.id,
+                                      t.name,
+                                      t.deviceId,
+                                      t.blockId,
+                                      t.address,
+                                      t.subAddress,
+                                      t.multiple,
+                                      t.add,
+                                      t.wordSwap,
+                                      t.divider );
     }
-    catch( SQLDriverException ex )
+    else if( t.type == "byte" )
     {
-        throw ex.description;
+        return arena->create<ByteTag>( t.id,
+                                       t.name,
+                                       t.deviceId,
+                                       t.blockId,
+                                       t.address,
+                                       t.subAddress,
+                                       t.multiple,
+                                       t.add,
+                                       t.wordSwap,
+                                       t.divider );
     }
-
-    /// the sql stringstream
-    std::stringstream sql;
-
-    /// delete the existing datatables
-    try
+    else if( t.type == "ubyte" )
     {
-        sql << "DROP TABLE tags;";
-        this->mysqlDriver->execute( sql.str() );
-        sql.str("");
-
-        sql << "DROP TABLE control;";
-        this->mysqlDriver->execute( sql.str() );
+        return arena->create<UByteTag>( t.id,
+                                        t.name,
+                                        t.deviceId,
+                                        t.blockId,
+                                        t.address,
+                                        t.subAddress,
+                                        t.multiple,
+                                        t.add,
+                                        t.wordSwap,
+                                        t.divider );
     }
-    catch( SQLDriverException )
+    else if( t.type == "word" )
     {
-        /// doing nothing :-)
+        return arena->create<WordTag>( t.id,
+                                       t.name,
+                                       t.deviceId,
+                                       t.blockId,
+                                       t.address,
+                                       t.subAddress,
+                                       t.multiple,
+                                       t.add,
+                                       t.wordSwap,
+                                       t.divider );
     }
-
-    /// create datatables
-    try
+    else if( t.type == "uword" )
     {
-        /// create tags table
-        sql.str("");
-        sql << "CREATE TABLE tags";
-        sql << "(";
-        sql << "id int(11) NOT NULL,";
-        sql << "name varchar(500) NOT NULL,";
-        sql << "device_id varchar(500) NOT NULL,";
-        sql << "block_id varchar(500) NOT NULL,";
-        sql << "address int(11) NOT NULL,";
-        sql << "type varchar(100) NOT NULL,";
-        sql << "sub_address int(11) DEFAULT 0,";
-        sql << "validity varchar(100) DEFAULT \"undefined\",";
-        sql << "multiple varchar(500) DEFAULT \"1\",";
-        sql << "_add varchar(500) DEFAULT \"0\",";
-        sql << "word_swap int(11) DEFAULT 0,";
-        sql << "divider int(11) DEFAULT 1,";
-        sql << "value varchar(500) DEFAULT \"0\",";
-        sql << "write_value varchar(500) DEFAULT \"0\",";
-        sql << "write_flag int(11) DEFAULT 0,";
-        sql << "PRIMARY KEY (id)";
-        sql << ")";
-        sql << "DEFAULT CHARSET=utf8 COLLATE=utf8_hungarian_ci ENGINE=MEMORY;";
-        this->mysqlDriver->execute( sql.str() );
-
-        /// create control table
-        sql.str("");
-        sql << "CREATE TABLE control";
-        sql << "(";
-        sql << "row_key int(11) NOT NULL,";
-        sql << "write_flag int(11) NOT NULL,";
-        sql << "heartbeat int(11),";
-        sql << "PRIMARY KEY (row_key)";
-        sql << ")";
-        sql << "DEFAULT CHARSET=utf8 COLLATE=utf8_hungarian_ci ENGINE=MEMORY;";
-        this->mysqlDriver->execute( sql.str() );
-
-        /// insert tags to tagtable
-        std::map<int,Tag*>::iterator it = this->tagMap.begin();
-        for( ; it != this->tagMap.end(); it++ )
-        {
-            std::pair<int,Tag*> p = *it;
-            Tag* _t = p.second;
-            sql.str("");
-            sql << "INSERT INTO tags VALUES(";
-            sql << _t->id << ",";
-            sql << "'" << _t->name << "',";
-            sql << "'" << _t->deviceId << "',";
-            sql << "'" << _t->blockId << "',";
-            sql << _t->address << ",";
-            sql << "'" << _t->type << "',";
-            sql << _t->subAddress << ",";
-            sql << "'" << _t->validity << "',";
-            sql << "'" << _t->multiple << "',";
-            sql << "'" << _t->add + "',";
-            sql << _t->wordSwap << ",";
-            sql << _t->divider << ",";
-            sql << "'" << _t->value << "',";
-            sql << "'" << _t->value << "',";
-            sql << "0";
-            sql << ");";
-
-            this->mysqlDriver->execute( sql.str() );
-        }
+        return arena->create<UWordTag>( t.id,
+                                        t.name,
+                                        t.deviceId,
+                                        t.blockId,
+                                        t.address,
+                                        t.subAddress,
+                                        t.multiple,
+                                        t.add,
+                                        t.wordSwap,
+                                        t.divider );
+    }
+    else if( t.type == "dword" )
+    {
+        return arena->create<DWordTag>( t.id,
+                                        t.name,
+                                        t.deviceId,
+                                        t.blockId,
+                                        t.address,
+                                        t.subAddress,
+                                        t.multiple,
+                                        t.add,
+                                        t.wordSwap,
+                                        t.divider );
+    }
+    else if( t.type == "udword" )
+    {
+        return arena->create<UDWordTag>( t.id,
+                                         t.name,
+                                         t.deviceId,
+                                         t.blockId,
+                                         t.address,
+                                         t.subAddress,
+                                         t.multiple,
+                                         t.add,
+                                         t.wordSwap,
+                                         t.divider );
+    }
+    else if( t.type == "real16" )
+    {
+        return arena->create<Real16Tag>( t.id,
+                                         t.name,
+                                         t.deviceId,
+                                         t.blockId,
+                                         t.address,
+                                         t.subAddress,
+                                         t.multiple,
+                                         t.add,
+                                         t.wordSwap,
+                                         t.divider );
+    }
 
-        /// insert row to control table
-        sql.str("");
-        sql << "INSERT INTO control VALUES(0,0,0);";
-        this->mysqlDriver->execute( sql.str() );
+    return NULL;
+}
 
+bool TagSynchronizer::same_tag( Tag* tag, const MBPro_Tag& t )
+{
+    return tag->type == t.type &&
+           tag->name == t.name &&
+           tag->deviceId == SymbolTable::find( t.deviceId ) &&
+           tag->blockId == SymbolTable::find( t.blockId ) &&
+           tag->address == t.address &&
+           tag->subAddress == t.subAddress &&
+           tag->multiple == t.multiple &&
+           tag->add == t.add &&
+           tag->wordSwap == t.wordSwap &&
+           tag->divider == t.divider;
+}
+
+void TagSynchronizer::publish_layout()
+{
+    std::shared_ptr<TagLayout> _layout( new TagLayout() );
+    _layout->rows.reserve( this->tagMap.size() );
+
+    /// the caches are rebuilt with the current values
+    this->tagValueCache.clear();
+    this->tagValidityCache.clear();
+
+    for( std::map<int,Tag*>::iterator _it = this->tagMap.begin(); _it != this->tagMap.end(); _it++ )
+    {
+        Tag* t = _it->second;
+        t->readValueFromModbusDriver( this->driverInterface );
+
+        TagRow _row;
+        _row.id = t->id;
+        _row.name = t->name;
+        _row.deviceId = SymbolTable::name( t->deviceId );
+        _row.blockId = SymbolTable::name( t->blockId );
+        _row.address = t->address;
+        _row.subAddress = t->subAddress;
+        _row.type = t->type;
+        _row.multiple = t->multiple;
+        _row.add = t->add;
+        _row.wordSwap = t->wordSwap;
+        _row.divider = t->divider;
+        _row.value = t->value;
+        _row.validity = t->validity;
+        _layout->rows.push_back( _row );
+
+        this->tagValueCache[ t->id ] = t->value;
+        this->tagValidityCache[ t->id ] = t->validity;
     }
-    catch( SQLDriverException ex )
+
+    TagChange _change;
+    _change.type = TagChange::TYPE_LAYOUT;
+    _change.id = 0;
+    _change.layout = _layout;
+
+    for( size_t i = 0; i < this->sinks.size(); i++ )
     {
-        this->mysqlDriver->close();
-        throw ex.description;
+        this->sinks[ i ]->publish( _change );
+        this->sinks[ i ]->flush();
     }
 
-    /// close the connection
-    this->mysqlDriver->close();
+    this->layoutPending = false;
 }
 
 void TagSynchronizer::do_read()
 {
-    try
+    std::chrono::steady_clock::time_point _start = std::chrono::steady_clock::now();
+
+    if( this->layoutPending )
     {
-        /// connect to DB
-        this->mysqlDriver->connect();
+        this->publish_layout();
+    }
+    else
+    {
+        bool _published = false;
 
         std::map<int,Tag*>::iterator it = this->tagMap.begin();
         for( ; it != this->tagMap.end(); it++ )
         {
             /// get all tag and refresh the values
-            std::pair<int,Tag*> p = *it;
-            Tag* t = p.second;
+            Tag* t = it->second;
             t->readValueFromModbusDriver( this->driverInterface );
 
-            /// if the value is not cached value, update in the sql table
+            /// if the value is not cached value, publish the change
             if( t->value != tagValueCache[ t->id ] || t->validity != tagValidityCache[ t->id ] )
             {
-                std::stringstream sql;
-                sql << "UPDATE tags SET value='" << t->value << "',validity='" << t->validity << "' ";
-                sql << "WHERE id=" << t->id;
-                this->mysqlDriver->execute( sql.str() );
+                TagChange _change;
+                _change.type = TagChange::TYPE_VALUE;
+                _change.id = t->id;
+                _change.value = t->value;
+                _change.validity = t->validity;
+
+                for( size_t i = 0; i < this->sinks.size(); i++ )
+                {
+                    this->sinks[ i ]->publish( _change );
+                }
 
                 /// refresh cache...
                 tagValueCache[ t->id ] = t->value;
                 tagValidityCache[ t->id ] = t->validity;
+                _published = true;
             }
         }
 
-        /// close the connection
-        this->mysqlDriver->close();
-    }
-    catch( SQLDriverException )
-    {
-        this->mysqlDriver->close();
+        /// wake the sinks after the changes of the cycle
+        for( size_t i = 0; _published && i < this->sinks.size(); i++ )
+        {
+            this->sinks[ i ]->flush();
+        }
     }
+
+    this->decodeDuration.record( std::chrono::duration_cast<std::chrono::microseconds>(
+                                     std::chrono::steady_clock::now() - _start ).count() );
 }
 
-void TagSynchronizer::do_write()
+void TagSynchronizer::reload( MBPro* mbpro )
 {
-    try
+    this->reloadMutex.lock();
+    this->mbpro = mbpro;
+    this->reloadTags = mbpro->taglist.tags;
+    this->reloadPending = true;
+    this->reloadMutex.unlock();
+}
+
+void TagSynchronizer::apply_reload()
+{
+    std::vector<MBPro_Tag> _tags;
+
+    this->reloadMutex.lock();
+    if( !this->reloadPending )
     {
-        /// open the connection
-        this->mysqlDriver->connect();
-
-        /// check global write flag
-        std::stringstream sql;
-        sql << "SELECT write_flag FROM control WHERE row_key=0;";
-        SQLResult res = this->mysqlDriver->executeQuery( sql.str() );
-        SQLRow row = res.getRow( 0 );
-        int write_flag = row.getInt( "write_flag" );
-
-        /// if write_flag = 0 -> exit
-        if( write_flag == 0 )
-        {
-            this->mysqlDriver->close();
-            return;
-        }
+        this->reloadMutex.unlock();
+        return;
+    }
+    _tags.swap( this->reloadTags );
+    this->reloadPending = false;
+    this->reloadMutex.unlock();
+
+    /// the new map in a new arena: the unchanged tags are copied with their values
+    Arena* _arena = new Arena();
+    std::map<int,Tag*> _map;
+    int _added = 0;
+    int _changed = 0;
+    int _removed = 0;
+
+    for( std::vector<MBPro_Tag>::iterator _it = _tags.begin(); _it != _tags.end(); _it++ )
+    {
+        if( _map.find( _it->id ) != _map.end() ) continue;
+
+        Tag* _tag = this->create_tag( *_it, _arena );
+        if( _tag == NULL ) continue;
+
+        _map[ _tag->id ] = _tag;
 
-        /// get tags for write
-        sql.str("");
-        sql << "SELECT id, write_value FROM tags WHERE write_flag=1;";
-        SQLResult res_2 = this->mysqlDriver->executeQuery( sql.str() );
-        for( int i = 0; i < res_2.getRowNum(); i++ )
+        std::map<int,Tag*>::iterator _old = this->tagMap.find( _it->id );
+
+        if( _old != this->tagMap.end() && same_tag( _old->second, *_it ) )
         {
-            /// refresh all values in the modbus driver
-            SQLRow row_2 = res_2.getRow( i );
-            Tag* t = tagMap[ row_2.getInt( "id" ) ];
-            t->value = row_2.getString( "write_value" );
-            t->writeValueToModbusDriver( this->driverInterface );
+            _tag->value = _old->second->value;
+            _tag->validity = _old->second->validity;
+            continue;
         }
 
-        /// call doWrite()
-        this->driverInterface->doWrite();
+        if( _old == this->tagMap.end() ) _added++; else _changed++;
+    }
+
+    for( std::map<int,Tag*>::iterator it = this->tagMap.begin(); it != this->tagMap.end(); it++ )
+    {
+        if( _map.find( it->first ) == _map.end() ) _removed++;
+    }
+
+    /// swap the maps, the old tags are freed at once with their arena
+    this->tagMap.swap( _map );
+    this->tagCount.set( this->tagMap.size() );
+
+    delete this->tagArena;
+    this->tagArena = _arena;
 
-        /// reset write flags
-        sql.str("");
-        sql << "UPDATE control SET write_flag=0 WHERE row_key=0;";
-        this->mysqlDriver->execute( sql.str() );
-        sql.str("");
-        sql << "UPDATE tags SET write_flag=0 WHERE write_flag=1;";
-        this->mysqlDriver->execute( sql.str() );
+    /// the sinks get the new tag list in the next cycle
+    this->layoutPending = true;
 
-        /// close connection
-        this->mysqlDriver->close();
+    std::stringstream _log;
+    _log << "Tags reloaded: " << _added << " added, " << _removed << " removed, " << _changed << " changed";
+    Logger::log( Logger::LEVEL_INFO, _log.str() );
+}
+
+void TagSynchronizer::readCycle()
+{
+    this->apply_reload();
+    this->do_read();
+}
+
+void TagSynchronizer::sinkCycle()
+{
+    for( size_t i = 0; i < this->sinks.size(); i++ )
+    {
+        this->sinks[ i ]->processCycle();
     }
-    catch( SQLDriverException )
+}
+
+bool TagSynchronizer::requestWrite( int id, const std::string& value )
+{
+    TagWrite _write;
+    _write.id = id;
+    _write.value = value;
+    _write.demand = false;
+
+    return this->writeQueue.push( _write );
+}
+
+bool TagSynchronizer::requestDemand( int id )
+{
+    TagWrite _write;
+    _write.id = id;
+    _write.demand = true;
+
+    return this->writeQueue.push( _write );
+}
+
+void TagSynchronizer::commitWrites()
+{
     {
-        this->mysqlDriver->close();
+        std::lock_guard<std::mutex> _lock( this->wakeMutex );
+        this->writesPending = true;
     }
+    this->wakeCond.notify_one();
 }
 
-void TagSynchronizer::do_heartbeat()
+void TagSynchronizer::apply_writes()
 {
-    try
+    TagWrite _write;
+    bool _written = false;
+
+    while( this->writeQueue.pop( _write ) )
     {
-        /// open the connection
-        this->mysqlDriver->connect();
+        std::map<int,Tag*>::iterator it = this->tagMap.find( _write.id );
+        if( it == this->tagMap.end() ) continue;
 
-        /// do the heartbeat
-        std::string sql = "UPDATE control SET heartbeat=0 WHERE row_key=0;";
-        this->mysqlDriver->execute( sql );
+        Tag* t = it->second;
 
-        /// close connection
-        this->mysqlDriver->close();
+        /// an on-demand block is polled while it is demanded
+        if( _write.demand )
+        {
+            this->driverInterface->tryDemand( t->deviceId, t->blockId, DEMAND_LEASE );
+            continue;
+        }
+
+        /// refresh the value in the modbus driver
+        t->value = _write.value;
+        t->writeValueToModbusDriver( this->driverInterface );
+        this->tagWrites.add();
+        _written = true;
     }
-    catch( SQLDriverException )
+
+    /// call doWrite()
+    if( _written )
     {
-        this->mysqlDriver->close();
+        this->driverInterface->doWrite();
     }
 }
 
@@ -425,22 +463,42 @@ void TagSynchronizer::do_heartbeat()
 
 void TagSynchronizer::run()
 {
-    int k = 0;
+    /// the sinks work in their own threads
+    for( size_t i = 0; i < this->sinks.size(); i++ )
+    {
+        this->sinks[ i ]->startThread();
+    }
+
     while( true ) {
-        /// read...
-         this->do_read();
+        std::chrono::steady_clock::time_point _start = std::chrono::steady_clock::now();
+        std::chrono::steady_clock::time_point _deadline = _start + std::chrono::milliseconds( this->cycleTime );
+
+        /// write first, the blocks are woken up by doWrite()
+        this->apply_writes();
 
-        /// write
-        this->do_write();
+        /// a reload is applied between two cycles
+        this->apply_reload();
+
+        /// read...
+        this->do_read();
 
-        /// heartbeat :-)
-        if( ++k > 60 )
+        /// the rest of the cycle: the requested writes are applied at once
+        while( std::chrono::steady_clock::now() < _deadline )
         {
-            k = 0;
-            this->do_heartbeat();
-        }
+            std::unique_lock<std::mutex> _lock( this->wakeMutex );
+
+            if( !this->writesPending )
+            {
+                this->wakeCond.wait_until( _lock, _deadline );
+            }
 
-        Thread::msleep( this->cycleTime );
+            if( !this->writesPending ) continue;
+
+            this->writesPending = false;
+            _lock.unlock();
+
+            this->apply_writes();
+        }
     }
 }
 
@@ -1,27 +1,80 @@
 #ifndef TAGSYNCHRONIZER_H
 #define TAGSYNCHRONIZER_H
 
+#include <condition_variable>
 #include <map>
+#include <mutex>
+#include <vector>
 
+#include "../Core/arena.hpp"
+#include "../Core/metrics.h"
 #include "../Core/thread.hpp"
 #include "../mbpro.h"
 #include "tag.h"
+#include "tagsink.h"
 #include "../ModbusDriver/modbusdriverdatainterface.h"
 #include "../SQLDriver/mysqldriver.h"
 
 namespace ModbusEngine
 {
 
+/**
+ * @brief The TagWrite class
+ *
+ * A write ( or a demand ) request of a sink.
+ */
+class TagWrite
+{
+
+public:
+    int id;
+    std::string value;
+    /// the block of the tag is demanded, the value is not written
+    bool demand;
+
+};
+
 /**
  * @brief The TagSynchronizer class
  *
- * Stores the tags, refreshs tags table in database, writes data to modbusdriver.
- * Cache is working on refresh tags.
+ * Stores the tags, decodes the values of the modbus driver and publishes the
+ * changes to the sinks, writes data to modbusdriver. Cache is working on
+ * change detection.
+ *
+ * The stages of the pipeline:
+ *
+ *   driver -> decode -> change detection -> ring buffer -> sink threads
+ *
+ * The synchronizer thread is the decode stage: it reads the tags in every
+ * cycle and publishes the changed values into the ring buffer of every sink
+ * ( TagSink ), the sinks ( the SQL tables ) work in their own threads with
+ * their own backpressure policy, a slow database does not slow the decode.
+ * The first cycle and every reload publish a layout: the tag list with the
+ * current values, the restored values of a warm restart are "stale".
+ *
+ * The write and demand requests of the sinks come back through a queue,
+ * they are applied by the synchronizer thread, so the tag objects have one
+ * owner. A demand keeps the on-demand block of the tag polled for
+ * DEMAND_LEASE millisecs.
+ *
+ * The tag objects of a tag list are created together in one arena, they
+ * sit in a few contiguous chunks and they are freed at once.
+ *
+ * A reload() is applied by the synchronizer thread between two cycles:
+ * the tag map is swapped to a new arena, the unchanged tags keep their
+ * values, the sinks get the new layout.
  */
-class TagSynchronizer : public Thread
+class TagSynchronizer : public Thread, public TagWriteInterface
 {
 
 private:
+    /// slots of the write request queue
+    static const int WRITE_QUEUE = 4096;
+    /// millisecs between two cycles of the sink threads
+    static const int SINK_CYCLE = 50;
+    /// millisecs of the interest of a demand request
+    static const int DEMAND_LEASE = 2000;
+
     /// working cycletime
     int cycleTime;
 
@@ -29,38 +82,133 @@ private:
     MBPro* mbpro;
     /// delivered driver data interface
     ModbusDriverDataInterface* driverInterface;
-    /// sql driver for access database
-    MySQLDriver* mysqlDriver;
-    /// store the tags
+    /// sql driver of the SQL sink
+    SQLDriver* sqlDriver;
+    /// the sinks of the change stream
+    std::vector<TagSink*> sinks;
+    /// store the tags, the objects live in the arena of the tag list
     std::map<int,Tag*> tagMap;
+    Arena* tagArena;
     /// caches for tag values and validity flags
     std::map<int,std::string> tagValueCache;
     std::map<int,std::string> tagValidityCache;
+    /// the next cycle publishes a layout ( start, reload )
+    bool layoutPending;
+
+    /// the tag list of the pending reload
+    std::mutex reloadMutex;
+    std::vector<MBPro_Tag> reloadTags;
+    bool reloadPending;
+
+    /// the write requests of the sinks, they wake the synchronizer thread
+    MPSCQueue<TagWrite> writeQueue;
+    std::mutex wakeMutex;
+    std::condition_variable wakeCond;
+    bool writesPending;
+
+    /// metrics (lock-free)
+    Histogram decodeDuration;
+    Counter tagWrites;
+    Gauge tagCount;
 
-    /// build functions for build the required map for tags and create datatables
+    /// build function for build the required map for tags
     void build_tag_map();
-    void build_tables() throw( std::string );
+
+    /**
+     * @brief create_tag
+     * @param t     -> the tag parameters
+     * @param arena -> the arena of the tag list
+     * @return the new tag, NULL when the type is unknown
+     */
+    Tag* create_tag( const MBPro_Tag& t, Arena* arena );
+
+    /**
+     * @brief same_tag
+     * @return the parameters of the tag are equal
+     */
+    static bool same_tag( Tag* tag, const MBPro_Tag& t );
+
+    /**
+     * @brief apply_reload
+     *
+     * Applies the pending reload ( called by the synchronizer thread ).
+     */
+    void apply_reload();
+
+    /**
+     * @brief publish_layout
+     *
+     * Reads all tags and publishes them as a layout.
+     */
+    void publish_layout();
 
     /// read and write helper functions
     void do_read();
-    void do_write();
-
-    /// heartbeat algorythm
-    void do_heartbeat();
+    void apply_writes();
 
 public:
     /**
      * @brief TagSynchronizer
      * @param mbpro         -> delivered mbpro file
      * @param interface     -> delivered driver data interface object
+     * @param metrics       -> delivered metrics registry
+     * @param sqlDriver     -> delivered sql driver, NULL -> MySQLDriver by the db section
      *
-     * Creates the synchronizer object.
+     * Creates the synchronizer object and the sinks.
      *
      * This function throws std::string exceptions:
      *
      *      ""
      */
-    TagSynchronizer( MBPro* mbpro , ModbusDriverDataInterface* interface ) throw( std::string );
+    TagSynchronizer( MBPro* mbpro,
+                     ModbusDriverDataInterface* interface,
+                     MetricsRegistry* metrics,
+                     SQLDriver* sqlDriver = NULL ) throw( std::string );
+
+    /**
+     * @brief reload
+     * @param mbpro -> the new project
+     *
+     * Queues the new tag list, the next cycle applies it.
+     */
+    void reload( MBPro* mbpro );
+
+    /**
+     * @brief readCycle
+     *
+     * Decodes the tags and publishes the changes once ( the read half of a
+     * run() cycle ).
+     */
+    void readCycle();
+
+    /**
+     * @brief sinkCycle
+     *
+     * Processes the published changes by every sink in the calling thread
+     * ( the sink threads are not started ).
+     */
+    void sinkCycle();
+
+    /**
+     * @brief requestWrite
+     *
+     * Inherited function from TagWriteInterface class.
+     */
+    bool requestWrite( int id, const std::string& value );
+
+    /**
+     * @brief requestDemand
+     *
+     * Inherited function from TagWriteInterface class.
+     */
+    bool requestDemand( int id );
+
+    /**
+     * @brief commitWrites
+     *
+     * Inherited function from TagWriteInterface class.
+     */
+    void commitWrites();
 
     /**
      * @brief run
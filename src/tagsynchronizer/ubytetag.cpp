@@ -21,81 +21,80 @@ UByteTag::UByteTag( int id,
 
 void UByteTag::readValueFromModbusDriver( ModbusDriverDataInterface* interface )
 {
-    try
+     // get data from interface
+    uint8 _byte;
+    MBError::Code _error = interface->tryReadByte( deviceId, blockId, address, subAddress, _byte );
+
+    if( !Tag::isReadable( _error ) )
     {
-         // get data from interface
-        int _value = interface->readByte( deviceId, blockId, address, subAddress );
-
-        // multiple and add operations before set this->value
-        int _multiple = Conversion::convert<std::string,int>( this->multiple );
-        int _add = Conversion::convert<std::string,int>( this->add );
-        _value *= _multiple;
-        _value += _add;
-
-        // set limits
-        if( _value > 255 )
-        {
-            _value = 255;
-        }
-
-        if( _value < 0 )
-        {
-            _value = 0;
-        }
-
-        // refresh value
-        this->value = Conversion::convert<int,std::string>( _value );
-
-        // set validity flag
-        this->validity = "valid";
+        this->setInvalid( _error );
+        return;
     }
-    catch( std::string _ex )
+
+    int _value = _byte;
+
+    // multiple and add operations before set this->value
+    int _multiple = Conversion::convert<std::string,int>( this->multiple );
+    int _add = Conversion::convert<std::string,int>( this->add );
+    _value *= _multiple;
+    _value += _add;
+
+    // set limits
+    if( _value > 255 )
     {
-        this->validity = _ex;
-        this->value = "#";
+        _value = 255;
     }
+
+    if( _value < 0 )
+    {
+        _value = 0;
+    }
+
+    // refresh value
+    this->value = Conversion::convert<int,std::string>( _value );
+
+    // set validity flag
+    this->setValid( _error );
 }
 
 void UByteTag::writeValueToModbusDriver( ModbusDriverDataInterface* interface )
 {
-    try
+    // get value to numeric data
+    int _value = Conversion::convert<std::string,int>( this->value );
+
+    // if the input is a string we returns...
+    if( _value == 0 && this->value != "0" )
     {
-        // get value to numeric data
-        int _value = Conversion::convert<std::string,int>( this->value );
-
-        // if the input is a string we returns...
-        if( _value == 0 && this->value != "0" )
-        {
-            return;
-        }
-
-        // add and multiple reverse operations
-        int _add = Conversion::convert<std::string,int>( this->add );
-        int _multiple = Conversion::convert<std::string,int>( this->multiple );
-        _value = _value - _add;
-        _value = _value / _multiple;
-
-        // set limits
-        if( _value > 255 )
-        {
-            _value = 255;
-        }
-
-        if( _value < 0 )
-        {
-            _value = 0;
-        }
-
-        // write to modbus driver
-        interface->writeByte( deviceId, blockId, address, subAddress, _value );
-
-        this->validity = "valid";
+        return;
     }
-    catch( std::string _ex )
+
+    // add and multiple reverse operations
+    int _add = Conversion::convert<std::string,int>( this->add );
+    int _multiple = Conversion::convert<std::string,int>( this->multiple );
+    _value = _value - _add;
+    _value = _value / _multiple;
+
+    // set limits
+    if( _value > 255 )
+    {
+        _value = 255;
+    }
+
+    if( _value < 0 )
+    {
+        _value = 0;
+    }
+
+    // write to modbus driver
+    MBError::Code _error = interface->tryWriteByte( deviceId, blockId, address, subAddress, _value );
+
+    if( _error != MBError::NO_ERROR )
     {
-        this->validity = _ex;
-        this->value = "#";
+        this->setInvalid( _error );
+        return;
     }
+
+    this->validity = "valid";
 }
 
 }
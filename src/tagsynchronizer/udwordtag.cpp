@@ -21,102 +21,113 @@ UDWordTag::UDWordTag( int id,
 
 void UDWordTag::readValueFromModbusDriver( ModbusDriverDataInterface* interface )
 {
-    try
-    {
-        // get data from interface
-        uint16 _v_1;
-        uint16 _v_2;
+    // get data from interface
+    uint16 _v_1;
+    uint16 _v_2;
+    MBError::Code _error;
 
-        if( this->wordSwap )
+    if( this->wordSwap )
+    {
+        _error = interface->tryReadWord( deviceId, blockId, address, _v_1 );
+        if( Tag::isReadable( _error ) )
         {
-            _v_1 = interface->readWord( deviceId, blockId, address );
-            _v_2 = interface->readWord( deviceId, blockId, address + 1 );
+            _error = interface->tryReadWord( deviceId, blockId, address + 1, _v_2 );
         }
-        else
+    }
+    else
+    {
+        _error = interface->tryReadWord( deviceId, blockId, address + 1, _v_1 );
+        if( Tag::isReadable( _error ) )
         {
-            _v_1 = interface->readWord( deviceId, blockId, address + 1 );
-            _v_2 = interface->readWord( deviceId, blockId, address );
+            _error = interface->tryReadWord( deviceId, blockId, address, _v_2 );
         }
+    }
 
-        unsigned long long int _value = Conversion::convert<uint32,unsigned long long int>( (uint32)(_v_1*65536 + _v_2) );
-
-        // multiple and add operations before set this->value
-        int _multiple = Conversion::convert<std::string,int>( this->multiple );
-        int _add = Conversion::convert<std::string,int>( this->add );
-        _value *= _multiple;
-        _value += _add;
+    if( !Tag::isReadable( _error ) )
+    {
+        this->setInvalid( _error );
+        return;
+    }
 
-        if( _value > 4294967295 )
-        {
-            _value = 4294967295;
-        }
+    unsigned long long int _value = Conversion::convert<uint32,unsigned long long int>( (uint32)(_v_1*65536 + _v_2) );
 
-        // refresh value
-        this->value = Conversion::convert<unsigned long long int,std::string>( _value );
+    // multiple and add operations before set this->value
+    int _multiple = Conversion::convert<std::string,int>( this->multiple );
+    int _add = Conversion::convert<std::string,int>( this->add );
+    _value *= _multiple;
+    _value += _add;
 
-        // set validity flag
-        this-> validity = "valid";
-    }
-    catch( std::string _ex )
+    if( _value > 4294967295 )
     {
-        this->validity = _ex;
-        this->value = "#";
+        _value = 4294967295;
     }
+
+    // refresh value
+    this->value = Conversion::convert<unsigned long long int,std::string>( _value );
+
+    // set validity flag
+    this->setValid( _error );
 }
 
 void UDWordTag::writeValueToModbusDriver( ModbusDriverDataInterface* interface )
 {
-    try
+    // get value to numeric data
+    long long int _value = Conversion::convert<std::string,long long int>( this->value );
+
+    // if the input is a string we returns...
+    if( _value == 0 && this->value != "0" )
     {
-        // get value to numeric data
-        long long int _value = Conversion::convert<std::string,long long int>( this->value );
+        return;
+    }
 
-        // if the input is a string we returns...
-        if( _value == 0 && this->value != "0" )
-        {
-            return;
-        }
+    // add and multiple reverse operations
+    uint32 _multiple = Conversion::convert<std::string,uint32>( this->multiple );
+    uint32 _add = Conversion::convert<std::string,uint32>( this->add );
+    _value -= _add;
+    _value /= _multiple;
 
-        // add and multiple reverse operations
-        uint32 _multiple = Conversion::convert<std::string,uint32>( this->multiple );
-        uint32 _add = Conversion::convert<std::string,uint32>( this->add );
-        _value -= _add;
-        _value /= _multiple;
+    // set limits
+    if( _value < 0 )
+    {
+        _value = 0;
+    }
 
-        // set limits
-        if( _value < 0 )
-        {
-            _value = 0;
-        }
+    if( _value > 4294967295 )
+    {
+        _value = 4294967295;
+    }
 
-        if( _value > 4294967295 )
-        {
-            _value = 4294967295;
-        }
+    // write to modbus driver
+    uint16 _v_1 = _value/65536;
+    uint16 _v_2 = _value%65536;
 
-        // write to modbus driver
-        uint16 _v_1 = _value/65536;
-        uint16 _v_2 = _value%65536;
+    MBError::Code _error;
 
-        if( this->wordSwap )
+    if( this->wordSwap )
+    {
+        _error = interface->tryWriteWord( deviceId, blockId, address, _v_1 );
+        if( _error == MBError::NO_ERROR )
         {
-            interface->writeWord( deviceId, blockId, address, _v_1 );
-            interface->writeWord( deviceId, blockId, address + 1, _v_2 );
+            _error = interface->tryWriteWord( deviceId, blockId, address + 1, _v_2 );
         }
-        else
+    }
+    else
+    {
+        _error = interface->tryWriteWord( deviceId, blockId, address + 1, _v_1 );
+        if( _error == MBError::NO_ERROR )
         {
-            interface->writeWord( deviceId, blockId, address + 1, _v_1 );
-            interface->writeWord( deviceId, blockId, address, _v_2 );
+            _error = interface->tryWriteWord( deviceId, blockId, address, _v_2 );
         }
-
-        // set validity
-        this->validity = "valid";
     }
-    catch( std::string _ex )
+
+    if( _error != MBError::NO_ERROR )
     {
-        this->validity = _ex;
-        this->value = "#";
+        this->setInvalid( _error );
+        return;
     }
+
+    // set validity
+    this->validity = "valid";
 }
 
 }
@@ -21,81 +21,81 @@ UWordTag::UWordTag( int id,
 
 void UWordTag::readValueFromModbusDriver( ModbusDriverDataInterface* interface )
 {
-    try
+    // get data from interface
+    uint16 _word;
+    MBError::Code _error = interface->tryReadWord( deviceId, blockId, address, _word );
+
+    if( !Tag::isReadable( _error ) )
     {
-        // get data from interface
-        int _value = interface->readWord( deviceId, blockId, address );
-
-        // multiple and add operations before set this->value
-        int _multiple = Conversion::convert<std::string,int>( this->multiple );
-        int _add = Conversion::convert<std::string,int>( this->add );
-        _value *= _multiple;
-        _value += _add;
-
-        // set limits
-        if( _value < 0 )
-        {
-            _value = 0;
-        }
-
-        if( _value > 65535 )
-        {
-            _value = 65535;
-        }
-
-        // refresh value
-        this->value = Conversion::convert<int,std::string>( _value );
-
-        // set validity flag
-        this->validity = "valid";
+        this->setInvalid( _error );
+        return;
     }
-    catch( std::string _ex )
+
+    int _value = _word;
+
+    // multiple and add operations before set this->value
+    int _multiple = Conversion::convert<std::string,int>( this->multiple );
+    int _add = Conversion::convert<std::string,int>( this->add );
+    _value *= _multiple;
+    _value += _add;
+
+    // set limits
+    if( _value < 0 )
     {
-        this->validity = _ex;
-        this->value = "#";
+        _value = 0;
     }
+
+    if( _value > 65535 )
+    {
+        _value = 65535;
+    }
+
+    // refresh value
+    this->value = Conversion::convert<int,std::string>( _value );
+
+    // set validity flag
+    this->setValid( _error );
 }
 
 void UWordTag::writeValueToModbusDriver( ModbusDriverDataInterface* interface )
 {
-    try {
-        // get value to numeric data
-        int _value = Conversion::convert<std::string,int>( this->value );
-
-        // if the input is a string we returns...
-        if( _value == 0 && this->value != "0" )
-        {
-            return;
-        }
-
-        // add and multiple reverse operations
-        int _multiple = Conversion::convert<std::string,int>( this->multiple );
-        int _add = Conversion::convert<std::string,int>( this->add );
-        _value = _value - _add;
-        _value /= _multiple;
-
-        // set limits
-        if( _value < 0 )
-        {
-            _value = 0;
-        }
-
-        if( _value > 65535 )
-        {
-            _value = 65535;
-        }
-
-        // write to modbus driver
-        interface->writeWord( deviceId, blockId, address, _value );
-
-        // set validity
-        this->validity = "valid";
+    // get value to numeric data
+    int _value = Conversion::convert<std::string,int>( this->value );
+
+    // if the input is a string we returns...
+    if( _value == 0 && this->value != "0" )
+    {
+        return;
     }
-    catch( std::string _ex )
+
+    // add and multiple reverse operations
+    int _multiple = Conversion::convert<std::string,int>( this->multiple );
+    int _add = Conversion::convert<std::string,int>( this->add );
+    _value = _value - _add;
+    _value /= _multiple;
+
+    // set limits
+    if( _value < 0 )
+    {
+        _value = 0;
+    }
+
+    if( _value > 65535 )
     {
-        this->validity = _ex;
-        this->value = "#";
+        _value = 65535;
     }
+
+    // write to modbus driver
+    MBError::Code _error = interface->tryWriteWord( deviceId, blockId, address, _value );
+
+    if( _error != MBError::NO_ERROR )
+    {
+        this->setInvalid( _error );
+        return;
+    }
+
+    // set validity
+    this->validity = "valid";
 }
 
 }